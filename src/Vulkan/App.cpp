@@ -9,18 +9,41 @@
 #include <imgui.h>
 #include <backends/imgui_impl_vulkan.h>
 #include <backends/imgui_impl_glfw.h>
+#include <filesystem>
+#include <fstream>
 
 #include "renderers/DefaultRenderer.hpp"
 #include "renderers/InstancedRenderer.hpp"
 #include "renderers/InstancedRendererChunked.hpp"
 #include "renderers/MainComponentSystem.hpp"
+#include "benchmarks/ComponentSystemBenchmarks.hpp"
+#include "benchmarks/SpatialGridBenchmarks.hpp"
+#include "benchmarks/TransformHierarchyBenchmarks.hpp"
+#include "benchmarks/ArchetypeBenchmarks.hpp"
+#include "benchmarks/UploadBenchmarks.hpp"
+#include "benchmarks/ReadbackBenchmarks.hpp"
+#include "benchmarks/RendererBenchmarks.hpp"
+#include "benchmarks/DefragmentationBenchmarks.hpp"
 
 App::App() {
 
     spdlog::set_pattern("%^[%H:%M] [%l]%$ %v");
 
+    m_jobSystem = std::make_unique<JobSystem>(JobSystem::Config{
+        .workerCount = 0,
+        .pinThreads = true
+    });
+
     m_renderPass = std::make_unique<MainRenderPass>();
-    m_componentSystem = std::make_unique<MainComponentSystem>();
+    // A saved scene replaces generating the entities on every launch.
+    if (std::filesystem::exists(MainComponentSystem::kDefaultScenePath)) {
+        auto componentSystem = std::make_unique<MainComponentSystem>(m_jobSystem.get(), 0);
+        componentSystem->LoadScene(MainComponentSystem::kDefaultScenePath);
+        m_componentSystem = std::move(componentSystem);
+    }
+    else {
+        m_componentSystem = std::make_unique<MainComponentSystem>(m_jobSystem.get());
+    }
 
     const auto config = std::make_shared <Context::Config>();
     config->vkValidationLayers.push_back("VK_LAYER_KHRONOS_validation");
@@ -33,11 +56,22 @@ App::App() {
     Context::CreateDesc contextDesc = {
         .config = config,
         .renderPass = m_renderPass.get(),
-        .componentSystem = m_componentSystem.get()
+        .componentSystem = m_componentSystem.get(),
+        .jobSystem = m_jobSystem.get()
     };
     m_context = std::make_unique<Context>(contextDesc);
 
     OnInitializeRenderer();
+
+    m_benchmarkRunner = std::make_unique<BenchmarkRunner>(m_context->GetDevice()->GetDeviceMemory());
+    ComponentSystemBenchmarks::Register(*m_benchmarkRunner, m_jobSystem.get());
+    SpatialGridBenchmarks::Register(*m_benchmarkRunner, m_jobSystem.get());
+    TransformHierarchyBenchmarks::Register(*m_benchmarkRunner, m_jobSystem.get());
+    ArchetypeBenchmarks::Register(*m_benchmarkRunner, m_jobSystem.get());
+    DefragmentationBenchmarks::Register(*m_benchmarkRunner);
+    UploadBenchmarks::Register(*m_benchmarkRunner, m_context.get());
+    ReadbackBenchmarks::Register(*m_benchmarkRunner, m_context.get());
+    RendererBenchmarks::Register(*m_benchmarkRunner, m_context.get(), dynamic_cast<MainComponentSystem*>(m_componentSystem.get()));
 }
 
 void App::Run() {
@@ -97,6 +131,12 @@ void App::Update(const Context::RenderDesc& desc) {
         this->OnInitializeRenderer();
     }
 
+    if (ImGui::Button("Capture frame")) {
+        this->CaptureFrame();
+    }
+    ImGui::SameLine();
+    ImGui::Text("Readbacks in flight: %u", m_context->GetReadbackRing()->GetInFlightCount());
+
     const MainRenderer::RecordDesc recordDesc = {
         .renderArea = {
             .offset = {0, 0},
@@ -105,9 +145,12 @@ void App::Update(const Context::RenderDesc& desc) {
         .commandBuffer = desc.commandBuffer,
         .renderPass = desc.renderPass,
         .framebuffer = desc.framebuffer,
+        .frameGraph = desc.frameGraph
     };
     m_renderer->Record(recordDesc);
+    m_context->SetWaitBeforeSimulation(m_renderer->ReadsComponentMemory());
 
+    m_benchmarkRunner->DrawImGui();
 
     ImGui::End();
     ImGui::Render();
@@ -121,6 +164,31 @@ void App::Update(const Context::RenderDesc& desc) {
     vkCmdEndRenderPass(desc.commandBuffer);
 }
 
+void App::CaptureFrame() {
+
+    const std::string path = std::format("{}/frame_{}.ppm", kCaptureDirectory, m_captureCount++);
+
+    m_context->RequestFrameCapture([path](const void* pixels, VkExtent2D extent, VkFormat format)
+    {
+        const bool bgra = format == VK_FORMAT_B8G8R8A8_SRGB || format == VK_FORMAT_B8G8R8A8_UNORM;
+        const auto source = static_cast<const uint8_t*>(pixels);
+
+        std::vector<uint8_t> rgb(static_cast<size_t>(extent.width) * extent.height * 3);
+        for (size_t ind = 0; ind < static_cast<size_t>(extent.width) * extent.height; ind++) {
+            rgb[ind * 3 + 0] = source[ind * 4 + (bgra ? 2 : 0)];
+            rgb[ind * 3 + 1] = source[ind * 4 + 1];
+            rgb[ind * 3 + 2] = source[ind * 4 + (bgra ? 0 : 2)];
+        }
+
+        std::filesystem::create_directories(kCaptureDirectory);
+        std::ofstream file(path, std::ios::binary);
+        file << std::format("P6\n{} {}\n255\n", extent.width, extent.height);
+        file.write(reinterpret_cast<const char*>(rgb.data()), static_cast<std::streamsize>(rgb.size()));
+
+        spdlog::info("[App] Saved frame capture to {}", path);
+    });
+}
+
 void App::OnInitializeRenderer() {
 
     if (m_renderer != nullptr) {
@@ -6,6 +6,8 @@
 #include "helpers/IRenderer.hpp"
 #include "helpers/IRenderPass.hpp"
 #include "helpers/IComponentSystem.hpp"
+#include "helpers/jobs/JobSystem.hpp"
+#include "benchmarks/BenchmarkRunner.hpp"
 
 /* * *
  * NOTES:
@@ -28,10 +30,22 @@ private:
 	void Update(const Context::RenderDesc& desc);
 	void OnInitializeRenderer();
 
+	/**
+	 * Saves the next frame to kCaptureDirectory as a binary PPM once the readback arrives.
+	 */
+	void CaptureFrame();
+
+	static constexpr const char* kCaptureDirectory = "captures";
+	uint32_t m_captureCount = 0;
+
+	// Declared first, so the workers are joined after everything that submits jobs is gone.
+	std::unique_ptr<JobSystem> m_jobSystem;
+
 	std::unique_ptr<Context> m_context;
 	std::unique_ptr<IRenderer> m_renderer;
 	std::unique_ptr<IRenderPass> m_renderPass;
 	std::unique_ptr<IComponentSystem> m_componentSystem;
+	std::unique_ptr<BenchmarkRunner> m_benchmarkRunner;
 
 	std::vector<const char*> m_rendererLabels{
 		"Default",
@@ -3,6 +3,7 @@
 layout(binding = 0) uniform Matrices {
     mat4 view;
     mat4 proj;
+    float blendFactor;
 } matrices;
 
 // Vertex attributes
@@ -13,6 +14,7 @@ layout(location = 1) in vec4 inColor;
 layout(location = 2) in vec4 inTranslate;
 layout(location = 3) in vec4 inRotation;
 layout(location = 4) in vec4 inUv;
+layout(location = 5) in vec4 inPreviousTranslate;
 
 // Out
 layout(location = 0) out vec4 fragColor;
@@ -20,13 +22,19 @@ layout(location = 1) out vec2 fragTexCoord;
 
 void main() {
 
+    // blendFactor is 1 when simulating once per frame and inPreviousTranslate is not written.
+    vec4 translate = inTranslate;
+    if (matrices.blendFactor < 1.0) {
+        translate = mix(inPreviousTranslate, inTranslate, matrices.blendFactor);
+    }
+
     mat4 modelMat;
     float s = sin(inRotation.z);
 	float c = cos(inRotation.z);
     modelMat[0] = vec4(c, -s, 0.0, 0.0);
     modelMat[1] = vec4(s,  c, 0.0, 0.0);
     modelMat[2] = vec4(0.0, 0.0, 1.0, 0.0);
-    modelMat[3] = vec4(inTranslate.x, inTranslate.y, inTranslate.z, 1.0);
+    modelMat[3] = vec4(translate.x, translate.y, translate.z, 1.0);
 
     gl_Position = matrices.proj * matrices.view * modelMat * vec4(inPosition, 1.0);
     fragColor = inColor;
@@ -0,0 +1,183 @@
+#include "ArchetypeBenchmarks.hpp"
+
+#include <memory>
+
+#include <tracy/Tracy.hpp>
+
+#include "BenchmarkRunner.hpp"
+#include "../pch.hpp"
+#include "../helpers/ecs/ArchetypeStore.hpp"
+#include "../renderers/MainComponentSystem.hpp"
+
+namespace {
+
+    using Transform = MainComponentSystem::Transform;
+    using Sprite = MainComponentSystem::Sprite;
+    using MoveComponent = MainComponentSystem::MoveComponent;
+    using Animation = MainComponentSystem::Animation;
+
+    struct InstanceData
+    {
+        glm::vec4 translate;
+        glm::vec4 rotation;
+        Sprite sprite;
+    };
+
+    struct ArchetypeState
+    {
+        std::unique_ptr<ArchetypeStore> store;
+        std::vector<Entity> entities;
+        std::vector<InstanceData> instances;
+        std::mt19937 rndEngine;
+        double time = 0;
+    };
+
+    Entity CreateEntity(ArchetypeStore& store, std::mt19937& rndEngine, uint32_t staticFraction) {
+
+        std::uniform_real_distribution<float> positionDist(-100, 100);
+        std::uniform_real_distribution<float> phaseDist(0, 6.28f);
+
+        const glm::vec4 center = glm::vec4(positionDist(rndEngine), positionDist(rndEngine), 0, 0);
+        const Transform transform = { .translate = center };
+        const Sprite sprite = { 0.0f, 0.125f, 0.0f, 1.0f };
+
+        if (rndEngine() % staticFraction == 0) {
+            return store.Create(transform, sprite);
+        }
+
+        const MoveComponent moveComponent = {
+            .center = center,
+            .amplitude = 1.0f,
+            .phase = phaseDist(rndEngine)
+        };
+        const Animation animation = {
+            .definition = MainComponentSystem::kDefaultAnimation,
+            .phase = static_cast<uint16_t>(rndEngine())
+        };
+        return store.Create(transform, moveComponent, sprite, animation);
+    }
+
+    void CreateStore(ArchetypeState& state, uint32_t entityCount, uint32_t staticFraction) {
+
+        state.rndEngine.seed(42);
+        state.store = std::make_unique<ArchetypeStore>();
+        state.entities.resize(entityCount);
+
+        for (Entity& entity : state.entities) {
+            entity = CreateEntity(*state.store, state.rndEngine, staticFraction);
+        }
+
+        spdlog::info("[ArchetypeBenchmarks] {} entities in {} archetypes, {} chunks",
+            state.store->GetEntityCount(), state.store->GetArchetypeCount(), state.store->GetChunkCount());
+    }
+}
+
+void ArchetypeBenchmarks::Register(BenchmarkRunner& runner, JobSystem* jobSystem) {
+
+    ArchetypeBenchmarks::RegisterUpdate(runner, jobSystem);
+    ArchetypeBenchmarks::RegisterPacking(runner);
+    ArchetypeBenchmarks::RegisterChurn(runner);
+}
+
+void ArchetypeBenchmarks::RegisterUpdate(BenchmarkRunner& runner, JobSystem* jobSystem) {
+
+    const auto state = std::make_shared<ArchetypeState>();
+    const auto query = std::make_shared<std::unique_ptr<ArchetypeQuery<Transform, const MoveComponent>>>();
+
+    runner.Register(BenchmarkRunner::Desc{
+        .name = std::format("Archetype movement query, {} entities", kEntityCount),
+        .iterations = 100,
+        .setUp = [state, query]
+        {
+            CreateStore(*state, kEntityCount, kStaticFraction);
+            *query = std::make_unique<ArchetypeQuery<Transform, const MoveComponent>>(state->store.get());
+        },
+        .iteration = [state, query, jobSystem]
+        {
+            state->time += 0.016;
+            const double currentTime = state->time;
+
+            (*query)->ParallelForEachChunk(jobSystem, "Archetype movement chunks", [currentTime](const Entity*, uint32_t count, Transform* transforms, const MoveComponent* moveComponents)
+            {
+                for (uint32_t ind = 0; ind < count; ind++) {
+                    transforms[ind].translate = moveComponents[ind].center;
+                    transforms[ind].translate.y += static_cast<float>(sin(moveComponents[ind].phase + currentTime)) * moveComponents[ind].amplitude;
+                }
+            });
+        },
+        .tearDown = [state, query]
+        {
+            *query = nullptr;
+            state->store = nullptr;
+            state->entities = {};
+        }
+    });
+}
+
+void ArchetypeBenchmarks::RegisterPacking(BenchmarkRunner& runner) {
+
+    const auto state = std::make_shared<ArchetypeState>();
+    const auto query = std::make_shared<std::unique_ptr<ArchetypeQuery<const Transform, const Sprite>>>();
+
+    runner.Register(BenchmarkRunner::Desc{
+        .name = std::format("Archetype instance packing, {} entities", kEntityCount),
+        .iterations = 100,
+        .setUp = [state, query]
+        {
+            CreateStore(*state, kEntityCount, kStaticFraction);
+            state->instances.resize(kEntityCount);
+            *query = std::make_unique<ArchetypeQuery<const Transform, const Sprite>>(state->store.get());
+        },
+        .iteration = [state, query]
+        {
+            InstanceData* instancesPtr = state->instances.data();
+
+            (*query)->ForEachChunk([&instancesPtr](const Entity*, uint32_t count, const Transform* transforms, const Sprite* sprites)
+            {
+                for (uint32_t ind = 0; ind < count; ind++) {
+                    instancesPtr[ind].translate = transforms[ind].translate;
+                    instancesPtr[ind].sprite = sprites[ind];
+                }
+                instancesPtr += count;
+            });
+        },
+        .tearDown = [state, query]
+        {
+            *query = nullptr;
+            state->store = nullptr;
+            state->entities = {};
+            state->instances = {};
+        }
+    });
+}
+
+void ArchetypeBenchmarks::RegisterChurn(BenchmarkRunner& runner) {
+
+    const auto state = std::make_shared<ArchetypeState>();
+
+    runner.Register(BenchmarkRunner::Desc{
+        .name = std::format("Archetype churn 10% of {} entities", kEntityCount),
+        .iterations = 100,
+        .setUp = [state]
+        {
+            CreateStore(*state, kEntityCount, kStaticFraction);
+        },
+        .iteration = [state]
+        {
+            const uint32_t replaceCount = kEntityCount / 10;
+            std::uniform_int_distribution<uint32_t> entityDist(0, kEntityCount - 1);
+
+            for (uint32_t ind = 0; ind < replaceCount; ind++) {
+
+                Entity& entity = state->entities[entityDist(state->rndEngine)];
+                state->store->Destroy(entity);
+                entity = CreateEntity(*state->store, state->rndEngine, kStaticFraction);
+            }
+        },
+        .tearDown = [state]
+        {
+            state->store = nullptr;
+            state->entities = {};
+        }
+    });
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+
+class BenchmarkRunner;
+class JobSystem;
+
+class ArchetypeBenchmarks
+{
+public:
+	static void Register(BenchmarkRunner& runner, JobSystem* jobSystem);
+
+private:
+	/**
+	 * Moves every entity that has a MoveComponent, one chunk per job. kStaticFraction of the entities have no
+	 * MoveComponent and are never touched.
+	 */
+	static void RegisterUpdate(BenchmarkRunner& runner, JobSystem* jobSystem);
+
+	/**
+	 * Packs the transform and sprite of every entity into instance data, chunk by chunk, the way an upload loop
+	 * over the archetype store would.
+	 */
+	static void RegisterPacking(BenchmarkRunner& runner);
+
+	/**
+	 * Replaces 10% of the entities with new ones every iteration, comparable to the component system churn.
+	 */
+	static void RegisterChurn(BenchmarkRunner& runner);
+
+	static constexpr uint32_t kEntityCount = 1000000;
+	static constexpr uint32_t kStaticFraction = 10;
+};
\ No newline at end of file
@@ -0,0 +1,240 @@
+#include "BenchmarkRunner.hpp"
+
+#include <tracy/Tracy.hpp>
+
+#include "../pch.hpp"
+#include "../helpers/DeviceMemory.hpp"
+
+#include <fstream>
+
+namespace {
+
+    std::string EscapeJson(const std::string& text) {
+
+        std::string escaped;
+        for (const char character : text) {
+            if (character == '"' || character == '\\') {
+                escaped += '\\';
+            }
+            escaped += character;
+        }
+        return escaped;
+    }
+
+    std::string CounterToJson(const DeviceMemory::Counter& counter) {
+        return std::format(R"({{ "liveSize": {}, "highWaterMark": {}, "liveCount": {} }})", counter.liveSize, counter.highWaterMark, counter.liveCount);
+    }
+
+    std::string CountsToJson(const DeviceMemory::Counts& counts) {
+        return std::format(R"({{ "allocationCount": {}, "freeCount": {}, "memoryAllocationCount": {}, "memoryFreeCount": {} }})",
+            counts.allocationCount, counts.freeCount, counts.memoryAllocationCount, counts.memoryFreeCount);
+    }
+}
+
+BenchmarkRunner::BenchmarkRunner(DeviceMemory* deviceMemory) {
+
+    m_deviceMemory = deviceMemory;
+}
+
+void BenchmarkRunner::Register(const BenchmarkRunner::Desc& desc) {
+
+    if (!desc.iteration) {
+        throw std::runtime_error("[BenchmarkRunner] Benchmark " + desc.name + " has no iteration function");
+    }
+
+    m_benchmarks.push_back(desc);
+}
+
+void BenchmarkRunner::Run(const std::string& name) {
+
+    const auto found = std::ranges::find_if(m_benchmarks, [&name](const BenchmarkRunner::Desc& desc)
+    {
+        return desc.name == name;
+    });
+
+    if (found == m_benchmarks.end()) {
+        spdlog::error("[BenchmarkRunner] Unknown benchmark: {}", name);
+        return;
+    }
+
+    this->StoreResult(this->RunBenchmark(*found));
+}
+
+void BenchmarkRunner::RunAll() {
+
+    for (const auto& benchmark : m_benchmarks) {
+        this->StoreResult(this->RunBenchmark(benchmark));
+    }
+
+    this->WriteJson(kResultsPath);
+}
+
+void BenchmarkRunner::DrawImGui() {
+
+    if (!ImGui::CollapsingHeader("Benchmarks")) {
+        return;
+    }
+
+    if (ImGui::Button("Run all")) {
+        this->RunAll();
+    }
+
+    for (const auto& benchmark : m_benchmarks) {
+
+        if (ImGui::Button(benchmark.name.c_str())) {
+            this->Run(benchmark.name);
+        }
+
+        const auto result = std::ranges::find_if(m_results, [&benchmark](const BenchmarkRunner::Result& result)
+        {
+            return result.name == benchmark.name;
+        });
+
+        if (result != m_results.end()) {
+            ImGui::SameLine();
+            ImGui::Text("avg %.3f ms, median %.3f ms, min %.3f ms, max %.3f ms", result->averageMs, result->medianMs, result->minMs, result->maxMs);
+
+            if (m_deviceMemory != nullptr && result->allocationCount > 0) {
+                ImGui::SameLine();
+                ImGui::Text(", %llu allocations, peak %.2f MB, retained %.2f MB", static_cast<unsigned long long>(result->allocationCount),
+                    static_cast<double>(result->peakBytes) / 1024.0 / 1024.0, static_cast<double>(result->retainedBytes) / 1024.0 / 1024.0);
+            }
+        }
+    }
+}
+
+const std::vector<BenchmarkRunner::Result>& BenchmarkRunner::GetResults() const {
+    return m_results;
+}
+
+void BenchmarkRunner::WriteJson(const std::string& path) const {
+
+    std::ofstream file(path, std::ios::trunc);
+    if (!file) {
+        spdlog::error("[BenchmarkRunner] Could not open {} for writing", path);
+        return;
+    }
+
+    file << "{\n  \"results\": [";
+    for (size_t ind = 0; ind < m_results.size(); ind++) {
+
+        const Result& result = m_results[ind];
+        file << (ind == 0 ? "\n" : ",\n") << std::format(
+            R"(    {{ "name": "{}", "iterations": {}, "minMs": {}, "averageMs": {}, "medianMs": {}, "maxMs": {}, )"
+            R"("retainedBytes": {}, "peakBytes": {}, "allocationCount": {}, "freeCount": {} }})",
+            EscapeJson(result.name), result.iterations, result.minMs, result.averageMs, result.medianMs, result.maxMs,
+            result.retainedBytes, result.peakBytes, result.allocationCount, result.freeCount);
+    }
+    file << "\n  ]";
+
+    if (m_deviceMemory != nullptr) {
+
+        const DeviceMemory::Snapshot snapshot = m_deviceMemory->GetSnapshot();
+
+        file << ",\n  \"memory\": {\n";
+        file << "    \"resources\": " << CounterToJson(snapshot.resources) << ",\n";
+        file << "    \"memory\": " << CounterToJson(snapshot.memory) << ",\n";
+
+        file << "    \"categories\": {";
+        for (uint32_t category = 0; category < DeviceMemory::kCategoryCount; category++) {
+            file << (category == 0 ? "\n" : ",\n") << std::format(R"(      "{}": {})",
+                DeviceMemory::GetCategoryName(static_cast<MemoryCategory>(category)), CounterToJson(snapshot.categories[category]));
+        }
+        file << "\n    },\n";
+
+        file << "    \"memoryTypes\": [";
+        for (size_t typeInd = 0; typeInd < snapshot.memoryTypes.size(); typeInd++) {
+            file << (typeInd == 0 ? "\n      " : ",\n      ") << CounterToJson(snapshot.memoryTypes[typeInd]);
+        }
+        file << "\n    ],\n";
+
+        file << "    \"frame\": " << CountsToJson(snapshot.frame) << ",\n";
+        file << "    \"total\": " << CountsToJson(snapshot.total) << "\n  }";
+    }
+
+    file << "\n}\n";
+    spdlog::info("[BenchmarkRunner] Wrote {} results to {}", m_results.size(), path);
+}
+
+BenchmarkRunner::Result BenchmarkRunner::RunBenchmark(const BenchmarkRunner::Desc& desc) {
+
+    ZoneScoped;
+    ZoneText(desc.name.c_str(), desc.name.size());
+
+    spdlog::info("[BenchmarkRunner] Running {} ({} iterations)", desc.name, desc.iterations);
+
+    DeviceMemory::Snapshot memoryBefore{};
+    if (m_deviceMemory != nullptr) {
+        m_deviceMemory->ResetHighWaterMarks();
+        memoryBefore = m_deviceMemory->GetSnapshot();
+    }
+
+    if (desc.setUp) {
+        desc.setUp();
+    }
+
+    std::vector<double> timings;
+    timings.reserve(desc.iterations);
+
+    for (uint32_t ind = 0; ind < desc.iterations; ind++) {
+
+        const auto start = std::chrono::high_resolution_clock::now();
+        desc.iteration();
+        const auto end = std::chrono::high_resolution_clock::now();
+
+        timings.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+    }
+
+    if (desc.tearDown) {
+        desc.tearDown();
+    }
+
+    BenchmarkRunner::Result result = {
+        .name = desc.name,
+        .iterations = desc.iterations
+    };
+
+    if (!timings.empty()) {
+        std::ranges::sort(timings);
+
+        result.minMs = timings.front();
+        result.maxMs = timings.back();
+        result.medianMs = timings[timings.size() / 2];
+        result.averageMs = std::accumulate(timings.begin(), timings.end(), 0.0) / static_cast<double>(timings.size());
+    }
+
+    // Set up and tear down are included, a benchmark should leave the memory as it found it.
+    if (m_deviceMemory != nullptr) {
+
+        const DeviceMemory::Snapshot memoryAfter = m_deviceMemory->GetSnapshot();
+
+        result.retainedBytes = static_cast<int64_t>(memoryAfter.resources.liveSize) - static_cast<int64_t>(memoryBefore.resources.liveSize);
+        result.peakBytes = memoryAfter.resources.highWaterMark - memoryBefore.resources.liveSize;
+        result.allocationCount = memoryAfter.total.allocationCount - memoryBefore.total.allocationCount;
+        result.freeCount = memoryAfter.total.freeCount - memoryBefore.total.freeCount;
+
+        if (result.retainedBytes != 0) {
+            spdlog::warn("[BenchmarkRunner] {} retained {} bytes of device memory", result.name, result.retainedBytes);
+        }
+    }
+
+    spdlog::info("[BenchmarkRunner] {}: avg {:.3f} ms, median {:.3f} ms, min {:.3f} ms, max {:.3f} ms",
+        result.name, result.averageMs, result.medianMs, result.minMs, result.maxMs);
+
+    return result;
+}
+
+void BenchmarkRunner::StoreResult(const BenchmarkRunner::Result& result) {
+
+    const auto found = std::ranges::find_if(m_results, [&result](const BenchmarkRunner::Result& stored)
+    {
+        return stored.name == result.name;
+    });
+
+    if (found != m_results.end()) {
+        *found = result;
+        return;
+    }
+
+    m_results.push_back(result);
+}
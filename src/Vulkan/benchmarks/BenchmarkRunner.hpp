@@ -0,0 +1,96 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <functional>
+
+class DeviceMemory;
+
+/**
+ * Runs named CPU-side benchmarks on demand from the debug window and keeps the last result of each.
+ * Results are also written to the log, and RunAll writes them as JSON, so they can be compared between builds.
+ */
+class BenchmarkRunner
+{
+public:
+
+	static constexpr const char* kResultsPath = "benchmarks.json";
+
+	/**
+	 * \param deviceMemory Optional. The device memory the benchmarks allocate and free is then recorded too, so
+	 * memory regressions show up next to the timings.
+	 */
+	explicit BenchmarkRunner(DeviceMemory* deviceMemory = nullptr);
+
+	struct Desc
+	{
+		std::string name;
+		uint32_t iterations;
+
+		/**
+		 * Optional. Called once before the timed iterations.
+		 */
+		std::function<void()> setUp;
+
+		/**
+		 * Timed.
+		 */
+		std::function<void()> iteration;
+
+		/**
+		 * Optional. Called once after the timed iterations.
+		 */
+		std::function<void()> tearDown;
+	};
+
+	struct Result
+	{
+		std::string name;
+		uint32_t iterations;
+
+		double minMs{};
+		double averageMs{};
+		double medianMs{};
+		double maxMs{};
+
+		/**
+		 * Change of the live resource bytes over the whole benchmark, anything but 0 was not freed again.
+		 */
+		int64_t retainedBytes{};
+
+		/**
+		 * Most resource bytes live at once on top of what was live before.
+		 */
+		uint64_t peakBytes{};
+		uint64_t allocationCount{};
+		uint64_t freeCount{};
+	};
+
+	void Register(const BenchmarkRunner::Desc& desc);
+
+	void Run(const std::string& name);
+	void RunAll();
+
+	/**
+	 * Must be called inside an ImGui window.
+	 */
+	void DrawImGui();
+
+	[[nodiscard]] const std::vector<BenchmarkRunner::Result>& GetResults() const;
+
+	/**
+	 * The last results, followed by a snapshot of the device memory if there is one.
+	 */
+	void WriteJson(const std::string& path) const;
+
+private:
+
+	BenchmarkRunner::Result RunBenchmark(const BenchmarkRunner::Desc& desc);
+	void StoreResult(const BenchmarkRunner::Result& result);
+
+	DeviceMemory* m_deviceMemory;
+
+	std::vector<BenchmarkRunner::Desc> m_benchmarks;
+	std::vector<BenchmarkRunner::Result> m_results;
+};
@@ -0,0 +1,216 @@
+#include "ComponentSystemBenchmarks.hpp"
+
+#include <memory>
+
+#include <tracy/Tracy.hpp>
+
+#include "BenchmarkRunner.hpp"
+#include "../pch.hpp"
+#include "../renderers/MainComponentSystem.hpp"
+
+namespace {
+
+    struct InstanceData
+    {
+        glm::vec4 translate;
+        glm::vec4 rotation;
+        MainComponentSystem::Sprite sprite;
+    };
+
+    struct ChurnState
+    {
+        std::unique_ptr<MainComponentSystem> componentSystem;
+        std::vector<InstanceData> instances;
+        std::mt19937 rndEngine;
+    };
+
+    struct AnimationEquivalenceState
+    {
+        std::unique_ptr<MainComponentSystem> fullPass;
+        std::unique_ptr<MainComponentSystem> eventDriven;
+        std::mt19937 rndEngine;
+        double time = 0.0;
+        uint32_t iteration = 0;
+    };
+
+    const char* GetModeName(HugePageMode mode) {
+
+        switch (mode) {
+        case HugePageMode::Disabled:
+            return "4 KB pages";
+        case HugePageMode::Transparent:
+            return "transparent huge pages";
+        case HugePageMode::Explicit:
+            return "explicit huge pages";
+        }
+
+        return "unknown";
+    }
+}
+
+void ComponentSystemBenchmarks::Register(BenchmarkRunner& runner, JobSystem* jobSystem) {
+
+    ComponentSystemBenchmarks::RegisterConstruction(runner, jobSystem, ComponentSystemBenchmarks::kEntityCount);
+
+    ComponentSystemBenchmarks::RegisterUpdate(runner, jobSystem, HugePageMode::Disabled);
+    ComponentSystemBenchmarks::RegisterUpdate(runner, jobSystem, HugePageMode::Transparent);
+
+    ComponentSystemBenchmarks::RegisterChurn(runner, jobSystem, ComponentSystemBenchmarks::kEntityCount / 10);
+    ComponentSystemBenchmarks::RegisterChurn(runner, jobSystem, ComponentSystemBenchmarks::kEntityCount);
+
+    ComponentSystemBenchmarks::RegisterAnimationEquivalence(runner, jobSystem, ComponentSystemBenchmarks::kEntityCount / 10);
+}
+
+void ComponentSystemBenchmarks::RegisterConstruction(BenchmarkRunner& runner, JobSystem* jobSystem, uint32_t entityCount) {
+
+    const auto componentSystem = std::make_shared<std::unique_ptr<MainComponentSystem>>();
+
+    runner.Register(BenchmarkRunner::Desc{
+        .name = std::format("Construct with {} entities", entityCount),
+        .iterations = 20,
+        .iteration = [componentSystem, jobSystem, entityCount]
+        {
+            *componentSystem = std::make_unique<MainComponentSystem>(jobSystem, entityCount);
+        },
+        .tearDown = [componentSystem]
+        {
+            *componentSystem = nullptr;
+        }
+    });
+}
+
+void ComponentSystemBenchmarks::RegisterUpdate(BenchmarkRunner& runner, JobSystem* jobSystem, HugePageMode mode) {
+
+    const auto componentSystem = std::make_shared<std::unique_ptr<MainComponentSystem>>();
+
+    runner.Register(BenchmarkRunner::Desc{
+        .name = std::format("Update {} entities, {}", ComponentSystemBenchmarks::kEntityCount, GetModeName(mode)),
+        .iterations = 100,
+        .setUp = [componentSystem, jobSystem, mode]
+        {
+            const HugePageMode previousMode = HugePages::GetMode();
+            HugePages::SetMode(mode);
+            *componentSystem = std::make_unique<MainComponentSystem>(jobSystem, ComponentSystemBenchmarks::kEntityCount);
+            HugePages::SetMode(previousMode);
+        },
+        .iteration = [componentSystem]
+        {
+            (*componentSystem)->Update();
+        },
+        .tearDown = [componentSystem]
+        {
+            *componentSystem = nullptr;
+        }
+    });
+}
+
+void ComponentSystemBenchmarks::RegisterChurn(BenchmarkRunner& runner, JobSystem* jobSystem, uint32_t entityCount) {
+
+    const auto state = std::make_shared<ChurnState>();
+
+    runner.Register(BenchmarkRunner::Desc{
+        .name = std::format("Churn 10% of {} entities", entityCount),
+        .iterations = 100,
+        .setUp = [state, jobSystem, entityCount]
+        {
+            state->componentSystem = std::make_unique<MainComponentSystem>(jobSystem);
+            state->componentSystem->SetEntityCount(entityCount);
+            state->instances.resize(entityCount);
+            state->rndEngine.seed(42);
+        },
+        .iteration = [state]
+        {
+            MainComponentSystem* componentSystem = state->componentSystem.get();
+            const uint32_t replaceCount = componentSystem->GetEntityCount() / 10;
+
+            {
+                ZoneScopedN("Despawn");
+                for (uint32_t ind = 0; ind < replaceCount; ind++) {
+                    std::uniform_int_distribution<uint32_t> denseDist(0, componentSystem->GetEntityCount() - 1);
+                    componentSystem->Despawn(componentSystem->GetEntities()[denseDist(state->rndEngine)]);
+                }
+            }
+
+            {
+                ZoneScopedN("Spawn");
+                for (uint32_t ind = 0; ind < replaceCount; ind++) {
+                    componentSystem->Spawn();
+                }
+            }
+
+            componentSystem->Update();
+
+            {
+                ZoneScopedN("Pack instances");
+                const uint32_t instanceCount = componentSystem->GetEntityCount();
+                const auto& transforms = componentSystem->GetTransforms();
+                const auto& sprites = componentSystem->GetSprites();
+
+                for (uint32_t ind = 0; ind < instanceCount; ind++) {
+                    state->instances[ind].translate = transforms[ind].translate;
+                    state->instances[ind].sprite = sprites[ind];
+                }
+            }
+        },
+        .tearDown = [state]
+        {
+            state->componentSystem = nullptr;
+            state->instances.clear();
+            state->instances.shrink_to_fit();
+        }
+    });
+}
+
+void ComponentSystemBenchmarks::RegisterAnimationEquivalence(BenchmarkRunner& runner, JobSystem* jobSystem, uint32_t entityCount) {
+
+    const auto state = std::make_shared<AnimationEquivalenceState>();
+
+    runner.Register(BenchmarkRunner::Desc{
+        .name = std::format("Event-driven animation matches the full pass, {} entities", entityCount),
+        .iterations = kEquivalenceIterations,
+        .setUp = [state, jobSystem, entityCount]
+        {
+            // Same seed, so both start out with the same entities.
+            state->fullPass = std::make_unique<MainComponentSystem>(jobSystem, entityCount);
+            state->eventDriven = std::make_unique<MainComponentSystem>(jobSystem, entityCount);
+            state->eventDriven->RequestEventDrivenAnimation(true);
+
+            state->rndEngine.seed(42);
+            state->time = 100.0;
+            state->iteration = 0;
+        },
+        .iteration = [state, entityCount]
+        {
+            // Halfway through both grow, which the wheel has to pick up.
+            if (state->iteration == kEquivalenceIterations / 2) {
+                state->fullPass->RequestEntityCount(entityCount + entityCount / 2);
+                state->eventDriven->RequestEntityCount(entityCount + entityCount / 2);
+            }
+            state->iteration++;
+
+            std::uniform_real_distribution<double> intervalDist(0.0, kMaxEquivalenceInterval);
+            state->time += intervalDist(state->rndEngine);
+
+            state->fullPass->UpdateAt(state->time);
+            state->eventDriven->UpdateAt(state->time);
+
+            const uint32_t count = state->fullPass->GetEntityCount();
+            if (state->eventDriven->GetEntityCount() != count) {
+                throw std::runtime_error(std::format("[ComponentSystemBenchmarks] Entity counts differ, {} and {}", count, state->eventDriven->GetEntityCount()));
+            }
+
+            const MainComponentSystem::Sprite* expected = state->fullPass->GetSprites().data();
+            const MainComponentSystem::Sprite* actual = state->eventDriven->GetSprites().data();
+            for (uint32_t ind = 0; ind < count; ind++) {
+                if (std::memcmp(&expected[ind], &actual[ind], sizeof(MainComponentSystem::Sprite)) != 0) {
+                    throw std::runtime_error(std::format("[ComponentSystemBenchmarks] Sprite {} differs from the full pass at update {}, time {}", ind, state->iteration, state->time));
+                }
+            }
+        },
+        .tearDown = [state]
+        {
+            state->fullPass = nullptr;
+            state->eventDriven = nullptr;
+        }
+    });
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+
+#include "../helpers/memory/HugePageAllocator.hpp"
+
+class BenchmarkRunner;
+class JobSystem;
+
+class ComponentSystemBenchmarks
+{
+public:
+	static void Register(BenchmarkRunner& runner, JobSystem* jobSystem);
+
+private:
+
+	/**
+	 * The entity limit is far beyond what these are meant to measure, so they keep to a fixed count.
+	 */
+	static constexpr uint32_t kEntityCount = 1000000;
+
+	/**
+	 * Constructs the component system with the given number of randomly generated entities.
+	 */
+	static void RegisterConstruction(BenchmarkRunner& runner, JobSystem* jobSystem, uint32_t entityCount);
+
+	/**
+	 * Update on all the entities, with the columns allocated in the given page mode.
+	 */
+	static void RegisterUpdate(BenchmarkRunner& runner, JobSystem* jobSystem, HugePageMode mode);
+
+	/**
+	 * Replaces 10% of the entities with new ones every iteration, then updates and packs the instance data
+	 * the same way InstancedRenderer does.
+	 */
+	static void RegisterChurn(BenchmarkRunner& runner, JobSystem* jobSystem, uint32_t entityCount);
+
+	/**
+	 * Updates a full-pass and an event-driven system side by side at random intervals, with a resize halfway.
+	 * Throws as soon as a sprite differs.
+	 */
+	static void RegisterAnimationEquivalence(BenchmarkRunner& runner, JobSystem* jobSystem, uint32_t entityCount);
+
+	static constexpr uint32_t kEquivalenceIterations = 600;
+
+	/**
+	 * Seconds. Longer than a frame, so some updates skip more than one frame change.
+	 */
+	static constexpr double kMaxEquivalenceInterval = 0.1;
+};
\ No newline at end of file
@@ -0,0 +1,198 @@
+#include "DefragmentationBenchmarks.hpp"
+
+#include <memory>
+
+#include <tracy/Tracy.hpp>
+
+#include "BenchmarkRunner.hpp"
+#include "../pch.hpp"
+#include "../helpers/memory/DefragmentationPlanner.hpp"
+
+namespace {
+
+    struct LiveAllocation
+    {
+        uint32_t block;
+        DefragmentationPlanner::Allocation allocation;
+    };
+
+    struct SimulationState
+    {
+        std::vector<BlockAllocator> blocks;
+        std::vector<LiveAllocation> allocations;
+    };
+
+    uint32_t CountUsedBlocks(const std::vector<BlockAllocator>& blocks) {
+        return static_cast<uint32_t>(std::ranges::count_if(blocks, [](const BlockAllocator& block) { return !block.IsEmpty(); }));
+    }
+
+    /**
+     * Sizes from a few kilobytes to a few megabytes like instance segments and meshes, first fit like DeviceMemory.
+     */
+    SimulationState CreateFragmentedBlocks(uint32_t allocationCount, double freedShare, uint64_t blockSize) {
+
+        std::mt19937 rndEngine(42);
+        std::uniform_int_distribution<uint64_t> pageDist(1, 512);
+        std::uniform_real_distribution<double> freeDist(0.0, 1.0);
+
+        SimulationState state;
+        for (uint32_t id = 0; id < allocationCount; id++) {
+
+            const uint64_t size = pageDist(rndEngine) * 4096;
+            const uint64_t alignment = 256;
+
+            std::optional<uint64_t> offset;
+            uint32_t block = 0;
+            for (; block < state.blocks.size() && !offset.has_value(); block++) {
+                offset = state.blocks[block].Allocate(size, alignment);
+            }
+            if (!offset.has_value()) {
+                block = static_cast<uint32_t>(state.blocks.size());
+                offset = state.blocks.emplace_back(blockSize).Allocate(size, alignment);
+            }
+            else {
+                block--;
+            }
+
+            state.allocations.push_back(LiveAllocation{
+                .block = block,
+                .allocation = {
+                    .id = id,
+                    .offset = *offset,
+                    .size = size,
+                    .alignment = alignment
+                }
+            });
+        }
+
+        std::erase_if(state.allocations, [&](const LiveAllocation& live)
+        {
+            if (freeDist(rndEngine) >= freedShare) {
+                return false;
+            }
+            state.blocks[live.block].Free(live.allocation.offset, live.allocation.size);
+            return true;
+        });
+
+        return state;
+    }
+
+    /**
+     * Places every allocation into fresh blocks, which fails if two of them overlap.
+     */
+    void ValidateNoOverlap(const SimulationState& state, uint64_t blockSize) {
+
+        std::vector<BlockAllocator> blocks(state.blocks.size(), BlockAllocator(blockSize));
+        for (const LiveAllocation& live : state.allocations) {
+
+            if (!blocks[live.block].AllocateAt(live.allocation.offset, live.allocation.size)) {
+                throw std::runtime_error(std::format("[DefragmentationBenchmarks] Allocation {} overlaps another", live.allocation.id));
+            }
+        }
+
+        for (uint32_t block = 0; block < blocks.size(); block++) {
+            if (blocks[block].GetUsedSize() != state.blocks[block].GetUsedSize()) {
+                throw std::runtime_error(std::format("[DefragmentationBenchmarks] Block {} lost track of its allocations", block));
+            }
+        }
+    }
+
+    /**
+     * \return Number of steps until the planner had nothing left to move.
+     */
+    uint32_t RunSimulation(SimulationState& state, uint64_t maxBytesPerStep) {
+
+        const uint32_t initialBlockCount = CountUsedBlocks(state.blocks);
+
+        uint32_t stepCount = 0;
+        while (true) {
+
+            std::vector<DefragmentationPlanner::Block> blocks;
+            for (const BlockAllocator& allocator : state.blocks) {
+                blocks.push_back(DefragmentationPlanner::Block{
+                    .allocator = allocator,
+                    .allocations = {}
+                });
+            }
+
+            // Ids double as indices, the planner only hands them back.
+            for (uint32_t index = 0; index < state.allocations.size(); index++) {
+                DefragmentationPlanner::Allocation allocation = state.allocations[index].allocation;
+                allocation.id = index;
+                blocks[state.allocations[index].block].allocations.push_back(allocation);
+            }
+
+            const std::vector<DefragmentationPlanner::Move> moves = DefragmentationPlanner::Plan(blocks, DefragmentationPlanner::Desc{
+                .maxSourceUsage = 0.5,
+                .maxBytesPerStep = maxBytesPerStep
+            });
+            if (moves.empty()) {
+                break;
+            }
+
+            const uint32_t blockCount = CountUsedBlocks(state.blocks);
+
+            // Destinations first and sources afterwards, the order the Defragmenter finishes moves in.
+            for (const DefragmentationPlanner::Move& move : moves) {
+
+                const LiveAllocation& live = state.allocations[move.id];
+                if (live.block != move.srcBlock || !state.blocks[move.dstBlock].AllocateAt(move.dstOffset, live.allocation.size)) {
+                    throw std::runtime_error(std::format("[DefragmentationBenchmarks] Step {} planned an invalid move", stepCount));
+                }
+            }
+            for (const DefragmentationPlanner::Move& move : moves) {
+
+                LiveAllocation& live = state.allocations[move.id];
+                state.blocks[live.block].Free(live.allocation.offset, live.allocation.size);
+                live.block = move.dstBlock;
+                live.allocation.offset = move.dstOffset;
+            }
+
+            if (CountUsedBlocks(state.blocks) >= blockCount) {
+                throw std::runtime_error(std::format("[DefragmentationBenchmarks] Step {} did not free a block", stepCount));
+            }
+            stepCount++;
+        }
+
+        spdlog::debug("[DefragmentationBenchmarks] {} steps, {} blocks down to {}", stepCount, initialBlockCount, CountUsedBlocks(state.blocks));
+        return stepCount;
+    }
+}
+
+void DefragmentationBenchmarks::Register(BenchmarkRunner& runner) {
+
+    DefragmentationBenchmarks::RegisterSimulation(runner, 10000, 0.7);
+    DefragmentationBenchmarks::RegisterSimulation(runner, 50000, 0.9);
+}
+
+void DefragmentationBenchmarks::RegisterSimulation(BenchmarkRunner& runner, uint32_t allocationCount, double freedShare) {
+
+    const auto state = std::make_shared<SimulationState>();
+    const auto initialState = std::make_shared<SimulationState>();
+
+    runner.Register(BenchmarkRunner::Desc{
+        .name = std::format("Defragmentation planner, {} allocations, {:.0f}% freed", allocationCount, freedShare * 100.0),
+        .iterations = 10,
+        .setUp = [initialState, allocationCount, freedShare]
+        {
+            *initialState = CreateFragmentedBlocks(allocationCount, freedShare, kBlockSize);
+        },
+        .iteration = [state, initialState]
+        {
+            *state = *initialState;
+
+            const uint32_t allocationCount = static_cast<uint32_t>(state->allocations.size());
+            RunSimulation(*state, kMaxBytesPerStep);
+
+            if (state->allocations.size() != allocationCount) {
+                throw std::runtime_error("[DefragmentationBenchmarks] Allocations were lost");
+            }
+            ValidateNoOverlap(*state, kBlockSize);
+        },
+        .tearDown = [state, initialState]
+        {
+            *state = {};
+            *initialState = {};
+        }
+    });
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+
+class BenchmarkRunner;
+
+class DefragmentationBenchmarks
+{
+public:
+	static void Register(BenchmarkRunner& runner);
+
+private:
+	/**
+	 * Fills blocks with random allocations, frees most of them and runs planner steps until nothing moves anymore,
+	 * all on the CPU. Every step is applied like the Defragmenter would and checked: planned destinations have to be
+	 * free, no allocation may be lost or overlap another, and the block count has to drop. Throws on a violation.
+	 */
+	static void RegisterSimulation(BenchmarkRunner& runner, uint32_t allocationCount, double freedShare);
+
+	static constexpr uint64_t kBlockSize = 32 * 1024 * 1024;
+	static constexpr uint64_t kMaxBytesPerStep = 8 * 1024 * 1024;
+};
\ No newline at end of file
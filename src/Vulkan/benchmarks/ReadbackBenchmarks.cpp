@@ -0,0 +1,155 @@
+#include "ReadbackBenchmarks.hpp"
+
+#include <memory>
+#include <vector>
+#include <chrono>
+
+#include "BenchmarkRunner.hpp"
+#include "../pch.hpp"
+#include "../helpers/Context.hpp"
+#include "../helpers/DeviceQueue.hpp"
+#include "../helpers/buffers/GenericBuffer.hpp"
+#include "../helpers/buffers/ReadbackRing.hpp"
+
+namespace {
+
+    struct ReadbackState
+    {
+        std::unique_ptr<GenericBuffer> source;
+        std::unique_ptr<ReadbackRing> ring;
+        VkCommandPool commandPool{};
+        VkCommandBuffer commandBuffer{};
+        std::vector<std::byte> pattern;
+    };
+}
+
+void ReadbackBenchmarks::Register(BenchmarkRunner& runner, const Context* context) {
+    ReadbackBenchmarks::RegisterRoundTrip(runner, context);
+}
+
+void ReadbackBenchmarks::RegisterRoundTrip(BenchmarkRunner& runner, const Context* context) {
+
+    const auto state = std::make_shared<ReadbackState>();
+
+    runner.Register(BenchmarkRunner::Desc{
+        .name = std::format("Readback ring round trip, {} bytes", kReadbackSize),
+        .iterations = 20,
+        .setUp = [state, context]
+        {
+            const VkDevice device = context->GetDevice()->GetVkDevice();
+
+            // Not a repeating byte, so a copy from the wrong offset does not pass.
+            state->pattern.resize(kReadbackSize);
+            for (uint32_t ind = 0; ind < kReadbackSize; ind++) {
+                state->pattern[ind] = static_cast<std::byte>((ind * 31 + ind / 256) & 0xFF);
+            }
+
+            state->source = std::make_unique<GenericBuffer>(context, GenericBuffer::Desc{
+                .bufferCreateInfo = VkBufferCreateInfo{
+                    .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+                    .size = kReadbackSize,
+                    .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                    .sharingMode = VK_SHARING_MODE_EXCLUSIVE
+                },
+                .memoryProperty = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                .category = MemoryCategory::Staging
+            });
+            state->source->CopyData(state->pattern.data(), kReadbackSize);
+
+            // A ring of its own, the one of the context belongs to the frame being recorded.
+            state->ring = std::make_unique<ReadbackRing>(context, ReadbackRing::Desc{
+                .slotCount = 2,
+                .slotSize = kReadbackSize
+            });
+
+            const VkCommandPoolCreateInfo poolInfo = {
+                .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+                .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+                .queueFamilyIndex = context->GetGraphicsQueue()->GetFamilyIndex()
+            };
+
+            VkResult result = vkCreateCommandPool(device, &poolInfo, nullptr, &state->commandPool);
+            if (result != VK_SUCCESS) {
+                throw std::runtime_error("[ReadbackBenchmarks] Could not create a command pool: " + std::to_string(result));
+            }
+
+            const VkCommandBufferAllocateInfo bufferInfo = {
+                .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+                .commandPool = state->commandPool,
+                .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+                .commandBufferCount = 1
+            };
+
+            result = vkAllocateCommandBuffers(device, &bufferInfo, &state->commandBuffer);
+            if (result != VK_SUCCESS) {
+                throw std::runtime_error("[ReadbackBenchmarks] Could not allocate a command buffer: " + std::to_string(result));
+            }
+        },
+        .iteration = [state, context]
+        {
+            const VkQueue queue = context->GetGraphicsQueue()->GetVkQueue();
+
+            constexpr VkCommandBufferBeginInfo beginInfo = {
+                .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+                .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+            };
+            vkBeginCommandBuffer(state->commandBuffer, &beginInfo);
+
+            bool delivered = false;
+            bool matches = false;
+            const std::optional<uint32_t> slot = state->ring->RecordBufferCopy(state->commandBuffer, state->source->GetVkBuffer(), 0, kReadbackSize,
+                [state, &delivered, &matches](const void* data, size_t dataSize)
+                {
+                    delivered = true;
+                    matches = dataSize == kReadbackSize && std::memcmp(data, state->pattern.data(), kReadbackSize) == 0;
+                });
+
+            vkEndCommandBuffer(state->commandBuffer);
+
+            // The previous iteration delivered its copy, so a slot is always free here.
+            if (!slot.has_value()) {
+                throw std::runtime_error("[ReadbackBenchmarks] Every readback slot is still in flight");
+            }
+
+            const VkSubmitInfo submitInfo = {
+                .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+                .commandBufferCount = 1,
+                .pCommandBuffers = &state->commandBuffer
+            };
+
+            const VkResult result = vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
+            if (result != VK_SUCCESS) {
+                throw std::runtime_error("[ReadbackBenchmarks] Could not submit the copy: " + std::to_string(result));
+            }
+            state->ring->Submit(queue);
+
+            const auto startTime = std::chrono::high_resolution_clock::now();
+            while (!delivered) {
+
+                state->ring->Poll();
+                if (std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count() > kTimeoutMs) {
+                    throw std::runtime_error(std::format("[ReadbackBenchmarks] Slot {} was not delivered within {} ms", *slot, kTimeoutMs));
+                }
+            }
+
+            if (!matches) {
+                throw std::runtime_error(std::format("[ReadbackBenchmarks] Slot {} did not read back the pattern", *slot));
+            }
+        },
+        .tearDown = [state, context]
+        {
+            const VkDevice device = context->GetDevice()->GetVkDevice();
+
+            state->ring->Destroy();
+            state->ring = nullptr;
+
+            vkFreeCommandBuffers(device, state->commandPool, 1, &state->commandBuffer);
+            vkDestroyCommandPool(device, state->commandPool, nullptr);
+            state->commandBuffer = VK_NULL_HANDLE;
+            state->commandPool = VK_NULL_HANDLE;
+
+            state->source->Destroy();
+            state->source = nullptr;
+        }
+    });
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+
+class BenchmarkRunner;
+class Context;
+
+class ReadbackBenchmarks
+{
+public:
+	static void Register(BenchmarkRunner& runner, const Context* context);
+
+private:
+	/**
+	 * Copies a known pattern through ReadbackRing::RecordBufferCopy on a command buffer of its own, then submits and
+	 * polls until the callback fires. Throws if the bytes that come back differ or nothing comes back at all.
+	 */
+	static void RegisterRoundTrip(BenchmarkRunner& runner, const Context* context);
+
+	static constexpr uint32_t kReadbackSize = 64 * 1024;
+
+	/**
+	 * Poll never waits, so the round trip gives up after this long instead of spinning forever on a lost copy.
+	 */
+	static constexpr double kTimeoutMs = 1000.0;
+};
\ No newline at end of file
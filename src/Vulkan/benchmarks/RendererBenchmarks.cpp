@@ -0,0 +1,146 @@
+#include "RendererBenchmarks.hpp"
+
+#include <memory>
+
+#include "BenchmarkRunner.hpp"
+#include "../pch.hpp"
+#include "../helpers/Context.hpp"
+#include "../helpers/buffers/SegmentedInstanceBuffer.hpp"
+#include "../helpers/jobs/JobSystem.hpp"
+#include "../renderers/InstancedRenderer.hpp"
+#include "../renderers/InstancedRendererChunked.hpp"
+
+namespace {
+
+    struct SwitchState
+    {
+        std::unique_ptr<MainRenderer> renderer;
+        bool chunked = false;
+    };
+
+    struct StreamUploadState
+    {
+        std::unique_ptr<SegmentedInstanceBuffer> stream;
+        MainComponentSystem::Column<MainComponentSystem::Transform> transforms;
+    };
+
+    // Same as the instanced renderers.
+    constexpr VkMemoryPropertyFlags kInstanceMemoryProperty = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    constexpr uint32_t kFirstSegmentCapacity = 64 * 1024;
+    constexpr uint32_t kMinUploadBatchSize = 8192;
+
+    std::unique_ptr<MainRenderer> CreateRenderer(const Context* context, MainComponentSystem* componentSystem, bool chunked) {
+
+        std::unique_ptr<MainRenderer> renderer;
+        if (chunked) {
+            renderer = std::make_unique<InstancedRendererChunked>(context, componentSystem);
+        }
+        else {
+            renderer = std::make_unique<InstancedRenderer>(context, componentSystem);
+        }
+
+        renderer->Initialize("shaders/instanced.vert.spv", "shaders/instanced.frag.spv");
+        return renderer;
+    }
+}
+
+void RendererBenchmarks::Register(BenchmarkRunner& runner, const Context* context, MainComponentSystem* componentSystem) {
+
+    RendererBenchmarks::RegisterSwitch(runner, context, componentSystem, true);
+    RendererBenchmarks::RegisterSwitch(runner, context, componentSystem, false);
+
+    // Up to the entity limit, the budget may cut the larger counts short.
+    for (uint32_t instanceCount = 1024 * 1024; instanceCount < MainComponentSystem::kMaxEntityCount; instanceCount *= 4) {
+        RendererBenchmarks::RegisterStreamUpload(runner, context, instanceCount);
+    }
+    RendererBenchmarks::RegisterStreamUpload(runner, context, MainComponentSystem::kMaxEntityCount);
+}
+
+void RendererBenchmarks::RegisterSwitch(BenchmarkRunner& runner, const Context* context, MainComponentSystem* componentSystem, bool pooled) {
+
+    const auto state = std::make_shared<SwitchState>();
+
+    runner.Register(BenchmarkRunner::Desc{
+        .name = pooled ? "Renderer switch, pooled" : "Renderer switch, unpooled",
+        .iterations = 20,
+        .setUp = [state, context, componentSystem]
+        {
+            state->chunked = false;
+            state->renderer = CreateRenderer(context, componentSystem, state->chunked);
+        },
+        .iteration = [state, context, componentSystem, pooled]
+        {
+            state->renderer->Destroy();
+            if (!pooled) {
+                context->GetResourcePool()->Trim(0);
+            }
+
+            state->chunked = !state->chunked;
+            state->renderer = CreateRenderer(context, componentSystem, state->chunked);
+        },
+        .tearDown = [state]
+        {
+            state->renderer->Destroy();
+            state->renderer = nullptr;
+        }
+    });
+}
+
+void RendererBenchmarks::RegisterStreamUpload(BenchmarkRunner& runner, const Context* context, uint32_t instanceCount) {
+
+    const auto state = std::make_shared<StreamUploadState>();
+
+    runner.Register(BenchmarkRunner::Desc{
+        .name = std::format("Segmented stream upload, {} instances", instanceCount),
+        .iterations = 20,
+        .setUp = [state, context, instanceCount]
+        {
+            // Stops at the memory ceiling the same way MainRenderer::FitInstanceCapacity does.
+            const VkDeviceSize available = context->GetDevice()->GetDeviceMemory()->GetAvailableBudget(kInstanceMemoryProperty) + context->GetResourcePool()->GetRetainedSize();
+            const VkDeviceSize fitting = static_cast<VkDeviceSize>(static_cast<double>(available) * MainRenderer::kInstanceBudgetShare) / sizeof(glm::vec4);
+            const uint32_t capacity = static_cast<uint32_t>(std::min<VkDeviceSize>(instanceCount, fitting));
+
+            if (capacity < instanceCount) {
+                spdlog::warn("[RendererBenchmarks] Only {} of {} instances fit into the remaining budget", capacity, instanceCount);
+            }
+
+            state->stream = std::make_unique<SegmentedInstanceBuffer>(context, SegmentedInstanceBuffer::Desc{
+                .stride = sizeof(glm::vec4),
+                .firstSegmentCapacity = kFirstSegmentCapacity,
+                .maxCapacity = std::max(capacity, 1u),
+                .memoryProperty = kInstanceMemoryProperty
+            });
+            state->stream->Resize(capacity);
+
+            spdlog::info("[RendererBenchmarks] {} instances in {} segments of up to {}", capacity, state->stream->GetSegmentCount(), state->stream->GetMaxSegmentCapacity());
+
+            state->transforms.reserve(capacity);
+            HugePages::Commit(state->transforms.data(), capacity * sizeof(MainComponentSystem::Transform));
+            state->transforms.resize(capacity);
+            for (uint32_t ind = 0; ind < capacity; ind++) {
+                state->transforms[ind].translate = glm::vec4(static_cast<float>(ind), 0.0f, 0.0f, 1.0f);
+            }
+        },
+        .iteration = [state, context]
+        {
+            const MainComponentSystem::Transform* transforms = state->transforms.data();
+            const SegmentedInstanceBuffer* stream = state->stream.get();
+
+            context->GetJobSystem()->ParallelFor("Segmented stream upload batch", static_cast<uint32_t>(state->transforms.size()), kMinUploadBatchSize, [=](uint32_t begin, uint32_t end)
+            {
+                stream->ForEachRange<glm::vec4>(begin, end, [=](glm::vec4* translations, uint32_t rangeBegin, uint32_t rangeEnd)
+                {
+                    for (uint32_t ind = rangeBegin; ind < rangeEnd; ind++) {
+                        translations[ind - rangeBegin] = transforms[ind].translate;
+                    }
+                });
+            });
+        },
+        .tearDown = [state]
+        {
+            state->stream->Destroy();
+            state->stream = nullptr;
+            state->transforms = {};
+        }
+    });
+}
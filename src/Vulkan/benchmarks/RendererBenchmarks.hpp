@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+
+class BenchmarkRunner;
+class Context;
+class MainComponentSystem;
+
+class RendererBenchmarks
+{
+public:
+	static void Register(BenchmarkRunner& runner, const Context* context, MainComponentSystem* componentSystem);
+
+private:
+	/**
+	 * Destroys a renderer and initializes the other instanced one, the way App::OnInitializeRenderer switches.
+	 * Without the pool everything it retained is freed after every destroy, which is what switching used to cost.
+	 * The renderers are separate from the one on screen and never record anything.
+	 */
+	static void RegisterSwitch(BenchmarkRunner& runner, const Context* context, MainComponentSystem* componentSystem, bool pooled);
+
+	/**
+	 * Writes one vec4 per instance into a segmented stream, the way the instanced renderers upload translations.
+	 * Counts beyond the memory budget are cut down to what fits, and the log says how many segments it took.
+	 */
+	static void RegisterStreamUpload(BenchmarkRunner& runner, const Context* context, uint32_t instanceCount);
+};
\ No newline at end of file
@@ -0,0 +1,118 @@
+#include "SpatialGridBenchmarks.hpp"
+
+#include <memory>
+
+#include <tracy/Tracy.hpp>
+
+#include "BenchmarkRunner.hpp"
+#include "../pch.hpp"
+#include "../helpers/spatial/SpatialHashGrid.hpp"
+
+namespace {
+
+    constexpr SpatialHashGrid::Desc kGridDesc = {
+        .cellSize = 2.0f,
+        .bucketCount = 1 << 16
+    };
+
+    struct GridState
+    {
+        std::unique_ptr<SpatialHashGrid> grid;
+        std::vector<glm::vec4> positions;
+        std::vector<glm::vec2> queryCenters;
+        std::vector<uint32_t> result;
+    };
+
+    std::vector<glm::vec4> CreatePositions(uint32_t count) {
+
+        std::mt19937 rndEngine(42);
+        std::uniform_real_distribution<float> offsetDist(-100, 100);
+
+        std::vector<glm::vec4> positions(count);
+        for (auto& position : positions) {
+            position = glm::vec4(offsetDist(rndEngine), offsetDist(rndEngine), 0, 0);
+        }
+
+        return positions;
+    }
+}
+
+void SpatialGridBenchmarks::Register(BenchmarkRunner& runner, JobSystem* jobSystem) {
+
+    for (const uint32_t entityCount : { 100000u, 1000000u }) {
+        SpatialGridBenchmarks::RegisterRebuild(runner, jobSystem, entityCount);
+        SpatialGridBenchmarks::RegisterQueries(runner, jobSystem, entityCount);
+    }
+}
+
+void SpatialGridBenchmarks::RegisterRebuild(BenchmarkRunner& runner, JobSystem* jobSystem, uint32_t entityCount) {
+
+    const auto state = std::make_shared<GridState>();
+
+    runner.Register(BenchmarkRunner::Desc{
+        .name = std::format("Spatial grid rebuild, {} entities", entityCount),
+        .iterations = 100,
+        .setUp = [state, jobSystem, entityCount]
+        {
+            state->grid = std::make_unique<SpatialHashGrid>(jobSystem, kGridDesc);
+            state->positions = CreatePositions(entityCount);
+        },
+        .iteration = [state]
+        {
+            state->grid->Rebuild(state->positions.data(), static_cast<uint32_t>(state->positions.size()));
+        },
+        .tearDown = [state]
+        {
+            state->grid = nullptr;
+            state->positions = {};
+        }
+    });
+}
+
+void SpatialGridBenchmarks::RegisterQueries(BenchmarkRunner& runner, JobSystem* jobSystem, uint32_t entityCount) {
+
+    const auto state = std::make_shared<GridState>();
+
+    runner.Register(BenchmarkRunner::Desc{
+        .name = std::format("Spatial grid {} queries, {} entities", kQueryCount * 2, entityCount),
+        .iterations = 50,
+        .setUp = [state, jobSystem, entityCount]
+        {
+            state->grid = std::make_unique<SpatialHashGrid>(jobSystem, kGridDesc);
+            state->positions = CreatePositions(entityCount);
+            state->grid->Rebuild(state->positions.data(), static_cast<uint32_t>(state->positions.size()));
+
+            std::mt19937 rndEngine(7);
+            std::uniform_real_distribution<float> offsetDist(-100, 100);
+            state->queryCenters.resize(kQueryCount);
+            for (auto& center : state->queryCenters) {
+                center = glm::vec2(offsetDist(rndEngine), offsetDist(rndEngine));
+            }
+        },
+        .iteration = [state]
+        {
+            {
+                ZoneScopedN("Radius queries");
+                for (const glm::vec2 center : state->queryCenters) {
+                    state->result.clear();
+                    state->grid->QueryRadius(center, 3.0f, state->result);
+                }
+            }
+
+            {
+                ZoneScopedN("Box queries");
+                for (const glm::vec2 center : state->queryCenters) {
+                    state->result.clear();
+                    state->grid->QueryBox(center - glm::vec2(3.0f), center + glm::vec2(3.0f), state->result);
+                }
+            }
+        },
+        .tearDown = [state]
+        {
+            state->grid = nullptr;
+            state->positions = {};
+            state->queryCenters = {};
+            state->result = {};
+        }
+    });
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+
+class BenchmarkRunner;
+class JobSystem;
+
+class SpatialGridBenchmarks
+{
+public:
+	static void Register(BenchmarkRunner& runner, JobSystem* jobSystem);
+
+private:
+	/**
+	 * Full rebuild from positions spread the same way MainComponentSystem spawns entities.
+	 */
+	static void RegisterRebuild(BenchmarkRunner& runner, JobSystem* jobSystem, uint32_t entityCount);
+
+	/**
+	 * kQueryCount radius and box queries around random points, on a single thread.
+	 */
+	static void RegisterQueries(BenchmarkRunner& runner, JobSystem* jobSystem, uint32_t entityCount);
+
+	static constexpr uint32_t kQueryCount = 10000;
+};
\ No newline at end of file
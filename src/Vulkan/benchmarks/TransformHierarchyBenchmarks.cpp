@@ -0,0 +1,114 @@
+#include "TransformHierarchyBenchmarks.hpp"
+
+#include <memory>
+#include <numbers>
+
+#include "BenchmarkRunner.hpp"
+#include "../pch.hpp"
+#include "../helpers/hierarchy/TransformHierarchy.hpp"
+
+namespace {
+
+    struct HierarchyState
+    {
+        std::unique_ptr<TransformHierarchy> hierarchy;
+        std::vector<TransformHierarchy::NodeID> dirtyNodes;
+        std::mt19937 rndEngine;
+    };
+
+    std::unique_ptr<TransformHierarchy> CreateHierarchy(JobSystem* jobSystem, uint32_t nodeCount, uint32_t levelCount) {
+
+        std::mt19937 rndEngine(42);
+        std::uniform_real_distribution<float> offsetDist(-1, 1);
+        std::uniform_real_distribution<float> rotationDist(-std::numbers::pi_v<float>, std::numbers::pi_v<float>);
+
+        auto hierarchy = std::make_unique<TransformHierarchy>(jobSystem);
+        hierarchy->Reserve(nodeCount);
+
+        const uint32_t levelSize = nodeCount / levelCount;
+        for (uint32_t node = 0; node < nodeCount; node++) {
+
+            // IDs are handed out level by level, so the level above is the previous block of levelSize IDs.
+            const uint32_t level = std::min(node / levelSize, levelCount - 1);
+
+            TransformHierarchy::NodeID parent = TransformHierarchy::kNoParent;
+            if (level > 0) {
+                parent = (level - 1) * levelSize + rndEngine() % levelSize;
+            }
+
+            const glm::vec4 translate = glm::vec4(offsetDist(rndEngine), offsetDist(rndEngine), 0, 0);
+            hierarchy->AddNode(parent, TransformHierarchy::MakeTransform(translate, rotationDist(rndEngine)));
+        }
+
+        // Sorts the nodes, so the timed iterations do not include it.
+        hierarchy->PropagateAll();
+        return hierarchy;
+    }
+}
+
+void TransformHierarchyBenchmarks::Register(BenchmarkRunner& runner, JobSystem* jobSystem) {
+
+    for (const uint32_t levelCount : { 2u, 8u, 32u }) {
+        TransformHierarchyBenchmarks::RegisterFullPropagation(runner, jobSystem, levelCount);
+        TransformHierarchyBenchmarks::RegisterDirtyPropagation(runner, jobSystem, levelCount);
+    }
+}
+
+void TransformHierarchyBenchmarks::RegisterFullPropagation(BenchmarkRunner& runner, JobSystem* jobSystem, uint32_t levelCount) {
+
+    const auto state = std::make_shared<HierarchyState>();
+
+    runner.Register(BenchmarkRunner::Desc{
+        .name = std::format("Transform hierarchy full propagation, {} nodes, {} levels", kNodeCount, levelCount),
+        .iterations = 100,
+        .setUp = [state, jobSystem, levelCount]
+        {
+            state->hierarchy = CreateHierarchy(jobSystem, kNodeCount, levelCount);
+        },
+        .iteration = [state]
+        {
+            state->hierarchy->PropagateAll();
+        },
+        .tearDown = [state]
+        {
+            state->hierarchy = nullptr;
+        }
+    });
+}
+
+void TransformHierarchyBenchmarks::RegisterDirtyPropagation(BenchmarkRunner& runner, JobSystem* jobSystem, uint32_t levelCount) {
+
+    const auto state = std::make_shared<HierarchyState>();
+
+    runner.Register(BenchmarkRunner::Desc{
+        .name = std::format("Transform hierarchy {} dirty nodes, {} nodes, {} levels", kDirtyCount, kNodeCount, levelCount),
+        .iterations = 100,
+        .setUp = [state, jobSystem, levelCount]
+        {
+            state->hierarchy = CreateHierarchy(jobSystem, kNodeCount, levelCount);
+            state->dirtyNodes.resize(kDirtyCount);
+            state->rndEngine.seed(7);
+        },
+        .iteration = [state]
+        {
+            for (TransformHierarchy::NodeID& node : state->dirtyNodes) {
+                node = state->rndEngine() % kNodeCount;
+            }
+
+            for (const TransformHierarchy::NodeID node : state->dirtyNodes) {
+
+                TransformHierarchy::Transform local = state->hierarchy->GetLocal(node);
+                local.translate.x += 0.01f;
+                state->hierarchy->SetLocal(node, local);
+            }
+
+            state->hierarchy->Propagate();
+        },
+        .tearDown = [state]
+        {
+            spdlog::info("[TransformHierarchyBenchmarks] Last dirty propagation updated {} nodes", state->hierarchy->GetLastUpdateCount());
+            state->hierarchy = nullptr;
+            state->dirtyNodes = {};
+        }
+    });
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+
+class BenchmarkRunner;
+class JobSystem;
+
+class TransformHierarchyBenchmarks
+{
+public:
+	static void Register(BenchmarkRunner& runner, JobSystem* jobSystem);
+
+private:
+	/**
+	 * PropagateAll over kNodeCount nodes split evenly into levelCount levels, every node parented to a random
+	 * node of the level above.
+	 */
+	static void RegisterFullPropagation(BenchmarkRunner& runner, JobSystem* jobSystem, uint32_t levelCount);
+
+	/**
+	 * Same tree, but every iteration moves kDirtyCount random nodes and only their subtrees are propagated.
+	 */
+	static void RegisterDirtyPropagation(BenchmarkRunner& runner, JobSystem* jobSystem, uint32_t levelCount);
+
+	static constexpr uint32_t kNodeCount = 1000000;
+	static constexpr uint32_t kDirtyCount = 1000;
+};
\ No newline at end of file
@@ -0,0 +1,102 @@
+#include "UploadBenchmarks.hpp"
+
+#include <memory>
+#include <array>
+
+#include "BenchmarkRunner.hpp"
+#include "../pch.hpp"
+#include "../helpers/Context.hpp"
+#include "../helpers/buffers/GenericBuffer.hpp"
+
+namespace {
+
+    constexpr VkMemoryPropertyFlags kUploadMemoryProperty = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+    struct UploadState
+    {
+        std::unique_ptr<GenericBuffer> buffer;
+        VkDeviceMemory memory{};
+        std::array<std::byte, 256> data{};
+    };
+}
+
+void UploadBenchmarks::Register(BenchmarkRunner& runner, const Context* context) {
+
+    static_assert(sizeof(UploadState::data) == kUploadSize);
+
+    UploadBenchmarks::RegisterMapPerCopy(runner, context);
+    UploadBenchmarks::RegisterPersistent(runner, context);
+}
+
+void UploadBenchmarks::RegisterMapPerCopy(BenchmarkRunner& runner, const Context* context) {
+
+    const auto state = std::make_shared<UploadState>();
+
+    runner.Register(BenchmarkRunner::Desc{
+        .name = std::format("Small uploads, map per copy, {} x {} bytes", kUploadCount, kUploadSize),
+        .iterations = 100,
+        .setUp = [state, context]
+        {
+            // Raw memory, so it is not mapped persistently and can still be mapped per copy.
+            state->memory = context->GetDevice()->GetDeviceMemory()->AllocateMemory(DeviceMemory::AllocationDesc{
+                .memoryRequirements = VkMemoryRequirements{
+                    .size = kUploadSize,
+                    .alignment = 1,
+                    .memoryTypeBits = UINT32_MAX
+                },
+                .memoryPropertyFlags = kUploadMemoryProperty,
+                .category = MemoryCategory::Staging
+            });
+        },
+        .iteration = [state, context]
+        {
+            const VkDevice device = context->GetDevice()->GetVkDevice();
+            for (uint32_t ind = 0; ind < kUploadCount; ind++) {
+
+                void* mappedMemory;
+                vkMapMemory(device, state->memory, 0, kUploadSize, 0, &mappedMemory);
+                std::memcpy(mappedMemory, state->data.data(), kUploadSize);
+                vkUnmapMemory(device, state->memory);
+            }
+        },
+        .tearDown = [state, context]
+        {
+            context->GetDevice()->GetDeviceMemory()->FreeMemory(state->memory);
+            state->memory = VK_NULL_HANDLE;
+        }
+    });
+}
+
+void UploadBenchmarks::RegisterPersistent(BenchmarkRunner& runner, const Context* context) {
+
+    const auto state = std::make_shared<UploadState>();
+
+    runner.Register(BenchmarkRunner::Desc{
+        .name = std::format("Small uploads, persistently mapped, {} x {} bytes", kUploadCount, kUploadSize),
+        .iterations = 100,
+        .setUp = [state, context]
+        {
+            state->buffer = std::make_unique<GenericBuffer>(context, GenericBuffer::Desc{
+                .bufferCreateInfo = VkBufferCreateInfo{
+                    .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+                    .size = kUploadSize,
+                    .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                    .sharingMode = VK_SHARING_MODE_EXCLUSIVE
+                },
+                .memoryProperty = kUploadMemoryProperty,
+                .category = MemoryCategory::Staging
+            });
+        },
+        .iteration = [state]
+        {
+            for (uint32_t ind = 0; ind < kUploadCount; ind++) {
+                state->buffer->CopyData(state->data.data(), kUploadSize);
+            }
+        },
+        .tearDown = [state]
+        {
+            state->buffer->Destroy();
+            state->buffer = nullptr;
+        }
+    });
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+
+class BenchmarkRunner;
+class Context;
+
+class UploadBenchmarks
+{
+public:
+	static void Register(BenchmarkRunner& runner, const Context* context);
+
+private:
+	/**
+	 * kUploadCount copies of kUploadSize bytes with vkMapMemory and vkUnmapMemory around each one, the way
+	 * GenericBuffer::CopyData used to upload.
+	 */
+	static void RegisterMapPerCopy(BenchmarkRunner& runner, const Context* context);
+
+	/**
+	 * The same copies through GenericBuffer::CopyData into the persistently mapped block.
+	 */
+	static void RegisterPersistent(BenchmarkRunner& runner, const Context* context);
+
+	static constexpr uint32_t kUploadCount = 1000;
+	static constexpr uint32_t kUploadSize = 256;
+};
\ No newline at end of file
@@ -7,6 +7,7 @@
 #include <tracy/Tracy.hpp>
 
 #include "IComponentSystem.hpp"
+#include "jobs/TaskGraph.hpp"
 #include "IRenderPass.hpp"
 #include "../pch.hpp"
 
@@ -26,6 +27,7 @@ Context::Context(const Context::CreateDesc& desc) {
     m_config = desc.config;
     m_renderPass = desc.renderPass;
     m_componentSystem = desc.componentSystem;
+    m_jobSystem = desc.jobSystem;
 
 	this->InitializeWindow();
 	this->InitializeVulkan();
@@ -51,6 +53,21 @@ Context::Context(const Context::CreateDesc& desc) {
     this->CreateCommandPools();
     this->CreateCommandBuffers();
 
+    // Created first, so the buffers below can register with it.
+    m_defragmenter = std::make_unique<Defragmenter>(this, Defragmenter::Desc{
+        .maxBytesPerStep = kDefragmentationBytesPerStep,
+        .maxSourceUsage = kDefragmentationMaxSourceUsage
+    });
+    m_readbackRing = std::make_unique<ReadbackRing>(this, ReadbackRing::Desc{
+        .slotCount = kReadbackSlotCount,
+        .slotSize = kReadbackSlotSize
+    });
+    m_resourcePool = std::make_unique<ResourcePool>(this);
+    m_frameArena = std::make_unique<FrameArena>(this, FrameArena::Desc{
+        .frameSize = kFrameArenaSize,
+        .frameCount = kFrameArenaFrameCount
+    });
+
     this->InitializeImGui();
 }
 
@@ -58,6 +75,15 @@ void Context::Destroy() {
 
     this->DestroyImGui();
 
+    m_frameArena->Destroy();
+    m_frameArena = nullptr;
+    m_readbackRing->Destroy();
+    m_readbackRing = nullptr;
+    m_resourcePool->Destroy();
+    m_resourcePool = nullptr;
+    m_defragmenter->Destroy();
+    m_defragmenter = nullptr;
+
     this->DestroyCommandBuffers();
     this->DestroyCommandPools();
 
@@ -98,11 +124,36 @@ void Context::HintWindowResize() {
     m_mustResize = true;
 }
 
+bool Context::RequestFrameCapture(FrameCaptureCallback callback) {
+
+    if ((m_swapchain->GetImageUsage() & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) == 0) {
+        spdlog::warn("[Context] The swapchain images cannot be copied from, frame capture is not available");
+        return false;
+    }
+
+    m_frameCaptureCallback = std::move(callback);
+    return true;
+}
+
+void Context::SetWaitBeforeSimulation(bool wait) {
+    m_waitBeforeSimulation = wait;
+}
+
 void Context::Update(const std::function<void(const Context::RenderDesc&)>& rendererCallback) {
 
     ZoneScoped;
 
-    m_componentSystem->Update();
+    // Also keeps a pipelined simulation from getting the snapshot that is being drawn back.
+    if (m_waitBeforeSimulation) {
+        ZoneScopedN("Wait before simulation");
+        vkWaitForFences(m_mainDevice->GetVkDevice(), 1, &m_submitFrameFence, VK_TRUE, UINT64_MAX);
+    }
+
+    // The simulation runs on the workers while this thread waits for the previous frame.
+    // Leaving early is fine, the graph waits for its tasks when it goes out of scope.
+    TaskGraph frameGraph(m_jobSystem);
+    m_componentSystem->Schedule(frameGraph);
+    frameGraph.Dispatch();
 
     {
         // Waiting until the frame is fully ready and all the resources are free to modify.
@@ -111,6 +162,20 @@ void Context::Update(const std::function<void(const Context::RenderDesc&)>& rend
         vkWaitForFences(m_mainDevice->GetVkDevice(), 1, &m_submitFrameFence, VK_TRUE, UINT64_MAX);
     }
 
+    // Allocations between two fence waits count as one frame.
+    m_mainDevice->GetDeviceMemory()->EndFrame();
+
+    // Throttled internally, the budget only has to follow the driver over a few frames.
+    m_mainDevice->GetDeviceMemory()->UpdateBudget(glfwGetTime());
+    m_resourcePool->TrimUnderPressure();
+
+    // After trimming, so the freed space can be compacted right away.
+    m_defragmenter->Update();
+
+    // The previous frame is done, so at least its readbacks are ready and its transient data can be overwritten.
+    m_readbackRing->Poll();
+    m_frameArena->Reset();
+
     uint32_t imageIndex;
     if (m_mustResize) {
 
@@ -139,7 +204,8 @@ void Context::Update(const std::function<void(const Context::RenderDesc&)>& rend
 
     vkResetFences(m_mainDevice->GetVkDevice(), 1, &m_submitFrameFence);
 
-    this->Render(rendererCallback, imageIndex);
+    this->Render(rendererCallback, imageIndex, frameGraph);
+    m_frameArena->Flush();
 
     VkSemaphore waitSemaphores[] = { m_imageAvailableSemaphore };
     VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
@@ -164,6 +230,7 @@ void Context::Update(const std::function<void(const Context::RenderDesc&)>& rend
         if (result != VK_SUCCESS) {
             throw std::runtime_error("[MainRenderPipeline] Error submitting a graphics queue: " + std::to_string(result));
         }
+        m_readbackRing->Submit(m_graphicsQueue->GetVkQueue());
     }
 
     VkSwapchainKHR swapchain = m_swapchain->GetVkSwapchain();
@@ -185,7 +252,7 @@ void Context::Update(const std::function<void(const Context::RenderDesc&)>& rend
     }
 }
 
-void Context::Render(const std::function<void(const Context::RenderDesc&)>& rendererCallback, uint32_t imageIndex) {
+void Context::Render(const std::function<void(const Context::RenderDesc&)>& rendererCallback, uint32_t imageIndex, TaskGraph& frameGraph) {
 
 	vkResetCommandBuffer(m_graphicsCommandBuffer, 0);
 
@@ -200,13 +267,28 @@ void Context::Render(const std::function<void(const Context::RenderDesc&)>& rend
         throw std::runtime_error("[Context] Could not begin graphics command buffer: " + std::to_string(result));
     }
 
-    // User code here
-    rendererCallback(RenderDesc{
-        .commandBuffer = m_graphicsCommandBuffer,
-        .framebuffer = m_framebuffers[imageIndex],
-        .renderPass = m_renderPass
+    // User code here. ImGui is not thread safe, so recording stays on this thread.
+    frameGraph.AddMainThreadTask("Command recording", [&]
+    {
+        rendererCallback(RenderDesc{
+            .commandBuffer = m_graphicsCommandBuffer,
+            .framebuffer = m_framebuffers[imageIndex],
+            .renderPass = m_renderPass,
+            .frameGraph = &frameGraph
+        });
     });
 
+    {
+        // Host writes must be finished before the submit makes them visible to the device.
+        ZoneScopedN("Wait frame graph");
+        frameGraph.WaitAll();
+    }
+
+    // After the render pass, which leaves the image ready to present.
+    if (m_frameCaptureCallback.has_value()) {
+        this->RecordFrameCapture(imageIndex);
+    }
+
     result = vkEndCommandBuffer(m_graphicsCommandBuffer);
     if (result != VK_SUCCESS) {
         throw std::runtime_error("[Context] Could not end graphics command buffer: " + std::to_string(result));
@@ -214,6 +296,29 @@ void Context::Render(const std::function<void(const Context::RenderDesc&)>& rend
 }
 
 
+void Context::RecordFrameCapture(uint32_t imageIndex) {
+
+    const VkExtent2D extent = m_swapchain->GetExtent();
+    const VkFormat format = m_swapchain->GetFormat();
+
+    const std::optional<uint32_t> slot = m_readbackRing->RecordImageCopy(m_graphicsCommandBuffer, ReadbackRing::ImageCopyDesc{
+        .image = m_swapchain->GetVkImage(imageIndex),
+        .extent = extent,
+        .bytesPerPixel = 4,
+        .layout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+        .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+        .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT
+    }, [callback = *m_frameCaptureCallback, extent, format](const void* data, size_t)
+    {
+        callback(data, extent, format);
+    });
+
+    // Stays requested until a slot is free.
+    if (slot.has_value()) {
+        m_frameCaptureCallback = std::nullopt;
+    }
+}
+
 void Context::InitializeWindow() {
     glfwInit();
 
@@ -664,6 +769,10 @@ const Device* Context::GetDevice() const {
     return m_mainDevice.get();
 }
 
+JobSystem* Context::GetJobSystem() const {
+    return m_jobSystem;
+}
+
 const DeviceQueue* Context::GetGraphicsQueue() const {
     return m_graphicsQueue.get();
 }
@@ -689,6 +798,22 @@ VkCommandBuffer Context::GetTransferCommandBuffer() const {
     return m_transferCommandBuffer;
 }
 
+ReadbackRing* Context::GetReadbackRing() const {
+    return m_readbackRing.get();
+}
+
+ResourcePool* Context::GetResourcePool() const {
+    return m_resourcePool.get();
+}
+
+Defragmenter* Context::GetDefragmenter() const {
+    return m_defragmenter.get();
+}
+
+FrameArena* Context::GetFrameArena() const {
+    return m_frameArena.get();
+}
+
 void Context::SetSwapchainImageCount(uint32_t count) const {
     m_config->swapChainImageCount = count;
 }
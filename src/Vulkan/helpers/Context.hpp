@@ -8,11 +8,17 @@
 #include "Device.hpp"
 #include "Surface.hpp"
 #include "Swapchain.hpp"
+#include "buffers/ReadbackRing.hpp"
+#include "buffers/FrameArena.hpp"
+#include "ResourcePool.hpp"
+#include "Defragmenter.hpp"
 
 class Swapchain;
 class IRenderPass;
 class IComponentSystem;
 class IRenderer;
+class JobSystem;
+class TaskGraph;
 
 
 class Context
@@ -42,6 +48,7 @@ public:
         std::shared_ptr<Context::Config> config;
         IRenderPass* renderPass;
         IComponentSystem* componentSystem;
+        JobSystem* jobSystem;
     };
 
     explicit Context(const CreateDesc& desc);
@@ -52,17 +59,41 @@ public:
         VkCommandBuffer commandBuffer;
         VkFramebuffer framebuffer;
     	const IRenderPass* renderPass;
+
+        /**
+         * Tasks added to the graph are finished before the command buffer is submitted.
+         */
+        TaskGraph* frameGraph;
     };
     void Run(const std::function<void(const Context::RenderDesc&)>& rendererCallback);
 
     void HintWindowResize();
 
+    /**
+     * Tightly packed pixels in the swapchain format.
+     */
+    using FrameCaptureCallback = std::function<void(const void* pixels, VkExtent2D extent, VkFormat format)>;
+
+    /**
+     * Copies the next rendered frame back to the host through the readback ring. The callback runs a frame or more
+     * later. Returns false if the swapchain images cannot be copied from.
+     */
+    bool RequestFrameCapture(FrameCaptureCallback callback);
+
+    /**
+     * Makes the next frames wait for the previous one before the component system is scheduled, for renderers that
+     * draw straight from the component memory. Otherwise the simulation overlaps the wait and writes what the device
+     * may still be reading.
+     */
+    void SetWaitBeforeSimulation(bool wait);
+
     void GetScreenSize(int& width, int& height) const;
 
     [[nodiscard]] const IRenderPass* GetRenderPass() const;
     [[nodiscard]] const Swapchain* GetSwapchain() const;
     
     [[nodiscard]] const Device* GetDevice() const;
+    [[nodiscard]] JobSystem* GetJobSystem() const;
     [[nodiscard]] const DeviceQueue* GetGraphicsQueue() const;
     [[nodiscard]] std::optional<const DeviceQueue*> GetTransferQueue() const;
     [[nodiscard]] const DeviceQueue* GetActualTransferQueue() const;
@@ -70,6 +101,26 @@ public:
     [[nodiscard]] VkCommandBuffer GetGraphicsCommandBuffer() const;
     [[nodiscard]] VkCommandBuffer GetTransferCommandBuffer() const;
 
+    /**
+     * Copies recorded into the graphics command buffer are submitted with the frame.
+     */
+    [[nodiscard]] ReadbackRing* GetReadbackRing() const;
+
+    /**
+     * Renderers release their resources here instead of destroying them, so switching back to one is cheap.
+     */
+    [[nodiscard]] ResourcePool* GetResourcePool() const;
+
+    /**
+     * Compacts the memory blocks between frames. Relocatable buffers register themselves.
+     */
+    [[nodiscard]] Defragmenter* GetDefragmenter() const;
+
+    /**
+     * Transient uniforms and small uploads of the frame being recorded. Reset once the previous frame is done.
+     */
+    [[nodiscard]] FrameArena* GetFrameArena() const;
+
     struct ShareInfo
     {
         std::vector<uint32_t> queueFamilyIndices;
@@ -92,7 +143,7 @@ public:
 private:
 
     void Update(const std::function<void(const Context::RenderDesc&)>& rendererCallback);
-    void Render(const std::function<void(const Context::RenderDesc&)>& rendererCallback, uint32_t imageIndex);
+    void Render(const std::function<void(const Context::RenderDesc&)>& rendererCallback, uint32_t imageIndex, TaskGraph& frameGraph);
 
     void InitializeWindow();
     void DestroyWindow();
@@ -120,12 +171,15 @@ private:
     void InitializeImGui();
     void DestroyImGui();
 
+    void RecordFrameCapture(uint32_t imageIndex);
+
     [[nodiscard]] std::vector<const char*> GetVulkanInstanceExtensions() const;
     [[nodiscard]] std::vector<const char*> GetVulkanValidationLayers() const;
 
     std::shared_ptr<Config> m_config{};
 	IRenderPass* m_renderPass{};
     IComponentSystem* m_componentSystem{};
+    JobSystem* m_jobSystem{};
 
     /**
      * The extensions that the default context expects you to have.
@@ -133,7 +187,18 @@ private:
      */
     std::vector<const char*> m_essentialDeviceExtensions = {
         VK_KHR_SWAPCHAIN_EXTENSION_NAME,
-        VK_EXT_MEMORY_BUDGET_EXTENSION_NAME
+        VK_EXT_MEMORY_BUDGET_EXTENSION_NAME,
+
+        // Lets the instanced renderers read the component arrays in place.
+        VK_KHR_EXTERNAL_MEMORY_EXTENSION_NAME,
+        VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME,
+
+        // Reports the largest allocation, which the instance streams are split by.
+        VK_KHR_MAINTENANCE_3_EXTENSION_NAME,
+
+        // Lets the driver ask for memory of their own for large buffers and images.
+        VK_KHR_GET_MEMORY_REQUIREMENTS_2_EXTENSION_NAME,
+        VK_KHR_DEDICATED_ALLOCATION_EXTENSION_NAME
     };
 
     GLFWwindow* m_window{};
@@ -146,6 +211,7 @@ private:
     std::unique_ptr<Swapchain> m_swapchain{};
 
     bool m_mustResize{};
+    bool m_waitBeforeSimulation{};
     std::vector<VkFramebuffer> m_framebuffers{};
 
     std::shared_ptr<DeviceQueue> m_graphicsQueue{};
@@ -164,6 +230,33 @@ private:
     VkSemaphore m_renderFinishedSemaphore{};
     VkFence m_submitFrameFence{};
 
+    /**
+     * A slot frees up once the frame that recorded it is done, so a few slots cover several readbacks per frame.
+     */
+    static constexpr uint32_t kReadbackSlotCount = 4;
+    static constexpr VkDeviceSize kReadbackSlotSize = 1024 * 1024;
+
+    std::unique_ptr<ReadbackRing> m_readbackRing{};
+    std::optional<FrameCaptureCallback> m_frameCaptureCallback{};
+
+    std::unique_ptr<ResourcePool> m_resourcePool{};
+
+    /**
+     * Moving more per frame would show up as a hitch, a few steps are enough to free the blocks after a renderer switch.
+     */
+    static constexpr VkDeviceSize kDefragmentationBytesPerStep = 8 * 1024 * 1024;
+    static constexpr double kDefragmentationMaxSourceUsage = 0.5;
+
+    std::unique_ptr<Defragmenter> m_defragmenter{};
+
+    /**
+     * Enough for the uniforms of every renderer with plenty to spare. One region, since one frame is in flight.
+     */
+    static constexpr VkDeviceSize kFrameArenaSize = 256 * 1024;
+    static constexpr uint32_t kFrameArenaFrameCount = 1;
+
+    std::unique_ptr<FrameArena> m_frameArena{};
+
 
     VkDescriptorPool m_imguiDescriptorPool{};
 };
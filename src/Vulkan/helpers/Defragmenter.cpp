@@ -0,0 +1,315 @@
+#include "Defragmenter.hpp"
+
+#include "../pch.hpp"
+#include "Context.hpp"
+#include "memory/DefragmentationPlanner.hpp"
+
+#include <map>
+#include <tracy/Tracy.hpp>
+
+Defragmenter::Defragmenter(const Context* context, const Defragmenter::Desc& desc) {
+
+    m_context = context;
+    m_desc = desc;
+
+    const DeviceQueue* transferQueue = m_context->GetActualTransferQueue();
+    const DeviceQueue* graphicsQueue = m_context->GetGraphicsQueue();
+    m_queue = transferQueue->GetFamilyIndex() == graphicsQueue->GetFamilyIndex() ? transferQueue : graphicsQueue;
+
+    const VkDevice device = m_context->GetDevice()->GetVkDevice();
+
+    const VkCommandPoolCreateInfo poolInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+        .queueFamilyIndex = m_queue->GetFamilyIndex()
+    };
+
+    VkResult result = vkCreateCommandPool(device, &poolInfo, nullptr, &m_commandPool);
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("[Defragmenter] Could not create a command pool: " + std::to_string(result));
+    }
+
+    const VkCommandBufferAllocateInfo bufferInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = m_commandPool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 1
+    };
+
+    result = vkAllocateCommandBuffers(device, &bufferInfo, &m_commandBuffer);
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("[Defragmenter] Could not allocate a command buffer: " + std::to_string(result));
+    }
+
+    constexpr VkFenceCreateInfo fenceInfo = {
+        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO
+    };
+
+    result = vkCreateFence(device, &fenceInfo, nullptr, &m_fence);
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("[Defragmenter] Could not create a fence: " + std::to_string(result));
+    }
+}
+
+void Defragmenter::Destroy() {
+
+    const VkDevice device = m_context->GetDevice()->GetVkDevice();
+
+    if (m_inFlight) {
+        vkWaitForFences(device, 1, &m_fence, VK_TRUE, UINT64_MAX);
+        this->FinishPendingMoves();
+    }
+
+    vkDestroyFence(device, m_fence, nullptr);
+    vkFreeCommandBuffers(device, m_commandPool, 1, &m_commandBuffer);
+    vkDestroyCommandPool(device, m_commandPool, nullptr);
+
+    m_fence = VK_NULL_HANDLE;
+    m_commandBuffer = VK_NULL_HANDLE;
+    m_commandPool = VK_NULL_HANDLE;
+
+    m_buffers.clear();
+}
+
+void Defragmenter::Register(GenericBuffer* buffer, VkDeviceSize alignment) {
+    m_buffers.insert_or_assign(buffer, alignment);
+}
+
+void Defragmenter::Unregister(GenericBuffer* buffer) {
+
+    const bool moving = std::ranges::any_of(m_pendingMoves, [buffer](const Move& move) { return move.buffer == buffer; });
+    if (moving) {
+        ZoneScopedN("Wait for defragmentation");
+        vkWaitForFences(m_context->GetDevice()->GetVkDevice(), 1, &m_fence, VK_TRUE, UINT64_MAX);
+        this->FinishPendingMoves();
+    }
+
+    m_buffers.erase(buffer);
+}
+
+void Defragmenter::Update() {
+
+    ZoneScoped;
+
+    if (m_inFlight) {
+        if (vkGetFenceStatus(m_context->GetDevice()->GetVkDevice(), m_fence) != VK_SUCCESS) {
+            return;
+        }
+        this->FinishPendingMoves();
+    }
+
+    if (!m_enabled) {
+        return;
+    }
+
+    this->Step();
+    this->Submit();
+}
+
+void Defragmenter::SetEnabled(bool enabled) {
+    m_enabled = enabled;
+}
+
+bool Defragmenter::IsEnabled() const {
+    return m_enabled;
+}
+
+Defragmenter::Stats Defragmenter::GetStats() const {
+
+    Stats stats = {
+        .blockCount = 0,
+        .blockSize = 0,
+        .blockUsedSize = 0,
+        .registeredCount = static_cast<uint32_t>(m_buffers.size()),
+        .moveCount = m_moveCount,
+        .movedSize = m_movedSize,
+        .freedBlockCount = m_freedBlockCount
+    };
+
+    for (const DeviceMemory::BlockInfo& block : m_context->GetDevice()->GetDeviceMemory()->GetBlocks()) {
+        stats.blockCount++;
+        stats.blockSize += block.allocator->GetSize();
+        stats.blockUsedSize += block.allocator->GetUsedSize();
+    }
+    return stats;
+}
+
+void Defragmenter::Step() {
+
+    DeviceMemory* deviceMemory = m_context->GetDevice()->GetDeviceMemory();
+    const std::vector<DeviceMemory::BlockInfo> blocks = deviceMemory->GetBlocks();
+
+    // Allocations only move between blocks of the same memory type, and buffer blocks are kept apart from image blocks.
+    std::map<std::pair<uint32_t, bool>, std::vector<uint32_t>> pools;
+    for (uint32_t blockInd = 0; blockInd < blocks.size(); blockInd++) {
+        pools[{ blocks[blockInd].memoryTypeIndex, blocks[blockInd].images }].push_back(blockInd);
+    }
+
+    std::unordered_map<VkDeviceMemory, std::vector<GenericBuffer*>> blockBuffers;
+    for (const auto& [buffer, alignment] : m_buffers) {
+        blockBuffers[buffer->GetVkDeviceMemory()].push_back(buffer);
+    }
+
+    VkDeviceSize remainingSize = m_desc.maxBytesPerStep;
+    for (const auto& [pool, poolBlocks] : pools) {
+
+        if (poolBlocks.size() < 2 || remainingSize == 0) {
+            continue;
+        }
+
+        std::vector<DefragmentationPlanner::Block> plannerBlocks;
+        std::vector<GenericBuffer*> plannerBuffers;
+
+        for (const uint32_t blockInd : poolBlocks) {
+
+            DefragmentationPlanner::Block& plannerBlock = plannerBlocks.emplace_back(DefragmentationPlanner::Block{
+                .allocator = *blocks[blockInd].allocator,
+                .allocations = {}
+            });
+
+            for (GenericBuffer* buffer : blockBuffers[blocks[blockInd].memory]) {
+
+                plannerBlock.allocations.push_back(DefragmentationPlanner::Allocation{
+                    .id = static_cast<uint32_t>(plannerBuffers.size()),
+                    .offset = buffer->GetMemoryOffset(),
+                    .size = buffer->GetAllocatedMemorySize(),
+                    .alignment = deviceMemory->GetSubAllocationAlignment(m_buffers.at(buffer), buffer->GetMemoryProperty())
+                });
+                plannerBuffers.push_back(buffer);
+            }
+        }
+
+        const std::vector<DefragmentationPlanner::Move> moves = DefragmentationPlanner::Plan(plannerBlocks, DefragmentationPlanner::Desc{
+            .maxSourceUsage = m_desc.maxSourceUsage,
+            .maxBytesPerStep = remainingSize
+        });
+
+        for (const DefragmentationPlanner::Move& move : moves) {
+
+            GenericBuffer* buffer = plannerBuffers[move.id];
+            remainingSize -= std::min(remainingSize, buffer->GetAllocatedMemorySize());
+
+            this->StartMove(buffer, blocks[poolBlocks[move.dstBlock]].memory, move.dstOffset);
+        }
+    }
+}
+
+void Defragmenter::StartMove(GenericBuffer* buffer, VkDeviceMemory dstMemory, VkDeviceSize dstOffset) {
+
+    DeviceMemory* deviceMemory = m_context->GetDevice()->GetDeviceMemory();
+    const VkDevice device = m_context->GetDevice()->GetVkDevice();
+    const VkDeviceSize size = buffer->GetAllocatedMemorySize();
+
+    // The plan was made on the current blocks, so this only fails if it is wrong.
+    if (!deviceMemory->SubAllocateAt(dstMemory, dstOffset, size)) {
+        spdlog::error("[Defragmenter] Planned destination at {} is not free", dstOffset);
+        return;
+    }
+
+    const DeviceMemory::SubAllocation dst = {
+        .memory = dstMemory,
+        .offset = dstOffset,
+        .size = size
+    };
+
+    VkBuffer dstBuffer;
+    const VkResult result = vkCreateBuffer(device, &buffer->m_relocationCreateInfo.value(), nullptr, &dstBuffer);
+    if (result != VK_SUCCESS) {
+        deviceMemory->FreeSubAllocation(dst);
+        throw std::runtime_error("[Defragmenter] Could not create a buffer: " + std::to_string(result));
+    }
+    vkBindBufferMemory(device, dstBuffer, dstMemory, dstOffset);
+
+    m_moveCount++;
+    m_movedSize += size;
+
+    // Nothing uses the buffer between frames, so host visible ones are switched right away.
+    if ((buffer->GetMemoryProperty() & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0) {
+
+        void* dstData = static_cast<std::byte*>(deviceMemory->MapMemory(dstMemory)) + dstOffset;
+        std::memcpy(dstData, buffer->GetMappedMemory(), buffer->GetBufferSize());
+        deviceMemory->FlushMemory(dstMemory, dstOffset, size);
+
+        this->FinishMove(Move{
+            .buffer = buffer,
+            .dstBuffer = dstBuffer,
+            .dst = dst
+        });
+        return;
+    }
+
+    if (!m_recording) {
+
+        constexpr VkCommandBufferBeginInfo beginInfo = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+            .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+        };
+        vkBeginCommandBuffer(m_commandBuffer, &beginInfo);
+        m_recording = true;
+    }
+
+    const VkBufferCopy copy = {
+        .srcOffset = 0,
+        .dstOffset = 0,
+        .size = buffer->GetBufferSize()
+    };
+    vkCmdCopyBuffer(m_commandBuffer, buffer->GetVkBuffer(), dstBuffer, 1, &copy);
+
+    m_pendingMoves.push_back(Move{
+        .buffer = buffer,
+        .dstBuffer = dstBuffer,
+        .dst = dst
+    });
+}
+
+void Defragmenter::FinishMove(const Move& move) {
+
+    DeviceMemory* deviceMemory = m_context->GetDevice()->GetDeviceMemory();
+
+    const DeviceMemory::SubAllocation src = move.buffer->GetSubAllocation();
+    const VkBuffer srcBuffer = move.buffer->GetVkBuffer();
+
+    move.buffer->Relocate(move.dstBuffer, move.dst);
+
+    vkDestroyBuffer(m_context->GetDevice()->GetVkDevice(), srcBuffer, nullptr);
+    deviceMemory->MoveSubAllocation(src, move.dst);
+    deviceMemory->FreeSubAllocation(src);
+
+    if (!deviceMemory->IsBlock(src.memory)) {
+        m_freedBlockCount++;
+    }
+}
+
+void Defragmenter::FinishPendingMoves() {
+
+    for (const Move& move : m_pendingMoves) {
+        this->FinishMove(move);
+    }
+
+    m_pendingMoves.clear();
+    m_inFlight = false;
+
+    vkResetFences(m_context->GetDevice()->GetVkDevice(), 1, &m_fence);
+}
+
+void Defragmenter::Submit() {
+
+    if (!m_recording) {
+        return;
+    }
+
+    vkEndCommandBuffer(m_commandBuffer);
+    m_recording = false;
+
+    const VkSubmitInfo submitInfo = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &m_commandBuffer
+    };
+
+    const VkResult result = vkQueueSubmit(m_queue->GetVkQueue(), 1, &submitInfo, m_fence);
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("[Defragmenter] Could not submit the copies: " + std::to_string(result));
+    }
+    m_inFlight = true;
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <volk.h>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+
+#include "DeviceMemory.hpp"
+
+class Context;
+class GenericBuffer;
+class DeviceQueue;
+
+/**
+ * Compacts the blocks DeviceMemory sub-allocates from, a few megabytes per frame. Sparsely used blocks are emptied by
+ * moving their relocatable buffers into fuller blocks of the same memory type, and freed once nothing is left in them.
+ *
+ * Host visible buffers are copied on the host right away. The others are copied with vkCmdCopyBuffer and switched
+ * over once the fence of the copy is signaled, a frame or more later. Buffers look up their VkBuffer every frame and
+ * ShaderLayout writes the descriptors of moved buffers again, so their owners don't notice.
+ */
+class Defragmenter
+{
+public:
+
+	struct Desc
+	{
+		/**
+		 * Bytes moved per frame. A block larger than that is still moved as a whole.
+		 */
+		VkDeviceSize maxBytesPerStep;
+
+		/**
+		 * Blocks used less than this share of their size are emptied.
+		 */
+		double maxSourceUsage;
+	};
+
+	struct Stats
+	{
+		uint32_t blockCount;
+		VkDeviceSize blockSize;
+		VkDeviceSize blockUsedSize;
+
+		uint32_t registeredCount;
+		uint32_t moveCount;
+		VkDeviceSize movedSize;
+		uint32_t freedBlockCount;
+	};
+
+	Defragmenter(const Context* context, const Defragmenter::Desc& desc);
+
+	/**
+	 * Waits for the copies in flight and switches their buffers over.
+	 */
+	void Destroy();
+
+	/**
+	 * Called by GenericBuffer for relocatable buffers in a block.
+	 * \param alignment From the memory requirements of the buffer.
+	 */
+	void Register(GenericBuffer* buffer, VkDeviceSize alignment);
+
+	/**
+	 * Waits for the copy of the buffer if one is in flight, so it can be destroyed afterwards.
+	 */
+	void Unregister(GenericBuffer* buffer);
+
+	/**
+	 * Switches over the buffers whose copies are done and starts the next step. Called once per frame, after the
+	 * previous frame is done and before the next one is recorded.
+	 */
+	void Update();
+
+	void SetEnabled(bool enabled);
+	[[nodiscard]] bool IsEnabled() const;
+
+	[[nodiscard]] Defragmenter::Stats GetStats() const;
+
+private:
+
+	struct Move
+	{
+		GenericBuffer* buffer;
+		VkBuffer dstBuffer;
+		DeviceMemory::SubAllocation dst;
+	};
+
+	void Step();
+
+	/**
+	 * Takes the destination, creates the buffer there and copies into it.
+	 */
+	void StartMove(GenericBuffer* buffer, VkDeviceMemory dstMemory, VkDeviceSize dstOffset);
+
+	/**
+	 * Switches the buffer over and frees where it was.
+	 */
+	void FinishMove(const Move& move);
+
+	void FinishPendingMoves();
+	void Submit();
+
+	const Context* m_context;
+	Defragmenter::Desc m_desc;
+	bool m_enabled = true;
+
+	// Registered buffers with the alignment of their memory requirements.
+	std::unordered_map<GenericBuffer*, VkDeviceSize> m_buffers;
+
+	/**
+	 * The graphics queue, or the transfer queue if it is of the same family. The buffers are exclusive to the
+	 * graphics family, so a transfer family would need ownership transfers in both directions.
+	 */
+	const DeviceQueue* m_queue;
+	VkCommandPool m_commandPool{};
+	VkCommandBuffer m_commandBuffer{};
+	VkFence m_fence{};
+
+	bool m_recording = false;
+	bool m_inFlight = false;
+	std::vector<Move> m_pendingMoves;
+
+	uint32_t m_moveCount = 0;
+	VkDeviceSize m_movedSize = 0;
+	uint32_t m_freedBlockCount = 0;
+};
\ No newline at end of file
@@ -105,6 +105,9 @@ std::unique_ptr<Device> Device::FindDevice(const Context* context, DeviceID devi
 
 
 void Device::Destroy() {
+
+    // Blocks kept for reuse are not owned by any resource, so nothing else frees them.
+    m_deviceMemory->FreeEmptyBlocks();
     vkDestroyDevice(m_logicalDevice, nullptr);
     m_logicalDevice = VK_NULL_HANDLE;
 
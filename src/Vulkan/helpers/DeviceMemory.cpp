@@ -2,6 +2,8 @@
 
 #include "../pch.hpp"
 
+#include <tracy/Tracy.hpp>
+
 #include "Device.hpp"
 #include "VkHelper.hpp"
 
@@ -33,53 +35,615 @@ std::string ToBestRepresentation(VkDeviceSize size) {
 	return std::format("{:.2f} GB", castedSize);
 }
 
+static void AddToCounter(DeviceMemory::Counter& counter, VkDeviceSize size) {
+
+	counter.liveSize += size;
+	counter.liveCount += 1;
+	counter.highWaterMark = std::max(counter.highWaterMark, counter.liveSize);
+}
+
+static void RemoveFromCounter(DeviceMemory::Counter& counter, VkDeviceSize size) {
+
+	counter.liveSize -= size;
+	counter.liveCount -= 1;
+}
+
+// Full paths only make the leak log harder to read.
+static std::string_view GetFileName(const std::source_location& location) {
+
+	const std::string_view path = location.file_name();
+	const size_t separator = path.find_last_of("/\\");
+	return separator == std::string_view::npos ? path : path.substr(separator + 1);
+}
+
 DeviceMemory::DeviceMemory(const Device* device) {
 
 	m_device = device;
 
+	if (m_device->IsExtensionEnabled(VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME)) {
+
+		VkPhysicalDeviceExternalMemoryHostPropertiesEXT hostProperties = {
+			.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_MEMORY_HOST_PROPERTIES_EXT
+		};
+
+		VkPhysicalDeviceProperties2 properties2 = {
+			.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+			.pNext = &hostProperties
+		};
+
+		vkGetPhysicalDeviceProperties2(m_device->GetVkPhysicalDevice(), &properties2);
+		m_minImportedHostPointerAlignment = hostProperties.minImportedHostPointerAlignment;
+	}
+
+	if (m_device->IsExtensionEnabled(VK_KHR_MAINTENANCE_3_EXTENSION_NAME)) {
+
+		VkPhysicalDeviceMaintenance3Properties maintenance3Properties = {
+			.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MAINTENANCE_3_PROPERTIES
+		};
+
+		VkPhysicalDeviceProperties2 properties2 = {
+			.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+			.pNext = &maintenance3Properties
+		};
+
+		vkGetPhysicalDeviceProperties2(m_device->GetVkPhysicalDevice(), &properties2);
+		m_maxAllocationSize = maintenance3Properties.maxMemoryAllocationSize;
+	}
+
+	m_dedicatedAllocationSupported = m_device->IsExtensionEnabled(VK_KHR_GET_MEMORY_REQUIREMENTS_2_EXTENSION_NAME)
+		&& m_device->IsExtensionEnabled(VK_KHR_DEDICATED_ALLOCATION_EXTENSION_NAME);
+
+	vkGetPhysicalDeviceMemoryProperties(m_device->GetVkPhysicalDevice(), &m_memoryProperties);
+	m_nonCoherentAtomSize = m_device->GetVkPhysicalDeviceProperties().limits.nonCoherentAtomSize;
+	m_bufferImageGranularity = m_device->GetVkPhysicalDeviceProperties().limits.bufferImageGranularity;
+
+	m_heapBudgets.resize(m_memoryProperties.memoryHeapCount);
+	for (uint32_t heapInd = 0; heapInd < m_memoryProperties.memoryHeapCount; heapInd++) {
+		m_heapBudgets[heapInd] = HeapBudget{
+			.flags = m_memoryProperties.memoryHeaps[heapInd].flags,
+			.size = m_memoryProperties.memoryHeaps[heapInd].size,
+			.budget = m_memoryProperties.memoryHeaps[heapInd].size,
+			.usage = 0,
+			.categoryUsage = {}
+		};
+	}
+	m_unqueriedUsage.assign(m_memoryProperties.memoryHeapCount, 0);
+	this->QueryBudget();
+
+	m_snapshot.memoryTypes.resize(m_memoryProperties.memoryTypeCount);
+	for (uint32_t typeInd = 0; typeInd < m_memoryProperties.memoryTypeCount; typeInd++) {
+		m_memoryTypePlotNames.push_back(std::format("GPU memory type {}", typeInd));
+	}
+
 	this->LogHeapInfo();
 	this->LogMemoryRequirements();
 }
 
 DeviceMemory::~DeviceMemory() {
 
-	if (!m_allocatedMemory.empty()) {
-		spdlog::error("[DeviceMemory] Detected memory leak. You must deallocate {} more resources", m_allocatedMemory.size());
-	}
+	this->LogLeaks();
 }
 
 VkDeviceMemory DeviceMemory::AllocateMemory(const DeviceMemory::AllocationDesc& desc) {
 
+	const VkDeviceSize size = desc.memoryRequirements.size;
+	if (size > m_maxAllocationSize) {
+		throw std::runtime_error(std::format("[DeviceMemory] {} allocation of {} is larger than the maximum allocation size of {}",
+			DeviceMemory::GetCategoryName(desc.category), ToBestRepresentation(size), ToBestRepresentation(m_maxAllocationSize)));
+	}
+
+	// Types with the preferred properties go first, the others are only fallbacks.
+	const VkMemoryPropertyFlags preferredFlags = desc.memoryPropertyFlags | desc.preferredPropertyFlags;
+
+	std::vector<uint32_t> candidateTypes;
+	for (const VkMemoryPropertyFlags flags : { preferredFlags, desc.memoryPropertyFlags }) {
+		for (uint32_t typeInd = 0; typeInd < m_memoryProperties.memoryTypeCount; typeInd++) {
+
+			const VkMemoryPropertyFlags typeFlags = m_memoryProperties.memoryTypes[typeInd].propertyFlags;
+			if ((desc.memoryRequirements.memoryTypeBits & (1 << typeInd)) != 0 && (typeFlags & flags) == flags
+				&& std::ranges::find(candidateTypes, typeInd) == candidateTypes.end()) {
+				candidateTypes.push_back(typeInd);
+			}
+		}
+	}
+
+	if (candidateTypes.empty()) {
+		throw std::runtime_error("[DeviceMemory] Could not find correct memory type");
+	}
+
+	const uint32_t preferredType = candidateTypes.front();
+	for (const uint32_t typeInd : candidateTypes) {
+
+		const VkMemoryType& memoryType = m_memoryProperties.memoryTypes[typeInd];
+		if (this->GetAvailableHeapBudget(memoryType.heapIndex) < size) {
+			continue;
+		}
+
+		if (typeInd != preferredType) {
+			spdlog::warn("[DeviceMemory] Heap {} is over budget, {} allocation of {} falls back to memory type {}",
+				m_memoryProperties.memoryTypes[preferredType].heapIndex, DeviceMemory::GetCategoryName(desc.category), ToBestRepresentation(size), typeInd);
+		}
+
+		const VkMemoryDedicatedAllocateInfoKHR dedicatedInfo = {
+			.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO_KHR,
+			.image = desc.image,
+			.buffer = desc.buffer
+		};
+		const bool dedicated = m_dedicatedAllocationSupported && (desc.prefersDedicated || desc.requiresDedicated);
+
+		const VkMemoryAllocateInfo memoryAllocateInfo = {
+			.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+			.pNext = dedicated ? &dedicatedInfo : nullptr,
+			.allocationSize = size,
+			.memoryTypeIndex = typeInd
+		};
+
+		VkDeviceMemory memory;
+
+		const VkResult result = vkAllocateMemory(m_device->GetVkDevice(), &memoryAllocateInfo, nullptr, &memory);
+		if (result != VK_SUCCESS) {
+			throw std::runtime_error("[DeviceMemory] Could not allocate memory");
+		}
+
+		this->TrackAllocation(memory, Allocation{
+			.size = size,
+			.heapIndex = memoryType.heapIndex,
+			.memoryTypeIndex = typeInd,
+			.category = desc.category,
+			.propertyFlags = memoryType.propertyFlags
+		});
+		return memory;
+	}
+
+	throw std::runtime_error(std::format("[DeviceMemory] {} allocation of {} does not fit into the remaining budget of {}",
+		DeviceMemory::GetCategoryName(desc.category), ToBestRepresentation(size),
+		ToBestRepresentation(this->GetAvailableHeapBudget(m_memoryProperties.memoryTypes[preferredType].heapIndex))));
+}
+
+VkDeviceMemory DeviceMemory::ImportHostMemory(void* hostPointer, VkDeviceSize size, uint32_t typeFilter, MemoryCategory category, const std::source_location& callSite) {
+
+	if (!this->IsHostImportSupported()) {
+		throw std::runtime_error("[DeviceMemory] Host memory import is not supported");
+	}
+
+	const VkDeviceSize alignment = m_minImportedHostPointerAlignment;
+	if (reinterpret_cast<uintptr_t>(hostPointer) % alignment != 0 || size % alignment != 0) {
+		throw std::runtime_error(std::format("[DeviceMemory] Imported host memory must be aligned to {} bytes", alignment));
+	}
+	if (size > m_maxAllocationSize) {
+		throw std::runtime_error(std::format("[DeviceMemory] Importing {} is over the maximum allocation size of {}", ToBestRepresentation(size), ToBestRepresentation(m_maxAllocationSize)));
+	}
+
+	VkMemoryHostPointerPropertiesEXT hostPointerProperties = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_HOST_POINTER_PROPERTIES_EXT
+	};
+
+	VkResult result = vkGetMemoryHostPointerPropertiesEXT(m_device->GetVkDevice(), VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT, hostPointer, &hostPointerProperties);
+	if (result != VK_SUCCESS || (hostPointerProperties.memoryTypeBits & typeFilter) == 0) {
+		throw std::runtime_error("[DeviceMemory] No memory type can import the host pointer");
+	}
+
+	const VkImportMemoryHostPointerInfoEXT importInfo = {
+		.sType = VK_STRUCTURE_TYPE_IMPORT_MEMORY_HOST_POINTER_INFO_EXT,
+		.handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT,
+		.pHostPointer = hostPointer
+	};
+
+	const uint32_t memoryTypeIndex = this->FindMemoryType(hostPointerProperties.memoryTypeBits & typeFilter, 0);
 	const VkMemoryAllocateInfo memoryAllocateInfo = {
 		.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-		.allocationSize = desc.memoryRequirements.size,
-		.memoryTypeIndex = this->FindMemoryType(desc.memoryRequirements.memoryTypeBits, desc.memoryPropertyFlags)
+		.pNext = &importInfo,
+		.allocationSize = size,
+		.memoryTypeIndex = memoryTypeIndex
 	};
 
 	VkDeviceMemory memory;
-	
-	const VkResult result = vkAllocateMemory(m_device->GetVkDevice(), &memoryAllocateInfo, nullptr, &memory);
+
+	result = vkAllocateMemory(m_device->GetVkDevice(), &memoryAllocateInfo, nullptr, &memory);
 	if (result != VK_SUCCESS) {
-		throw std::runtime_error("[DeviceMemory] Could not allocate memory");
+		throw std::runtime_error("[DeviceMemory] Could not import host memory");
 	}
 
-	m_allocatedMemory.insert(memory);
+	// Already host memory, so it counts as mapped at the imported pointer.
+	this->TrackAllocation(memory, Allocation{
+		.size = size,
+		.heapIndex = m_memoryProperties.memoryTypes[memoryTypeIndex].heapIndex,
+		.memoryTypeIndex = memoryTypeIndex,
+		.category = category,
+		.propertyFlags = m_memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags,
+		.mappedMemory = hostPointer
+	});
+	this->TrackResource(memory, 0, Resource{
+		.size = size,
+		.category = category,
+		.callSite = callSite
+	});
 	return memory;
 }
 
+DeviceMemory::SubAllocation DeviceMemory::SubAllocate(const DeviceMemory::AllocationDesc& desc) {
+
+	const SubAllocation subAllocation = this->PlaceSubAllocation(desc);
+	this->TrackResource(subAllocation.memory, subAllocation.offset, Resource{
+		.size = subAllocation.size,
+		.category = desc.category,
+		.callSite = desc.callSite
+	});
+	return subAllocation;
+}
+
+DeviceMemory::SubAllocation DeviceMemory::PlaceSubAllocation(const DeviceMemory::AllocationDesc& desc) {
+
+	const char* categoryName = DeviceMemory::GetCategoryName(desc.category);
+
+	if (desc.requiresDedicated || desc.prefersDedicated) {
+
+		spdlog::info("[DeviceMemory] {} allocation of {} is dedicated, the driver {} it", categoryName,
+			ToBestRepresentation(desc.memoryRequirements.size), desc.requiresDedicated ? "requires" : "prefers");
+		return SubAllocation{
+			.memory = this->AllocateMemory(desc),
+			.offset = 0,
+			.size = desc.memoryRequirements.size
+		};
+	}
+
+	if (desc.memoryRequirements.size > kMaxSubAllocationSize) {
+
+		spdlog::debug("[DeviceMemory] {} allocation of {} gets memory of its own, it is too large for a block", categoryName,
+			ToBestRepresentation(desc.memoryRequirements.size));
+		return SubAllocation{
+			.memory = this->AllocateMemory(desc),
+			.offset = 0,
+			.size = desc.memoryRequirements.size
+		};
+	}
+
+	// Linear buffers and optimal images must not share a bufferImageGranularity page, so where that is more than a
+	// byte they go to different blocks. Categories share blocks, the resources are attributed one by one.
+	const bool images = desc.image != VK_NULL_HANDLE && m_bufferImageGranularity > 1;
+	const VkDeviceSize size = desc.memoryRequirements.size;
+	const VkDeviceSize alignment = desc.memoryRequirements.alignment;
+
+	const VkMemoryPropertyFlags preferredFlags = desc.memoryPropertyFlags | desc.preferredPropertyFlags;
+	for (const VkMemoryPropertyFlags flags : { preferredFlags, desc.memoryPropertyFlags }) {
+		for (auto& [memory, block] : m_blocks) {
+
+			const Allocation& blockAllocation = m_allocations.at(memory);
+			if (block.images != images || (desc.memoryRequirements.memoryTypeBits & (1 << blockAllocation.memoryTypeIndex)) == 0
+				|| (blockAllocation.propertyFlags & flags) != flags) {
+				continue;
+			}
+
+			const std::optional<uint64_t> offset = block.allocator.Allocate(size, this->GetSubAllocationAlignment(alignment, blockAllocation.propertyFlags));
+			if (offset.has_value()) {
+				return SubAllocation{
+					.memory = memory,
+					.offset = *offset,
+					.size = size
+				};
+			}
+		}
+	}
+
+	AllocationDesc blockDesc = desc;
+	blockDesc.memoryRequirements.size = kBlockSize;
+	blockDesc.category = MemoryCategory::Other;
+	blockDesc.buffer = VK_NULL_HANDLE;
+	blockDesc.image = VK_NULL_HANDLE;
+
+	VkDeviceMemory memory;
+	try {
+		memory = this->AllocateMemory(blockDesc);
+	}
+	catch (const std::runtime_error& error) {
+
+		// A whole block may not fit where the allocation alone still does.
+		spdlog::warn("[DeviceMemory] {}, allocating {} on its own", error.what(), ToBestRepresentation(desc.memoryRequirements.size));
+		return SubAllocation{
+			.memory = this->AllocateMemory(desc),
+			.offset = 0,
+			.size = desc.memoryRequirements.size
+		};
+	}
+
+	spdlog::debug("[DeviceMemory] New {} block in memory type {} for a {} allocation of {}", images ? "image" : "buffer",
+		m_allocations.at(memory).memoryTypeIndex, categoryName, ToBestRepresentation(size));
+
+	Block& block = m_blocks.emplace(memory, Block{ .allocator = BlockAllocator(kBlockSize), .images = images }).first->second;
+	return SubAllocation{
+		.memory = memory,
+		.offset = *block.allocator.Allocate(size, this->GetSubAllocationAlignment(alignment, m_allocations.at(memory).propertyFlags)),
+		.size = size
+	};
+}
+
+VkDeviceSize DeviceMemory::GetSubAllocationAlignment(VkDeviceSize alignment, VkMemoryPropertyFlags propertyFlags) const {
+
+	if ((propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0 && (propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) == 0) {
+		return std::max(alignment, m_nonCoherentAtomSize);
+	}
+	return alignment;
+}
+
+bool DeviceMemory::SubAllocateAt(VkDeviceMemory block, VkDeviceSize offset, VkDeviceSize size) {
+
+	const auto it = m_blocks.find(block);
+	if (it == m_blocks.end()) {
+		throw std::runtime_error("[DeviceMemory] Trying to sub-allocate from memory that is not a block");
+	}
+	return it->second.allocator.AllocateAt(offset, size);
+}
+
+void DeviceMemory::FreeSubAllocation(const DeviceMemory::SubAllocation& subAllocation) {
+
+	this->UntrackResource(subAllocation.memory, subAllocation.offset);
+
+	const auto it = m_blocks.find(subAllocation.memory);
+	if (it == m_blocks.end()) {
+		this->FreeMemory(subAllocation.memory);
+		return;
+	}
+
+	Block& block = it->second;
+	block.allocator.Free(subAllocation.offset, subAllocation.size);
+	if (!block.allocator.IsEmpty()) {
+		return;
+	}
+
+	const uint32_t memoryTypeIndex = m_allocations.at(subAllocation.memory).memoryTypeIndex;
+	const bool hasSpare = std::ranges::any_of(m_blocks, [&](const auto& other)
+	{
+		return other.first != subAllocation.memory && other.second.images == block.images && other.second.allocator.IsEmpty()
+			&& m_allocations.at(other.first).memoryTypeIndex == memoryTypeIndex;
+	});
+
+	if (hasSpare) {
+		this->FreeMemory(subAllocation.memory);
+	}
+}
+
+void DeviceMemory::FreeEmptyBlocks() {
+
+	std::vector<VkDeviceMemory> emptyBlocks;
+	for (const auto& [memory, block] : m_blocks) {
+		if (block.allocator.IsEmpty()) {
+			emptyBlocks.push_back(memory);
+		}
+	}
+
+	for (const VkDeviceMemory memory : emptyBlocks) {
+		this->FreeMemory(memory);
+	}
+}
+
+void DeviceMemory::MoveSubAllocation(const DeviceMemory::SubAllocation& from, const DeviceMemory::SubAllocation& to) {
+
+	const auto it = m_resources.find({ from.memory, from.offset });
+	if (it == m_resources.end()) {
+		throw std::runtime_error("[DeviceMemory] Trying to move a sub-allocation that is not tracked");
+	}
+
+	const Resource resource = it->second;
+	m_resources.erase(it);
+	m_resources.emplace(std::make_pair(to.memory, to.offset), resource);
+}
+
+bool DeviceMemory::IsBlock(VkDeviceMemory memory) const {
+	return m_blocks.contains(memory);
+}
+
+std::vector<DeviceMemory::BlockInfo> DeviceMemory::GetBlocks() const {
+
+	std::vector<BlockInfo> blocks;
+	blocks.reserve(m_blocks.size());
+
+	for (const auto& [memory, block] : m_blocks) {
+
+		const Allocation& allocation = m_allocations.at(memory);
+		blocks.push_back(BlockInfo{
+			.memory = memory,
+			.memoryTypeIndex = allocation.memoryTypeIndex,
+			.images = block.images,
+			.allocator = &block.allocator
+		});
+	}
+	return blocks;
+}
+
+void* DeviceMemory::MapMemory(VkDeviceMemory memory) {
+
+	const auto it = m_allocations.find(memory);
+	if (it == m_allocations.end()) {
+		throw std::runtime_error("[DeviceMemory] Trying to map memory that was not allocated here");
+	}
+
+	Allocation& allocation = it->second;
+	if (allocation.mappedMemory != nullptr) {
+		return allocation.mappedMemory;
+	}
+
+	if ((allocation.propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) == 0) {
+		throw std::runtime_error(std::format("[DeviceMemory] Trying to map {} memory that is not host visible", DeviceMemory::GetCategoryName(allocation.category)));
+	}
+
+	const VkResult result = vkMapMemory(m_device->GetVkDevice(), memory, 0, VK_WHOLE_SIZE, 0, &allocation.mappedMemory);
+	if (result != VK_SUCCESS) {
+		throw std::runtime_error("[DeviceMemory] Could not map memory");
+	}
+
+	return allocation.mappedMemory;
+}
+
+void DeviceMemory::FlushMemory(VkDeviceMemory memory, VkDeviceSize offset, VkDeviceSize size) const {
+
+	VkMappedMemoryRange range;
+	if (!this->GetNonCoherentRange(memory, offset, size, range)) {
+		return;
+	}
+
+	const VkResult result = vkFlushMappedMemoryRanges(m_device->GetVkDevice(), 1, &range);
+	if (result != VK_SUCCESS) {
+		throw std::runtime_error("[DeviceMemory] Could not flush mapped memory");
+	}
+}
+
+void DeviceMemory::InvalidateMemory(VkDeviceMemory memory, VkDeviceSize offset, VkDeviceSize size) const {
+
+	VkMappedMemoryRange range;
+	if (!this->GetNonCoherentRange(memory, offset, size, range)) {
+		return;
+	}
+
+	const VkResult result = vkInvalidateMappedMemoryRanges(m_device->GetVkDevice(), 1, &range);
+	if (result != VK_SUCCESS) {
+		throw std::runtime_error("[DeviceMemory] Could not invalidate mapped memory");
+	}
+}
+
+VkMemoryPropertyFlags DeviceMemory::GetMemoryPropertyFlags(VkDeviceMemory memory) const {
+
+	const auto it = m_allocations.find(memory);
+	if (it == m_allocations.end()) {
+		throw std::runtime_error("[DeviceMemory] Trying to query memory that was not allocated here");
+	}
+	return it->second.propertyFlags;
+}
+
 void DeviceMemory::FreeMemory(VkDeviceMemory memory) {
 
+	// Mapped memory is unmapped implicitly when it is freed.
 	vkFreeMemory(m_device->GetVkDevice(), memory, nullptr);
-	m_allocatedMemory.erase(memory);
+	m_blocks.erase(memory);
+
+	const auto it = m_allocations.find(memory);
+	if (it == m_allocations.end()) {
+		return;
+	}
+
+	// Resources that were never freed on their own go with their memory.
+	while (true) {
+
+		const auto resource = m_resources.lower_bound({ memory, 0 });
+		if (resource == m_resources.end() || resource->first.first != memory) {
+			break;
+		}
+		this->UntrackResource(memory, resource->first.second);
+	}
+
+	const Allocation& allocation = it->second;
+	m_heapBudgets[allocation.heapIndex].categoryUsage[static_cast<uint32_t>(allocation.category)] -= allocation.size;
+	m_unqueriedUsage[allocation.heapIndex] -= static_cast<int64_t>(allocation.size);
+
+	RemoveFromCounter(m_snapshot.memoryTypes[allocation.memoryTypeIndex], allocation.size);
+	RemoveFromCounter(m_snapshot.memory, allocation.size);
+	m_frameCounts.memoryFreeCount++;
+	m_snapshot.total.memoryFreeCount++;
+
+	m_allocations.erase(it);
 }
 
-uint32_t DeviceMemory::FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const {
+void DeviceMemory::UpdateBudget(double currentTime) {
+
+	if (currentTime - m_lastBudgetQueryTime < kBudgetQueryInterval) {
+		return;
+	}
+
+	m_lastBudgetQueryTime = currentTime;
+	this->QueryBudget();
+}
+
+const std::vector<DeviceMemory::HeapBudget>& DeviceMemory::GetHeapBudgets() const {
+	return m_heapBudgets;
+}
+
+void DeviceMemory::EndFrame() {
+
+	m_snapshot.frame = m_frameCounts;
+	m_frameCounts = {};
+
+	static constexpr std::array<const char*, kCategoryCount> kCategoryPlotNames = {
+		"GPU Other", "GPU Instance", "GPU Vertex", "GPU Index", "GPU Uniform", "GPU Staging", "GPU Texture"
+	};
 
-	VkPhysicalDeviceMemoryProperties memoryProperties;
-	vkGetPhysicalDeviceMemoryProperties(m_device->GetVkPhysicalDevice(), &memoryProperties);
+	for (uint32_t category = 0; category < kCategoryCount; category++) {
+		TracyPlot(kCategoryPlotNames[category], static_cast<int64_t>(m_snapshot.categories[category].liveSize));
+	}
+	for (uint32_t typeInd = 0; typeInd < m_snapshot.memoryTypes.size(); typeInd++) {
+		TracyPlot(m_memoryTypePlotNames[typeInd].c_str(), static_cast<int64_t>(m_snapshot.memoryTypes[typeInd].liveSize));
+	}
+
+	TracyPlot("GPU resources", static_cast<int64_t>(m_snapshot.resources.liveSize));
+	TracyPlot("GPU memory", static_cast<int64_t>(m_snapshot.memory.liveSize));
+	TracyPlot("GPU allocations per frame", static_cast<int64_t>(m_snapshot.frame.allocationCount));
+	TracyPlot("GPU frees per frame", static_cast<int64_t>(m_snapshot.frame.freeCount));
+}
+
+DeviceMemory::Snapshot DeviceMemory::GetSnapshot() const {
+	return m_snapshot;
+}
+
+void DeviceMemory::ResetHighWaterMarks() {
+
+	for (Counter& counter : m_snapshot.categories) {
+		counter.highWaterMark = counter.liveSize;
+	}
+	for (Counter& counter : m_snapshot.memoryTypes) {
+		counter.highWaterMark = counter.liveSize;
+	}
+	m_snapshot.resources.highWaterMark = m_snapshot.resources.liveSize;
+	m_snapshot.memory.highWaterMark = m_snapshot.memory.liveSize;
+}
+
+VkDeviceSize DeviceMemory::GetAvailableBudget(VkMemoryPropertyFlags properties, uint32_t typeFilter) const {
+
+	const uint32_t typeInd = this->FindMemoryType(typeFilter, properties);
+	return this->GetAvailableHeapBudget(m_memoryProperties.memoryTypes[typeInd].heapIndex);
+}
+
+const char* DeviceMemory::GetCategoryName(MemoryCategory category) {
+
+	switch (category) {
+	case MemoryCategory::Other:
+		return "Other";
+	case MemoryCategory::Instance:
+		return "Instance";
+	case MemoryCategory::Vertex:
+		return "Vertex";
+	case MemoryCategory::Index:
+		return "Index";
+	case MemoryCategory::Uniform:
+		return "Uniform";
+	case MemoryCategory::Staging:
+		return "Staging";
+	case MemoryCategory::Texture:
+		return "Texture";
+	case MemoryCategory::Count:
+		break;
+	}
+
+	return "Unknown";
+}
+
+bool DeviceMemory::IsHostImportSupported() const {
+	return m_minImportedHostPointerAlignment != 0;
+}
+
+bool DeviceMemory::IsDedicatedAllocationSupported() const {
+	return m_dedicatedAllocationSupported;
+}
+
+VkDeviceSize DeviceMemory::GetMinImportedHostPointerAlignment() const {
+	return m_minImportedHostPointerAlignment;
+}
+
+VkDeviceSize DeviceMemory::GetMaxAllocationSize() const {
+	return m_maxAllocationSize;
+}
 
-	for (uint32_t ind = 0; ind < memoryProperties.memoryTypeCount; ind++) {
-		if (typeFilter & (1 << ind) && ((memoryProperties.memoryTypes[ind].propertyFlags & properties) == properties)) {
+uint32_t DeviceMemory::FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const {
+
+	for (uint32_t ind = 0; ind < m_memoryProperties.memoryTypeCount; ind++) {
+		if (typeFilter & (1 << ind) && ((m_memoryProperties.memoryTypes[ind].propertyFlags & properties) == properties)) {
 			return ind;
 		}
 	}
@@ -87,6 +651,148 @@ uint32_t DeviceMemory::FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags
 	throw std::runtime_error("[DeviceMemory] Could not find correct memory type");
 }
 
+VkDeviceSize DeviceMemory::GetAvailableHeapBudget(uint32_t heapIndex) const {
+
+	const HeapBudget& heap = m_heapBudgets[heapIndex];
+	const int64_t usage = static_cast<int64_t>(heap.usage) + m_unqueriedUsage[heapIndex];
+
+	return usage < static_cast<int64_t>(heap.budget) ? heap.budget - static_cast<VkDeviceSize>(std::max<int64_t>(usage, 0)) : 0;
+}
+
+bool DeviceMemory::GetNonCoherentRange(VkDeviceMemory memory, VkDeviceSize offset, VkDeviceSize size, VkMappedMemoryRange& range) const {
+
+	const auto it = m_allocations.find(memory);
+	if (it == m_allocations.end()) {
+		throw std::runtime_error("[DeviceMemory] Trying to flush or invalidate memory that was not allocated here");
+	}
+
+	const Allocation& allocation = it->second;
+	if ((allocation.propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0 || size == 0) {
+		return false;
+	}
+
+	if (allocation.mappedMemory == nullptr) {
+		throw std::runtime_error("[DeviceMemory] Trying to flush or invalidate memory that is not mapped");
+	}
+
+	// Both ends have to be multiples of the atom size, except for an end at the end of the allocation.
+	const VkDeviceSize begin = offset / m_nonCoherentAtomSize * m_nonCoherentAtomSize;
+	const VkDeviceSize end = size == VK_WHOLE_SIZE ? allocation.size : offset + size;
+	const VkDeviceSize alignedEnd = (end + m_nonCoherentAtomSize - 1) / m_nonCoherentAtomSize * m_nonCoherentAtomSize;
+
+	range = VkMappedMemoryRange{
+		.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+		.memory = memory,
+		.offset = begin,
+		.size = alignedEnd >= allocation.size ? VK_WHOLE_SIZE : alignedEnd - begin
+	};
+	return true;
+}
+
+void DeviceMemory::QueryBudget() {
+
+	ZoneScoped;
+
+	if (!m_device->IsExtensionEnabled(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME)) {
+
+		// Only our own allocations are known, against the whole heap.
+		for (uint32_t heapInd = 0; heapInd < m_heapBudgets.size(); heapInd++) {
+
+			HeapBudget& heap = m_heapBudgets[heapInd];
+			heap.usage = 0;
+			for (const VkDeviceSize categoryUsage : heap.categoryUsage) {
+				heap.usage += categoryUsage;
+			}
+			m_unqueriedUsage[heapInd] = 0;
+		}
+		return;
+	}
+
+	VkPhysicalDeviceMemoryBudgetPropertiesEXT memoryBudget = {
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT
+	};
+
+	VkPhysicalDeviceMemoryProperties2 memoryProperties2 = {
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2,
+		.pNext = &memoryBudget,
+	};
+
+	vkGetPhysicalDeviceMemoryProperties2(m_device->GetVkPhysicalDevice(), &memoryProperties2);
+
+	for (uint32_t heapInd = 0; heapInd < m_heapBudgets.size(); heapInd++) {
+		m_heapBudgets[heapInd].budget = memoryBudget.heapBudget[heapInd];
+		m_heapBudgets[heapInd].usage = memoryBudget.heapUsage[heapInd];
+		m_unqueriedUsage[heapInd] = 0;
+	}
+}
+
+void DeviceMemory::TrackAllocation(VkDeviceMemory memory, const Allocation& allocation) {
+
+	m_allocations.emplace(memory, allocation);
+	m_heapBudgets[allocation.heapIndex].categoryUsage[static_cast<uint32_t>(allocation.category)] += allocation.size;
+	m_unqueriedUsage[allocation.heapIndex] += static_cast<int64_t>(allocation.size);
+
+	AddToCounter(m_snapshot.memoryTypes[allocation.memoryTypeIndex], allocation.size);
+	AddToCounter(m_snapshot.memory, allocation.size);
+	m_frameCounts.memoryAllocationCount++;
+	m_snapshot.total.memoryAllocationCount++;
+}
+
+void DeviceMemory::TrackResource(VkDeviceMemory memory, VkDeviceSize offset, const Resource& resource) {
+
+	m_resources.emplace(std::make_pair(memory, offset), resource);
+
+	AddToCounter(m_snapshot.categories[static_cast<uint32_t>(resource.category)], resource.size);
+	AddToCounter(m_snapshot.resources, resource.size);
+	m_frameCounts.allocationCount++;
+	m_snapshot.total.allocationCount++;
+}
+
+void DeviceMemory::UntrackResource(VkDeviceMemory memory, VkDeviceSize offset) {
+
+	const auto it = m_resources.find({ memory, offset });
+	if (it == m_resources.end()) {
+		return;
+	}
+
+	const Resource& resource = it->second;
+	RemoveFromCounter(m_snapshot.categories[static_cast<uint32_t>(resource.category)], resource.size);
+	RemoveFromCounter(m_snapshot.resources, resource.size);
+	m_frameCounts.freeCount++;
+	m_snapshot.total.freeCount++;
+
+	m_resources.erase(it);
+}
+
+void DeviceMemory::LogLeaks() const {
+
+	if (m_resources.empty() && m_allocations.empty()) {
+		return;
+	}
+
+	spdlog::error("[DeviceMemory] Detected memory leak. {} resources in {} memory allocations were not freed", m_resources.size(), m_allocations.size());
+
+	struct LeakGroup
+	{
+		uint32_t count;
+		VkDeviceSize size;
+	};
+
+	// Leaks usually come in numbers from the same place, so they are listed once per category and call site.
+	std::map<std::string, LeakGroup> groups;
+	for (const auto& [key, resource] : m_resources) {
+
+		LeakGroup& group = groups[std::format("{} from {}:{}", DeviceMemory::GetCategoryName(resource.category),
+			GetFileName(resource.callSite), resource.callSite.line())];
+		group.count += 1;
+		group.size += resource.size;
+	}
+
+	for (const auto& [name, group] : groups) {
+		spdlog::error("[DeviceMemory] \t{}: {} resources, {}", name, group.count, ToBestRepresentation(group.size));
+	}
+}
+
 
 void DeviceMemory::LogHeapInfo() const {
 
@@ -149,5 +855,7 @@ void DeviceMemory::LogMemoryRequirements() const {
 	spdlog::info("[DeviceMemory] Min map memory alignment: {}", physicalDeviceProperties.limits.minMemoryMapAlignment);
 	spdlog::info("[DeviceMemory] Optimal buffer copy offset alignment: {}", physicalDeviceProperties.limits.optimalBufferCopyOffsetAlignment);
 	spdlog::info("[DeviceMemory] Optimal buffer copy row pitch alignment: {}", physicalDeviceProperties.limits.optimalBufferCopyRowPitchAlignment);
+	spdlog::info("[DeviceMemory] Max storage buffer range: {}", ToBestRepresentation(physicalDeviceProperties.limits.maxStorageBufferRange));
+	spdlog::info("[DeviceMemory] Max memory allocation size: {}", ToBestRepresentation(m_maxAllocationSize));
 	spdlog::info("");
 }
@@ -1,34 +1,385 @@
 #pragma once
 
 #include <volk.h>
-#include <unordered_set>
+#include <map>
+#include <array>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <unordered_map>
+#include <source_location>
+
+#include "memory/BlockAllocator.hpp"
 
 class Device;
 
+/**
+ * What an allocation is used for, so the usage of every heap can be broken down.
+ */
+enum class MemoryCategory : uint32_t
+{
+	Other,
+	Instance,
+	Vertex,
+	Index,
+	Uniform,
+	Staging,
+	Texture,
+
+	Count
+};
+
 class DeviceMemory
 {
 public:
 	DeviceMemory(const Device* device);
 	~DeviceMemory();
 
+	static constexpr uint32_t kCategoryCount = static_cast<uint32_t>(MemoryCategory::Count);
+
+	/**
+	 * The budget changes with other applications too, but querying it is not free.
+	 */
+	static constexpr double kBudgetQueryInterval = 0.5;
+
+	/**
+	 * What maxMemoryAllocationSize is guaranteed to be at least, used when the device does not report it.
+	 */
+	static constexpr VkDeviceSize kDefaultMaxAllocationSize = VkDeviceSize{ 1 } << 30;
+
+	/**
+	 * Allocations up to kMaxSubAllocationSize share blocks of kBlockSize with others of the same memory type, whatever
+	 * their category. Larger ones get memory of their own, they would not leave much room in a block anyway.
+	 */
+	static constexpr VkDeviceSize kBlockSize = 32 * 1024 * 1024;
+	static constexpr VkDeviceSize kMaxSubAllocationSize = kBlockSize / 4;
+
 	struct AllocationDesc
 	{
 		VkMemoryRequirements memoryRequirements;
 		VkMemoryPropertyFlags memoryPropertyFlags;
+		MemoryCategory category = MemoryCategory::Other;
+
+		/**
+		 * Used if a memory type has them, e.g. HOST_CACHED for reading back. Does not have to be a superset of
+		 * memoryPropertyFlags.
+		 */
+		VkMemoryPropertyFlags preferredPropertyFlags = 0;
+
+		/**
+		 * From VkMemoryDedicatedRequirements. SubAllocate gives such a resource memory of its own, allocated for it
+		 * alone if VK_KHR_dedicated_allocation is enabled.
+		 */
+		bool prefersDedicated = false;
+		bool requiresDedicated = false;
+
+		/**
+		 * The resource the memory is for, at most one of them. Needed for dedicated allocations, and images get
+		 * blocks of their own where bufferImageGranularity keeps them apart from buffers.
+		 */
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkImage image = VK_NULL_HANDLE;
+
+		/**
+		 * Where the resource was created, so a leak can be traced back to it. Wrappers like GenericBuffer pass on
+		 * the call site of their own constructor.
+		 */
+		std::source_location callSite = std::source_location::current();
+	};
+
+	/**
+	 * A range of a block, or memory of its own at offset 0.
+	 */
+	struct SubAllocation
+	{
+		VkDeviceMemory memory;
+		VkDeviceSize offset;
+		VkDeviceSize size;
+	};
+
+	struct BlockInfo
+	{
+		VkDeviceMemory memory;
+		uint32_t memoryTypeIndex;
+		bool images;
+		const BlockAllocator* allocator;
+	};
+
+	struct HeapBudget
+	{
+		VkMemoryHeapFlags flags;
+		VkDeviceSize size;
+
+		/**
+		 * From VK_EXT_memory_budget, so it includes other processes. Without the extension the budget is the heap
+		 * size and the usage is what this class allocated.
+		 */
+		VkDeviceSize budget;
+		VkDeviceSize usage;
+
+		/**
+		 * Allocated through this class. Blocks are shared between categories and count as Other, Snapshot::categories
+		 * has the resources in them.
+		 */
+		std::array<VkDeviceSize, kCategoryCount> categoryUsage;
+	};
+
+	struct Counter
+	{
+		VkDeviceSize liveSize;
+
+		/**
+		 * Most that was live at once since the start or ResetHighWaterMarks.
+		 */
+		VkDeviceSize highWaterMark;
+		uint32_t liveCount;
 	};
 
+	struct Counts
+	{
+		uint64_t allocationCount;
+		uint64_t freeCount;
+
+		/**
+		 * Calls to vkAllocateMemory and vkFreeMemory, which sub-allocations mostly avoid.
+		 */
+		uint64_t memoryAllocationCount;
+		uint64_t memoryFreeCount;
+	};
+
+	/**
+	 * Resources are what SubAllocate and ImportHostMemory hand out. Memory is what vkAllocateMemory returned, a block
+	 * counts as a whole no matter how much of it is used.
+	 */
+	struct Snapshot
+	{
+		std::array<Counter, kCategoryCount> categories;
+		Counter resources;
+
+		std::vector<Counter> memoryTypes;
+		Counter memory;
+
+		/**
+		 * Of the last frame, see EndFrame. The totals are up to date, so they also cover work outside of frames.
+		 */
+		Counts frame;
+		Counts total;
+	};
+
+	/**
+	 * Picks the first memory type with the properties whose heap still has room for the allocation, so a full heap
+	 * degrades to the next matching one. Throws before calling vkAllocateMemory if none has room, or if the size is
+	 * over GetMaxAllocationSize.
+	 */
 	[[nodiscard]] VkDeviceMemory AllocateMemory(const DeviceMemory::AllocationDesc& desc);
+
+	/**
+	 * Places the allocation into a block whose memory type has the properties, preferring
+	 * blocks with the preferred properties, and allocates a new block if none has room. Dedicated allocations,
+	 * allocations larger than kMaxSubAllocationSize, and those that no new block fits for get memory of their own.
+	 */
+	[[nodiscard]] DeviceMemory::SubAllocation SubAllocate(const DeviceMemory::AllocationDesc& desc);
+
+	/**
+	 * Takes exactly this range of a block, for moving an allocation there.
+	 * \return False if the range is not free.
+	 */
+	[[nodiscard]] bool SubAllocateAt(VkDeviceMemory block, VkDeviceSize offset, VkDeviceSize size);
+
+	/**
+	 * Frees the block too once nothing is left in it, unless it is the only empty block of its memory type. Keeping
+	 * one spares a resource that is created and destroyed every frame, like a staging buffer, a vkAllocateMemory each
+	 * time. Memory that is not a block is freed as a whole.
+	 */
+	void FreeSubAllocation(const DeviceMemory::SubAllocation& subAllocation);
+
+	/**
+	 * Frees the blocks FreeSubAllocation kept around. Called before the device is destroyed.
+	 */
+	void FreeEmptyBlocks();
+
+	/**
+	 * Carries the category and call site of a resource over to the range the Defragmenter moved it to, so the move
+	 * counts as neither an allocation nor a free. Called before the old range is freed.
+	 */
+	void MoveSubAllocation(const DeviceMemory::SubAllocation& from, const DeviceMemory::SubAllocation& to);
+
+	/**
+	 * Alignment of a sub-allocation in memory with these properties. Also keeps sub-allocations in non-coherent memory
+	 * from sharing a nonCoherentAtomSize atom, flushes and invalidates are rounded out to whole atoms.
+	 */
+	[[nodiscard]] VkDeviceSize GetSubAllocationAlignment(VkDeviceSize alignment, VkMemoryPropertyFlags propertyFlags) const;
+
+	[[nodiscard]] bool IsBlock(VkDeviceMemory memory) const;
+	[[nodiscard]] std::vector<DeviceMemory::BlockInfo> GetBlocks() const;
+
+	/**
+	 * Wraps memory the application already allocated, without copying it (VK_EXT_external_memory_host).
+	 * The pointer and the size must be multiples of GetMinImportedHostPointerAlignment, and the host memory must
+	 * stay allocated until the returned memory is freed.
+	 * \param typeFilter Memory type bits of the resource the memory is bound to.
+	 */
+	[[nodiscard]] VkDeviceMemory ImportHostMemory(void* hostPointer, VkDeviceSize size, uint32_t typeFilter, MemoryCategory category = MemoryCategory::Other,
+		const std::source_location& callSite = std::source_location::current());
+
+	/**
+	 * Maps the whole memory block the first time and returns the same pointer afterwards. The block stays mapped
+	 * until it is freed, so buffers never map or unmap per copy and only add their offset in the block.
+	 */
+	[[nodiscard]] void* MapMemory(VkDeviceMemory memory);
+
+	/**
+	 * Makes host writes to a range visible to the device. The range is rounded out to nonCoherentAtomSize.
+	 * Does nothing for host coherent memory, so callers don't have to check.
+	 */
+	void FlushMemory(VkDeviceMemory memory, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE) const;
+
+	/**
+	 * Makes device writes to a range visible to the host, the counterpart of FlushMemory.
+	 */
+	void InvalidateMemory(VkDeviceMemory memory, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE) const;
+
+	/**
+	 * Properties of the memory type the allocation actually came from, which can have more than was asked for.
+	 */
+	[[nodiscard]] VkMemoryPropertyFlags GetMemoryPropertyFlags(VkDeviceMemory memory) const;
+
 	void FreeMemory(VkDeviceMemory memory);
 
 	[[nodiscard]] bool IsBARSupported();
 
+	[[nodiscard]] bool IsHostImportSupported() const;
+
+	/**
+	 * Whether resources can be asked for VkMemoryDedicatedRequirements and get memory allocated for them alone
+	 * (VK_KHR_get_memory_requirements2 and VK_KHR_dedicated_allocation).
+	 */
+	[[nodiscard]] bool IsDedicatedAllocationSupported() const;
+	[[nodiscard]] VkDeviceSize GetMinImportedHostPointerAlignment() const;
+
+	/**
+	 * Largest single allocation, from VK_KHR_maintenance3. Many drivers fail larger ones even if the heap has room.
+	 */
+	[[nodiscard]] VkDeviceSize GetMaxAllocationSize() const;
+
+	/**
+	 * Queries the heap budgets again if kBudgetQueryInterval passed since the last query. Called once per frame.
+	 */
+	void UpdateBudget(double currentTime);
+
+	[[nodiscard]] const std::vector<HeapBudget>& GetHeapBudgets() const;
+
+	/**
+	 * Closes the allocation and free counts of the frame and plots the snapshot in Tracy. Called once per frame.
+	 */
+	void EndFrame();
+
+	[[nodiscard]] DeviceMemory::Snapshot GetSnapshot() const;
+
+	/**
+	 * Lowers the high-water marks to what is live now, so the peak of a single benchmark can be measured.
+	 */
+	void ResetHighWaterMarks();
+
+	/**
+	 * Bytes that still fit into the budget of the heap an allocation with these properties would come from.
+	 */
+	[[nodiscard]] VkDeviceSize GetAvailableBudget(VkMemoryPropertyFlags properties, uint32_t typeFilter = UINT32_MAX) const;
+
+	[[nodiscard]] static const char* GetCategoryName(MemoryCategory category);
+
 private:
+
+	struct Allocation
+	{
+		VkDeviceSize size;
+		uint32_t heapIndex;
+		uint32_t memoryTypeIndex;
+		MemoryCategory category;
+		VkMemoryPropertyFlags propertyFlags;
+
+		void* mappedMemory = nullptr;
+	};
+
+	/**
+	 * A resource that was handed out and not freed yet.
+	 */
+	struct Resource
+	{
+		VkDeviceSize size;
+		MemoryCategory category;
+		std::source_location callSite;
+	};
+
+	/**
+	 * Picks the place for SubAllocate, which then tracks the resource.
+	 */
+	[[nodiscard]] DeviceMemory::SubAllocation PlaceSubAllocation(const DeviceMemory::AllocationDesc& desc);
+
 	[[nodiscard]] uint32_t FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
 
+	[[nodiscard]] VkDeviceSize GetAvailableHeapBudget(uint32_t heapIndex) const;
+
+	/**
+	 * False if the memory is host coherent and needs no flush or invalidate.
+	 */
+	bool GetNonCoherentRange(VkDeviceMemory memory, VkDeviceSize offset, VkDeviceSize size, VkMappedMemoryRange& range) const;
+
+	void QueryBudget();
+	void TrackAllocation(VkDeviceMemory memory, const Allocation& allocation);
+	void TrackResource(VkDeviceMemory memory, VkDeviceSize offset, const Resource& resource);
+
+	/**
+	 * Does nothing for ranges that are not resources, e.g. the destination of a move that was given up on.
+	 */
+	void UntrackResource(VkDeviceMemory memory, VkDeviceSize offset);
+
+	void LogLeaks() const;
+
 	void LogHeapInfo() const;
 	void LogMemoryRequirements() const;
 
 	const Device* m_device;
+	VkPhysicalDeviceMemoryProperties m_memoryProperties;
+	VkDeviceSize m_nonCoherentAtomSize = 1;
+	VkDeviceSize m_maxAllocationSize = kDefaultMaxAllocationSize;
+	VkDeviceSize m_bufferImageGranularity = 1;
+	bool m_dedicatedAllocationSupported = false;
+
+	// 0 when host memory cannot be imported.
+	VkDeviceSize m_minImportedHostPointerAlignment = 0;
+
+	std::unordered_map<VkDeviceMemory, Allocation> m_allocations;
+
+	struct Block
+	{
+		BlockAllocator allocator;
+
+		/**
+		 * Only set when bufferImageGranularity is above 1. Buffers and images are kept apart by block then, instead
+		 * of padding every image out to whole granularity pages.
+		 */
+		bool images;
+	};
+
+	// Memory that is split into sub-allocations, the rest of its bookkeeping is in m_allocations.
+	std::unordered_map<VkDeviceMemory, Block> m_blocks;
+
+	std::vector<HeapBudget> m_heapBudgets;
+	double m_lastBudgetQueryTime = 0.0;
+
+	/**
+	 * Bytes allocated minus bytes freed per heap since the last query, which the queried usage does not include yet.
+	 */
+	std::vector<int64_t> m_unqueriedUsage;
+
+	// By memory and offset, so the resources of a memory are next to each other.
+	std::map<std::pair<VkDeviceMemory, VkDeviceSize>, Resource> m_resources;
+
+	DeviceMemory::Snapshot m_snapshot{};
+	DeviceMemory::Counts m_frameCounts{};
 
-	std::unordered_set<VkDeviceMemory> m_allocatedMemory;
+	// Tracy keeps the name pointers, so they have to outlive the plots.
+	std::vector<std::string> m_memoryTypePlotNames;
 };
\ No newline at end of file
@@ -1,7 +1,19 @@
 #pragma once
 
+#include "jobs/TaskGraph.hpp"
+
 class IComponentSystem
 {
 public:
+	virtual ~IComponentSystem() = default;
+
 	virtual void Update() = 0;
+
+	/**
+	 * Adds the update to the frame graph instead of running it right away.
+	 * By default the whole update is a single task.
+	 */
+	virtual void Schedule(TaskGraph& graph) {
+		graph.AddTask("Component system update", [this] { this->Update(); });
+	}
 };
\ No newline at end of file
@@ -4,6 +4,8 @@
 
 #include "IRenderPass.hpp"
 
+class TaskGraph;
+
 class IRenderer
 {
 public:
@@ -14,6 +16,8 @@ public:
 		VkCommandBuffer commandBuffer;
 		const IRenderPass* renderPass;
 		VkFramebuffer framebuffer;
+
+		TaskGraph* frameGraph;
 	};
 
 	virtual ~IRenderer() = default;
@@ -22,4 +26,12 @@ public:
 	virtual void Destroy() = 0;
 
 	virtual void Record(const IRenderer::RecordDesc& desc) = 0;
+
+	/**
+	 * Whether the recorded frame reads memory the component system writes, e.g. imported component columns.
+	 * The simulation then waits for the frame to finish before it writes again, see Context::SetWaitBeforeSimulation.
+	 */
+	[[nodiscard]] virtual bool ReadsComponentMemory() const {
+		return false;
+	}
 };
\ No newline at end of file
@@ -0,0 +1,207 @@
+#include "ResourcePool.hpp"
+
+#include "../pch.hpp"
+#include "Context.hpp"
+
+ResourcePool::ResourcePool(const Context* context) {
+    m_context = context;
+}
+
+void ResourcePool::Destroy() {
+    this->Trim(0);
+}
+
+std::unique_ptr<GenericBuffer> ResourcePool::AcquireBuffer(const ResourcePool::BufferKey& key) {
+
+    // The smallest match wastes the least, the newest one is the tie-breaker.
+    std::optional<size_t> bestInd;
+    for (size_t ind = 0; ind < m_retained.size(); ind++) {
+
+        const Retained& retained = m_retained[ind];
+        if (retained.buffer == nullptr || !ResourcePool::Matches(retained.key, key)) {
+            continue;
+        }
+        if (!bestInd.has_value() || retained.key.size <= m_retained[*bestInd].key.size) {
+            bestInd = ind;
+        }
+    }
+
+    if (!bestInd.has_value()) {
+        m_missCount++;
+        return nullptr;
+    }
+
+    std::unique_ptr<GenericBuffer> buffer = std::move(m_retained[*bestInd].buffer);
+    m_retainedSize -= m_retained[*bestInd].size;
+    m_retained.erase(m_retained.begin() + static_cast<std::ptrdiff_t>(*bestInd));
+
+    m_hitCount++;
+    return buffer;
+}
+
+std::unique_ptr<GenericBuffer> ResourcePool::AcquireBuffer(const GenericBuffer::Desc& desc) {
+
+    std::unique_ptr<GenericBuffer> buffer = this->AcquireBuffer(BufferKey{
+        .size = desc.bufferCreateInfo.size,
+        .usage = desc.bufferCreateInfo.usage,
+        .memoryProperty = desc.memoryProperty
+    });
+    if (buffer != nullptr) {
+        return buffer;
+    }
+
+    try {
+        return std::make_unique<GenericBuffer>(m_context, desc);
+    }
+    catch (const std::runtime_error& error) {
+
+        if (m_retained.empty()) {
+            throw;
+        }
+        spdlog::warn("[ResourcePool] {}, freeing {} retained resources and trying again", error.what(), m_retained.size());
+    }
+
+    this->Trim(0);
+    return std::make_unique<GenericBuffer>(m_context, desc);
+}
+
+void ResourcePool::ReleaseBuffer(const ResourcePool::BufferKey& key, std::unique_ptr<GenericBuffer> buffer) {
+
+    const VkDeviceSize size = buffer->GetAllocatedMemorySize();
+    const VkMemoryPropertyFlags memoryProperty = buffer->GetMemoryProperty();
+
+    this->Retain(Retained{
+        .key = key,
+        .buffer = std::move(buffer),
+        .size = size,
+        .memoryProperty = memoryProperty
+    });
+}
+
+void ResourcePool::ReleaseBuffer(std::unique_ptr<GenericBuffer> buffer) {
+
+    const BufferKey key = {
+        .size = buffer->GetBufferSize(),
+        .usage = buffer->GetUsage(),
+        .memoryProperty = buffer->GetMemoryProperty()
+    };
+    this->ReleaseBuffer(key, std::move(buffer));
+}
+
+std::unique_ptr<Sampler> ResourcePool::AcquireSampler(const std::string& path) {
+
+    for (size_t ind = m_retained.size(); ind > 0; ind--) {
+
+        Retained& retained = m_retained[ind - 1];
+        if (retained.sampler == nullptr || retained.sampler->GetPath() != path) {
+            continue;
+        }
+
+        std::unique_ptr<Sampler> sampler = std::move(retained.sampler);
+        m_retainedSize -= retained.size;
+        m_retained.erase(m_retained.begin() + static_cast<std::ptrdiff_t>(ind - 1));
+
+        m_hitCount++;
+        return sampler;
+    }
+
+    m_missCount++;
+    return std::make_unique<Sampler>(m_context, path);
+}
+
+void ResourcePool::ReleaseSampler(std::unique_ptr<Sampler> sampler) {
+
+    const VkDeviceSize size = sampler->GetAllocatedMemorySize();
+
+    this->Retain(Retained{
+        .key = {},
+        .sampler = std::move(sampler),
+        .size = size,
+        .memoryProperty = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+    });
+}
+
+void ResourcePool::Trim(VkDeviceSize maxRetainedSize) {
+
+    size_t freeCount = 0;
+    while (freeCount < m_retained.size() && m_retainedSize > maxRetainedSize) {
+        this->Free(m_retained[freeCount]);
+        freeCount++;
+    }
+    m_retained.erase(m_retained.begin(), m_retained.begin() + static_cast<std::ptrdiff_t>(freeCount));
+}
+
+void ResourcePool::TrimUnderPressure() {
+
+    const DeviceMemory* deviceMemory = m_context->GetDevice()->GetDeviceMemory();
+
+    const auto lowOnBudget = [deviceMemory](const Retained& retained)
+    {
+        return deviceMemory->GetAvailableBudget(retained.memoryProperty) < kMinAvailableBudget;
+    };
+
+    size_t freeCount = 0;
+    for (Retained& retained : m_retained) {
+        if (lowOnBudget(retained)) {
+            this->Free(retained);
+            freeCount++;
+        }
+    }
+
+    if (freeCount > 0) {
+        std::erase_if(m_retained, [](const Retained& retained) { return retained.buffer == nullptr && retained.sampler == nullptr; });
+        spdlog::info("[ResourcePool] Low on memory budget, freed {} retained resources", freeCount);
+    }
+}
+
+VkDeviceSize ResourcePool::GetRetainedSize() const {
+    return m_retainedSize;
+}
+
+uint32_t ResourcePool::GetRetainedCount() const {
+    return static_cast<uint32_t>(m_retained.size());
+}
+
+uint32_t ResourcePool::GetHitCount() const {
+    return m_hitCount;
+}
+
+uint32_t ResourcePool::GetMissCount() const {
+    return m_missCount;
+}
+
+bool ResourcePool::Matches(const BufferKey& retained, const BufferKey& requested) {
+
+    if (retained.usage != requested.usage || retained.content != requested.content
+        || (retained.memoryProperty & requested.memoryProperty) != requested.memoryProperty) {
+        return false;
+    }
+
+    if (!requested.content.empty()) {
+        return retained.size == requested.size;
+    }
+
+    const auto maxSize = static_cast<VkDeviceSize>(static_cast<double>(requested.size) * (1.0 + kMaxSizeSlack));
+    return retained.size >= requested.size && retained.size <= maxSize;
+}
+
+void ResourcePool::Retain(Retained&& retained) {
+
+    m_retainedSize += retained.size;
+    m_retained.push_back(std::move(retained));
+
+    this->Trim(kMaxRetainedSize);
+}
+
+void ResourcePool::Free(Retained& retained) {
+
+    if (retained.buffer != nullptr) {
+        retained.buffer->Destroy();
+        retained.buffer = nullptr;
+    }
+    if (retained.sampler != nullptr) {
+        retained.sampler->Destroy();
+        retained.sampler = nullptr;
+    }
+    m_retainedSize -= retained.size;
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <volk.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "buffers/GenericBuffer.hpp"
+#include "textures/Sampler.hpp"
+
+class Context;
+
+/**
+ * Keeps released buffers and samplers alive, so a renderer that is created again gets them back without allocating,
+ * uploading or decoding anything. Retained resources still count against the memory budget, so they are trimmed
+ * oldest first when the pool grows past kMaxRetainedSize or a heap runs low.
+ */
+class ResourcePool
+{
+public:
+
+	struct BufferKey
+	{
+		VkDeviceSize size;
+		VkBufferUsageFlags usage;
+		VkMemoryPropertyFlags memoryProperty;
+
+		/**
+		 * Names what the buffer holds if it is only written once, e.g. a mesh, and must match exactly.
+		 * Empty if the contents are rewritten anyway, in which case a slightly larger buffer matches too.
+		 */
+		std::string content;
+	};
+
+	static constexpr VkDeviceSize kMaxRetainedSize = 256 * 1024 * 1024;
+
+	/**
+	 * Retained resources in a heap with less budget than this left are freed.
+	 */
+	static constexpr VkDeviceSize kMinAvailableBudget = 128 * 1024 * 1024;
+
+	/**
+	 * How much larger than asked for a buffer without content may be, so instance buffers sized from a budget that
+	 * moved a little are still reused.
+	 */
+	static constexpr double kMaxSizeSlack = 0.25;
+
+	explicit ResourcePool(const Context* context);
+	void Destroy();
+
+	/**
+	 * \return A retained buffer that matches, or nullptr.
+	 */
+	[[nodiscard]] std::unique_ptr<GenericBuffer> AcquireBuffer(const ResourcePool::BufferKey& key);
+
+	/**
+	 * Reuses a retained buffer or creates a new one. If creating fails the pool is emptied and it is tried once more.
+	 */
+	[[nodiscard]] std::unique_ptr<GenericBuffer> AcquireBuffer(const GenericBuffer::Desc& desc);
+
+	void ReleaseBuffer(const ResourcePool::BufferKey& key, std::unique_ptr<GenericBuffer> buffer);
+
+	/**
+	 * For buffers without content, the key is taken from the buffer.
+	 */
+	void ReleaseBuffer(std::unique_ptr<GenericBuffer> buffer);
+
+	/**
+	 * Reuses a retained sampler of the same image or loads it.
+	 */
+	[[nodiscard]] std::unique_ptr<Sampler> AcquireSampler(const std::string& path);
+	void ReleaseSampler(std::unique_ptr<Sampler> sampler);
+
+	/**
+	 * Frees the oldest resources until at most maxRetainedSize bytes are retained.
+	 */
+	void Trim(VkDeviceSize maxRetainedSize);
+
+	/**
+	 * Frees the retained resources of heaps that are low on budget. Called once per frame.
+	 */
+	void TrimUnderPressure();
+
+	[[nodiscard]] VkDeviceSize GetRetainedSize() const;
+	[[nodiscard]] uint32_t GetRetainedCount() const;
+	[[nodiscard]] uint32_t GetHitCount() const;
+	[[nodiscard]] uint32_t GetMissCount() const;
+
+private:
+
+	/**
+	 * Either a buffer or a sampler.
+	 */
+	struct Retained
+	{
+		BufferKey key;
+		std::unique_ptr<GenericBuffer> buffer;
+		std::unique_ptr<Sampler> sampler;
+
+		VkDeviceSize size;
+		VkMemoryPropertyFlags memoryProperty;
+	};
+
+	[[nodiscard]] static bool Matches(const BufferKey& retained, const BufferKey& requested);
+
+	void Retain(Retained&& retained);
+	void Free(Retained& retained);
+
+	const Context* m_context;
+
+	// Oldest first.
+	std::vector<Retained> m_retained;
+	VkDeviceSize m_retainedSize = 0;
+
+	uint32_t m_hitCount = 0;
+	uint32_t m_missCount = 0;
+};
\ No newline at end of file
@@ -7,11 +7,12 @@
 #include "Shader.hpp"
 #include "Device.hpp"
 
-ShaderLayout::ShaderLayout(const Device* device, const Shader* vertexShader, const Shader* fragmentShader) {
+ShaderLayout::ShaderLayout(const Device* device, const Shader* vertexShader, const Shader* fragmentShader, const std::vector<std::string>& dynamicBuffers) {
 
     m_device = device;
 	m_fragmentShader = fragmentShader;
 	m_vertexShader = vertexShader;
+    m_dynamicBufferNames = dynamicBuffers;
 
     std::vector<VkDescriptorPoolSize> poolSizes{};
     this->ParseShader(m_vertexShader, poolSizes);
@@ -21,6 +22,10 @@ ShaderLayout::ShaderLayout(const Device* device, const Shader* vertexShader, con
 	this->CreateDescriptorSetLayout();
     this->AllocateDescriptorSets();
 
+    if (m_dynamicDescriptors.size() != m_dynamicBufferNames.size()) {
+        throw std::runtime_error("[ShaderLayout] Not every dynamic buffer was found among the uniform buffers");
+    }
+
 	const VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {
 		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
 		.setLayoutCount = static_cast<uint32_t>(m_descriptorSetLayouts.size()),
@@ -38,6 +43,7 @@ ShaderLayout::ShaderLayout(const Device* device, const Shader* vertexShader, con
 
 void ShaderLayout::Destroy() {
 
+    m_bufferAttachments.clear();
     this->DestroyDescriptorPool();
     this->DestroyDescriptorSetLayout();
     vkDestroyPipelineLayout(m_device->GetVkDevice(), m_pipelineLayout, nullptr);
@@ -45,19 +51,44 @@ void ShaderLayout::Destroy() {
 }
 
 void ShaderLayout::AttachBuffer(const DescriptorID& id, const GenericBuffer* buffer, VkDeviceSize offset, VkDeviceSize range) {
-    VkDescriptorBufferInfo bufferInfo = {
-        .buffer = buffer->GetVkBuffer(),
+
+    const BufferAttachment attachment = {
+        .id = id,
+        .buffer = buffer,
         .offset = offset,
-        .range = range
+        .range = range,
+        .relocationCount = buffer->GetRelocationCount()
+    };
+    this->WriteBufferDescriptor(attachment);
+
+    // Attaching to the same descriptor again replaces what was there.
+    const auto it = std::ranges::find_if(m_bufferAttachments, [&id](const BufferAttachment& other)
+    {
+        return other.id.set == id.set && other.id.binding == id.binding && other.id.index == id.index;
+    });
+    if (it != m_bufferAttachments.end()) {
+        *it = attachment;
+    }
+    else {
+        m_bufferAttachments.push_back(attachment);
+    }
+}
+
+void ShaderLayout::WriteBufferDescriptor(const BufferAttachment& attachment) const {
+
+    VkDescriptorBufferInfo bufferInfo = {
+        .buffer = attachment.buffer->GetVkBuffer(),
+        .offset = attachment.offset,
+        .range = attachment.range
     };
 
     const VkWriteDescriptorSet write = {
         .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-        .dstSet = m_descriptorSets[id.set],
-        .dstBinding = id.binding,
-        .dstArrayElement = id.index,
+        .dstSet = m_descriptorSets[attachment.id.set],
+        .dstBinding = attachment.id.binding,
+        .dstArrayElement = attachment.id.index,
         .descriptorCount = 1,           // TODO: Support array bindings.
-        .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+        .descriptorType = m_descriptorSetsInfo[attachment.id.set]->at(attachment.id.binding)->type,
         .pBufferInfo = &bufferInfo
     };
 
@@ -93,15 +124,41 @@ void ShaderLayout::AttackSampler(const std::string& name, const Sampler* sampler
     this->AttackSampler(this->GetDescriptorID(name), sampler);
 }
 
+void ShaderLayout::SetDynamicOffset(const DescriptorID& id, uint32_t offset) {
+
+    const auto it = std::ranges::find_if(m_dynamicDescriptors, [&id](const DescriptorID& other)
+    {
+        return other.set == id.set && other.binding == id.binding;
+    });
+    if (it == m_dynamicDescriptors.end()) {
+        throw std::runtime_error(std::format("[ShaderLayout] Descriptor at set {} binding {} is not dynamic", id.set, id.binding));
+    }
+
+    m_dynamicOffsets[it - m_dynamicDescriptors.begin()] = offset;
+}
+
+void ShaderLayout::SetDynamicOffset(const std::string& name, uint32_t offset) {
+    this->SetDynamicOffset(this->GetDescriptorID(name), offset);
+}
+
 VkPipelineLayout ShaderLayout::GetVkPipelineLayout() const {
     return m_pipelineLayout;
 }
 
 void ShaderLayout::BindDescriptors(VkCommandBuffer buffer) const {
 
+    for (BufferAttachment& attachment : m_bufferAttachments) {
+
+        const uint32_t relocationCount = attachment.buffer->GetRelocationCount();
+        if (attachment.relocationCount != relocationCount) {
+            attachment.relocationCount = relocationCount;
+            this->WriteBufferDescriptor(attachment);
+        }
+    }
+
     vkCmdBindDescriptorSets(buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 
         0, static_cast<uint32_t>(m_descriptorSets.size()), m_descriptorSets.data(),
-        0, nullptr);
+        static_cast<uint32_t>(m_dynamicOffsets.size()), m_dynamicOffsets.data());
 }
 
 ShaderLayout::DescriptorID ShaderLayout::GetDescriptorID(const std::string& name) {
@@ -166,7 +223,7 @@ void ShaderLayout::ParseResourceType(VkDescriptorType type, const Shader* shader
     const auto& resources = ShaderLayout::GetResourceFromType(shaderResources, type);
 
     // We do not need to allocate more descriptors when the same resource appears in another shader.
-    uint32_t descriptorCount = 0;
+    std::unordered_map<VkDescriptorType, uint32_t> descriptorCounts{};
 
     for (const spirv_cross::Resource& resource : resources) {
 
@@ -188,28 +245,30 @@ void ShaderLayout::ParseResourceType(VkDescriptorType type, const Shader* shader
         }
 
         if (!setInfo[binding].has_value()) {
+
+            const bool dynamic = type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER && std::ranges::find(m_dynamicBufferNames, resource.name) != m_dynamicBufferNames.end();
+            const VkDescriptorType bindingType = dynamic ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC : type;
+
             setInfo[binding] = BindingInfo{
                 .bindingIndex = binding,
                 .setIndex = set,
                 .name = resource.name,
                 .visibility = shader->GetVkType(),
-                .type = type
+                .type = bindingType
             };
-            descriptorCount += 1;
+            descriptorCounts[bindingType] += 1;
         }
         else {
             setInfo[binding]->visibility |= shader->GetVkType();
         }
     }
 
-    if (descriptorCount == 0) {
-        return;
+    for (const auto& [descriptorType, descriptorCount] : descriptorCounts) {
+        poolSizes.push_back(VkDescriptorPoolSize{
+            .type = descriptorType,
+            .descriptorCount = descriptorCount
+        });
     }
-
-    poolSizes.push_back(VkDescriptorPoolSize{
-		.type = type,
-		.descriptorCount = descriptorCount
-    });
 }
 
 
@@ -327,6 +386,11 @@ void ShaderLayout::AllocateDescriptorSets() {
                 .binding = bindingInfo->bindingIndex,
                 .index = 0
             };
+
+            if (bindingInfo->type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC) {
+                m_dynamicDescriptors.push_back(m_descriptorIdMap[bindingInfo->name]);
+                m_dynamicOffsets.push_back(0);
+            }
         }
     }
 }
@@ -28,7 +28,10 @@ public:
 		uint32_t index;
 	};
 
-	ShaderLayout(const Device* device, const Shader* vertexShader, const Shader* fragmentShader);
+	/**
+	 * \param dynamicBuffers Names of the uniform buffers to bind with dynamic offsets, see SetDynamicOffset.
+	 */
+	ShaderLayout(const Device* device, const Shader* vertexShader, const Shader* fragmentShader, const std::vector<std::string>& dynamicBuffers = {});
 	void Destroy();
 
 	void AttachBuffer(const DescriptorID& id, const GenericBuffer* buffer, VkDeviceSize offset, VkDeviceSize range);
@@ -37,6 +40,17 @@ public:
 	void AttachBuffer(const std::string& name, const GenericBuffer* buffer, VkDeviceSize offset, VkDeviceSize range);
 	void AttackSampler(const std::string& name, const Sampler* sampler);
 
+	/**
+	 * Added to the offset the buffer was attached with on the next BindDescriptors, so a slice of a FrameArena can
+	 * be bound without writing the descriptor again. Has to be a multiple of minUniformBufferOffsetAlignment.
+	 */
+	void SetDynamicOffset(const DescriptorID& id, uint32_t offset);
+	void SetDynamicOffset(const std::string& name, uint32_t offset);
+
+	/**
+	 * Also writes the descriptors of attached buffers again if the Defragmenter moved them. Only safe while the
+	 * descriptor sets are not in use, which holds with one frame in flight.
+	 */
 	void BindDescriptors(VkCommandBuffer buffer) const;
 
 	[[nodiscard]] DescriptorID GetDescriptorID(const std::string& name);
@@ -57,10 +71,29 @@ private:
 
 	void AllocateDescriptorSets();
 
+	struct BufferAttachment
+	{
+		DescriptorID id;
+		const GenericBuffer* buffer;
+		VkDeviceSize offset;
+		VkDeviceSize range;
+
+		// Of the buffer when the descriptor was written.
+		uint32_t relocationCount;
+	};
+
+	void WriteBufferDescriptor(const BufferAttachment& attachment) const;
+
 	const Device* m_device;
 	const Shader* m_fragmentShader;
 	const Shader* m_vertexShader;
 
+	std::vector<std::string> m_dynamicBufferNames;
+
+	// In the order vkCmdBindDescriptorSets expects them, by set and then by binding.
+	std::vector<DescriptorID> m_dynamicDescriptors;
+	std::vector<uint32_t> m_dynamicOffsets;
+
 
 	struct BindingInfo
 	{
@@ -75,6 +108,8 @@ private:
 
 	std::unordered_map<std::string, DescriptorID> m_descriptorIdMap;
 
+	mutable std::vector<BufferAttachment> m_bufferAttachments;
+
 	VkDescriptorPool m_descriptorPool;
 
 	std::vector<VkDescriptorSetLayout> m_descriptorSetLayouts;
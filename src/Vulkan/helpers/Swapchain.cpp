@@ -41,6 +41,10 @@ VkImageView Swapchain::GetImage(int index) const {
     return m_swapChainImageViews[index];
 }
 
+VkImage Swapchain::GetVkImage(uint32_t index) const {
+    return m_swapChainImages[index];
+}
+
 uint32_t Swapchain::GetImageCount() const {
     return m_swapChainImageViews.size();
 }
@@ -53,6 +57,10 @@ VkFormat Swapchain::GetFormat() const {
     return m_swapChainImageFormat;
 }
 
+VkImageUsageFlags Swapchain::GetImageUsage() const {
+    return m_imageUsage;
+}
+
 void Swapchain::Initialize() {
     const Device::SurfaceCapabilities capabilities = m_device->QuerySurfaceCapabilities(m_surface);
 
@@ -72,6 +80,11 @@ void Swapchain::Initialize() {
         m_context->SetSwapchainImageCount(capabilities.surfaceCapabilities.maxImageCount);
     }
 
+    m_imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    if (capabilities.surfaceCapabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) {
+        m_imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    }
+
     VkSwapchainCreateInfoKHR createInfo = {
         .sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
         .surface = m_surface->GetVkSurface(),
@@ -80,7 +93,7 @@ void Swapchain::Initialize() {
         .imageColorSpace = surfaceFormat.colorSpace,
         .imageExtent = extent,
         .imageArrayLayers = 1,
-        .imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+        .imageUsage = m_imageUsage,
         .preTransform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR,
         .compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
         .presentMode = presentMode,
@@ -22,11 +22,17 @@ public:
 
     [[nodiscard]] VkSwapchainKHR GetVkSwapchain() const;
     [[nodiscard]] VkImageView GetImage(int index) const;
+    [[nodiscard]] VkImage GetVkImage(uint32_t index) const;
     [[nodiscard]] uint32_t GetImageCount() const;
 
     [[nodiscard]] VkExtent2D GetExtent() const;
     [[nodiscard]] VkFormat GetFormat() const;
 
+    /**
+     * Includes VK_IMAGE_USAGE_TRANSFER_SRC_BIT if the surface supports it, which frame captures need.
+     */
+    [[nodiscard]] VkImageUsageFlags GetImageUsage() const;
+
 private:
 
     void Initialize();
@@ -46,4 +52,5 @@ private:
 
     VkFormat m_swapChainImageFormat{};
     VkExtent2D m_swapChainExtent{};
+    VkImageUsageFlags m_imageUsage{};
 };
@@ -0,0 +1,92 @@
+#include "FrameArena.hpp"
+
+#include "../../pch.hpp"
+#include "../Context.hpp"
+
+FrameArena::FrameArena(const Context* context, const FrameArena::Desc& desc) {
+
+    if (desc.frameSize == 0 || desc.frameCount == 0) {
+        throw std::runtime_error("[FrameArena] The arena has to hold at least one byte for one frame");
+    }
+
+    m_context = context;
+    m_desc = desc;
+
+    m_alignment = std::max<VkDeviceSize>(m_context->GetDevice()->GetVkPhysicalDeviceProperties().limits.minUniformBufferOffsetAlignment, 1);
+    m_desc.frameSize = (desc.frameSize + m_alignment - 1) / m_alignment * m_alignment;
+
+    // Written every frame and read once by the device, so host visible device memory is the best place if there is some.
+    m_buffer = std::make_unique<GenericBuffer>(m_context, GenericBuffer::Desc{
+        .bufferCreateInfo = VkBufferCreateInfo {
+            .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+            .size = m_desc.frameSize * m_desc.frameCount,
+            .usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+            .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        },
+        .memoryProperty = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+        .category = MemoryCategory::Uniform,
+        .preferredMemoryProperty = VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+    });
+}
+
+void FrameArena::Destroy() {
+
+    m_buffer->Destroy();
+    m_buffer = nullptr;
+}
+
+void FrameArena::Reset() {
+
+    m_region = (m_region + 1) % m_desc.frameCount;
+    m_usedSize = 0;
+}
+
+FrameArena::Slice FrameArena::Allocate(VkDeviceSize size) {
+
+    const VkDeviceSize alignedSize = (size + m_alignment - 1) / m_alignment * m_alignment;
+    if (m_usedSize + alignedSize > m_desc.frameSize) {
+        throw std::runtime_error(std::format("[FrameArena] Allocating {} bytes, but only {} of {} are left this frame", size,
+            m_desc.frameSize - m_usedSize, m_desc.frameSize));
+    }
+
+    const VkDeviceSize offset = this->GetRegionOffset() + m_usedSize;
+    m_usedSize += alignedSize;
+    m_highWaterMark = std::max(m_highWaterMark, m_usedSize);
+
+    return Slice{
+        .data = static_cast<std::byte*>(m_buffer->GetMappedMemory()) + offset,
+        .offset = offset,
+        .size = size
+    };
+}
+
+void FrameArena::Flush() const {
+
+    if (m_usedSize > 0) {
+        m_buffer->Flush(this->GetRegionOffset(), m_usedSize);
+    }
+}
+
+const GenericBuffer* FrameArena::GetBuffer() const {
+    return m_buffer.get();
+}
+
+VkDeviceSize FrameArena::GetAlignment() const {
+    return m_alignment;
+}
+
+VkDeviceSize FrameArena::GetFrameSize() const {
+    return m_desc.frameSize;
+}
+
+VkDeviceSize FrameArena::GetUsedSize() const {
+    return m_usedSize;
+}
+
+VkDeviceSize FrameArena::GetHighWaterMark() const {
+    return m_highWaterMark;
+}
+
+VkDeviceSize FrameArena::GetRegionOffset() const {
+    return static_cast<VkDeviceSize>(m_region) * m_desc.frameSize;
+}
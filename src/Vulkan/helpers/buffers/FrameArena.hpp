@@ -0,0 +1,100 @@
+#pragma once
+
+#include <volk.h>
+#include <memory>
+#include <cstdint>
+#include <cstring>
+
+#include "GenericBuffer.hpp"
+
+class Context;
+
+/**
+ * Bump allocator for data that only lives for one frame, e.g. uniforms and small uploads. Slices come from one
+ * persistently mapped buffer with a region per frame in flight, aligned to minUniformBufferOffsetAlignment so they
+ * can be bound with dynamic descriptor offsets instead of a buffer each.
+ *
+ * Nothing is freed on its own. Reset moves on to the next region once the frame that used it is done.
+ */
+class FrameArena
+{
+public:
+
+	struct Desc
+	{
+		/**
+		 * Bytes every frame can allocate, rounded up to the alignment.
+		 */
+		VkDeviceSize frameSize;
+
+		/**
+		 * Frames that can be in flight at once, each gets a region of its own.
+		 */
+		uint32_t frameCount;
+	};
+
+	struct Slice
+	{
+		void* data;
+
+		/**
+		 * From the start of the buffer, which is what dynamic offsets are relative to.
+		 */
+		VkDeviceSize offset;
+		VkDeviceSize size;
+	};
+
+	FrameArena(const Context* context, const FrameArena::Desc& desc);
+	void Destroy();
+
+	/**
+	 * Moves on to the next region and forgets what was allocated in it. Only call once the fence of the frame that
+	 * last used that region is signaled.
+	 */
+	void Reset();
+
+	/**
+	 * Throws if the frame ran out of space, slices of the current frame stay where they are.
+	 */
+	[[nodiscard]] FrameArena::Slice Allocate(VkDeviceSize size);
+
+	template<typename T>
+	[[nodiscard]] FrameArena::Slice Push(const T& value);
+
+	/**
+	 * Makes the writes of the current frame visible to the device. Called before the frame is submitted.
+	 */
+	void Flush() const;
+
+	[[nodiscard]] const GenericBuffer* GetBuffer() const;
+	[[nodiscard]] VkDeviceSize GetAlignment() const;
+	[[nodiscard]] VkDeviceSize GetFrameSize() const;
+	[[nodiscard]] VkDeviceSize GetUsedSize() const;
+
+	/**
+	 * Most bytes a single frame allocated so far.
+	 */
+	[[nodiscard]] VkDeviceSize GetHighWaterMark() const;
+
+private:
+
+	[[nodiscard]] VkDeviceSize GetRegionOffset() const;
+
+	const Context* m_context;
+	FrameArena::Desc m_desc;
+	VkDeviceSize m_alignment;
+
+	std::unique_ptr<GenericBuffer> m_buffer;
+
+	uint32_t m_region = 0;
+	VkDeviceSize m_usedSize = 0;
+	VkDeviceSize m_highWaterMark = 0;
+};
+
+template<typename T>
+FrameArena::Slice FrameArena::Push(const T& value) {
+
+	const Slice slice = this->Allocate(sizeof(T));
+	std::memcpy(slice.data, &value, sizeof(T));
+	return slice;
+}
\ No newline at end of file
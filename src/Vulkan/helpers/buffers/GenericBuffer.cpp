@@ -8,13 +8,20 @@ GenericBuffer::GenericBuffer(const Context* context, const GenericBuffer::Desc&
 
     m_context = context;
 
-    this->CreateBuffer(desc.bufferCreateInfo);
-    this->AllocateBuffer(desc.memoryProperty);
+    this->CreateBuffer(desc.bufferCreateInfo, desc.relocatable);
+    this->AllocateBuffer(desc.memoryProperty, desc.category, desc.preferredMemoryProperty, desc.callSite);
 }
 
 void GenericBuffer::Destroy() {
 
-    m_context->GetDevice()->GetDeviceMemory()->FreeMemory(m_bufferMemory);
+    // Finishes a move that is still in flight first, so what is freed below is where the buffer is now.
+    Defragmenter* defragmenter = m_context->GetDefragmenter();
+    if (m_registeredForDefragmentation && defragmenter != nullptr) {
+        defragmenter->Unregister(this);
+    }
+    m_registeredForDefragmentation = false;
+
+    m_context->GetDevice()->GetDeviceMemory()->FreeSubAllocation(this->GetSubAllocation());
     vkDestroyBuffer(m_context->GetDevice()->GetVkDevice(), m_buffer, nullptr);
 
     m_bufferMemory = VK_NULL_HANDLE;
@@ -22,27 +29,35 @@ void GenericBuffer::Destroy() {
 
     m_allocatedMemorySize = 0;
     m_bufferSize = 0;
+    m_memoryOffset = 0;
+    m_memoryProperty = 0;
+    m_mappedMemory = nullptr;
+    m_relocationCreateInfo.reset();
 }
 
-void* GenericBuffer::MapMemory(const VkDeviceSize memorySize) {
+void GenericBuffer::CopyData(const void* data, const VkDeviceSize dataSize) {
 
-    if (m_mappedMemory != nullptr) {
-        throw std::runtime_error("[GenericBuffer] Memory is already mapped");
+    if (dataSize > m_bufferSize) {
+        throw std::runtime_error(std::format("[GenericBuffer] Trying to copy {} bytes into a buffer of {} bytes", dataSize, m_bufferSize));
     }
-    vkMapMemory(m_context->GetDevice()->GetVkDevice(), m_bufferMemory, 0, memorySize, 0, &m_mappedMemory);
-    return m_mappedMemory;
+    std::memcpy(this->GetMappedMemory(), data, dataSize);
+    this->Flush(0, dataSize);
 }
 
-void GenericBuffer::UnmapMemory() {
-    vkUnmapMemory(m_context->GetDevice()->GetVkDevice(), m_bufferMemory);
-    m_mappedMemory = nullptr;
+void GenericBuffer::Flush(VkDeviceSize offset, VkDeviceSize size) const {
+
+    if (size == VK_WHOLE_SIZE) {
+        size = m_allocatedMemorySize - offset;
+    }
+    m_context->GetDevice()->GetDeviceMemory()->FlushMemory(m_bufferMemory, m_memoryOffset + offset, size);
 }
 
-void GenericBuffer::CopyData(const void* data, const VkDeviceSize dataSize) {
+void GenericBuffer::Invalidate(VkDeviceSize offset, VkDeviceSize size) const {
 
-    void* mappedPointer = this->MapMemory(dataSize);
-    std::memcpy(mappedPointer, data, dataSize);
-    this->UnmapMemory();
+    if (size == VK_WHOLE_SIZE) {
+        size = m_allocatedMemorySize - offset;
+    }
+    m_context->GetDevice()->GetDeviceMemory()->InvalidateMemory(m_bufferMemory, m_memoryOffset + offset, size);
 }
 
 void GenericBuffer::CopyFromBuffer(const VkCommandBuffer commandBuffer, const GenericBuffer* srcBuffer, const VkBufferCopy& bufferCopyInfo) const {
@@ -56,7 +71,7 @@ void GenericBuffer::CopyFromBuffer(const VkCommandBuffer commandBuffer, const Ge
 
 void* GenericBuffer::GetMappedMemory() const {
     if (m_mappedMemory == nullptr) {
-        throw std::runtime_error("[GenericBuffer] Memory is not mapped");
+        throw std::runtime_error("[GenericBuffer] Memory is not host visible");
     }
 
     return m_mappedMemory;
@@ -74,10 +89,26 @@ VkBuffer GenericBuffer::GetVkBuffer() const {
     return m_buffer;
 }
 
+VkBufferUsageFlags GenericBuffer::GetUsage() const {
+    return m_bufferUsage;
+}
+
 VkDeviceMemory GenericBuffer::GetVkDeviceMemory() const {
     return m_bufferMemory;
 }
 
+VkDeviceSize GenericBuffer::GetMemoryOffset() const {
+    return m_memoryOffset;
+}
+
+VkMemoryPropertyFlags GenericBuffer::GetMemoryProperty() const {
+    return m_memoryProperty;
+}
+
+uint32_t GenericBuffer::GetRelocationCount() const {
+    return m_relocationCount;
+}
+
 GenericBuffer::GenericBuffer(const Context* context) {
 
 	m_context = context;
@@ -86,36 +117,114 @@ GenericBuffer::GenericBuffer(const Context* context) {
     m_bufferMemory = VK_NULL_HANDLE;
 }
 
-void GenericBuffer::CreateBuffer(const VkBufferCreateInfo& bufferCreateInfo) {
+void GenericBuffer::CreateBuffer(const VkBufferCreateInfo& bufferCreateInfo, bool relocatable) {
 
     if (bufferCreateInfo.size == 0) {
         throw std::runtime_error("[GenericBuffer] Trying to create a buffer with size of 0");
     }
 
-	const VkResult result = vkCreateBuffer(m_context->GetDevice()->GetVkDevice(), &bufferCreateInfo, nullptr, &m_buffer);
+    // Buffers shared between queue families or with extension structs are left where they are.
+    VkBufferCreateInfo createInfo = bufferCreateInfo;
+    if (relocatable && createInfo.sharingMode == VK_SHARING_MODE_EXCLUSIVE && createInfo.pNext == nullptr) {
+        createInfo.usage |= VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        m_relocationCreateInfo = createInfo;
+    }
+
+	const VkResult result = vkCreateBuffer(m_context->GetDevice()->GetVkDevice(), &createInfo, nullptr, &m_buffer);
     if (result != VK_SUCCESS) {
         throw std::runtime_error("[GenericBuffer] Could not create buffer");
     }
 
+    // The usage asked for, the resource pool matches buffers by it.
     m_bufferSize = bufferCreateInfo.size;
     m_bufferUsage = bufferCreateInfo.usage;
 }
 
-void GenericBuffer::AllocateBuffer(VkMemoryPropertyFlags memoryPropertyFlags) {
+void GenericBuffer::AllocateBuffer(VkMemoryPropertyFlags memoryPropertyFlags, MemoryCategory category, VkMemoryPropertyFlags preferredMemoryPropertyFlags,
+    const std::source_location& callSite) {
+
+    DeviceMemory* deviceMemory = m_context->GetDevice()->GetDeviceMemory();
+    const VkDevice device = m_context->GetDevice()->GetVkDevice();
+
+    VkMemoryDedicatedRequirementsKHR dedicatedRequirements = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS_KHR
+    };
 
     VkMemoryRequirements memoryRequirements;
-    vkGetBufferMemoryRequirements(m_context->GetDevice()->GetVkDevice(), m_buffer, &memoryRequirements);
+    if (deviceMemory->IsDedicatedAllocationSupported()) {
+
+        const VkBufferMemoryRequirementsInfo2KHR requirementsInfo = {
+            .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_REQUIREMENTS_INFO_2_KHR,
+            .buffer = m_buffer
+        };
+
+        VkMemoryRequirements2KHR memoryRequirements2 = {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2_KHR,
+            .pNext = &dedicatedRequirements
+        };
+
+        vkGetBufferMemoryRequirements2KHR(device, &requirementsInfo, &memoryRequirements2);
+        memoryRequirements = memoryRequirements2.memoryRequirements;
+    }
+    else {
+        vkGetBufferMemoryRequirements(device, m_buffer, &memoryRequirements);
+    }
 
     const DeviceMemory::AllocationDesc desc = {
         .memoryRequirements = memoryRequirements,
-        .memoryPropertyFlags = memoryPropertyFlags
+        .memoryPropertyFlags = memoryPropertyFlags,
+        .category = category,
+        .preferredPropertyFlags = preferredMemoryPropertyFlags,
+        .prefersDedicated = dedicatedRequirements.prefersDedicatedAllocation == VK_TRUE,
+        .requiresDedicated = dedicatedRequirements.requiresDedicatedAllocation == VK_TRUE,
+        .buffer = m_buffer,
+        .callSite = callSite
     };
     //spdlog::info("[GenericBuffer] Allocated {} with flags: {}", VkHelper::BufferUsageFlagsToString(m_bufferUsage), VkHelper::MemoryPropertyFlagsToString(memoryPropertyFlags, ", "));
 
-    m_bufferMemory = m_context->GetDevice()->GetDeviceMemory()->AllocateMemory(desc);
+    const DeviceMemory::SubAllocation subAllocation = deviceMemory->SubAllocate(desc);
+
+    m_bufferMemory = subAllocation.memory;
+    m_memoryOffset = subAllocation.offset;
+    m_memoryProperty = deviceMemory->GetMemoryPropertyFlags(m_bufferMemory);
 
     m_allocatedMemorySize = memoryRequirements.size;
-    vkBindBufferMemory(m_context->GetDevice()->GetVkDevice(), m_buffer, m_bufferMemory, 0);
+    vkBindBufferMemory(device, m_buffer, m_bufferMemory, m_memoryOffset);
+
+    if (memoryPropertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        m_mappedMemory = static_cast<std::byte*>(deviceMemory->MapMemory(m_bufferMemory)) + m_memoryOffset;
+    }
+
+    // Buffers with memory of their own have nothing to be compacted with.
+    Defragmenter* defragmenter = m_context->GetDefragmenter();
+    if (m_relocationCreateInfo.has_value() && defragmenter != nullptr && deviceMemory->IsBlock(m_bufferMemory)) {
+        defragmenter->Register(this, memoryRequirements.alignment);
+        m_registeredForDefragmentation = true;
+    }
+}
+
+void GenericBuffer::Relocate(VkBuffer buffer, const DeviceMemory::SubAllocation& subAllocation) {
+
+    DeviceMemory* deviceMemory = m_context->GetDevice()->GetDeviceMemory();
+
+    m_buffer = buffer;
+    m_bufferMemory = subAllocation.memory;
+    m_memoryOffset = subAllocation.offset;
+
+    if (m_mappedMemory != nullptr) {
+        m_mappedMemory = static_cast<std::byte*>(deviceMemory->MapMemory(m_bufferMemory)) + m_memoryOffset;
+    }
+
+    m_relocationCount++;
+}
+
+DeviceMemory::SubAllocation GenericBuffer::GetSubAllocation() const {
+
+    return DeviceMemory::SubAllocation{
+        .memory = m_bufferMemory,
+        .offset = m_memoryOffset,
+        .size = m_allocatedMemorySize
+    };
 }
 
 
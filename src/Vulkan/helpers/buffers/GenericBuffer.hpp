@@ -1,6 +1,10 @@
 #pragma once
 
 #include <volk.h>
+#include <optional>
+#include <source_location>
+
+#include "../DeviceMemory.hpp"
 
 class Context;
 
@@ -11,17 +15,49 @@ public:
 	{
 		VkBufferCreateInfo bufferCreateInfo;
 		VkMemoryPropertyFlags memoryProperty;
+		MemoryCategory category = MemoryCategory::Other;
+
+		/**
+		 * Used if available, see DeviceMemory::AllocationDesc.
+		 */
+		VkMemoryPropertyFlags preferredMemoryProperty = 0;
+
+		/**
+		 * Lets the Defragmenter move the buffer to another block between frames. Only for buffers that are looked up
+		 * again every frame, see GetVkBuffer and GetMappedMemory.
+		 */
+		bool relocatable = false;
+
+		/**
+		 * Where the buffer was created, see DeviceMemory::AllocationDesc.
+		 */
+		std::source_location callSite = std::source_location::current();
 	};
 
 	GenericBuffer(const Context* context, const GenericBuffer::Desc& desc);
 	void Destroy();
 
-	void* MapMemory(const VkDeviceSize memorySize);
-	void UnmapMemory();
-
+	/**
+	 * Copies to the start of the buffer and flushes the written range.
+	 */
 	virtual void CopyData(const void* data, size_t dataSize);
+
+	/**
+	 * Needed after writing to the mapped memory directly, unless it is host coherent.
+	 */
+	void Flush(VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE) const;
+
+	/**
+	 * Needed before reading what the device wrote, unless the memory is host coherent.
+	 */
+	void Invalidate(VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE) const;
+
 	void CopyFromBuffer(VkCommandBuffer commandBuffer, const GenericBuffer* srcBuffer, const VkBufferCopy& bufferCopyInfo) const;
 
+	/**
+	 * Host pointer to the start of the buffer. Only for host visible memory. Stable for the whole lifetime unless the
+	 * buffer is relocatable, then only until the end of the frame.
+	 */
 	[[nodiscard]] void* GetMappedMemory() const;
 
 	/**
@@ -33,26 +69,68 @@ public:
 	 * Amount of memory in bytes that we asked for when creating the buffer.
 	 */
 	[[nodiscard]] VkDeviceSize GetBufferSize() const;
+	/**
+	 * Changes when a relocatable buffer is moved, so it should not be kept across frames.
+	 */
 	[[nodiscard]] VkBuffer GetVkBuffer() const;
+	[[nodiscard]] VkBufferUsageFlags GetUsage() const;
 	[[nodiscard]] VkDeviceMemory GetVkDeviceMemory() const;
 
+	/**
+	 * Where the buffer starts in its memory block.
+	 */
+	[[nodiscard]] VkDeviceSize GetMemoryOffset() const;
+
+	/**
+	 * Properties of the memory type the buffer ended up in.
+	 */
+	[[nodiscard]] VkMemoryPropertyFlags GetMemoryProperty() const;
+
+	/**
+	 * How often the buffer was moved, so descriptors pointing at it know when to be written again.
+	 */
+	[[nodiscard]] uint32_t GetRelocationCount() const;
+
 
 protected:
 
 	explicit GenericBuffer(const Context* context);
 
-	void CreateBuffer(const VkBufferCreateInfo& bufferCreateInfo);
-	void AllocateBuffer(VkMemoryPropertyFlags memoryPropertyFlags);
+	/**
+	 * A relocatable buffer also gets the transfer usages, so it can be copied to where it is moved.
+	 */
+	void CreateBuffer(const VkBufferCreateInfo& bufferCreateInfo, bool relocatable = false);
+	void AllocateBuffer(VkMemoryPropertyFlags memoryPropertyFlags, MemoryCategory category = MemoryCategory::Other, VkMemoryPropertyFlags preferredMemoryPropertyFlags = 0,
+		const std::source_location& callSite = std::source_location::current());
 
 	const Context* m_context{};
 
 	VkBuffer m_buffer{};
 	VkBufferUsageFlags m_bufferUsage{};
 	VkDeviceMemory m_bufferMemory{};
+	VkDeviceSize m_memoryOffset = 0;
+	VkMemoryPropertyFlags m_memoryProperty{};
 
 	// These could be sometimes different because of the memory requirements.
 	VkDeviceSize m_bufferSize = 0;
 	VkDeviceSize m_allocatedMemorySize = 0;
 
+	// The block is mapped persistently by DeviceMemory, this already includes the offset.
 	void* m_mappedMemory = nullptr;
+
+private:
+
+	friend class Defragmenter;
+
+	/**
+	 * Switches to a copy of the buffer in another place. The old buffer and memory are the caller's to free.
+	 */
+	void Relocate(VkBuffer buffer, const DeviceMemory::SubAllocation& subAllocation);
+
+	[[nodiscard]] DeviceMemory::SubAllocation GetSubAllocation() const;
+
+	// Only set if the buffer can be moved, a copy of it is created with the same info.
+	std::optional<VkBufferCreateInfo> m_relocationCreateInfo{};
+	bool m_registeredForDefragmentation = false;
+	uint32_t m_relocationCount = 0;
 };
\ No newline at end of file
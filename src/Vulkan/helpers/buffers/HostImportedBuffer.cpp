@@ -0,0 +1,56 @@
+#include "HostImportedBuffer.hpp"
+
+#include "../../pch.hpp"
+#include "../Context.hpp"
+
+bool HostImportedBuffer::CanImport(const Context* context, const void* hostPointer, VkDeviceSize size) {
+
+    const DeviceMemory* deviceMemory = context->GetDevice()->GetDeviceMemory();
+    if (!deviceMemory->IsHostImportSupported() || hostPointer == nullptr || size == 0) {
+        return false;
+    }
+
+    const VkDeviceSize alignment = deviceMemory->GetMinImportedHostPointerAlignment();
+    return reinterpret_cast<uintptr_t>(hostPointer) % alignment == 0 && size % alignment == 0;
+}
+
+HostImportedBuffer::HostImportedBuffer(const Context* context, const HostImportedBuffer::Desc& desc) : GenericBuffer(context) {
+
+    const VkExternalMemoryBufferCreateInfo externalInfo = {
+        .sType = VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_BUFFER_CREATE_INFO,
+        .handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT
+    };
+
+    this->CreateBuffer({
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .pNext = &externalInfo,
+        .size = desc.size,
+        .usage = desc.usageFlags,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE
+    });
+
+    const VkDevice device = m_context->GetDevice()->GetVkDevice();
+
+    VkMemoryRequirements memoryRequirements;
+    vkGetBufferMemoryRequirements(device, m_buffer, &memoryRequirements);
+
+    if (memoryRequirements.size > desc.size) {
+        vkDestroyBuffer(device, m_buffer, nullptr);
+        throw std::runtime_error(std::format("[HostImportedBuffer] Buffer needs {} bytes, but only {} are imported", memoryRequirements.size, desc.size));
+    }
+
+    try {
+        m_bufferMemory = m_context->GetDevice()->GetDeviceMemory()->ImportHostMemory(desc.hostPointer, desc.size, memoryRequirements.memoryTypeBits, desc.category, desc.callSite);
+    }
+    catch (...) {
+        vkDestroyBuffer(device, m_buffer, nullptr);
+        throw;
+    }
+
+    m_allocatedMemorySize = desc.size;
+    m_memoryProperty = m_context->GetDevice()->GetDeviceMemory()->GetMemoryPropertyFlags(m_bufferMemory);
+    vkBindBufferMemory(device, m_buffer, m_bufferMemory, 0);
+
+    // Already host memory, the mapped pointer is the imported one.
+    m_mappedMemory = desc.hostPointer;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "GenericBuffer.hpp"
+
+/**
+ * Buffer over memory the application allocated, imported with VK_EXT_external_memory_host.
+ * The GPU reads the host memory in place, so nothing is ever copied into the buffer.
+ */
+class HostImportedBuffer : public GenericBuffer
+{
+public:
+	struct Desc
+	{
+		VkBufferUsageFlags usageFlags;
+
+		/**
+		 * Must stay allocated until the buffer is destroyed.
+		 */
+		void* hostPointer;
+		VkDeviceSize size;
+
+		MemoryCategory category = MemoryCategory::Other;
+
+		/**
+		 * Where the buffer was created, see DeviceMemory::AllocationDesc.
+		 */
+		std::source_location callSite = std::source_location::current();
+	};
+
+	/**
+	 * Whether the device can import the range, see DeviceMemory::ImportHostMemory.
+	 */
+	[[nodiscard]] static bool CanImport(const Context* context, const void* hostPointer, VkDeviceSize size);
+
+	HostImportedBuffer(const Context* context, const HostImportedBuffer::Desc& desc);
+};
\ No newline at end of file
@@ -14,8 +14,8 @@ LocalBuffer::LocalBuffer(const Context* context, const LocalBuffer::Desc& desc)
         .size = desc.bufferSize,
         .usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | desc.usageFlags,
         .sharingMode = VK_SHARING_MODE_EXCLUSIVE
-    });
-    this->AllocateBuffer(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    }, true);
+    this->AllocateBuffer(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, desc.category, 0, desc.callSite);
 
     VkCommandBuffer transferCommandBuffer = m_context->GetTransferCommandBuffer();
 	this->CopyFromBuffer(transferCommandBuffer, &stagingBuffer, {
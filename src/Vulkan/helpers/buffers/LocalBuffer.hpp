@@ -11,6 +11,13 @@ public:
 
 		const void* buffer;
 		VkDeviceSize bufferSize;
+
+		MemoryCategory category = MemoryCategory::Other;
+
+		/**
+		 * Where the buffer was created, see DeviceMemory::AllocationDesc.
+		 */
+		std::source_location callSite = std::source_location::current();
 	};
 
 	LocalBuffer(const Context* context, const LocalBuffer::Desc& desc);
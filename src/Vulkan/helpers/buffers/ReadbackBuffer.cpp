@@ -0,0 +1,29 @@
+#include "ReadbackBuffer.hpp"
+
+#include "../../pch.hpp"
+#include "../Context.hpp"
+
+ReadbackBuffer::ReadbackBuffer(const Context* context, const VkDeviceSize bufferSize, const std::source_location& callSite) : GenericBuffer(context) {
+
+    this->CreateBuffer({
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = bufferSize,
+        .usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE
+    });
+    this->AllocateBuffer(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, MemoryCategory::Staging, VK_MEMORY_PROPERTY_HOST_CACHED_BIT, callSite);
+
+    if ((m_memoryProperty & VK_MEMORY_PROPERTY_HOST_CACHED_BIT) == 0) {
+        spdlog::warn("[ReadbackBuffer] No cached host memory, reading back will be slow");
+    }
+}
+
+void ReadbackBuffer::ReadData(void* data, size_t dataSize, VkDeviceSize offset) const {
+
+    if (offset + dataSize > m_bufferSize) {
+        throw std::runtime_error(std::format("[ReadbackBuffer] Trying to read {} bytes at {} from a buffer of {} bytes", dataSize, offset, m_bufferSize));
+    }
+
+    this->Invalidate(offset, dataSize);
+    std::memcpy(data, static_cast<const std::byte*>(this->GetMappedMemory()) + offset, dataSize);
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "GenericBuffer.hpp"
+
+class Context;
+
+/**
+ * Destination for copies from the device that the host reads. Prefers HOST_CACHED memory, since reading
+ * uncached memory goes over the bus for every cache line.
+ */
+class ReadbackBuffer : public GenericBuffer
+{
+public:
+	ReadbackBuffer(const Context* context, VkDeviceSize bufferSize, const std::source_location& callSite = std::source_location::current());
+
+	/**
+	 * Invalidates the range and copies it out. The copy into the buffer must have finished on the device.
+	 */
+	void ReadData(void* data, size_t dataSize, VkDeviceSize offset = 0) const;
+};
\ No newline at end of file
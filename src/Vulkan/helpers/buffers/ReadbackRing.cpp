@@ -0,0 +1,219 @@
+#include "ReadbackRing.hpp"
+
+#include "../../pch.hpp"
+#include "../Context.hpp"
+
+#include <tracy/Tracy.hpp>
+
+ReadbackRing::ReadbackRing(const Context* context, const ReadbackRing::Desc& desc) {
+
+    m_context = context;
+    m_slots.resize(desc.slotCount);
+
+    constexpr VkFenceCreateInfo fenceInfo = {
+        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO
+    };
+
+    for (Slot& slot : m_slots) {
+
+        slot.buffer = std::make_unique<ReadbackBuffer>(m_context, desc.slotSize);
+
+        const VkResult result = vkCreateFence(m_context->GetDevice()->GetVkDevice(), &fenceInfo, nullptr, &slot.fence);
+        if (result != VK_SUCCESS) {
+            throw std::runtime_error("[ReadbackRing] Could not create a fence: " + std::to_string(result));
+        }
+    }
+}
+
+void ReadbackRing::Destroy() {
+
+    const VkDevice device = m_context->GetDevice()->GetVkDevice();
+
+    for (Slot& slot : m_slots) {
+
+        // Waiting only for what was submitted, recorded slots never get signaled.
+        if (slot.state == SlotState::Submitted) {
+            vkWaitForFences(device, 1, &slot.fence, VK_TRUE, UINT64_MAX);
+        }
+
+        vkDestroyFence(device, slot.fence, nullptr);
+        slot.buffer->Destroy();
+    }
+
+    m_slots.clear();
+    m_inFlight.clear();
+}
+
+std::optional<uint32_t> ReadbackRing::RecordBufferCopy(VkCommandBuffer commandBuffer, VkBuffer srcBuffer, VkDeviceSize srcOffset, VkDeviceSize size, Callback callback) {
+
+    const std::optional<uint32_t> slotIndex = this->AcquireSlot(size);
+    if (!slotIndex.has_value()) {
+        return std::nullopt;
+    }
+
+    Slot& slot = m_slots[*slotIndex];
+
+    const VkBufferCopy copy = {
+        .srcOffset = srcOffset,
+        .dstOffset = 0,
+        .size = size
+    };
+    vkCmdCopyBuffer(commandBuffer, srcBuffer, slot.buffer->GetVkBuffer(), 1, &copy);
+    this->RecordHostBarrier(commandBuffer, slot);
+
+    slot.state = SlotState::Recorded;
+    slot.dataSize = size;
+    slot.callback = std::move(callback);
+    m_inFlight.push_back(*slotIndex);
+
+    return slotIndex;
+}
+
+std::optional<uint32_t> ReadbackRing::RecordImageCopy(VkCommandBuffer commandBuffer, const ReadbackRing::ImageCopyDesc& desc, Callback callback) {
+
+    const VkDeviceSize size = static_cast<VkDeviceSize>(desc.extent.width) * desc.extent.height * desc.bytesPerPixel;
+
+    const std::optional<uint32_t> slotIndex = this->AcquireSlot(size);
+    if (!slotIndex.has_value()) {
+        return std::nullopt;
+    }
+
+    Slot& slot = m_slots[*slotIndex];
+
+    constexpr VkImageSubresourceRange subresourceRange = {
+        .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+        .baseMipLevel = 0,
+        .levelCount = 1,
+        .baseArrayLayer = 0,
+        .layerCount = 1
+    };
+
+    const VkImageMemoryBarrier toTransfer = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = desc.srcAccessMask,
+        .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+        .oldLayout = desc.layout,
+        .newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = desc.image,
+        .subresourceRange = subresourceRange
+    };
+    vkCmdPipelineBarrier(commandBuffer, desc.srcStageMask, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &toTransfer);
+
+    const VkBufferImageCopy copy = {
+        .bufferOffset = 0,
+        .bufferRowLength = 0,
+        .bufferImageHeight = 0,
+        .imageSubresource = {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .mipLevel = 0,
+            .baseArrayLayer = 0,
+            .layerCount = 1
+        },
+        .imageOffset = { 0, 0, 0 },
+        .imageExtent = { desc.extent.width, desc.extent.height, 1 }
+    };
+    vkCmdCopyImageToBuffer(commandBuffer, desc.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot.buffer->GetVkBuffer(), 1, &copy);
+
+    // Whatever uses the image next synchronizes against its own stage, so only the layout has to be restored.
+    const VkImageMemoryBarrier toOriginal = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+        .dstAccessMask = 0,
+        .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        .newLayout = desc.layout,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = desc.image,
+        .subresourceRange = subresourceRange
+    };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &toOriginal);
+
+    this->RecordHostBarrier(commandBuffer, slot);
+
+    slot.state = SlotState::Recorded;
+    slot.dataSize = size;
+    slot.callback = std::move(callback);
+    m_inFlight.push_back(*slotIndex);
+
+    return slotIndex;
+}
+
+void ReadbackRing::Submit(VkQueue queue) {
+
+    for (const uint32_t slotIndex : m_inFlight) {
+
+        Slot& slot = m_slots[slotIndex];
+        if (slot.state != SlotState::Recorded) {
+            continue;
+        }
+
+        const VkResult result = vkQueueSubmit(queue, 0, nullptr, slot.fence);
+        if (result != VK_SUCCESS) {
+            throw std::runtime_error("[ReadbackRing] Could not submit the readback fence: " + std::to_string(result));
+        }
+        slot.state = SlotState::Submitted;
+    }
+}
+
+void ReadbackRing::Poll() {
+
+    ZoneScoped;
+
+    const VkDevice device = m_context->GetDevice()->GetVkDevice();
+
+    while (!m_inFlight.empty()) {
+
+        Slot& slot = m_slots[m_inFlight.front()];
+        if (slot.state != SlotState::Submitted || vkGetFenceStatus(device, slot.fence) != VK_SUCCESS) {
+            break;
+        }
+
+        slot.buffer->Invalidate(0, slot.dataSize);
+        slot.callback(slot.buffer->GetMappedMemory(), slot.dataSize);
+
+        vkResetFences(device, 1, &slot.fence);
+        slot.callback = nullptr;
+        slot.state = SlotState::Free;
+        m_inFlight.pop_front();
+    }
+}
+
+uint32_t ReadbackRing::GetInFlightCount() const {
+    return static_cast<uint32_t>(m_inFlight.size());
+}
+
+std::optional<uint32_t> ReadbackRing::AcquireSlot(VkDeviceSize size) {
+
+    for (uint32_t slotIndex = 0; slotIndex < m_slots.size(); slotIndex++) {
+
+        Slot& slot = m_slots[slotIndex];
+        if (slot.state != SlotState::Free) {
+            continue;
+        }
+
+        if (slot.buffer->GetBufferSize() < size) {
+            slot.buffer->Destroy();
+            slot.buffer = std::make_unique<ReadbackBuffer>(m_context, size);
+        }
+        return slotIndex;
+    }
+
+    return std::nullopt;
+}
+
+void ReadbackRing::RecordHostBarrier(VkCommandBuffer commandBuffer, const Slot& slot) const {
+
+    const VkBufferMemoryBarrier barrier = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .buffer = slot.buffer->GetVkBuffer(),
+        .offset = 0,
+        .size = VK_WHOLE_SIZE
+    };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <volk.h>
+#include <memory>
+#include <vector>
+#include <deque>
+#include <optional>
+#include <functional>
+
+#include "ReadbackBuffer.hpp"
+
+class Context;
+
+/**
+ * Fixed set of cached readback buffers that copies from the device are recorded into. Every slot gets its own fence
+ * when it is submitted, and Poll hands the data to the callback once that fence is signaled, so results arrive one or
+ * more frames later and the host never waits on the device for them.
+ */
+class ReadbackRing
+{
+public:
+
+	struct Desc
+	{
+		uint32_t slotCount;
+
+		/**
+		 * Initial size of every slot. A free slot grows when a larger copy is recorded into it.
+		 */
+		VkDeviceSize slotSize;
+	};
+
+	/**
+	 * The data is only valid during the call.
+	 */
+	using Callback = std::function<void(const void* data, size_t dataSize)>;
+
+	struct ImageCopyDesc
+	{
+		VkImage image;
+		VkExtent2D extent;
+		uint32_t bytesPerPixel;
+
+		/**
+		 * The image is in this layout when the copy is recorded and is put back into it afterwards.
+		 */
+		VkImageLayout layout;
+
+		/**
+		 * What last wrote the image, e.g. the color attachment output of a render pass.
+		 */
+		VkPipelineStageFlags srcStageMask;
+		VkAccessFlags srcAccessMask;
+	};
+
+	ReadbackRing(const Context* context, const ReadbackRing::Desc& desc);
+	void Destroy();
+
+	/**
+	 * Must be recorded outside a render pass.
+	 * \return Slot of the copy, or nothing if every slot is still in flight. Readbacks are dropped rather than stalling.
+	 */
+	std::optional<uint32_t> RecordBufferCopy(VkCommandBuffer commandBuffer, VkBuffer srcBuffer, VkDeviceSize srcOffset, VkDeviceSize size, Callback callback);
+
+	/**
+	 * Copies the first mip level and layer of a color image, tightly packed row by row.
+	 * \return Slot of the copy, or nothing if every slot is still in flight.
+	 */
+	std::optional<uint32_t> RecordImageCopy(VkCommandBuffer commandBuffer, const ReadbackRing::ImageCopyDesc& desc, Callback callback);
+
+	/**
+	 * Call right after the command buffer with the recorded copies was submitted to the queue. Gives every recorded
+	 * slot its fence with an empty submit, which is signaled once all the work submitted before it is done.
+	 */
+	void Submit(VkQueue queue);
+
+	/**
+	 * Calls the callbacks of the finished copies in the order they were recorded. Never waits.
+	 */
+	void Poll();
+
+	[[nodiscard]] uint32_t GetInFlightCount() const;
+
+private:
+
+	enum class SlotState
+	{
+		Free,
+		Recorded,
+		Submitted
+	};
+
+	struct Slot
+	{
+		std::unique_ptr<ReadbackBuffer> buffer;
+		VkFence fence{};
+		SlotState state = SlotState::Free;
+
+		VkDeviceSize dataSize = 0;
+		Callback callback;
+	};
+
+	/**
+	 * Finds a free slot and grows its buffer to the size if needed.
+	 */
+	std::optional<uint32_t> AcquireSlot(VkDeviceSize size);
+
+	/**
+	 * Makes the transfer into the slot visible to the host once its fence is signaled.
+	 */
+	void RecordHostBarrier(VkCommandBuffer commandBuffer, const Slot& slot) const;
+
+	const Context* m_context;
+
+	std::vector<Slot> m_slots;
+
+	// Slots in the order they were recorded, which is the order their results are delivered in.
+	std::deque<uint32_t> m_inFlight;
+};
\ No newline at end of file
@@ -0,0 +1,131 @@
+#include "SegmentedInstanceBuffer.hpp"
+
+#include "../../pch.hpp"
+#include "../Context.hpp"
+#include "../ResourcePool.hpp"
+
+#include <algorithm>
+
+SegmentedInstanceBuffer::SegmentedInstanceBuffer(const Context* context, const SegmentedInstanceBuffer::Desc& desc) {
+
+    if (desc.firstSegmentCapacity == 0 || desc.maxCapacity == 0) {
+        throw std::runtime_error("[SegmentedInstanceBuffer] The capacity has to be at least one instance");
+    }
+
+    m_context = context;
+    m_desc = desc;
+
+    // The segments are only bound as vertex buffers so far, but staying within a storage buffer binding keeps them
+    // readable from a compute shader too.
+    const DeviceMemory* deviceMemory = m_context->GetDevice()->GetDeviceMemory();
+    const VkDeviceSize maxSegmentSize = std::min<VkDeviceSize>(deviceMemory->GetMaxAllocationSize(), m_context->GetDevice()->GetVkPhysicalDeviceProperties().limits.maxStorageBufferRange);
+
+    m_maxSegmentCapacity = static_cast<uint32_t>(std::min<VkDeviceSize>(maxSegmentSize / m_desc.stride, UINT32_MAX));
+    if (m_maxSegmentCapacity == 0) {
+        throw std::runtime_error(std::format("[SegmentedInstanceBuffer] A stride of {} bytes does not fit into a segment", m_desc.stride));
+    }
+
+    this->AddSegment();
+}
+
+void SegmentedInstanceBuffer::Destroy() {
+
+    while (!m_segments.empty()) {
+        this->RemoveSegment();
+    }
+}
+
+bool SegmentedInstanceBuffer::Resize(uint32_t instanceCount) {
+
+    const uint32_t previousCount = this->GetSegmentCount();
+
+    while (m_capacity < instanceCount && m_capacity < m_desc.maxCapacity) {
+        this->AddSegment();
+    }
+
+    while (m_segments.size() > 1) {
+
+        const uint32_t remainingCapacity = m_capacity - m_segments.back().capacity;
+        if (instanceCount > static_cast<uint32_t>(static_cast<double>(remainingCapacity) * kShrinkThreshold)) {
+            break;
+        }
+        this->RemoveSegment();
+    }
+
+    if (this->GetSegmentCount() != previousCount) {
+        spdlog::debug("[SegmentedInstanceBuffer] {} segments for {} instances, {} resident", this->GetSegmentCount(), instanceCount, m_capacity);
+    }
+
+    return this->GetSegmentCount() > previousCount;
+}
+
+uint32_t SegmentedInstanceBuffer::FindSegment(uint32_t instance) const {
+
+    // Segments past the largest size are not a power of two apart anymore, so the start is searched for.
+    const auto it = std::upper_bound(m_segments.begin(), m_segments.end(), instance, [](uint32_t value, const Segment& segment)
+    {
+        return value < segment.firstInstance;
+    });
+    return static_cast<uint32_t>(std::max<std::ptrdiff_t>(it - m_segments.begin() - 1, 0));
+}
+
+uint32_t SegmentedInstanceBuffer::GetSegmentCount() const {
+    return static_cast<uint32_t>(m_segments.size());
+}
+
+const SegmentedInstanceBuffer::Segment& SegmentedInstanceBuffer::GetSegment(uint32_t segment) const {
+    return m_segments[segment];
+}
+
+uint32_t SegmentedInstanceBuffer::GetCapacity() const {
+    return m_capacity;
+}
+
+uint32_t SegmentedInstanceBuffer::GetMaxSegmentCapacity() const {
+    return m_maxSegmentCapacity;
+}
+
+VkDeviceSize SegmentedInstanceBuffer::GetResidentSize() const {
+
+    VkDeviceSize size = 0;
+    for (const Segment& segment : m_segments) {
+        size += segment.buffer->GetAllocatedMemorySize();
+    }
+    return size;
+}
+
+void SegmentedInstanceBuffer::AddSegment() {
+
+    // Past 32 doublings the segments are at the largest size anyway.
+    const uint32_t segmentIndex = std::min(this->GetSegmentCount(), 32u);
+    const uint64_t fullCapacity = std::min<uint64_t>(static_cast<uint64_t>(m_desc.firstSegmentCapacity) << segmentIndex, m_maxSegmentCapacity);
+    const uint32_t capacity = static_cast<uint32_t>(std::min<uint64_t>(fullCapacity, m_desc.maxCapacity - m_capacity));
+
+    std::unique_ptr<GenericBuffer> buffer = m_context->GetResourcePool()->AcquireBuffer(GenericBuffer::Desc{
+        .bufferCreateInfo = VkBufferCreateInfo {
+            .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+            .size = static_cast<VkDeviceSize>(capacity) * m_desc.stride,
+            .usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+            .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        },
+        .memoryProperty = m_desc.memoryProperty,
+        .category = MemoryCategory::Instance,
+        .relocatable = true
+    });
+
+    m_segments.push_back(Segment{
+        .buffer = std::move(buffer),
+        .firstInstance = m_capacity,
+        .capacity = capacity
+    });
+    m_capacity += capacity;
+}
+
+void SegmentedInstanceBuffer::RemoveSegment() {
+
+    Segment& segment = m_segments.back();
+    m_capacity -= segment.capacity;
+
+    m_context->GetResourcePool()->ReleaseBuffer(std::move(segment.buffer));
+    m_segments.pop_back();
+}
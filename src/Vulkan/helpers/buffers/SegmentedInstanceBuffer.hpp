@@ -0,0 +1,120 @@
+#pragma once
+
+#include <volk.h>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+#include "GenericBuffer.hpp"
+
+class Context;
+
+/**
+ * Host visible per-instance storage that grows in segments instead of being reallocated. Segment i holds
+ * firstSegmentCapacity << i instances, so the capacity at least doubles with every segment and nothing that was
+ * written is ever copied. The last segment is dropped again once the count falls well below the capacity without it.
+ *
+ * No segment is larger than the device's maxMemoryAllocationSize or maxStorageBufferRange. Once the doubling reaches
+ * that, segments keep the largest size, so a stream can hold far more than any single buffer could.
+ *
+ * Segments are drawn one after another, each bound at offset 0. Streams with the same first segment capacity and
+ * stride share the segment boundaries, so they can be bound segment by segment together.
+ */
+class SegmentedInstanceBuffer
+{
+public:
+
+	struct Desc
+	{
+		uint32_t stride;
+		uint32_t firstSegmentCapacity;
+
+		/**
+		 * The last segment is cut short to not go over it.
+		 */
+		uint32_t maxCapacity;
+		VkMemoryPropertyFlags memoryProperty;
+	};
+
+	struct Segment
+	{
+		std::unique_ptr<GenericBuffer> buffer;
+		uint32_t firstInstance;
+		uint32_t capacity;
+	};
+
+	/**
+	 * The count has to fall to this share of the capacity without the last segment before that segment is dropped,
+	 * so a count moving around a segment boundary does not allocate and free every frame.
+	 */
+	static constexpr double kShrinkThreshold = 0.5;
+
+	SegmentedInstanceBuffer(const Context* context, const SegmentedInstanceBuffer::Desc& desc);
+
+	/**
+	 * Hands the segments back to the resource pool.
+	 */
+	void Destroy();
+
+	/**
+	 * Grows or shrinks to fit the count. Only call while the device is not using the segments.
+	 * \return Whether segments were added. Their contents are undefined until written.
+	 */
+	bool Resize(uint32_t instanceCount);
+
+	/**
+	 * Splits [begin, end) at the segment boundaries and calls function(data, rangeBegin, rangeEnd) for every piece,
+	 * where data points to instance rangeBegin. The range must be within the capacity.
+	 */
+	template<typename T, typename Function>
+	void ForEachRange(uint32_t begin, uint32_t end, Function&& function) const;
+
+	template<typename T>
+	[[nodiscard]] T* GetInstance(uint32_t instance) const;
+
+	[[nodiscard]] uint32_t FindSegment(uint32_t instance) const;
+
+	[[nodiscard]] uint32_t GetSegmentCount() const;
+	[[nodiscard]] const Segment& GetSegment(uint32_t segment) const;
+	[[nodiscard]] uint32_t GetCapacity() const;
+	[[nodiscard]] uint32_t GetMaxSegmentCapacity() const;
+
+	/**
+	 * Bytes of memory the segments take up.
+	 */
+	[[nodiscard]] VkDeviceSize GetResidentSize() const;
+
+private:
+
+	void AddSegment();
+	void RemoveSegment();
+
+	const Context* m_context;
+	SegmentedInstanceBuffer::Desc m_desc;
+
+	uint32_t m_maxSegmentCapacity;
+
+	std::vector<Segment> m_segments;
+	uint32_t m_capacity = 0;
+};
+
+template<typename T, typename Function>
+void SegmentedInstanceBuffer::ForEachRange(uint32_t begin, uint32_t end, Function&& function) const {
+
+	for (uint32_t segment = this->FindSegment(begin); begin < end; segment++) {
+
+		const Segment& current = m_segments[segment];
+		const uint32_t rangeEnd = std::min(end, current.firstInstance + current.capacity);
+
+		function(static_cast<T*>(current.buffer->GetMappedMemory()) + (begin - current.firstInstance), begin, rangeEnd);
+		begin = rangeEnd;
+	}
+}
+
+template<typename T>
+T* SegmentedInstanceBuffer::GetInstance(uint32_t instance) const {
+
+	const Segment& segment = m_segments[this->FindSegment(instance)];
+	return static_cast<T*>(segment.buffer->GetMappedMemory()) + (instance - segment.firstInstance);
+}
\ No newline at end of file
@@ -1,10 +1,8 @@
 #include "StagingBuffer.hpp"
 
-#include <vector>
-
 #include "../Context.hpp"
 
-StagingBuffer::StagingBuffer(const Context* context, const VkDeviceSize bufferSize) : GenericBuffer(context) {
+StagingBuffer::StagingBuffer(const Context* context, const VkDeviceSize bufferSize, const std::source_location& callSite) : GenericBuffer(context) {
 
     Context::ShareInfo shareInfo = context->GetTransferShareInfo();
 
@@ -18,21 +16,6 @@ StagingBuffer::StagingBuffer(const Context* context, const VkDeviceSize bufferSi
     };
 
     this->CreateBuffer(createInfo);
-    this->AllocateBuffer(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-}
-
-void StagingBuffer::CopyData(const void* data, size_t dataSize) {
-
-    void* mappedPointer = this->MapMemory(dataSize);
-    std::memcpy(mappedPointer, data, dataSize);
-
-	/*const VkMappedMemoryRange range = {
-        .sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
-        .memory = m_bufferMemory,
-        .offset = 0,
-        .size = dataSize
-    };
-    vkFlushMappedMemoryRanges(m_context->GetDevice()->GetVkDevice(), 1, &range);*/
-
-    this->UnmapMemory();
+    // Only written front to back, so write-combined memory is as fast as cached. Non-coherent memory is flushed by CopyData.
+    this->AllocateBuffer(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, MemoryCategory::Staging, 0, callSite);
 }
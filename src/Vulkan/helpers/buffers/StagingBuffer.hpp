@@ -7,7 +7,5 @@ class Context;
 class StagingBuffer : public GenericBuffer
 {
 public:
-	StagingBuffer(const Context* context, VkDeviceSize bufferSize);
-
-	void CopyData(const void* data, size_t dataSize) override;
+	StagingBuffer(const Context* context, VkDeviceSize bufferSize, const std::source_location& callSite = std::source_location::current());
 }; 
\ No newline at end of file
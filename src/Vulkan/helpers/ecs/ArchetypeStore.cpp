@@ -0,0 +1,304 @@
+#include "ArchetypeStore.hpp"
+
+#include <bit>
+#include <algorithm>
+#include <mutex>
+#include <format>
+
+namespace {
+
+    std::mutex g_componentTypeMutex;
+    std::array<ComponentTypes::Info, ComponentTypes::kMaxTypeCount> g_componentTypes;
+    uint32_t g_componentTypeCount = 0;
+
+    uint32_t AlignUp(uint32_t value, uint32_t alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+}
+
+const ComponentTypes::Info& ComponentTypes::GetInfo(ComponentTypeID type) {
+    return g_componentTypes[type];
+}
+
+ComponentTypeID ComponentTypes::Register(uint32_t size, uint32_t alignment) {
+
+    std::lock_guard lock(g_componentTypeMutex);
+
+    if (g_componentTypeCount == kMaxTypeCount) {
+        throw std::runtime_error(std::format("[ComponentTypes] More than {} component types", kMaxTypeCount));
+    }
+
+    g_componentTypes[g_componentTypeCount] = Info{
+        .size = size,
+        .alignment = alignment
+    };
+    return g_componentTypeCount++;
+}
+
+ArchetypeStore::Archetype::Archetype(ComponentMask mask) {
+
+    m_mask = mask;
+    m_columnOffsets.fill(kNoColumn);
+
+    uint32_t entitySize = sizeof(Entity);
+    for (ComponentMask bits = mask; bits != 0; bits &= bits - 1) {
+
+        const ComponentTypeID type = static_cast<ComponentTypeID>(std::countr_zero(bits));
+        m_types.push_back(type);
+        entitySize += ComponentTypes::GetInfo(type).size;
+    }
+
+    // Start from the capacity without padding and back off until the aligned columns fit.
+    for (m_chunkCapacity = static_cast<uint32_t>(kChunkSize) / entitySize; m_chunkCapacity > 0; m_chunkCapacity--) {
+
+        uint32_t offset = m_chunkCapacity * static_cast<uint32_t>(sizeof(Entity));
+        for (const ComponentTypeID type : m_types) {
+
+            const ComponentTypes::Info& info = ComponentTypes::GetInfo(type);
+            offset = AlignUp(offset, info.alignment);
+            m_columnOffsets[type] = offset;
+            offset += m_chunkCapacity * info.size;
+        }
+
+        if (offset <= kChunkSize) {
+            break;
+        }
+    }
+
+    if (m_chunkCapacity == 0) {
+        throw std::runtime_error("[ArchetypeStore] Components do not fit into a chunk");
+    }
+}
+
+ComponentMask ArchetypeStore::Archetype::GetMask() const {
+    return m_mask;
+}
+
+uint32_t ArchetypeStore::Archetype::GetChunkCapacity() const {
+    return m_chunkCapacity;
+}
+
+uint32_t ArchetypeStore::Archetype::GetChunkCount() const {
+    return (m_entityCount + m_chunkCapacity - 1) / m_chunkCapacity;
+}
+
+uint32_t ArchetypeStore::Archetype::GetEntityCount() const {
+    return m_entityCount;
+}
+
+uint32_t ArchetypeStore::Archetype::GetChunkEntityCount(uint32_t chunk) const {
+    return std::min(m_chunkCapacity, m_entityCount - chunk * m_chunkCapacity);
+}
+
+const Entity* ArchetypeStore::Archetype::GetEntities(uint32_t chunk) const {
+    return reinterpret_cast<const Entity*>(m_chunks[chunk]->data);
+}
+
+uint32_t ArchetypeStore::Archetype::GetColumnOffset(ComponentTypeID type) const {
+    return m_columnOffsets[type];
+}
+
+std::byte* ArchetypeStore::Archetype::GetChunkData(uint32_t chunk) const {
+    return m_chunks[chunk]->data;
+}
+
+uint32_t ArchetypeStore::Archetype::AddRow(Entity entity) {
+
+    const uint32_t row = m_entityCount;
+    const uint32_t chunk = row / m_chunkCapacity;
+    if (chunk == m_chunks.size()) {
+        m_chunks.push_back(std::make_unique<Chunk>());
+    }
+
+    std::memcpy(this->GetComponent(row, 0, sizeof(Entity)), &entity, sizeof(Entity));
+    m_entityCount++;
+
+    return row;
+}
+
+Entity ArchetypeStore::Archetype::RemoveRow(uint32_t row) {
+
+    const uint32_t lastRow = m_entityCount - 1;
+
+    Entity movedEntity;
+    if (row != lastRow) {
+
+        std::memcpy(&movedEntity, this->GetComponent(lastRow, 0, sizeof(Entity)), sizeof(Entity));
+        std::memcpy(this->GetComponent(row, 0, sizeof(Entity)), &movedEntity, sizeof(Entity));
+
+        for (const ComponentTypeID type : m_types) {
+
+            const uint32_t size = ComponentTypes::GetInfo(type).size;
+            std::memcpy(this->GetComponent(row, m_columnOffsets[type], size), this->GetComponent(lastRow, m_columnOffsets[type], size), size);
+        }
+    }
+
+    m_entityCount--;
+
+    // Keeps at most one empty chunk.
+    while (m_chunks.size() > this->GetChunkCount() + 1) {
+        m_chunks.pop_back();
+    }
+
+    return movedEntity;
+}
+
+std::byte* ArchetypeStore::Archetype::GetComponent(uint32_t row, uint32_t columnOffset, uint32_t size) const {
+    return m_chunks[row / m_chunkCapacity]->data + columnOffset + static_cast<size_t>(row % m_chunkCapacity) * size;
+}
+
+void ArchetypeStore::Destroy(Entity entity) {
+
+    if (!this->IsAlive(entity)) {
+        throw std::runtime_error("[ArchetypeStore] Trying to destroy an entity that is not alive");
+    }
+
+    Record& record = m_records[entity.index];
+
+    const Entity movedEntity = m_archetypes[record.archetype]->RemoveRow(record.row);
+    if (movedEntity.IsValid()) {
+        m_records[movedEntity.index].row = record.row;
+    }
+
+    record.archetype = kNoArchetype;
+    record.generation += 1;
+    m_freeIndices.push_back(entity.index);
+    m_entityCount--;
+}
+
+bool ArchetypeStore::IsAlive(Entity entity) const {
+
+    return entity.index < m_records.size()
+        && m_records[entity.index].archetype != kNoArchetype
+        && m_records[entity.index].generation == entity.generation;
+}
+
+void ArchetypeStore::Clear() {
+
+    // Bumping the generations keeps handles from before the clear invalid.
+    for (uint32_t index = 0; index < m_records.size(); index++) {
+
+        Record& record = m_records[index];
+        if (record.archetype != kNoArchetype) {
+            record.archetype = kNoArchetype;
+            record.generation += 1;
+            m_freeIndices.push_back(index);
+        }
+    }
+
+    for (const auto& archetype : m_archetypes) {
+        archetype->m_entityCount = 0;
+        archetype->m_chunks.resize(std::min<size_t>(archetype->m_chunks.size(), 1));
+    }
+
+    m_entityCount = 0;
+}
+
+uint32_t ArchetypeStore::GetEntityCount() const {
+    return m_entityCount;
+}
+
+uint32_t ArchetypeStore::GetArchetypeCount() const {
+    return static_cast<uint32_t>(m_archetypes.size());
+}
+
+const ArchetypeStore::Archetype& ArchetypeStore::GetArchetype(uint32_t index) const {
+    return *m_archetypes[index];
+}
+
+uint32_t ArchetypeStore::GetChunkCount() const {
+
+    uint32_t count = 0;
+    for (const auto& archetype : m_archetypes) {
+        count += archetype->GetChunkCount();
+    }
+    return count;
+}
+
+uint32_t ArchetypeStore::FindOrCreateArchetype(ComponentMask mask) {
+
+    const auto it = m_archetypeIndices.find(mask);
+    if (it != m_archetypeIndices.end()) {
+        return it->second;
+    }
+
+    const uint32_t index = static_cast<uint32_t>(m_archetypes.size());
+    m_archetypes.push_back(std::make_unique<Archetype>(mask));
+    m_archetypeIndices.emplace(mask, index);
+
+    return index;
+}
+
+Entity ArchetypeStore::Allocate(uint32_t archetype) {
+
+    uint32_t index;
+    if (!m_freeIndices.empty()) {
+        index = m_freeIndices.back();
+        m_freeIndices.pop_back();
+    }
+    else {
+        index = static_cast<uint32_t>(m_records.size());
+        m_records.push_back(Record{
+            .generation = 0,
+            .archetype = kNoArchetype,
+            .row = 0
+        });
+    }
+
+    Record& record = m_records[index];
+    const Entity entity = {
+        .index = index,
+        .generation = record.generation
+    };
+
+    record.archetype = archetype;
+    record.row = m_archetypes[archetype]->AddRow(entity);
+    m_entityCount++;
+
+    return entity;
+}
+
+uint32_t ArchetypeStore::Move(Entity entity, uint32_t archetype) {
+
+    Record& record = m_records[entity.index];
+    if (record.archetype == archetype) {
+        return record.row;
+    }
+
+    Archetype& source = *m_archetypes[record.archetype];
+    Archetype& target = *m_archetypes[archetype];
+
+    const uint32_t row = target.AddRow(entity);
+    for (const ComponentTypeID type : target.m_types) {
+
+        const uint32_t sourceOffset = source.GetColumnOffset(type);
+        if (sourceOffset == Archetype::kNoColumn) {
+            continue;
+        }
+
+        const uint32_t size = ComponentTypes::GetInfo(type).size;
+        std::memcpy(target.GetComponent(row, target.GetColumnOffset(type), size), source.GetComponent(record.row, sourceOffset, size), size);
+    }
+
+    const Entity movedEntity = source.RemoveRow(record.row);
+    if (movedEntity.IsValid()) {
+        m_records[movedEntity.index].row = record.row;
+    }
+
+    record.archetype = archetype;
+    record.row = row;
+
+    return row;
+}
+
+std::byte* ArchetypeStore::GetComponent(Entity entity, ComponentTypeID type) const {
+
+    const Record& record = m_records[entity.index];
+    const Archetype& archetype = *m_archetypes[record.archetype];
+
+    const uint32_t offset = archetype.GetColumnOffset(type);
+    if (offset == Archetype::kNoColumn) {
+        return nullptr;
+    }
+    return archetype.GetComponent(record.row, offset, ComponentTypes::GetInfo(type).size);
+}
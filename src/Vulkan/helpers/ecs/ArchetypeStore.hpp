@@ -0,0 +1,438 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <utility>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+
+#include "Entity.hpp"
+#include "../jobs/JobSystem.hpp"
+
+using ComponentTypeID = uint32_t;
+
+/**
+ * One bit per component type.
+ */
+using ComponentMask = uint64_t;
+
+/**
+ * Process wide IDs for component types, handed out the first time a type is used.
+ */
+class ComponentTypes
+{
+public:
+
+	static constexpr uint32_t kMaxTypeCount = 64;
+
+	struct Info
+	{
+		uint32_t size;
+		uint32_t alignment;
+	};
+
+	template<typename T>
+	static ComponentTypeID Get();
+
+	template<typename... Components>
+	static ComponentMask MaskOf();
+
+	static const Info& GetInfo(ComponentTypeID type);
+
+private:
+
+	/**
+	 * Holds the ID of the unqualified type, so T and const T share it.
+	 */
+	template<typename T>
+	static ComponentTypeID GetUnqualified();
+
+	static ComponentTypeID Register(uint32_t size, uint32_t alignment);
+};
+
+/**
+ * Entities grouped by the exact set of components they have (their archetype).
+ *
+ * Every archetype stores its entities in 16 KB chunks. A chunk holds the entity handles followed by one tightly
+ * packed column per component, so a system only touches the columns it asks for and a chunk is a natural unit
+ * of parallel work. Chunks stay full except for the last one: removing an entity moves the archetype's last
+ * entity into its place, the same as EntityRegistry does for the dense arrays.
+ *
+ * Components must be trivially copyable, they are moved between chunks and archetypes with memcpy.
+ * Structural changes (Create, Destroy, Add, Remove) must not happen while a query iterates.
+ */
+class ArchetypeStore
+{
+public:
+
+	static constexpr size_t kChunkSize = 16 * 1024;
+
+	class Archetype
+	{
+	public:
+
+		static constexpr uint32_t kNoColumn = UINT32_MAX;
+
+		explicit Archetype(ComponentMask mask);
+
+		[[nodiscard]] ComponentMask GetMask() const;
+
+		/**
+		 * Entities per chunk.
+		 */
+		[[nodiscard]] uint32_t GetChunkCapacity() const;
+
+		[[nodiscard]] uint32_t GetChunkCount() const;
+		[[nodiscard]] uint32_t GetEntityCount() const;
+
+		/**
+		 * Number of entities in the chunk. Only the last chunk may be partially filled.
+		 */
+		[[nodiscard]] uint32_t GetChunkEntityCount(uint32_t chunk) const;
+
+		[[nodiscard]] const Entity* GetEntities(uint32_t chunk) const;
+
+		/**
+		 * Byte offset of the component's column inside every chunk, kNoColumn when the archetype does not have it.
+		 */
+		[[nodiscard]] uint32_t GetColumnOffset(ComponentTypeID type) const;
+
+		[[nodiscard]] std::byte* GetChunkData(uint32_t chunk) const;
+
+	private:
+
+		friend class ArchetypeStore;
+
+		struct Chunk
+		{
+			alignas(64) std::byte data[kChunkSize];
+		};
+
+		/**
+		 * Appends an entity with uninitialized components and returns its row.
+		 */
+		uint32_t AddRow(Entity entity);
+
+		/**
+		 * Moves the last entity into the row and returns it, or an invalid handle when the row was the last one.
+		 */
+		Entity RemoveRow(uint32_t row);
+
+		[[nodiscard]] std::byte* GetComponent(uint32_t row, uint32_t columnOffset, uint32_t size) const;
+
+		ComponentMask m_mask;
+		std::vector<ComponentTypeID> m_types;
+		std::array<uint32_t, ComponentTypes::kMaxTypeCount> m_columnOffsets;
+
+		uint32_t m_chunkCapacity = 0;
+		uint32_t m_entityCount = 0;
+
+		// May hold one empty chunk past the used ones, so an entity count going back and forth over a chunk
+		// boundary does not allocate every time.
+		std::vector<std::unique_ptr<Chunk>> m_chunks;
+	};
+
+	ArchetypeStore() = default;
+
+	template<typename... Components>
+	Entity Create(const Components&... components);
+
+	void Destroy(Entity entity);
+
+	[[nodiscard]] bool IsAlive(Entity entity) const;
+
+	/**
+	 * nullptr when the entity does not have the component. Invalidated by structural changes.
+	 */
+	template<typename T>
+	[[nodiscard]] T* Get(Entity entity) const;
+
+	template<typename T>
+	[[nodiscard]] bool Has(Entity entity) const;
+
+	/**
+	 * Moves the entity to the archetype with the component added. Overwrites the component if it already has it.
+	 */
+	template<typename T>
+	void Add(Entity entity, const T& component);
+
+	template<typename T>
+	void Remove(Entity entity);
+
+	/**
+	 * Destroys every entity. Archetypes are kept, so queries stay valid.
+	 */
+	void Clear();
+
+	[[nodiscard]] uint32_t GetEntityCount() const;
+	[[nodiscard]] uint32_t GetArchetypeCount() const;
+	[[nodiscard]] const Archetype& GetArchetype(uint32_t index) const;
+
+	/**
+	 * Chunks in use over all archetypes.
+	 */
+	[[nodiscard]] uint32_t GetChunkCount() const;
+
+private:
+
+	struct Record
+	{
+		uint32_t generation;
+		uint32_t archetype;
+		uint32_t row;
+	};
+
+	static constexpr uint32_t kNoArchetype = UINT32_MAX;
+
+	uint32_t FindOrCreateArchetype(ComponentMask mask);
+
+	/**
+	 * Takes a free index, or a new one, and places the entity at the end of the archetype.
+	 */
+	Entity Allocate(uint32_t archetype);
+
+	/**
+	 * Moves the entity to the archetype, copying the components both have. Returns the new row.
+	 */
+	uint32_t Move(Entity entity, uint32_t archetype);
+
+	[[nodiscard]] std::byte* GetComponent(Entity entity, ComponentTypeID type) const;
+
+	// Never shrinks, an archetype's index and address stay the same for the lifetime of the store.
+	std::vector<std::unique_ptr<Archetype>> m_archetypes;
+	std::unordered_map<ComponentMask, uint32_t> m_archetypeIndices;
+
+	std::vector<Record> m_records;
+	std::vector<uint32_t> m_freeIndices;
+	uint32_t m_entityCount = 0;
+};
+
+/**
+ * Iterates the chunks of every archetype that has all of the components and none of the excluded ones.
+ * The matching archetypes are cached, only archetypes created since the last iteration are tested.
+ *
+ * Components may be const to mark the columns as read-only: ArchetypeQuery<Transform, const MoveComponent>.
+ */
+template<typename... Components>
+class ArchetypeQuery
+{
+public:
+
+	explicit ArchetypeQuery(ArchetypeStore* store, ComponentMask exclude = 0);
+
+	/**
+	 * function(const Entity* entities, uint32_t count, Components*... columns), once per chunk.
+	 */
+	template<typename Function>
+	void ForEachChunk(Function&& function);
+
+	/**
+	 * Same as ForEachChunk, with the chunks spread over the job system. Every chunk is processed by one thread.
+	 */
+	template<typename Function>
+	void ParallelForEachChunk(JobSystem* jobSystem, const char* name, Function&& function);
+
+	[[nodiscard]] uint32_t GetEntityCount();
+	[[nodiscard]] uint32_t GetChunkCount();
+
+private:
+
+	static constexpr uint32_t kMinChunkBatchSize = 8;
+
+	struct MatchedArchetype
+	{
+		const ArchetypeStore::Archetype* archetype;
+		std::array<uint32_t, sizeof...(Components)> columnOffsets;
+	};
+
+	struct ChunkRef
+	{
+		uint32_t matched;
+		uint32_t chunk;
+	};
+
+	void Refresh();
+
+	template<typename Function, size_t... Indices>
+	void Invoke(Function& function, const MatchedArchetype& matched, uint32_t chunk, std::index_sequence<Indices...>) const;
+
+	ArchetypeStore* m_store;
+	ComponentMask m_include;
+	ComponentMask m_exclude;
+
+	std::vector<MatchedArchetype> m_matched;
+	uint32_t m_checkedArchetypeCount = 0;
+
+	// Chunk list for the parallel loop, kept around to avoid reallocating every frame.
+	std::vector<ChunkRef> m_chunks;
+};
+
+template<typename T>
+ComponentTypeID ComponentTypes::Get() {
+	return ComponentTypes::GetUnqualified<std::remove_cv_t<T>>();
+}
+
+template<typename T>
+ComponentTypeID ComponentTypes::GetUnqualified() {
+
+	static_assert(std::is_trivially_copyable_v<T>, "Components are moved with memcpy");
+
+	static const ComponentTypeID type = ComponentTypes::Register(sizeof(T), alignof(T));
+	return type;
+}
+
+template<typename... Components>
+ComponentMask ComponentTypes::MaskOf() {
+	return (ComponentMask{ 0 } | ... | (ComponentMask{ 1 } << ComponentTypes::Get<Components>()));
+}
+
+template<typename... Components>
+Entity ArchetypeStore::Create(const Components&... components) {
+
+	const uint32_t archetype = this->FindOrCreateArchetype(ComponentTypes::MaskOf<Components...>());
+	const Entity entity = this->Allocate(archetype);
+
+	(std::memcpy(this->GetComponent(entity, ComponentTypes::Get<Components>()), &components, sizeof(Components)), ...);
+	return entity;
+}
+
+template<typename T>
+T* ArchetypeStore::Get(Entity entity) const {
+
+	if (!this->IsAlive(entity)) {
+		return nullptr;
+	}
+	return reinterpret_cast<T*>(this->GetComponent(entity, ComponentTypes::Get<T>()));
+}
+
+template<typename T>
+bool ArchetypeStore::Has(Entity entity) const {
+	return this->Get<T>(entity) != nullptr;
+}
+
+template<typename T>
+void ArchetypeStore::Add(Entity entity, const T& component) {
+
+	if (!this->IsAlive(entity)) {
+		throw std::runtime_error("[ArchetypeStore] Trying to add a component to an entity that is not alive");
+	}
+
+	const ComponentMask mask = m_archetypes[m_records[entity.index].archetype]->GetMask() | ComponentTypes::MaskOf<T>();
+	this->Move(entity, this->FindOrCreateArchetype(mask));
+
+	std::memcpy(this->GetComponent(entity, ComponentTypes::Get<T>()), &component, sizeof(T));
+}
+
+template<typename T>
+void ArchetypeStore::Remove(Entity entity) {
+
+	if (!this->IsAlive(entity)) {
+		throw std::runtime_error("[ArchetypeStore] Trying to remove a component from an entity that is not alive");
+	}
+
+	const ComponentMask mask = m_archetypes[m_records[entity.index].archetype]->GetMask() & ~ComponentTypes::MaskOf<T>();
+	this->Move(entity, this->FindOrCreateArchetype(mask));
+}
+
+template<typename... Components>
+ArchetypeQuery<Components...>::ArchetypeQuery(ArchetypeStore* store, ComponentMask exclude) {
+
+	m_store = store;
+	m_include = ComponentTypes::MaskOf<Components...>();
+	m_exclude = exclude;
+}
+
+template<typename... Components>
+template<typename Function>
+void ArchetypeQuery<Components...>::ForEachChunk(Function&& function) {
+
+	this->Refresh();
+
+	for (const MatchedArchetype& matched : m_matched) {
+
+		const uint32_t chunkCount = matched.archetype->GetChunkCount();
+		for (uint32_t chunk = 0; chunk < chunkCount; chunk++) {
+			this->Invoke(function, matched, chunk, std::index_sequence_for<Components...>{});
+		}
+	}
+}
+
+template<typename... Components>
+template<typename Function>
+void ArchetypeQuery<Components...>::ParallelForEachChunk(JobSystem* jobSystem, const char* name, Function&& function) {
+
+	this->Refresh();
+
+	m_chunks.clear();
+	for (uint32_t ind = 0; ind < m_matched.size(); ind++) {
+
+		const uint32_t chunkCount = m_matched[ind].archetype->GetChunkCount();
+		for (uint32_t chunk = 0; chunk < chunkCount; chunk++) {
+			m_chunks.push_back(ChunkRef{ ind, chunk });
+		}
+	}
+
+	jobSystem->ParallelFor(name, static_cast<uint32_t>(m_chunks.size()), kMinChunkBatchSize, [this, &function](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t ind = begin; ind < end; ind++) {
+
+			const ChunkRef& ref = m_chunks[ind];
+			this->Invoke(function, m_matched[ref.matched], ref.chunk, std::index_sequence_for<Components...>{});
+		}
+	});
+}
+
+template<typename... Components>
+uint32_t ArchetypeQuery<Components...>::GetEntityCount() {
+
+	this->Refresh();
+
+	uint32_t count = 0;
+	for (const MatchedArchetype& matched : m_matched) {
+		count += matched.archetype->GetEntityCount();
+	}
+	return count;
+}
+
+template<typename... Components>
+uint32_t ArchetypeQuery<Components...>::GetChunkCount() {
+
+	this->Refresh();
+
+	uint32_t count = 0;
+	for (const MatchedArchetype& matched : m_matched) {
+		count += matched.archetype->GetChunkCount();
+	}
+	return count;
+}
+
+template<typename... Components>
+void ArchetypeQuery<Components...>::Refresh() {
+
+	const uint32_t archetypeCount = m_store->GetArchetypeCount();
+	for (; m_checkedArchetypeCount < archetypeCount; m_checkedArchetypeCount++) {
+
+		const ArchetypeStore::Archetype& archetype = m_store->GetArchetype(m_checkedArchetypeCount);
+		if ((archetype.GetMask() & m_include) != m_include || (archetype.GetMask() & m_exclude) != 0) {
+			continue;
+		}
+
+		m_matched.push_back(MatchedArchetype{
+			.archetype = &archetype,
+			.columnOffsets = { archetype.GetColumnOffset(ComponentTypes::Get<Components>())... }
+		});
+	}
+}
+
+template<typename... Components>
+template<typename Function, size_t... Indices>
+void ArchetypeQuery<Components...>::Invoke(Function& function, const MatchedArchetype& matched, uint32_t chunk, std::index_sequence<Indices...>) const {
+
+	std::byte* data = matched.archetype->GetChunkData(chunk);
+	function(matched.archetype->GetEntities(chunk), matched.archetype->GetChunkEntityCount(chunk), reinterpret_cast<Components*>(data + matched.columnOffsets[Indices])...);
+}
\ No newline at end of file
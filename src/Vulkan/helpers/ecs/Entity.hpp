@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * Generational entity handle.
+ * The index addresses a slot in the registry, the generation is bumped every time the slot is reused,
+ * so a handle to a despawned entity never resolves to the entity that took its place.
+ */
+struct Entity
+{
+	static constexpr uint32_t kInvalidIndex = UINT32_MAX;
+
+	uint32_t index = kInvalidIndex;
+	uint32_t generation = 0;
+
+	[[nodiscard]] bool IsValid() const { return index != kInvalidIndex; }
+
+	bool operator==(const Entity& other) const = default;
+};
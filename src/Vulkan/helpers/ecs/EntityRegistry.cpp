@@ -0,0 +1,100 @@
+#include "EntityRegistry.hpp"
+
+#include <stdexcept>
+
+EntityRegistry::EntityRegistry(uint32_t capacity) {
+    this->Reserve(capacity);
+}
+
+Entity EntityRegistry::Spawn() {
+
+    uint32_t index;
+    if (!m_freeIndices.empty()) {
+        index = m_freeIndices.back();
+        m_freeIndices.pop_back();
+    }
+    else {
+        index = static_cast<uint32_t>(m_sparse.size());
+        m_sparse.push_back(kInvalidDenseIndex);
+        m_generations.push_back(0);
+    }
+
+    const Entity entity = {
+        .index = index,
+        .generation = m_generations[index]
+    };
+
+    m_sparse[index] = static_cast<uint32_t>(m_dense.size());
+    m_dense.push_back(entity);
+
+    return entity;
+}
+
+EntityRegistry::DespawnResult EntityRegistry::Despawn(Entity entity) {
+
+    if (!this->IsAlive(entity)) {
+        throw std::runtime_error("[EntityRegistry] Trying to despawn an entity that is not alive");
+    }
+
+    const uint32_t denseIndex = m_sparse[entity.index];
+    const uint32_t lastIndex = static_cast<uint32_t>(m_dense.size() - 1);
+
+    const Entity movedEntity = m_dense[lastIndex];
+    m_dense[denseIndex] = movedEntity;
+    m_sparse[movedEntity.index] = denseIndex;
+    m_dense.pop_back();
+
+    m_sparse[entity.index] = kInvalidDenseIndex;
+    m_generations[entity.index] += 1;
+    m_freeIndices.push_back(entity.index);
+
+    return DespawnResult{
+        .denseIndex = denseIndex,
+        .movedFromIndex = lastIndex
+    };
+}
+
+void EntityRegistry::Reserve(uint32_t capacity) {
+
+    m_dense.reserve(capacity);
+    m_sparse.reserve(capacity);
+    m_generations.reserve(capacity);
+}
+
+void EntityRegistry::Clear() {
+
+    // Bumping the generations keeps handles from before the clear invalid.
+    for (const Entity& entity : m_dense) {
+        m_sparse[entity.index] = kInvalidDenseIndex;
+        m_generations[entity.index] += 1;
+        m_freeIndices.push_back(entity.index);
+    }
+    m_dense.clear();
+}
+
+bool EntityRegistry::IsAlive(Entity entity) const {
+
+    return entity.index < m_sparse.size()
+        && m_sparse[entity.index] != kInvalidDenseIndex
+        && m_generations[entity.index] == entity.generation;
+}
+
+uint32_t EntityRegistry::GetDenseIndex(Entity entity) const {
+
+    if (!this->IsAlive(entity)) {
+        return kInvalidDenseIndex;
+    }
+    return m_sparse[entity.index];
+}
+
+Entity EntityRegistry::GetEntity(uint32_t denseIndex) const {
+    return m_dense[denseIndex];
+}
+
+uint32_t EntityRegistry::Size() const {
+    return static_cast<uint32_t>(m_dense.size());
+}
+
+const std::vector<Entity>& EntityRegistry::GetEntities() const {
+    return m_dense;
+}
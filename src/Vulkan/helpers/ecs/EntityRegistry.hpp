@@ -0,0 +1,67 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "Entity.hpp"
+
+/**
+ * Sparse set of generational entities.
+ *
+ * Alive entities are kept in a dense array, so component columns that follow the same order stay contiguous.
+ * Despawning swaps the last dense entity into the freed slot. The caller must mirror that swap in its columns,
+ * see DespawnResult.
+ */
+class EntityRegistry
+{
+public:
+
+	static constexpr uint32_t kInvalidDenseIndex = UINT32_MAX;
+
+	explicit EntityRegistry(uint32_t capacity = 0);
+
+	/**
+	 * Appends the entity to the end of the dense array.
+	 * The returned entity's dense index is always Size() - 1 after the call.
+	 */
+	Entity Spawn();
+
+	struct DespawnResult
+	{
+		/**
+		 * Dense slot that became free. The last dense element was moved here.
+		 */
+		uint32_t denseIndex;
+
+		/**
+		 * Dense slot the moved element came from. Equals denseIndex when the despawned entity was the last one.
+		 */
+		uint32_t movedFromIndex;
+	};
+
+	/**
+	 * O(1) swap-remove. Apply the same swap-remove to every column that follows the dense order.
+	 */
+	DespawnResult Despawn(Entity entity);
+
+	void Reserve(uint32_t capacity);
+	void Clear();
+
+	[[nodiscard]] bool IsAlive(Entity entity) const;
+	[[nodiscard]] uint32_t GetDenseIndex(Entity entity) const;
+	[[nodiscard]] Entity GetEntity(uint32_t denseIndex) const;
+
+	[[nodiscard]] uint32_t Size() const;
+	[[nodiscard]] const std::vector<Entity>& GetEntities() const;
+
+private:
+
+	std::vector<Entity> m_dense;
+
+	/**
+	 * Indexed by Entity::index. Holds kInvalidDenseIndex for free slots.
+	 */
+	std::vector<uint32_t> m_sparse;
+	std::vector<uint32_t> m_generations;
+	std::vector<uint32_t> m_freeIndices;
+};
@@ -0,0 +1,331 @@
+#include "TransformHierarchy.hpp"
+
+#include <cmath>
+#include <tracy/Tracy.hpp>
+
+#include "../jobs/JobSystem.hpp"
+#include "../../pch.hpp"
+
+namespace {
+
+    TransformHierarchy::Transform Combine(const TransformHierarchy::Transform& parent, const TransformHierarchy::Transform& local) {
+
+        const glm::vec2 q = parent.rotationScale;
+
+        TransformHierarchy::Transform world;
+        world.translate = glm::vec4(
+            parent.translate.x + q.x * local.translate.x - q.y * local.translate.y,
+            parent.translate.y + q.y * local.translate.x + q.x * local.translate.y,
+            parent.translate.z + local.translate.z,
+            parent.translate.w + local.translate.w
+        );
+        world.rotationScale = glm::vec2(
+            q.x * local.rotationScale.x - q.y * local.rotationScale.y,
+            q.x * local.rotationScale.y + q.y * local.rotationScale.x
+        );
+        return world;
+    }
+}
+
+TransformHierarchy::Transform TransformHierarchy::MakeTransform(const glm::vec4& translate, float rotation, float scale) {
+
+    return Transform{
+        .translate = translate,
+        .rotationScale = glm::vec2(scale * std::cos(rotation), scale * std::sin(rotation))
+    };
+}
+
+TransformHierarchy::TransformHierarchy(JobSystem* jobSystem) {
+
+    m_jobSystem = jobSystem;
+    this->Clear();
+}
+
+TransformHierarchy::NodeID TransformHierarchy::AddNode(NodeID parent, const Transform& local) {
+
+    const NodeID node = this->GetNodeCount();
+    if (parent != kNoParent && parent >= node) {
+        throw std::runtime_error(std::format("[TransformHierarchy] Parent {} does not exist", parent));
+    }
+    if (node == kNoParent) {
+        throw std::runtime_error("[TransformHierarchy] Out of node IDs");
+    }
+
+    // Slot == node until the next sort. Sorted slots never go past the old node count, so the slot is free.
+    m_nodeParents.push_back(parent);
+    m_nodeSlots.push_back(node);
+
+    m_locals.push_back(local);
+    m_worlds.push_back(local);
+    m_parentSlots.push_back(kNoParent);
+
+    m_layoutChanged = true;
+    return node;
+}
+
+void TransformHierarchy::Reserve(uint32_t nodeCount) {
+
+    m_nodeParents.reserve(nodeCount);
+    m_nodeSlots.reserve(nodeCount);
+    m_locals.reserve(nodeCount);
+    m_worlds.reserve(nodeCount);
+    m_parentSlots.reserve(nodeCount);
+    m_childBegin.reserve(static_cast<size_t>(nodeCount) + 1);
+}
+
+void TransformHierarchy::Clear() {
+
+    m_nodeParents.clear();
+    m_nodeSlots.clear();
+    m_locals.clear();
+    m_worlds.clear();
+    m_parentSlots.clear();
+    m_childBegin.assign(1, 0);
+    m_levelStart.assign(1, 0);
+
+    m_layoutChanged = false;
+    m_dirtySlots.clear();
+}
+
+void TransformHierarchy::SetLocal(NodeID node, const Transform& local) {
+
+    const uint32_t slot = m_nodeSlots[node];
+    m_locals[slot] = local;
+
+    if (!m_layoutChanged) {
+        m_dirtySlots.push_back(slot);
+    }
+}
+
+const TransformHierarchy::Transform& TransformHierarchy::GetLocal(NodeID node) const {
+    return m_locals[m_nodeSlots[node]];
+}
+
+const TransformHierarchy::Transform& TransformHierarchy::GetWorld(NodeID node) const {
+    return m_worlds[m_nodeSlots[node]];
+}
+
+void TransformHierarchy::Propagate() {
+
+    ZoneScoped;
+
+    if (m_layoutChanged) {
+        this->PropagateAll();
+        return;
+    }
+
+    m_lastUpdateCount = 0;
+    if (m_dirtySlots.empty()) {
+        return;
+    }
+
+    // Slots are in level order, so the dirty slots of a level are one run of this array.
+    std::sort(m_dirtySlots.begin(), m_dirtySlots.end());
+    size_t dirtyIndex = 0;
+
+    m_childRanges.clear();
+    for (uint32_t level = 0; level + 1 < m_levelStart.size(); level++) {
+
+        const uint32_t levelEnd = m_levelStart[level + 1];
+
+        // Subtrees continued from the level above, plus the nodes changed directly on this level.
+        m_levelRanges.swap(m_childRanges);
+        for (; dirtyIndex < m_dirtySlots.size() && m_dirtySlots[dirtyIndex] < levelEnd; dirtyIndex++) {
+            m_levelRanges.push_back(Range{ m_dirtySlots[dirtyIndex], m_dirtySlots[dirtyIndex] + 1 });
+        }
+
+        if (m_levelRanges.empty()) {
+            if (dirtyIndex == m_dirtySlots.size()) {
+                break;
+            }
+            continue;
+        }
+
+        TransformHierarchy::Coalesce(m_levelRanges);
+        this->UpdateRanges(m_levelRanges);
+
+        m_childRanges.clear();
+        for (const Range& range : m_levelRanges) {
+
+            const Range children = { m_childBegin[range.begin], m_childBegin[range.end] };
+            if (children.begin != children.end) {
+                m_childRanges.push_back(children);
+            }
+        }
+        m_levelRanges.clear();
+    }
+
+    m_dirtySlots.clear();
+}
+
+void TransformHierarchy::PropagateAll() {
+
+    ZoneScoped;
+
+    if (m_layoutChanged) {
+        this->Sort();
+    }
+
+    m_lastUpdateCount = 0;
+    for (uint32_t level = 0; level + 1 < m_levelStart.size(); level++) {
+
+        m_levelRanges.assign(1, Range{ m_levelStart[level], m_levelStart[level + 1] });
+        this->UpdateRanges(m_levelRanges);
+    }
+
+    m_levelRanges.clear();
+    m_dirtySlots.clear();
+}
+
+uint32_t TransformHierarchy::GetNodeCount() const {
+    return static_cast<uint32_t>(m_nodeParents.size());
+}
+
+uint32_t TransformHierarchy::GetLevelCount() const {
+    return static_cast<uint32_t>(m_levelStart.size() - 1);
+}
+
+uint32_t TransformHierarchy::GetLastUpdateCount() const {
+    return m_lastUpdateCount;
+}
+
+void TransformHierarchy::Sort() {
+
+    ZoneScoped;
+
+    const uint32_t nodeCount = this->GetNodeCount();
+
+    // Children of every node in ID order, as a counting sort by parent.
+    std::vector<uint32_t> childOffsets(static_cast<size_t>(nodeCount) + 1, 0);
+    for (const NodeID parent : m_nodeParents) {
+        if (parent != kNoParent) {
+            childOffsets[parent + 1] += 1;
+        }
+    }
+    for (uint32_t node = 0; node < nodeCount; node++) {
+        childOffsets[node + 1] += childOffsets[node];
+    }
+
+    std::vector<NodeID> children(childOffsets[nodeCount]);
+    {
+        std::vector<uint32_t> cursors(childOffsets.begin(), childOffsets.end() - 1);
+        for (NodeID node = 0; node < nodeCount; node++) {
+            if (m_nodeParents[node] != kNoParent) {
+                children[cursors[m_nodeParents[node]]++] = node;
+            }
+        }
+    }
+
+    // Breadth first, which puts every level and every group of siblings into a contiguous range.
+    std::vector<NodeID> order;
+    order.reserve(nodeCount);
+    for (NodeID node = 0; node < nodeCount; node++) {
+        if (m_nodeParents[node] == kNoParent) {
+            order.push_back(node);
+        }
+    }
+
+    m_childBegin.resize(static_cast<size_t>(nodeCount) + 1);
+    m_levelStart.assign(1, 0);
+
+    uint32_t levelBegin = 0;
+    while (levelBegin < order.size()) {
+
+        const uint32_t levelEnd = static_cast<uint32_t>(order.size());
+        m_levelStart.push_back(levelEnd);
+
+        for (uint32_t slot = levelBegin; slot < levelEnd; slot++) {
+
+            const NodeID node = order[slot];
+            m_childBegin[slot] = static_cast<uint32_t>(order.size());
+            order.insert(order.end(), children.begin() + childOffsets[node], children.begin() + childOffsets[node + 1]);
+        }
+
+        levelBegin = levelEnd;
+    }
+    m_childBegin[nodeCount] = nodeCount;
+
+    // Move the per-slot arrays into the new order.
+    std::vector<Transform> locals(nodeCount);
+    for (uint32_t slot = 0; slot < nodeCount; slot++) {
+        locals[slot] = m_locals[m_nodeSlots[order[slot]]];
+    }
+    m_locals.swap(locals);
+
+    for (uint32_t slot = 0; slot < nodeCount; slot++) {
+        m_nodeSlots[order[slot]] = slot;
+    }
+
+    for (uint32_t slot = 0; slot < nodeCount; slot++) {
+
+        const NodeID parent = m_nodeParents[order[slot]];
+        m_parentSlots[slot] = parent == kNoParent ? kNoParent : m_nodeSlots[parent];
+    }
+
+    m_layoutChanged = false;
+
+    spdlog::info("[TransformHierarchy] Sorted {} nodes into {} levels", nodeCount, this->GetLevelCount());
+}
+
+void TransformHierarchy::UpdateRanges(const std::vector<Range>& ranges) {
+
+    Transform* __restrict worldsPtr = m_worlds.data();
+    const Transform* __restrict localsPtr = m_locals.data();
+    const uint32_t* __restrict parentSlotsPtr = m_parentSlots.data();
+
+    const auto updateRange = [=](Range range)
+    {
+        for (uint32_t slot = range.begin; slot < range.end; slot++) {
+
+            const uint32_t parentSlot = parentSlotsPtr[slot];
+            worldsPtr[slot] = parentSlot == kNoParent ? localsPtr[slot] : Combine(worldsPtr[parentSlot], localsPtr[slot]);
+        }
+    };
+
+    // Equal sized batches, so the parallel loop hands every thread the same amount of work.
+    m_batches.clear();
+    uint32_t updateCount = 0;
+    for (const Range& range : ranges) {
+
+        updateCount += range.end - range.begin;
+        for (uint32_t begin = range.begin; begin < range.end; begin += kMinBatchSize) {
+            m_batches.push_back(Range{ begin, std::min(range.end, begin + kMinBatchSize) });
+        }
+    }
+    m_lastUpdateCount += updateCount;
+
+    if (m_batches.size() <= 1) {
+        for (const Range& batch : m_batches) {
+            updateRange(batch);
+        }
+        return;
+    }
+
+    const Range* batchesPtr = m_batches.data();
+    m_jobSystem->ParallelFor("Transform hierarchy batch", static_cast<uint32_t>(m_batches.size()), 1, [=](uint32_t begin, uint32_t end)
+    {
+        for (uint32_t ind = begin; ind < end; ind++) {
+            updateRange(batchesPtr[ind]);
+        }
+    });
+}
+
+void TransformHierarchy::Coalesce(std::vector<Range>& ranges) {
+
+    std::sort(ranges.begin(), ranges.end(), [](const Range& a, const Range& b) { return a.begin < b.begin; });
+
+    size_t last = 0;
+    for (size_t ind = 1; ind < ranges.size(); ind++) {
+
+        if (ranges[ind].begin <= ranges[last].end) {
+            ranges[last].end = std::max(ranges[last].end, ranges[ind].end);
+        }
+        else {
+            ranges[++last] = ranges[ind];
+        }
+    }
+
+    if (!ranges.empty()) {
+        ranges.resize(last + 1);
+    }
+}
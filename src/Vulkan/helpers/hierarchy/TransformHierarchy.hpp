@@ -0,0 +1,130 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
+
+class JobSystem;
+
+/**
+ * Parent/child transforms, for objects made of several parts (attachments, formations).
+ *
+ * Nodes are stored breadth first: level by level, with the children of a node next to each other and in the
+ * same order as their parents. A level is therefore one contiguous range that only reads the level before it,
+ * and the descendants of a contiguous range are again one contiguous range on every level below.
+ *
+ * Propagation walks the levels with a parallel loop per level. After SetLocal only the dirty subtrees are
+ * recomputed, as one set of ranges per level.
+ */
+class TransformHierarchy
+{
+public:
+
+	using NodeID = uint32_t;
+	static constexpr NodeID kNoParent = UINT32_MAX;
+
+	/**
+	 * 2D similarity transform. Rotation and uniform scale are stored as the complex number scale * (cos, sin),
+	 * so combining two transforms needs no trigonometry. z and w of the translation are simply added.
+	 */
+	struct Transform
+	{
+		glm::vec4 translate;
+		glm::vec2 rotationScale;
+	};
+
+	static Transform MakeTransform(const glm::vec4& translate, float rotation = 0.0f, float scale = 1.0f);
+
+	explicit TransformHierarchy(JobSystem* jobSystem);
+
+	/**
+	 * The parent must already exist, so there can be no cycles. IDs are handed out in order, starting at 0.
+	 * Changes the layout, the next Propagate sorts the nodes again and recomputes all of them.
+	 */
+	NodeID AddNode(NodeID parent, const Transform& local);
+
+	void Reserve(uint32_t nodeCount);
+	void Clear();
+
+	void SetLocal(NodeID node, const Transform& local);
+	[[nodiscard]] const Transform& GetLocal(NodeID node) const;
+
+	/**
+	 * Valid after the next Propagate.
+	 */
+	[[nodiscard]] const Transform& GetWorld(NodeID node) const;
+
+	/**
+	 * Recomputes the world transforms of the nodes changed since the last call and of everything below them.
+	 */
+	void Propagate();
+
+	/**
+	 * Recomputes every world transform.
+	 */
+	void PropagateAll();
+
+	[[nodiscard]] uint32_t GetNodeCount() const;
+	[[nodiscard]] uint32_t GetLevelCount() const;
+
+	/**
+	 * Number of world transforms the last Propagate / PropagateAll computed.
+	 */
+	[[nodiscard]] uint32_t GetLastUpdateCount() const;
+
+private:
+
+	struct Range
+	{
+		uint32_t begin;
+		uint32_t end;
+	};
+
+	static constexpr uint32_t kMinBatchSize = 16384;
+
+	/**
+	 * Puts the nodes in breadth first order and rebuilds the per-slot arrays.
+	 */
+	void Sort();
+
+	/**
+	 * Computes the world transforms of the slots in the ranges. The ranges must be on a single level.
+	 */
+	void UpdateRanges(const std::vector<Range>& ranges);
+
+	/**
+	 * Sorts the ranges and merges the ones that overlap or touch.
+	 */
+	static void Coalesce(std::vector<Range>& ranges);
+
+	JobSystem* m_jobSystem;
+
+	// Indexed by node ID.
+	std::vector<NodeID> m_nodeParents;
+	std::vector<uint32_t> m_nodeSlots;
+
+	// Indexed by slot, in breadth first order once sorted.
+	std::vector<Transform> m_locals;
+	std::vector<Transform> m_worlds;
+	std::vector<uint32_t> m_parentSlots;
+
+	/**
+	 * slotCount + 1 entries. The children of slot s are [m_childBegin[s], m_childBegin[s + 1]).
+	 */
+	std::vector<uint32_t> m_childBegin;
+
+	/**
+	 * levelCount + 1 entries. Level d is [m_levelStart[d], m_levelStart[d + 1]).
+	 */
+	std::vector<uint32_t> m_levelStart;
+
+	bool m_layoutChanged = false;
+	std::vector<uint32_t> m_dirtySlots;
+	uint32_t m_lastUpdateCount = 0;
+
+	// Propagation scratch, kept around to avoid reallocating every frame.
+	std::vector<Range> m_levelRanges;
+	std::vector<Range> m_childRanges;
+	std::vector<Range> m_batches;
+};
\ No newline at end of file
@@ -0,0 +1,91 @@
+#include "MappedFile.hpp"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include <stdexcept>
+
+MappedFile::MappedFile(const std::string& path) {
+
+#ifdef _WIN32
+    m_fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (m_fileHandle == INVALID_HANDLE_VALUE) {
+        m_fileHandle = nullptr;
+        throw std::runtime_error("[MappedFile] Could not open " + path);
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(m_fileHandle, &fileSize) || fileSize.QuadPart == 0) {
+        CloseHandle(m_fileHandle);
+        throw std::runtime_error("[MappedFile] Could not map empty file " + path);
+    }
+    m_size = static_cast<size_t>(fileSize.QuadPart);
+
+    m_mappingHandle = CreateFileMappingA(m_fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (m_mappingHandle == nullptr) {
+        CloseHandle(m_fileHandle);
+        throw std::runtime_error("[MappedFile] Could not create a file mapping for " + path);
+    }
+
+    m_data = static_cast<const std::byte*>(MapViewOfFile(m_mappingHandle, FILE_MAP_READ, 0, 0, 0));
+    if (m_data == nullptr) {
+        CloseHandle(m_mappingHandle);
+        CloseHandle(m_fileHandle);
+        throw std::runtime_error("[MappedFile] Could not map " + path);
+    }
+#else
+    const int file = open(path.c_str(), O_RDONLY);
+    if (file == -1) {
+        throw std::runtime_error("[MappedFile] Could not open " + path);
+    }
+
+    struct stat fileStat{};
+    if (fstat(file, &fileStat) != 0 || fileStat.st_size == 0) {
+        close(file);
+        throw std::runtime_error("[MappedFile] Could not map empty file " + path);
+    }
+    m_size = static_cast<size_t>(fileStat.st_size);
+
+    void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, file, 0);
+
+    // The mapping keeps its own reference to the file.
+    close(file);
+
+    if (data == MAP_FAILED) {
+        throw std::runtime_error("[MappedFile] Could not map " + path);
+    }
+
+    // Columns are read front to back, so aggressive read-ahead pays off.
+    madvise(data, m_size, MADV_SEQUENTIAL);
+    m_data = static_cast<const std::byte*>(data);
+#endif
+}
+
+MappedFile::~MappedFile() {
+
+#ifdef _WIN32
+    UnmapViewOfFile(m_data);
+    CloseHandle(m_mappingHandle);
+    CloseHandle(m_fileHandle);
+#else
+    munmap(const_cast<std::byte*>(m_data), m_size);
+#endif
+}
+
+const std::byte* MappedFile::GetData() const {
+    return m_data;
+}
+
+size_t MappedFile::GetSize() const {
+    return m_size;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * Read-only memory mapping of a whole file. The pages are loaded by the OS on first access.
+ */
+class MappedFile
+{
+public:
+
+	explicit MappedFile(const std::string& path);
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	[[nodiscard]] const std::byte* GetData() const;
+	[[nodiscard]] size_t GetSize() const;
+
+private:
+
+	const std::byte* m_data{};
+	size_t m_size{};
+
+#ifdef _WIN32
+	void* m_fileHandle{};
+	void* m_mappingHandle{};
+#endif
+};
\ No newline at end of file
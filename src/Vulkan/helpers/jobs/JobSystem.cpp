@@ -0,0 +1,279 @@
+#include "JobSystem.hpp"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <tracy/Tracy.hpp>
+
+#include "../../pch.hpp"
+
+namespace {
+    constexpr uint32_t kNotAWorker = UINT32_MAX;
+
+    /**
+     * Index of the queue owned by the current thread.
+     */
+    thread_local uint32_t t_workerIndex = kNotAWorker;
+}
+
+JobSystem::JobSystem(const JobSystem::Config& config) {
+
+    uint32_t workerCount = config.workerCount;
+    if (workerCount == 0) {
+        workerCount = std::max(1u, std::thread::hardware_concurrency()) - 1;
+    }
+
+    m_queues.reserve(workerCount);
+    for (uint32_t ind = 0; ind < workerCount; ind++) {
+        m_queues.push_back(std::make_unique<WorkerQueue>());
+    }
+
+    m_workers.reserve(workerCount);
+    for (uint32_t ind = 0; ind < workerCount; ind++) {
+        m_workers.emplace_back(&JobSystem::WorkerLoop, this, ind);
+
+        if (config.pinThreads) {
+            JobSystem::PinThread(m_workers.back(), ind + 1);
+        }
+    }
+
+    spdlog::info("[JobSystem] Started {} workers{}", workerCount, config.pinThreads ? " pinned to cores" : "");
+}
+
+JobSystem::~JobSystem() {
+
+    {
+        std::lock_guard lock(m_sleepMutex);
+        m_stop = true;
+    }
+    m_wakeCondition.notify_all();
+
+    for (auto& worker : m_workers) {
+        worker.join();
+    }
+}
+
+void JobSystem::Submit(const char* name, std::function<void()> function, JobSystem::Counter* counter) {
+
+    if (counter != nullptr) {
+        counter->m_pending.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    Job job = {
+        .name = name,
+        .function = std::move(function),
+        .counter = counter
+    };
+
+    // No workers. Run inline, so the callers do not have to care.
+    if (m_queues.empty()) {
+        this->Execute(job);
+        return;
+    }
+
+    const uint32_t queueIndex = t_workerIndex != kNotAWorker
+        ? t_workerIndex
+        : m_nextQueue.fetch_add(1, std::memory_order_relaxed) % static_cast<uint32_t>(m_queues.size());
+
+    this->Push(queueIndex, std::move(job));
+    this->WakeWorkers(false);
+}
+
+void JobSystem::Wait(const JobSystem::Counter& counter) {
+
+    while (!counter.IsDone()) {
+        if (!this->RunPendingJob()) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+bool JobSystem::RunPendingJob() {
+
+    Job job;
+    const bool found = t_workerIndex != kNotAWorker
+        ? this->PopJob(t_workerIndex, job) || this->StealJob(t_workerIndex, job)
+        : this->StealJob(m_nextQueue.load(std::memory_order_relaxed), job);
+
+    if (!found) {
+        return false;
+    }
+
+    m_queuedJobCount.fetch_sub(1, std::memory_order_relaxed);
+    this->Execute(job);
+    return true;
+}
+
+void JobSystem::ParallelFor(const char* name, uint32_t count, uint32_t minBatchSize, const std::function<void(uint32_t begin, uint32_t end)>& function) {
+
+    if (count == 0) {
+        return;
+    }
+
+    minBatchSize = std::max(1u, minBatchSize);
+    const uint32_t batchCount = std::min(this->GetThreadCount(), (count + minBatchSize - 1) / minBatchSize);
+    const uint32_t batchSize = (count + batchCount - 1) / batchCount;
+
+    Counter counter;
+    for (uint32_t batch = 1; batch < batchCount; batch++) {
+
+        const uint32_t begin = batch * batchSize;
+        const uint32_t end = std::min(count, begin + batchSize);
+        if (begin >= end) {
+            break;
+        }
+
+        counter.m_pending.fetch_add(1, std::memory_order_relaxed);
+        this->Push((batch - 1) % static_cast<uint32_t>(m_queues.size()), Job{
+            .name = name,
+            .function = [&function, begin, end] { function(begin, end); },
+            .counter = &counter
+        });
+    }
+
+    // Every worker has its own range now, so all of them are woken instead of letting one steal the rest.
+    if (batchCount > 1) {
+        this->WakeWorkers(true);
+    }
+
+    {
+        ZoneScopedN("Job");
+        ZoneName(name, std::strlen(name));
+        function(0, std::min(count, batchSize));
+    }
+
+    this->Wait(counter);
+}
+
+uint32_t JobSystem::GetThreadCount() const {
+    return static_cast<uint32_t>(m_workers.size()) + 1;
+}
+
+void JobSystem::Push(uint32_t queueIndex, Job&& job) {
+
+    {
+        std::lock_guard lock(m_queues[queueIndex]->mutex);
+        m_queues[queueIndex]->jobs.push_back(std::move(job));
+    }
+    m_queuedJobCount.fetch_add(1, std::memory_order_release);
+}
+
+void JobSystem::WakeWorkers(bool all) {
+
+    // Taking the lock guarantees that a worker is either already waiting or will see the new job count.
+    {
+        std::lock_guard lock(m_sleepMutex);
+    }
+
+    if (all) {
+        m_wakeCondition.notify_all();
+    }
+    else {
+        m_wakeCondition.notify_one();
+    }
+}
+
+void JobSystem::WorkerLoop(uint32_t workerIndex) {
+
+    t_workerIndex = workerIndex;
+
+    const std::string threadName = "Worker " + std::to_string(workerIndex);
+    tracy::SetThreadName(threadName.c_str());
+
+    while (true) {
+
+        if (this->RunPendingJob()) {
+            continue;
+        }
+
+        std::unique_lock lock(m_sleepMutex);
+        m_wakeCondition.wait(lock, [this]
+        {
+            return m_stop || m_queuedJobCount.load(std::memory_order_acquire) > 0;
+        });
+
+        if (m_stop && m_queuedJobCount.load(std::memory_order_acquire) == 0) {
+            return;
+        }
+    }
+}
+
+void JobSystem::Execute(Job& job) {
+
+    {
+        ZoneScopedN("Job");
+        ZoneName(job.name, std::strlen(job.name));
+        job.function();
+    }
+
+    if (job.counter != nullptr) {
+        job.counter->m_pending.fetch_sub(1, std::memory_order_release);
+    }
+}
+
+bool JobSystem::PopJob(uint32_t queueIndex, Job& job) {
+
+    WorkerQueue& queue = *m_queues[queueIndex];
+
+    std::lock_guard lock(queue.mutex);
+    if (queue.jobs.empty()) {
+        return false;
+    }
+
+    // LIFO for the owner keeps recently submitted, cache-hot work local.
+    job = std::move(queue.jobs.back());
+    queue.jobs.pop_back();
+    return true;
+}
+
+bool JobSystem::StealJob(uint32_t thiefIndex, Job& job) {
+
+    const uint32_t queueCount = static_cast<uint32_t>(m_queues.size());
+
+    for (uint32_t offset = 1; offset <= queueCount; offset++) {
+
+        WorkerQueue& queue = *m_queues[(thiefIndex + offset) % queueCount];
+
+        std::lock_guard lock(queue.mutex);
+        if (queue.jobs.empty()) {
+            continue;
+        }
+
+        // FIFO for thieves takes the oldest, usually the largest, piece of work.
+        job = std::move(queue.jobs.front());
+        queue.jobs.pop_front();
+        return true;
+    }
+
+    return false;
+}
+
+void JobSystem::PinThread(std::thread& thread, uint32_t core) {
+
+    const uint32_t coreCount = std::max(1u, std::thread::hardware_concurrency());
+    core %= coreCount;
+
+#ifdef _WIN32
+    if (SetThreadAffinityMask(thread.native_handle(), static_cast<DWORD_PTR>(1) << core) == 0) {
+        spdlog::warn("[JobSystem] Could not pin a worker to core {}", core);
+    }
+#elif defined(__linux__)
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    CPU_SET(core, &cpuSet);
+
+    if (pthread_setaffinity_np(thread.native_handle(), sizeof(cpu_set_t), &cpuSet) != 0) {
+        spdlog::warn("[JobSystem] Could not pin a worker to core {}", core);
+    }
+#else
+    spdlog::warn("[JobSystem] Thread pinning is not implemented on this platform");
+#endif
+}
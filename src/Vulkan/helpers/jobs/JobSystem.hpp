@@ -0,0 +1,115 @@
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <condition_variable>
+
+/**
+ * Work-stealing thread pool.
+ *
+ * Every worker owns a deque. Workers push and pop their own jobs at the back and steal from the front of other
+ * workers' deques when they run dry. Threads that wait on a counter keep executing jobs instead of blocking,
+ * so jobs may submit and wait for other jobs.
+ */
+class JobSystem
+{
+public:
+
+	struct Config
+	{
+		/**
+		 * 0 means one worker per hardware thread, minus the calling thread.
+		 */
+		uint32_t workerCount;
+
+		/**
+		 * Pins worker N to core N + 1. Core 0 is left to the main thread. Cores are taken in OS order, the NUMA
+		 * topology is not considered.
+		 */
+		bool pinThreads;
+	};
+
+	class Counter
+	{
+	public:
+		[[nodiscard]] bool IsDone() const { return m_pending.load(std::memory_order_acquire) == 0; }
+
+	private:
+		friend class JobSystem;
+		std::atomic<uint32_t> m_pending{ 0 };
+	};
+
+	explicit JobSystem(const JobSystem::Config& config);
+	~JobSystem();
+
+	/**
+	 * \param name Must outlive the job. Shown in Tracy.
+	 * \param counter Optional. Incremented now, decremented when the job finishes.
+	 */
+	void Submit(const char* name, std::function<void()> function, JobSystem::Counter* counter = nullptr);
+
+	/**
+	 * Executes other jobs until the counter reaches zero.
+	 */
+	void Wait(const JobSystem::Counter& counter);
+
+	/**
+	 * Executes a single pending job on the calling thread.
+	 * \return false if there was nothing to run.
+	 */
+	bool RunPendingJob();
+
+	/**
+	 * Splits [0, count) into one contiguous range per thread, like schedule(static), and blocks until all of them are done.
+	 * The calling thread processes the first range itself, range N is queued on worker N - 1.
+	 *
+	 * Calls over the same count therefore hand the same range to the same thread unless it gets stolen.
+	 */
+	void ParallelFor(const char* name, uint32_t count, uint32_t minBatchSize, const std::function<void(uint32_t begin, uint32_t end)>& function);
+
+	/**
+	 * Workers plus the calling thread.
+	 */
+	[[nodiscard]] uint32_t GetThreadCount() const;
+
+private:
+
+	struct Job
+	{
+		const char* name;
+		std::function<void()> function;
+		JobSystem::Counter* counter;
+	};
+
+	struct WorkerQueue
+	{
+		std::mutex mutex;
+		std::deque<Job> jobs;
+	};
+
+	void Push(uint32_t queueIndex, Job&& job);
+	void WakeWorkers(bool all);
+
+	void WorkerLoop(uint32_t workerIndex);
+	void Execute(Job& job);
+
+	bool PopJob(uint32_t queueIndex, Job& job);
+	bool StealJob(uint32_t thiefIndex, Job& job);
+
+	static void PinThread(std::thread& thread, uint32_t core);
+
+	std::vector<std::unique_ptr<WorkerQueue>> m_queues;
+	std::vector<std::thread> m_workers;
+
+	std::atomic<uint32_t> m_queuedJobCount{ 0 };
+	std::atomic<uint32_t> m_nextQueue{ 0 };
+	std::atomic<bool> m_stop{ false };
+
+	std::mutex m_sleepMutex;
+	std::condition_variable m_wakeCondition;
+};
@@ -0,0 +1,212 @@
+#include "TaskGraph.hpp"
+
+#include <tracy/Tracy.hpp>
+
+#include "../../pch.hpp"
+
+TaskGraph::TaskGraph(JobSystem* jobSystem) {
+
+    m_jobSystem = jobSystem;
+    m_ownerThread = std::this_thread::get_id();
+}
+
+TaskGraph::~TaskGraph() {
+    this->WaitAll();
+}
+
+TaskGraph::TaskID TaskGraph::AddTask(const char* name, std::function<void()> function, std::initializer_list<TaskID> dependencies) {
+    return this->Add(name, std::move(function), false, dependencies);
+}
+
+TaskGraph::TaskID TaskGraph::AddMainThreadTask(const char* name, std::function<void()> function, std::initializer_list<TaskID> dependencies) {
+    return this->Add(name, std::move(function), true, dependencies);
+}
+
+void TaskGraph::Dispatch() {
+
+    std::vector<TaskID> readyTasks;
+    {
+        std::lock_guard lock(m_mutex);
+        if (m_dispatched) {
+            return;
+        }
+
+        m_dispatched = true;
+        for (const TaskID task : m_heldBackTasks) {
+            this->Schedule(task, readyTasks);
+        }
+        m_heldBackTasks.clear();
+    }
+
+    this->Submit(readyTasks);
+}
+
+void TaskGraph::Wait(TaskID task) {
+
+    if (task == kInvalidTask) {
+        return;
+    }
+
+    ZoneScoped;
+    this->Dispatch();
+    this->WaitUntil([this, task] { return this->IsDone(task); });
+}
+
+void TaskGraph::WaitAll() {
+
+    ZoneScoped;
+    this->Dispatch();
+    this->WaitUntil([this] { return m_unfinishedTaskCount.load(std::memory_order_acquire) == 0; });
+}
+
+bool TaskGraph::IsDone(TaskID task) const {
+
+    std::lock_guard lock(m_mutex);
+    return m_tasks[task].done;
+}
+
+JobSystem* TaskGraph::GetJobSystem() const {
+    return m_jobSystem;
+}
+
+TaskGraph::TaskID TaskGraph::Add(const char* name, std::function<void()> function, bool mainThread, std::initializer_list<TaskID> dependencies) {
+
+    std::vector<TaskID> readyTasks;
+    TaskID id;
+    {
+        std::lock_guard lock(m_mutex);
+
+        id = static_cast<TaskID>(m_tasks.size());
+        Task& task = m_tasks.emplace_back();
+        task.name = name;
+        task.function = std::move(function);
+        task.mainThread = mainThread;
+        task.pendingDependencies = 0;
+
+        for (const TaskID dependency : dependencies) {
+
+            if (dependency == kInvalidTask) {
+                continue;
+            }
+            if (dependency >= id) {
+                throw std::runtime_error(std::format("[TaskGraph] Task {} depends on an unknown task", name));
+            }
+
+            Task& dependencyTask = m_tasks[dependency];
+            if (dependencyTask.done) {
+                continue;
+            }
+
+            dependencyTask.successors.push_back(id);
+            task.pendingDependencies += 1;
+        }
+
+        m_unfinishedTaskCount.fetch_add(1, std::memory_order_relaxed);
+
+        if (task.pendingDependencies == 0) {
+            this->Schedule(id, readyTasks);
+        }
+    }
+
+    this->Submit(readyTasks);
+    return id;
+}
+
+void TaskGraph::Schedule(TaskID task, std::vector<TaskID>& readyTasks) {
+
+    if (!m_dispatched) {
+        m_heldBackTasks.push_back(task);
+        return;
+    }
+
+    if (m_tasks[task].mainThread) {
+        m_readyMainThreadTasks.push_back(task);
+        return;
+    }
+
+    readyTasks.push_back(task);
+}
+
+void TaskGraph::Submit(const std::vector<TaskID>& readyTasks) {
+
+    // Submitting outside of the lock, because the job system may run the job inline.
+    for (const TaskID task : readyTasks) {
+
+        const char* name;
+        {
+            std::lock_guard lock(m_mutex);
+            name = m_tasks[task].name;
+        }
+
+        m_jobSystem->Submit(name, [this, task] { this->Run(task); });
+    }
+}
+
+void TaskGraph::Run(TaskID taskId) {
+
+    Task* task;
+    {
+        std::lock_guard lock(m_mutex);
+        task = &m_tasks[taskId];
+    }
+
+    {
+        ZoneScopedN("Task");
+        ZoneName(task->name, std::strlen(task->name));
+        task->function();
+    }
+
+    std::vector<TaskID> readyTasks;
+    {
+        std::lock_guard lock(m_mutex);
+
+        task->done = true;
+        for (const TaskID successor : task->successors) {
+
+            m_tasks[successor].pendingDependencies -= 1;
+            if (m_tasks[successor].pendingDependencies == 0) {
+                this->Schedule(successor, readyTasks);
+            }
+        }
+    }
+
+    this->Submit(readyTasks);
+
+    // Last, because WaitAll may return and the graph may be destroyed as soon as the count reaches zero.
+    m_unfinishedTaskCount.fetch_sub(1, std::memory_order_release);
+}
+
+bool TaskGraph::RunMainThreadTask() {
+
+    if (std::this_thread::get_id() != m_ownerThread) {
+        return false;
+    }
+
+    TaskID task;
+    {
+        std::lock_guard lock(m_mutex);
+        if (m_readyMainThreadTasks.empty()) {
+            return false;
+        }
+
+        task = m_readyMainThreadTasks.front();
+        m_readyMainThreadTasks.erase(m_readyMainThreadTasks.begin());
+    }
+
+    this->Run(task);
+    return true;
+}
+
+void TaskGraph::WaitUntil(const std::function<bool()>& condition) {
+
+    while (!condition()) {
+
+        if (this->RunMainThreadTask()) {
+            continue;
+        }
+
+        if (!m_jobSystem->RunPendingJob()) {
+            std::this_thread::yield();
+        }
+    }
+}
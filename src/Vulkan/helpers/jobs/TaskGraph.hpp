@@ -0,0 +1,92 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <initializer_list>
+
+#include "JobSystem.hpp"
+
+/**
+ * Per-frame dependency graph of named tasks executed on the JobSystem.
+ *
+ * Tasks may be added at any time, also after Dispatch and from inside other tasks.
+ * A task starts as soon as all of its dependencies have finished.
+ * Main thread tasks are only executed by the thread that created the graph, while it waits in Wait/WaitAll.
+ */
+class TaskGraph
+{
+public:
+
+	typedef uint32_t TaskID;
+	static constexpr TaskID kInvalidTask = UINT32_MAX;
+
+	explicit TaskGraph(JobSystem* jobSystem);
+
+	/**
+	 * Waits for all the tasks. Tasks capture frame locals by reference, so the graph must not outlive them.
+	 */
+	~TaskGraph();
+
+	TaskGraph(const TaskGraph&) = delete;
+	TaskGraph& operator=(const TaskGraph&) = delete;
+
+	/**
+	 * \param name Must outlive the graph. Shown in Tracy.
+	 * \param dependencies kInvalidTask entries are ignored.
+	 */
+	TaskID AddTask(const char* name, std::function<void()> function, std::initializer_list<TaskID> dependencies = {});
+	TaskID AddMainThreadTask(const char* name, std::function<void()> function, std::initializer_list<TaskID> dependencies = {});
+
+	/**
+	 * Starts executing the tasks. Tasks added before Dispatch are held back until it is called.
+	 */
+	void Dispatch();
+
+	void Wait(TaskID task);
+	void WaitAll();
+
+	[[nodiscard]] bool IsDone(TaskID task) const;
+	[[nodiscard]] JobSystem* GetJobSystem() const;
+
+private:
+
+	struct Task
+	{
+		const char* name;
+		std::function<void()> function;
+		bool mainThread;
+
+		uint32_t pendingDependencies;
+		std::vector<TaskID> successors;
+		std::atomic<bool> done{ false };
+	};
+
+	TaskID Add(const char* name, std::function<void()> function, bool mainThread, std::initializer_list<TaskID> dependencies);
+
+	/**
+	 * Must be called with m_mutex locked. Job system tasks are collected into readyTasks and must be submitted
+	 * after unlocking.
+	 */
+	void Schedule(TaskID task, std::vector<TaskID>& readyTasks);
+	void Submit(const std::vector<TaskID>& readyTasks);
+	void Run(TaskID task);
+
+	bool RunMainThreadTask();
+	void WaitUntil(const std::function<bool()>& condition);
+
+	JobSystem* m_jobSystem;
+	std::thread::id m_ownerThread;
+
+	mutable std::mutex m_mutex;
+
+	// Deque keeps the addresses stable while tasks are being added.
+	std::deque<Task> m_tasks;
+	std::vector<TaskID> m_readyMainThreadTasks;
+	std::vector<TaskID> m_heldBackTasks;
+
+	bool m_dispatched = false;
+	std::atomic<uint32_t> m_unfinishedTaskCount{ 0 };
+};
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+/**
+ * Lock-free single producer, single consumer triple buffer.
+ *
+ * The producer fills the back buffer and publishes it, the consumer picks up the latest published buffer.
+ * Neither side ever waits for the other. Buffers that were published but never acquired are simply overwritten.
+ */
+template<typename T>
+class TripleBuffer
+{
+public:
+
+	/**
+	 * Producer side. The buffer stays owned by the producer until Publish.
+	 */
+	T& GetWriteBuffer() {
+		return m_buffers[m_writeIndex];
+	}
+
+	void Publish() {
+		const uint32_t previous = m_middle.exchange(m_writeIndex | kFreshBit, std::memory_order_acq_rel);
+		m_writeIndex = previous & kIndexMask;
+	}
+
+	/**
+	 * Consumer side. Swaps in the latest published buffer.
+	 * \return false if nothing new was published since the last call. The read buffer is left as it was.
+	 */
+	bool Acquire() {
+
+		if ((m_middle.load(std::memory_order_relaxed) & kFreshBit) == 0) {
+			return false;
+		}
+
+		const uint32_t previous = m_middle.exchange(m_readIndex, std::memory_order_acq_rel);
+		m_readIndex = previous & kIndexMask;
+		return true;
+	}
+
+	const T& GetReadBuffer() const {
+		return m_buffers[m_readIndex];
+	}
+
+private:
+
+	static constexpr uint32_t kFreshBit = 0x4;
+	static constexpr uint32_t kIndexMask = 0x3;
+
+	std::array<T, 3> m_buffers{};
+
+	// The indices are touched by one side each, so they are kept on separate cache lines.
+	alignas(64) uint32_t m_writeIndex = 0;
+	alignas(64) std::atomic<uint32_t> m_middle{ 1 };
+	alignas(64) uint32_t m_readIndex = 2;
+};
\ No newline at end of file
@@ -0,0 +1,143 @@
+#include "BlockAllocator.hpp"
+
+#include <iterator>
+#include <algorithm>
+#include <stdexcept>
+
+BlockAllocator::BlockAllocator(uint64_t size) {
+
+    m_size = size;
+    m_freeRanges.push_back(Range{
+        .offset = 0,
+        .size = size
+    });
+}
+
+std::optional<uint64_t> BlockAllocator::Allocate(uint64_t size, uint64_t alignment) {
+
+    if (size == 0) {
+        throw std::runtime_error("[BlockAllocator] Trying to allocate 0 bytes");
+    }
+    alignment = std::max<uint64_t>(alignment, 1);
+
+    for (size_t index = 0; index < m_freeRanges.size(); index++) {
+
+        const Range& range = m_freeRanges[index];
+        const uint64_t offset = (range.offset + alignment - 1) / alignment * alignment;
+
+        if (offset + size <= range.offset + range.size) {
+            this->TakeFromRange(index, offset, size);
+            return offset;
+        }
+    }
+
+    return std::nullopt;
+}
+
+bool BlockAllocator::AllocateAt(uint64_t offset, uint64_t size) {
+
+    // The last free range that starts at or before the offset is the only one that can contain it.
+    const auto it = std::upper_bound(m_freeRanges.begin(), m_freeRanges.end(), offset, [](uint64_t value, const Range& range)
+    {
+        return value < range.offset;
+    });
+    if (it == m_freeRanges.begin()) {
+        return false;
+    }
+
+    const size_t index = static_cast<size_t>(it - m_freeRanges.begin()) - 1;
+    const Range& range = m_freeRanges[index];
+    if (offset + size > range.offset + range.size) {
+        return false;
+    }
+
+    this->TakeFromRange(index, offset, size);
+    return true;
+}
+
+void BlockAllocator::Free(uint64_t offset, uint64_t size) {
+
+    const auto next = std::upper_bound(m_freeRanges.begin(), m_freeRanges.end(), offset, [](uint64_t value, const Range& range)
+    {
+        return value < range.offset;
+    });
+
+    const bool overlapsPrevious = next != m_freeRanges.begin() && std::prev(next)->offset + std::prev(next)->size > offset;
+    const bool overlapsNext = next != m_freeRanges.end() && offset + size > next->offset;
+    if (overlapsPrevious || overlapsNext || offset + size > m_size || size > m_usedSize) {
+        throw std::runtime_error("[BlockAllocator] Trying to free a range that is not allocated");
+    }
+
+    m_usedSize -= size;
+
+    const bool mergesPrevious = next != m_freeRanges.begin() && std::prev(next)->offset + std::prev(next)->size == offset;
+    const bool mergesNext = next != m_freeRanges.end() && offset + size == next->offset;
+
+    if (mergesPrevious && mergesNext) {
+        std::prev(next)->size += size + next->size;
+        m_freeRanges.erase(next);
+    }
+    else if (mergesPrevious) {
+        std::prev(next)->size += size;
+    }
+    else if (mergesNext) {
+        next->offset = offset;
+        next->size += size;
+    }
+    else {
+        m_freeRanges.insert(next, Range{
+            .offset = offset,
+            .size = size
+        });
+    }
+}
+
+uint64_t BlockAllocator::GetSize() const {
+    return m_size;
+}
+
+uint64_t BlockAllocator::GetUsedSize() const {
+    return m_usedSize;
+}
+
+uint64_t BlockAllocator::GetLargestFreeSize() const {
+
+    uint64_t largest = 0;
+    for (const Range& range : m_freeRanges) {
+        largest = std::max(largest, range.size);
+    }
+    return largest;
+}
+
+bool BlockAllocator::IsEmpty() const {
+    return m_usedSize == 0;
+}
+
+const std::vector<BlockAllocator::Range>& BlockAllocator::GetFreeRanges() const {
+    return m_freeRanges;
+}
+
+void BlockAllocator::TakeFromRange(size_t index, uint64_t offset, uint64_t size) {
+
+    const Range range = m_freeRanges[index];
+    const uint64_t end = offset + size;
+    const uint64_t rangeEnd = range.offset + range.size;
+
+    m_freeRanges.erase(m_freeRanges.begin() + static_cast<std::ptrdiff_t>(index));
+
+    // The tail goes in first, so the head ends up in front of it.
+    if (end < rangeEnd) {
+        m_freeRanges.insert(m_freeRanges.begin() + static_cast<std::ptrdiff_t>(index), Range{
+            .offset = end,
+            .size = rangeEnd - end
+        });
+    }
+    if (offset > range.offset) {
+        m_freeRanges.insert(m_freeRanges.begin() + static_cast<std::ptrdiff_t>(index), Range{
+            .offset = range.offset,
+            .size = offset - range.offset
+        });
+    }
+
+    m_usedSize += size;
+}
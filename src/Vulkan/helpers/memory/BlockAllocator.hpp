@@ -0,0 +1,60 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <optional>
+
+/**
+ * Places ranges inside one block of memory, first fit over a free list sorted by offset. Freed ranges are merged with
+ * their neighbours, so the list only has as many entries as the block has gaps.
+ *
+ * Knows nothing about Vulkan, so the defragmentation planner can simulate blocks with copies of it.
+ */
+class BlockAllocator
+{
+public:
+
+	struct Range
+	{
+		uint64_t offset;
+		uint64_t size;
+	};
+
+	explicit BlockAllocator(uint64_t size);
+
+	/**
+	 * \return Offset of the range, or nothing if no gap is large enough.
+	 */
+	[[nodiscard]] std::optional<uint64_t> Allocate(uint64_t size, uint64_t alignment);
+
+	/**
+	 * Takes exactly this range, e.g. one the planner picked on a copy of the allocator.
+	 * \return False if any part of it is not free.
+	 */
+	[[nodiscard]] bool AllocateAt(uint64_t offset, uint64_t size);
+
+	/**
+	 * The range must have been allocated with the same offset and size.
+	 */
+	void Free(uint64_t offset, uint64_t size);
+
+	[[nodiscard]] uint64_t GetSize() const;
+	[[nodiscard]] uint64_t GetUsedSize() const;
+	[[nodiscard]] uint64_t GetLargestFreeSize() const;
+	[[nodiscard]] bool IsEmpty() const;
+
+	[[nodiscard]] const std::vector<Range>& GetFreeRanges() const;
+
+private:
+
+	/**
+	 * Cuts [offset, offset + size) out of the free range at index, which must contain it.
+	 */
+	void TakeFromRange(size_t index, uint64_t offset, uint64_t size);
+
+	uint64_t m_size;
+	uint64_t m_usedSize = 0;
+
+	// Sorted by offset, never adjacent to each other.
+	std::vector<Range> m_freeRanges;
+};
\ No newline at end of file
@@ -0,0 +1,111 @@
+#include "DefragmentationPlanner.hpp"
+
+#include <numeric>
+#include <algorithm>
+
+std::vector<DefragmentationPlanner::Move> DefragmentationPlanner::Plan(const std::vector<Block>& blocks, const DefragmentationPlanner::Desc& desc) {
+
+    const uint32_t blockCount = static_cast<uint32_t>(blocks.size());
+
+    std::vector<BlockAllocator> simulated;
+    simulated.reserve(blockCount);
+    for (const Block& block : blocks) {
+        simulated.push_back(block.allocator);
+    }
+
+    // Emptiest first, those are the cheapest to empty and free the most per byte moved.
+    std::vector<uint32_t> order(blockCount);
+    std::iota(order.begin(), order.end(), 0);
+    std::ranges::stable_sort(order, [&blocks](uint32_t lhs, uint32_t rhs)
+    {
+        return blocks[lhs].allocator.GetUsedSize() < blocks[rhs].allocator.GetUsedSize();
+    });
+
+    std::vector<bool> emptied(blockCount, false);
+    std::vector<bool> receiving(blockCount, false);
+
+    std::vector<Move> moves;
+    uint64_t plannedBytes = 0;
+
+    for (size_t orderInd = 0; orderInd < order.size(); orderInd++) {
+
+        const uint32_t src = order[orderInd];
+        const Block& block = blocks[src];
+        const uint64_t usedSize = block.allocator.GetUsedSize();
+
+        if (usedSize == 0 || receiving[src]) {
+            continue;
+        }
+        if (static_cast<double>(usedSize) >= desc.maxSourceUsage * static_cast<double>(block.allocator.GetSize())) {
+            continue;
+        }
+        if (plannedBytes > 0 && plannedBytes + usedSize > desc.maxBytesPerStep) {
+            break;
+        }
+
+        uint64_t movableSize = 0;
+        for (const Allocation& allocation : block.allocations) {
+            movableSize += allocation.size;
+        }
+        if (movableSize != usedSize) {
+            continue;
+        }
+
+        // Fuller blocks first as destinations, so the allocations end up packed into as few blocks as possible.
+        std::vector<uint32_t> destinations(order.begin() + static_cast<std::ptrdiff_t>(orderInd) + 1, order.end());
+        std::erase_if(destinations, [&emptied](uint32_t dst) { return emptied[dst]; });
+        std::ranges::stable_sort(destinations, [&simulated](uint32_t lhs, uint32_t rhs)
+        {
+            return simulated[lhs].GetUsedSize() > simulated[rhs].GetUsedSize();
+        });
+
+        // Largest first, small allocations fill the gaps the large ones leave.
+        std::vector<Allocation> allocations = block.allocations;
+        std::ranges::stable_sort(allocations, [](const Allocation& lhs, const Allocation& rhs)
+        {
+            return lhs.size > rhs.size;
+        });
+
+        // Stops at the first allocation that does not fit, so blockMoves[i] is the move of allocations[i].
+        std::vector<Move> blockMoves;
+        for (const Allocation& allocation : allocations) {
+
+            const size_t moveCount = blockMoves.size();
+            for (const uint32_t dst : destinations) {
+
+                const std::optional<uint64_t> offset = simulated[dst].Allocate(allocation.size, allocation.alignment);
+                if (offset.has_value()) {
+                    blockMoves.push_back(Move{
+                        .id = allocation.id,
+                        .srcBlock = src,
+                        .dstBlock = dst,
+                        .dstOffset = *offset
+                    });
+                    break;
+                }
+            }
+
+            if (blockMoves.size() == moveCount) {
+                break;
+            }
+        }
+
+        // Moving only a part of the block would not free it, so the placements are taken back.
+        if (blockMoves.size() != allocations.size()) {
+            for (size_t moveInd = 0; moveInd < blockMoves.size(); moveInd++) {
+                simulated[blockMoves[moveInd].dstBlock].Free(blockMoves[moveInd].dstOffset, allocations[moveInd].size);
+            }
+            continue;
+        }
+
+        emptied[src] = true;
+        for (const Move& move : blockMoves) {
+            receiving[move.dstBlock] = true;
+        }
+
+        moves.insert(moves.end(), blockMoves.begin(), blockMoves.end());
+        plannedBytes += usedSize;
+    }
+
+    return moves;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "BlockAllocator.hpp"
+
+/**
+ * Decides which allocations move where so that sparsely used blocks end up empty. Works on copies of the block
+ * allocators only, so it runs without a device and can be checked by simulation.
+ *
+ * A block is only emptied if everything in it fits into fuller blocks, so every planned step frees whole blocks and
+ * nothing is moved for nothing. Blocks that receive allocations are not emptied in the same step.
+ */
+class DefragmentationPlanner
+{
+public:
+
+	struct Allocation
+	{
+		uint32_t id;
+		uint64_t offset;
+		uint64_t size;
+		uint64_t alignment;
+	};
+
+	struct Block
+	{
+		BlockAllocator allocator;
+
+		/**
+		 * The allocations that can be moved. A block whose allocations do not add up to its used size holds
+		 * something that cannot be moved, so it is only used as a destination.
+		 */
+		std::vector<Allocation> allocations;
+	};
+
+	struct Move
+	{
+		uint32_t id;
+		uint32_t srcBlock;
+		uint32_t dstBlock;
+		uint64_t dstOffset;
+	};
+
+	struct Desc
+	{
+		/**
+		 * Blocks used less than this share of their size are emptied.
+		 */
+		double maxSourceUsage = 0.5;
+
+		/**
+		 * Bytes moved per step. The first block is planned even if it is larger, so a step always makes progress.
+		 */
+		uint64_t maxBytesPerStep;
+	};
+
+	/**
+	 * The moves are ordered by source block. Applying them in that order, allocating every destination with
+	 * BlockAllocator::AllocateAt and then freeing the sources, leaves the blocks the moves come from empty.
+	 */
+	[[nodiscard]] static std::vector<Move> Plan(const std::vector<Block>& blocks, const DefragmentationPlanner::Desc& desc);
+};
\ No newline at end of file
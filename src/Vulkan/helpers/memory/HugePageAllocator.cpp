@@ -0,0 +1,182 @@
+#include "HugePageAllocator.hpp"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#include <atomic>
+#include <algorithm>
+
+#include "../../pch.hpp"
+
+namespace {
+
+    std::atomic<HugePageMode> g_mode{ HugePageMode::Transparent };
+
+    // Only warned about once, every large column would report the same problem.
+    std::atomic<bool> g_explicitFallbackReported{ false };
+
+    size_t RoundUp(size_t size, size_t alignment) {
+        return (size + alignment - 1) / alignment * alignment;
+    }
+
+    void ReportExplicitFallback() {
+        if (!g_explicitFallbackReported.exchange(true)) {
+            spdlog::warn("[HugePages] Could not get reserved huge pages, falling back to regular pages");
+        }
+    }
+
+#ifndef _WIN32
+    void* MapBlock(size_t size, HugePageMode mode, int extraFlags) {
+
+        if (mode == HugePageMode::Explicit) {
+
+            void* pointer = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | extraFlags, -1, 0);
+            if (pointer != MAP_FAILED) {
+                return pointer;
+            }
+            ReportExplicitFallback();
+        }
+
+        // Over-allocating by one huge page, so the block can start on a huge page boundary.
+        const size_t mappedSize = size + HugePages::kHugePageSize;
+        void* mapping = mmap(nullptr, mappedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | extraFlags, -1, 0);
+        if (mapping == MAP_FAILED) {
+            throw std::bad_alloc();
+        }
+
+        const uintptr_t mappingStart = reinterpret_cast<uintptr_t>(mapping);
+        const uintptr_t start = RoundUp(mappingStart, HugePages::kHugePageSize);
+        const size_t headSize = start - mappingStart;
+        const size_t tailSize = mappedSize - headSize - size;
+
+        if (headSize > 0) {
+            munmap(mapping, headSize);
+        }
+        if (tailSize > 0) {
+            munmap(reinterpret_cast<void*>(start + size), tailSize);
+        }
+
+        void* pointer = reinterpret_cast<void*>(start);
+        madvise(pointer, size, mode == HugePageMode::Disabled ? MADV_NOHUGEPAGE : MADV_HUGEPAGE);
+        return pointer;
+    }
+#endif
+}
+
+void HugePages::SetMode(HugePageMode mode) {
+    g_mode.store(mode, std::memory_order_relaxed);
+}
+
+HugePageMode HugePages::GetMode() {
+    return g_mode.load(std::memory_order_relaxed);
+}
+
+void* HugePages::Allocate(size_t size) {
+
+    if (size < kHugePageSize) {
+        return ::operator new(size);
+    }
+
+    // Whole huge pages, so a reserved mapping and a regular one can be released the same way.
+    size = RoundUp(size, kHugePageSize);
+    const HugePageMode mode = HugePages::GetMode();
+
+#ifdef _WIN32
+    if (mode == HugePageMode::Explicit) {
+
+        const size_t largePageSize = GetLargePageMinimum();
+        if (largePageSize != 0) {
+            void* pointer = VirtualAlloc(nullptr, RoundUp(size, largePageSize), MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+            if (pointer != nullptr) {
+                return pointer;
+            }
+        }
+        ReportExplicitFallback();
+    }
+
+    void* pointer = VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    if (pointer == nullptr) {
+        throw std::bad_alloc();
+    }
+    return pointer;
+#else
+    return MapBlock(size, mode, 0);
+#endif
+}
+
+void HugePages::Free(void* pointer, size_t size) {
+
+    if (pointer == nullptr) {
+        return;
+    }
+
+    if (size < kHugePageSize) {
+        ::operator delete(pointer);
+        return;
+    }
+
+#ifdef _WIN32
+    VirtualFree(pointer, 0, MEM_RELEASE);
+#else
+    munmap(pointer, RoundUp(size, kHugePageSize));
+#endif
+}
+
+void* HugePages::Reserve(size_t size) {
+
+    size = RoundUp(std::max<size_t>(size, 1), kHugePageSize);
+
+#ifdef _WIN32
+    void* pointer = VirtualAlloc(nullptr, size, MEM_RESERVE, PAGE_READWRITE);
+    if (pointer == nullptr) {
+        throw std::bad_alloc();
+    }
+    return pointer;
+#else
+    // Without MAP_NORESERVE the kernel would account the whole reservation. With it, a MAP_HUGETLB mapping only
+    // takes pages from the pool when touched and raises SIGBUS if the pool is empty by then.
+    HugePageMode mode = HugePages::GetMode();
+    if (mode == HugePageMode::Explicit) {
+        mode = HugePageMode::Transparent;
+    }
+    return MapBlock(size, mode, MAP_NORESERVE);
+#endif
+}
+
+void HugePages::Release(void* pointer, size_t size) {
+
+    if (pointer == nullptr) {
+        return;
+    }
+
+#ifdef _WIN32
+    VirtualFree(pointer, 0, MEM_RELEASE);
+#else
+    munmap(pointer, RoundUp(std::max<size_t>(size, 1), kHugePageSize));
+#endif
+}
+
+void HugePages::Commit(void* pointer, size_t size) {
+
+    if (pointer == nullptr || size == 0) {
+        return;
+    }
+
+#ifdef _WIN32
+    // Reserved blocks span whole huge pages, so the rounded size stays inside the block.
+    if (VirtualAlloc(pointer, RoundUp(size, kHugePageSize), MEM_COMMIT, PAGE_READWRITE) == nullptr) {
+        throw std::bad_alloc();
+    }
+#endif
+}
+
+size_t HugePages::GetBlockSize(size_t size) {
+    return size < kHugePageSize ? size : RoundUp(size, kHugePageSize);
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <new>
+#include <utility>
+#include <cstddef>
+#include <cstdint>
+
+enum class HugePageMode
+{
+	/**
+	 * Regular 4 KB pages. Also opts out of transparent huge pages on systems where they are always on.
+	 */
+	Disabled,
+
+	/**
+	 * Asks the OS for transparent 2 MB pages (madvise on Linux). No setup needed, but not guaranteed.
+	 * Windows has no transparent huge pages, so this behaves like Disabled there.
+	 */
+	Transparent,
+
+	/**
+	 * Reserved huge pages: MAP_HUGETLB on Linux, MEM_LARGE_PAGES on Windows.
+	 * Needs pages reserved in vm.nr_hugepages or the "Lock pages in memory" privilege. Falls back to Transparent.
+	 * Only applies to HugePages::Allocate. Reserved blocks are committed piecewise, which large pages cannot do on
+	 * Windows and which on Linux would leave a MAP_NORESERVE mapping to SIGBUS once the pool runs dry, so
+	 * HugePages::Reserve treats Explicit as Transparent.
+	 */
+	Explicit,
+};
+
+/**
+ * Page-level allocation for large arrays.
+ *
+ * Large blocks are mapped straight from the OS, so no page is touched until it is written. Together with
+ * HugePageAllocator's default-initialization that leaves the first touch to whichever thread writes the
+ * element first.
+ */
+class HugePages
+{
+public:
+
+	static constexpr size_t kHugePageSize = 2 * 1024 * 1024;
+
+	/**
+	 * Only affects allocations made afterwards.
+	 */
+	static void SetMode(HugePageMode mode);
+	[[nodiscard]] static HugePageMode GetMode();
+
+	/**
+	 * Blocks smaller than kHugePageSize come from operator new. The same size must be passed to Free.
+	 */
+	[[nodiscard]] static void* Allocate(size_t size);
+	static void Free(void* pointer, size_t size);
+
+	/**
+	 * Address space only, always whole huge pages. Windows faults on pages that were not committed first, Linux
+	 * backs them on first touch. Never uses reserved huge pages, see HugePageMode::Explicit. The same size must be
+	 * passed to Release.
+	 */
+	[[nodiscard]] static void* Reserve(size_t size);
+	static void Release(void* pointer, size_t size);
+
+	/**
+	 * Commits the first size bytes of a block from Reserve, rounded up to whole huge pages. Committing pages
+	 * again is harmless. Does nothing on Linux.
+	 */
+	static void Commit(void* pointer, size_t size);
+
+	/**
+	 * Size of the block Allocate returns for the given size. Blocks of kHugePageSize or more start on a page
+	 * boundary and span whole huge pages, so they can be handed to APIs that want page-aligned memory.
+	 */
+	[[nodiscard]] static size_t GetBlockSize(size_t size);
+};
+
+/**
+ * std::allocator replacement backed by HugePages.
+ *
+ * Elements are default-initialized instead of value-initialized, so resize on trivial types does not write
+ * anything. Whoever fills the elements afterwards does the first touch.
+ */
+template<typename T>
+class HugePageAllocator
+{
+public:
+
+	typedef T value_type;
+
+	HugePageAllocator() = default;
+
+	template<typename U>
+	HugePageAllocator(const HugePageAllocator<U>&) noexcept {}
+
+	[[nodiscard]] T* allocate(size_t count) {
+		return static_cast<T*>(HugePages::Allocate(count * sizeof(T)));
+	}
+
+	void deallocate(T* pointer, size_t count) noexcept {
+		HugePages::Free(pointer, count * sizeof(T));
+	}
+
+	template<typename U, typename... Args>
+	void construct(U* pointer, Args&&... args) {
+		if constexpr (sizeof...(Args) == 0) {
+			::new(static_cast<void*>(pointer)) U;
+		}
+		else {
+			::new(static_cast<void*>(pointer)) U(std::forward<Args>(args)...);
+		}
+	}
+
+	template<typename U>
+	bool operator==(const HugePageAllocator<U>&) const noexcept { return true; }
+};
+
+/**
+ * HugePageAllocator for containers that reserve their full capacity once and never reallocate.
+ *
+ * Blocks come from HugePages::Reserve, so the owner has to HugePages::Commit the elements before it grows
+ * the container into them.
+ */
+template<typename T>
+class ReservedPageAllocator : public HugePageAllocator<T>
+{
+public:
+
+	typedef T value_type;
+
+	ReservedPageAllocator() = default;
+
+	template<typename U>
+	ReservedPageAllocator(const ReservedPageAllocator<U>&) noexcept {}
+
+	[[nodiscard]] T* allocate(size_t count) {
+		return static_cast<T*>(HugePages::Reserve(count * sizeof(T)));
+	}
+
+	void deallocate(T* pointer, size_t count) noexcept {
+		HugePages::Release(pointer, count * sizeof(T));
+	}
+};
\ No newline at end of file
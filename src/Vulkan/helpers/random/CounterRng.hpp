@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * Counter-based generator built on the Squares RNG by B. Widynski.
+ *
+ * Every value is a pure function of (seed, counter), so any element can be generated independently.
+ * Filling an array in parallel gives the same result for any thread count or batch split.
+ */
+class CounterRng
+{
+public:
+
+	explicit CounterRng(uint64_t seed) {
+		// Squares needs a key with well mixed bits, a plain small seed would give poor output.
+		m_key = CounterRng::SplitMix64(seed) | 1;
+	}
+
+	[[nodiscard]] uint32_t Next32(uint64_t counter) const {
+
+		uint64_t x = counter * m_key;
+		const uint64_t y = x;
+		const uint64_t z = y + m_key;
+
+		x = x * x + y;
+		x = (x >> 32) | (x << 32);
+		x = x * x + z;
+		x = (x >> 32) | (x << 32);
+		x = x * x + y;
+		x = (x >> 32) | (x << 32);
+		return static_cast<uint32_t>((x * x + z) >> 32);
+	}
+
+	/**
+	 * Uniform in [min, max). Uses the top 24 bits, which is all a float mantissa can hold.
+	 */
+	[[nodiscard]] float Uniform(uint64_t counter, float min, float max) const {
+		const float unit = static_cast<float>(this->Next32(counter) >> 8) * (1.0f / 16777216.0f);
+		return min + unit * (max - min);
+	}
+
+private:
+
+	static uint64_t SplitMix64(uint64_t value) {
+
+		value += 0x9E3779B97F4A7C15ull;
+		value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+		value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+		return value ^ (value >> 31);
+	}
+
+	uint64_t m_key;
+};
\ No newline at end of file
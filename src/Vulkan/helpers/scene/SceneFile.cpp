@@ -0,0 +1,183 @@
+#include "SceneFile.hpp"
+
+#include <fstream>
+
+#include <tracy/Tracy.hpp>
+
+#include "../io/MappedFile.hpp"
+#include "../../pch.hpp"
+
+namespace {
+
+    uint64_t AlignUp(uint64_t value, uint64_t alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+}
+
+SceneWriter::SceneWriter(uint32_t entityCount) {
+    m_entityCount = entityCount;
+}
+
+void SceneWriter::AddColumn(uint32_t columnId, uint32_t elementSize, const void* data) {
+    this->AddTable(columnId, elementSize, m_entityCount, data);
+}
+
+void SceneWriter::AddTable(uint32_t columnId, uint32_t elementSize, uint64_t elementCount, const void* data) {
+
+    for (const Column& column : m_columns) {
+        if (column.columnId == columnId) {
+            throw std::runtime_error(std::format("[SceneWriter] Column {} was added twice", columnId));
+        }
+    }
+
+    m_columns.push_back(Column{
+        .columnId = columnId,
+        .elementSize = elementSize,
+        .elementCount = elementCount,
+        .data = data
+    });
+}
+
+void SceneWriter::Write(const std::string& path) const {
+
+    ZoneScoped;
+
+    std::vector<SceneFormat::Section> sections;
+    sections.reserve(m_columns.size());
+
+    uint64_t offset = sizeof(SceneFormat::Header) + m_columns.size() * sizeof(SceneFormat::Section);
+    for (const Column& column : m_columns) {
+
+        offset = AlignUp(offset, SceneFormat::kAlignment);
+        const uint64_t size = static_cast<uint64_t>(column.elementSize) * column.elementCount;
+
+        sections.push_back(SceneFormat::Section{
+            .columnId = column.columnId,
+            .elementSize = column.elementSize,
+            .elementCount = column.elementCount,
+            .offset = offset,
+            .size = size
+        });
+        offset += size;
+    }
+
+    const SceneFormat::Header header = {
+        .magic = SceneFormat::kMagic,
+        .version = SceneFormat::kVersion,
+        .entityCount = m_entityCount,
+        .sectionCount = static_cast<uint32_t>(sections.size()),
+        .fileSize = offset,
+        .reserved = 0
+    };
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        throw std::runtime_error("[SceneWriter] Could not open " + path + " for writing");
+    }
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(sections.data()), static_cast<std::streamsize>(sections.size() * sizeof(SceneFormat::Section)));
+
+    constexpr char padding[SceneFormat::kAlignment] = {};
+    for (size_t ind = 0; ind < m_columns.size(); ind++) {
+
+        const uint64_t position = static_cast<uint64_t>(file.tellp());
+        file.write(padding, static_cast<std::streamsize>(sections[ind].offset - position));
+        file.write(static_cast<const char*>(m_columns[ind].data), static_cast<std::streamsize>(sections[ind].size));
+    }
+
+    if (!file.good()) {
+        throw std::runtime_error("[SceneWriter] Could not write " + path);
+    }
+
+    spdlog::info("[SceneWriter] Wrote {} entities, {} columns, {} bytes to {}", m_entityCount, sections.size(), header.fileSize, path);
+}
+
+SceneFile::SceneFile(const std::string& path) {
+
+    ZoneScoped;
+
+    m_path = path;
+    m_file = std::make_unique<MappedFile>(path);
+
+    const std::byte* data = m_file->GetData();
+    const uint64_t fileSize = m_file->GetSize();
+
+    if (fileSize < sizeof(SceneFormat::Header)) {
+        throw std::runtime_error("[SceneFile] " + path + " is too small to be a scene");
+    }
+
+    // The mapping is page aligned, so the header and the section table are suitably aligned too.
+    m_header = reinterpret_cast<const SceneFormat::Header*>(data);
+    if (m_header->magic != SceneFormat::kMagic) {
+        throw std::runtime_error("[SceneFile] " + path + " is not a scene file");
+    }
+    if (m_header->version != SceneFormat::kVersion) {
+        throw std::runtime_error(std::format("[SceneFile] {} has version {}, expected {}", path, m_header->version, SceneFormat::kVersion));
+    }
+    if (m_header->fileSize != fileSize) {
+        throw std::runtime_error("[SceneFile] " + path + " is truncated");
+    }
+
+    const uint64_t sectionTableEnd = sizeof(SceneFormat::Header) + static_cast<uint64_t>(m_header->sectionCount) * sizeof(SceneFormat::Section);
+    if (sectionTableEnd > fileSize) {
+        throw std::runtime_error("[SceneFile] " + path + " has a broken section table");
+    }
+    m_sections = reinterpret_cast<const SceneFormat::Section*>(data + sizeof(SceneFormat::Header));
+
+    for (uint32_t ind = 0; ind < m_header->sectionCount; ind++) {
+
+        const SceneFormat::Section& section = m_sections[ind];
+        if (section.offset % SceneFormat::kAlignment != 0
+            || section.size != static_cast<uint64_t>(section.elementSize) * section.elementCount
+            || section.offset < sectionTableEnd
+            || section.offset > fileSize
+            || section.size > fileSize - section.offset) {
+            throw std::runtime_error(std::format("[SceneFile] {} has a broken section for column {}", path, section.columnId));
+        }
+    }
+}
+
+SceneFile::~SceneFile() = default;
+
+uint32_t SceneFile::GetEntityCount() const {
+    return m_header->entityCount;
+}
+
+bool SceneFile::HasColumn(uint32_t columnId) const {
+    return this->FindSection(columnId) != nullptr;
+}
+
+const void* SceneFile::GetColumn(uint32_t columnId, uint32_t elementSize) const {
+
+    const std::span<const std::byte> column = this->GetTable(columnId, elementSize);
+    if (column.size() != static_cast<uint64_t>(elementSize) * m_header->entityCount) {
+        throw std::runtime_error(std::format("[SceneFile] Column {} in {} is not one element per entity", columnId, m_path));
+    }
+
+    return column.data();
+}
+
+std::span<const std::byte> SceneFile::GetTable(uint32_t columnId, uint32_t elementSize) const {
+
+    const SceneFormat::Section* section = this->FindSection(columnId);
+    if (section == nullptr) {
+        throw std::runtime_error(std::format("[SceneFile] {} has no column {}", m_path, columnId));
+    }
+    if (section->elementSize != elementSize) {
+        throw std::runtime_error(std::format("[SceneFile] Column {} in {} has {} byte elements, expected {}", columnId, m_path, section->elementSize, elementSize));
+    }
+
+    return { m_file->GetData() + section->offset, section->size };
+}
+
+const SceneFormat::Section* SceneFile::FindSection(uint32_t columnId) const {
+
+    for (uint32_t ind = 0; ind < m_header->sectionCount; ind++) {
+        if (m_sections[ind].columnId == columnId) {
+            return &m_sections[ind];
+        }
+    }
+
+    return nullptr;
+}
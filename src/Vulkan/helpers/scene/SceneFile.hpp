@@ -0,0 +1,171 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <string>
+#include <cstdint>
+#include <span>
+#include <type_traits>
+
+class MappedFile;
+
+/**
+ * Binary scene snapshot. Every component is stored as its own column, so a whole column can be used in place
+ * or copied with a single memcpy.
+ *
+ * Layout:
+ *  Header
+ *  Section[header.sectionCount]
+ *  Column data, every column starts at a multiple of kAlignment
+ *
+ * Columns are raw structs in the writer's native layout and byte order. Bump kVersion whenever a stored
+ * struct changes.
+ *
+ * Besides per-entity columns, a file can carry tables with their own element count, e.g. definitions
+ * the columns refer to by ID.
+ */
+namespace SceneFormat
+{
+	constexpr uint32_t kMagic = 0x53495047; // "GPIS"
+	constexpr uint32_t kVersion = 3;
+
+	/**
+	 * Cache line, also enough for any SIMD loads straight from the mapping.
+	 */
+	constexpr uint64_t kAlignment = 64;
+
+	struct Header
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t entityCount;
+		uint32_t sectionCount;
+		uint64_t fileSize;
+		uint64_t reserved;
+	};
+
+	struct Section
+	{
+		uint32_t columnId;
+		uint32_t elementSize;
+
+		/**
+		 * Equal to the entity count for columns.
+		 */
+		uint64_t elementCount;
+		uint64_t offset;
+		uint64_t size;
+	};
+}
+
+class SceneWriter
+{
+public:
+
+	explicit SceneWriter(uint32_t entityCount);
+
+	/**
+	 * The data is not copied, it must stay alive until Write.
+	 */
+	void AddColumn(uint32_t columnId, uint32_t elementSize, const void* data);
+
+	template<typename T, typename Allocator>
+	void AddColumn(uint32_t columnId, const std::vector<T, Allocator>& column);
+
+	/**
+	 * Same as AddColumn, but not tied to the entity count. Shares the ID space with the columns.
+	 */
+	void AddTable(uint32_t columnId, uint32_t elementSize, uint64_t elementCount, const void* data);
+
+	template<typename T, typename Allocator>
+	void AddTable(uint32_t columnId, const std::vector<T, Allocator>& table);
+
+	void Write(const std::string& path) const;
+
+private:
+
+	struct Column
+	{
+		uint32_t columnId;
+		uint32_t elementSize;
+		uint64_t elementCount;
+		const void* data;
+	};
+
+	uint32_t m_entityCount;
+	std::vector<Column> m_columns;
+};
+
+/**
+ * Maps a scene file and validates it. Columns point straight into the mapping and live as long as the SceneFile.
+ */
+class SceneFile
+{
+public:
+
+	explicit SceneFile(const std::string& path);
+	~SceneFile();
+
+	SceneFile(const SceneFile&) = delete;
+	SceneFile& operator=(const SceneFile&) = delete;
+
+	[[nodiscard]] uint32_t GetEntityCount() const;
+	[[nodiscard]] bool HasColumn(uint32_t columnId) const;
+
+	/**
+	 * Throws if the column is missing, was written with a different element size or is not one element per entity.
+	 */
+	[[nodiscard]] const void* GetColumn(uint32_t columnId, uint32_t elementSize) const;
+
+	template<typename T>
+	[[nodiscard]] const T* GetColumn(uint32_t columnId) const;
+
+	/**
+	 * Throws if the table is missing or was written with a different element size.
+	 */
+	[[nodiscard]] std::span<const std::byte> GetTable(uint32_t columnId, uint32_t elementSize) const;
+
+	template<typename T>
+	[[nodiscard]] std::span<const T> GetTable(uint32_t columnId) const;
+
+private:
+
+	[[nodiscard]] const SceneFormat::Section* FindSection(uint32_t columnId) const;
+
+	std::string m_path;
+	std::unique_ptr<MappedFile> m_file;
+
+	const SceneFormat::Header* m_header{};
+	const SceneFormat::Section* m_sections{};
+};
+
+template<typename T, typename Allocator>
+void SceneWriter::AddColumn(uint32_t columnId, const std::vector<T, Allocator>& column) {
+
+	static_assert(std::is_trivially_copyable_v<T>, "Scene columns are stored as raw bytes");
+	this->AddColumn(columnId, static_cast<uint32_t>(sizeof(T)), column.data());
+}
+
+template<typename T, typename Allocator>
+void SceneWriter::AddTable(uint32_t columnId, const std::vector<T, Allocator>& table) {
+
+	static_assert(std::is_trivially_copyable_v<T>, "Scene tables are stored as raw bytes");
+	this->AddTable(columnId, static_cast<uint32_t>(sizeof(T)), table.size(), table.data());
+}
+
+template<typename T>
+const T* SceneFile::GetColumn(uint32_t columnId) const {
+
+	static_assert(std::is_trivially_copyable_v<T>, "Scene columns are stored as raw bytes");
+	static_assert(alignof(T) <= SceneFormat::kAlignment);
+	return static_cast<const T*>(this->GetColumn(columnId, static_cast<uint32_t>(sizeof(T))));
+}
+
+template<typename T>
+std::span<const T> SceneFile::GetTable(uint32_t columnId) const {
+
+	static_assert(std::is_trivially_copyable_v<T>, "Scene tables are stored as raw bytes");
+	static_assert(alignof(T) <= SceneFormat::kAlignment);
+	const std::span<const std::byte> bytes = this->GetTable(columnId, static_cast<uint32_t>(sizeof(T)));
+	return { reinterpret_cast<const T*>(bytes.data()), bytes.size() / sizeof(T) };
+}
\ No newline at end of file
@@ -0,0 +1,126 @@
+#include "SpatialHashGrid.hpp"
+
+#include <tracy/Tracy.hpp>
+
+#include "../jobs/JobSystem.hpp"
+#include "../../pch.hpp"
+
+SpatialHashGrid::SpatialHashGrid(JobSystem* jobSystem, const SpatialHashGrid::Desc& desc) {
+
+    if (desc.bucketCount == 0 || (desc.bucketCount & (desc.bucketCount - 1)) != 0) {
+        throw std::runtime_error("[SpatialHashGrid] Bucket count must be a power of two");
+    }
+    if (desc.cellSize <= 0.0f) {
+        throw std::runtime_error("[SpatialHashGrid] Cell size must be positive");
+    }
+
+    m_jobSystem = jobSystem;
+    m_cellSize = desc.cellSize;
+    m_inverseCellSize = 1.0f / desc.cellSize;
+    m_bucketMask = desc.bucketCount - 1;
+
+    m_bucketStart.assign(desc.bucketCount + 1, 0);
+}
+
+void SpatialHashGrid::Rebuild(const glm::vec4* positions, uint32_t count) {
+
+    ZoneScoped;
+
+    const uint32_t bucketCount = m_bucketMask + 1;
+
+    m_entries.resize(count);
+    m_sourceBuckets.resize(count);
+
+    if (count == 0) {
+        std::fill(m_bucketStart.begin(), m_bucketStart.end(), 0);
+        return;
+    }
+
+    // One histogram per batch, so the batches never write to shared counters.
+    const uint32_t batchCount = std::min(m_jobSystem->GetThreadCount(), (count + kMinBatchSize - 1) / kMinBatchSize);
+    const uint32_t batchSize = (count + batchCount - 1) / batchCount;
+    m_batchBucketOffsets.resize(static_cast<size_t>(batchCount) * bucketCount);
+
+    m_jobSystem->ParallelFor("Grid count", batchCount, 1, [=, this](uint32_t beginBatch, uint32_t endBatch)
+    {
+        for (uint32_t batch = beginBatch; batch < endBatch; batch++) {
+
+            uint32_t* histogram = m_batchBucketOffsets.data() + static_cast<size_t>(batch) * bucketCount;
+            std::fill(histogram, histogram + bucketCount, 0);
+
+            const uint32_t end = std::min(count, (batch + 1) * batchSize);
+            for (uint32_t ind = batch * batchSize; ind < end; ind++) {
+
+                const uint32_t bucket = this->GetBucket(this->GetCellCoordinate(positions[ind].x), this->GetCellCoordinate(positions[ind].y));
+                m_sourceBuckets[ind] = bucket;
+                histogram[bucket] += 1;
+            }
+        }
+    });
+
+    {
+        ZoneScopedN("Grid scan");
+
+        // Within a bucket, batches are laid out in order, which keeps the sort stable.
+        m_jobSystem->ParallelFor("Grid bucket scan", bucketCount, kMinBatchSize, [=, this](uint32_t begin, uint32_t end)
+        {
+            for (uint32_t bucket = begin; bucket < end; bucket++) {
+
+                uint32_t bucketSize = 0;
+                for (uint32_t batch = 0; batch < batchCount; batch++) {
+
+                    uint32_t& offset = m_batchBucketOffsets[static_cast<size_t>(batch) * bucketCount + bucket];
+                    const uint32_t batchBucketSize = offset;
+                    offset = bucketSize;
+                    bucketSize += batchBucketSize;
+                }
+
+                m_bucketStart[bucket] = bucketSize;
+            }
+        });
+
+        uint32_t bucketStart = 0;
+        for (uint32_t bucket = 0; bucket < bucketCount; bucket++) {
+
+            const uint32_t bucketSize = m_bucketStart[bucket];
+            m_bucketStart[bucket] = bucketStart;
+            bucketStart += bucketSize;
+        }
+        m_bucketStart[bucketCount] = bucketStart;
+    }
+
+    m_jobSystem->ParallelFor("Grid scatter", batchCount, 1, [=, this](uint32_t beginBatch, uint32_t endBatch)
+    {
+        for (uint32_t batch = beginBatch; batch < endBatch; batch++) {
+
+            uint32_t* offsets = m_batchBucketOffsets.data() + static_cast<size_t>(batch) * bucketCount;
+
+            const uint32_t end = std::min(count, (batch + 1) * batchSize);
+            for (uint32_t ind = batch * batchSize; ind < end; ind++) {
+
+                const uint32_t bucket = m_sourceBuckets[ind];
+                m_entries[m_bucketStart[bucket] + offsets[bucket]++] = Entry{
+                    .x = positions[ind].x,
+                    .y = positions[ind].y,
+                    .index = ind
+                };
+            }
+        }
+    });
+}
+
+void SpatialHashGrid::QueryRadius(glm::vec2 center, float radius, std::vector<uint32_t>& result) const {
+    this->ForEachInRadius(center, radius, [&result](uint32_t index) { result.push_back(index); });
+}
+
+void SpatialHashGrid::QueryBox(glm::vec2 min, glm::vec2 max, std::vector<uint32_t>& result) const {
+    this->ForEachInBox(min, max, [&result](uint32_t index) { result.push_back(index); });
+}
+
+uint32_t SpatialHashGrid::GetEntryCount() const {
+    return static_cast<uint32_t>(m_entries.size());
+}
+
+float SpatialHashGrid::GetCellSize() const {
+    return m_cellSize;
+}
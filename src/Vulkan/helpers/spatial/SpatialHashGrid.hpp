@@ -0,0 +1,148 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
+
+class JobSystem;
+
+/**
+ * Uniform grid over the XY plane, hashed into a fixed number of buckets.
+ *
+ * Rebuilt from scratch with a parallel counting sort, so every bucket ends up as a contiguous range of entries.
+ * Entries keep a copy of the position, queries never touch the source array.
+ * Results are indices into the array passed to Rebuild.
+ */
+class SpatialHashGrid
+{
+public:
+
+	struct Desc
+	{
+		float cellSize;
+
+		/**
+		 * Must be a power of two. Distinct cells that hash into the same bucket are filtered out by the queries.
+		 */
+		uint32_t bucketCount;
+	};
+
+	SpatialHashGrid(JobSystem* jobSystem, const SpatialHashGrid::Desc& desc);
+
+	/**
+	 * Only x and y of the positions are used.
+	 */
+	void Rebuild(const glm::vec4* positions, uint32_t count);
+
+	/**
+	 * Appends the indices of the entries inside the circle / box to result.
+	 * Cost grows with the number of cells the query covers, so it is meant for small, local queries.
+	 */
+	void QueryRadius(glm::vec2 center, float radius, std::vector<uint32_t>& result) const;
+	void QueryBox(glm::vec2 min, glm::vec2 max, std::vector<uint32_t>& result) const;
+
+	template<typename Function>
+	void ForEachInRadius(glm::vec2 center, float radius, Function&& function) const;
+
+	template<typename Function>
+	void ForEachInBox(glm::vec2 min, glm::vec2 max, Function&& function) const;
+
+	[[nodiscard]] uint32_t GetEntryCount() const;
+	[[nodiscard]] float GetCellSize() const;
+
+private:
+
+	struct Entry
+	{
+		float x;
+		float y;
+		uint32_t index;
+	};
+
+	static constexpr uint32_t kMinBatchSize = 16384;
+
+	[[nodiscard]] int32_t GetCellCoordinate(float position) const;
+	[[nodiscard]] uint32_t GetBucket(int32_t cellX, int32_t cellY) const;
+
+	template<typename Function>
+	void ForEachInCells(glm::vec2 min, glm::vec2 max, Function&& function) const;
+
+	JobSystem* m_jobSystem;
+
+	float m_cellSize;
+	float m_inverseCellSize;
+	uint32_t m_bucketMask;
+
+	/**
+	 * bucketCount + 1 offsets into m_entries. Bucket b is [m_bucketStart[b], m_bucketStart[b + 1]).
+	 */
+	std::vector<uint32_t> m_bucketStart;
+	std::vector<Entry> m_entries;
+
+	// Rebuild scratch, kept around to avoid reallocating every frame.
+	std::vector<uint32_t> m_batchBucketOffsets;
+	std::vector<uint32_t> m_sourceBuckets;
+};
+
+inline int32_t SpatialHashGrid::GetCellCoordinate(float position) const {
+	return static_cast<int32_t>(std::floor(position * m_inverseCellSize));
+}
+
+inline uint32_t SpatialHashGrid::GetBucket(int32_t cellX, int32_t cellY) const {
+	// Large primes from "Optimized Spatial Hashing for Collision Detection of Deformable Objects".
+	return (static_cast<uint32_t>(cellX) * 73856093u ^ static_cast<uint32_t>(cellY) * 19349663u) & m_bucketMask;
+}
+
+template<typename Function>
+void SpatialHashGrid::ForEachInCells(glm::vec2 min, glm::vec2 max, Function&& function) const {
+
+	const int32_t minCellX = this->GetCellCoordinate(min.x);
+	const int32_t minCellY = this->GetCellCoordinate(min.y);
+	const int32_t maxCellX = this->GetCellCoordinate(max.x);
+	const int32_t maxCellY = this->GetCellCoordinate(max.y);
+
+	for (int32_t cellY = minCellY; cellY <= maxCellY; cellY++) {
+		for (int32_t cellX = minCellX; cellX <= maxCellX; cellX++) {
+
+			const uint32_t bucket = this->GetBucket(cellX, cellY);
+			for (uint32_t ind = m_bucketStart[bucket]; ind < m_bucketStart[bucket + 1]; ind++) {
+
+				const Entry& entry = m_entries[ind];
+
+				// Skips other cells sharing the bucket, which also keeps results from being reported twice.
+				if (this->GetCellCoordinate(entry.x) != cellX || this->GetCellCoordinate(entry.y) != cellY) {
+					continue;
+				}
+
+				function(entry);
+			}
+		}
+	}
+}
+
+template<typename Function>
+void SpatialHashGrid::ForEachInRadius(glm::vec2 center, float radius, Function&& function) const {
+
+	const float radiusSquared = radius * radius;
+	this->ForEachInCells(center - glm::vec2(radius), center + glm::vec2(radius), [&](const Entry& entry)
+	{
+		const float dx = entry.x - center.x;
+		const float dy = entry.y - center.y;
+		if (dx * dx + dy * dy <= radiusSquared) {
+			function(entry.index);
+		}
+	});
+}
+
+template<typename Function>
+void SpatialHashGrid::ForEachInBox(glm::vec2 min, glm::vec2 max, Function&& function) const {
+
+	this->ForEachInCells(min, max, [&](const Entry& entry)
+	{
+		if (entry.x >= min.x && entry.x <= max.x && entry.y >= min.y && entry.y <= max.y) {
+			function(entry.index);
+		}
+	});
+}
\ No newline at end of file
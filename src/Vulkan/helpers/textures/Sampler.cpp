@@ -10,6 +10,7 @@
 Sampler::Sampler(const Context* context, const std::string& path) {
 
 	m_context = context;
+	m_path = path;
 
 	this->LoadImage(path);
 
@@ -63,7 +64,11 @@ void Sampler::Destroy() {
 
 	vkDestroyImage(m_context->GetDevice()->GetVkDevice(), m_image, nullptr);
 
-	m_context->GetDevice()->GetDeviceMemory()->FreeMemory(m_imageMemory);
+	m_context->GetDevice()->GetDeviceMemory()->FreeSubAllocation(DeviceMemory::SubAllocation{
+		.memory = m_imageMemory,
+		.offset = m_memoryOffset,
+		.size = m_allocatedMemorySize
+	});
 
 	m_image = VK_NULL_HANDLE;
 	m_imageMemory = VK_NULL_HANDLE;
@@ -81,6 +86,14 @@ VkImageLayout Sampler::GetVkImageLayout() const {
 	return m_layout;
 }
 
+const std::string& Sampler::GetPath() const {
+	return m_path;
+}
+
+VkDeviceSize Sampler::GetAllocatedMemorySize() const {
+	return m_allocatedMemorySize;
+}
+
 void Sampler::LoadImage(const std::string& path) {
 	int width, height;
 	int channelCount;
@@ -94,9 +107,7 @@ void Sampler::LoadImage(const std::string& path) {
 
 	StagingBuffer stagingBuffer(m_context, imageSize);
 
-	void* mappedMemory = stagingBuffer.MapMemory(stagingBuffer.GetBufferSize());
-	std::memcpy(mappedMemory, pixels, stagingBuffer.GetBufferSize());
-	stagingBuffer.UnmapMemory();
+	stagingBuffer.CopyData(pixels, imageSize);
 
 	stbi_image_free(pixels);
 
@@ -202,15 +213,47 @@ void Sampler::TransitionLayout(VkCommandBuffer commandBuffer, const TransitionDe
 }
 
 void Sampler::AllocateImage(VkMemoryPropertyFlags memoryProperty) {
+
+	DeviceMemory* deviceMemory = m_context->GetDevice()->GetDeviceMemory();
+	const VkDevice device = m_context->GetDevice()->GetVkDevice();
+
+	VkMemoryDedicatedRequirementsKHR dedicatedRequirements = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS_KHR
+	};
+
 	VkMemoryRequirements memoryRequirements;
-	vkGetImageMemoryRequirements(m_context->GetDevice()->GetVkDevice(), m_image, &memoryRequirements);
+	if (deviceMemory->IsDedicatedAllocationSupported()) {
+
+		const VkImageMemoryRequirementsInfo2KHR requirementsInfo = {
+			.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2_KHR,
+			.image = m_image
+		};
+
+		VkMemoryRequirements2KHR memoryRequirements2 = {
+			.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2_KHR,
+			.pNext = &dedicatedRequirements
+		};
+
+		vkGetImageMemoryRequirements2KHR(device, &requirementsInfo, &memoryRequirements2);
+		memoryRequirements = memoryRequirements2.memoryRequirements;
+	}
+	else {
+		vkGetImageMemoryRequirements(device, m_image, &memoryRequirements);
+	}
 
 	const DeviceMemory::AllocationDesc desc = {
 		.memoryRequirements = memoryRequirements,
-		.memoryPropertyFlags = memoryProperty
+		.memoryPropertyFlags = memoryProperty,
+		.category = MemoryCategory::Texture,
+		.prefersDedicated = dedicatedRequirements.prefersDedicatedAllocation == VK_TRUE,
+		.requiresDedicated = dedicatedRequirements.requiresDedicatedAllocation == VK_TRUE,
+		.image = m_image
 	};
-	m_imageMemory = m_context->GetDevice()->GetDeviceMemory()->AllocateMemory(desc);
+	const DeviceMemory::SubAllocation subAllocation = deviceMemory->SubAllocate(desc);
+
+	m_imageMemory = subAllocation.memory;
+	m_memoryOffset = subAllocation.offset;
 
-	m_allocatedMemorySize = memoryRequirements.size;
-	vkBindImageMemory(m_context->GetDevice()->GetVkDevice(), m_image, m_imageMemory, 0);
+	m_allocatedMemorySize = subAllocation.size;
+	vkBindImageMemory(device, m_image, m_imageMemory, m_memoryOffset);
 }
@@ -17,6 +17,9 @@ public:
 	[[nodiscard]] VkImageView GetVkImageView() const;
 	[[nodiscard]] VkImageLayout GetVkImageLayout() const;
 
+	[[nodiscard]] const std::string& GetPath() const;
+	[[nodiscard]] VkDeviceSize GetAllocatedMemorySize() const;
+
 private:
 
 	void LoadImage(const std::string& path);
@@ -35,9 +38,11 @@ private:
 	void AllocateImage(VkMemoryPropertyFlags memoryProperty);
 
 	const Context* m_context;
+	std::string m_path;
 
 	VkImage m_image{};
 	VkDeviceMemory m_imageMemory{};
+	VkDeviceSize m_memoryOffset = 0;
 
 	VkImageView m_imageView{};
 	VkSampler m_sampler{};
@@ -0,0 +1,63 @@
+#include "TimingWheel.hpp"
+
+#include <bit>
+#include <algorithm>
+
+TimingWheel::TimingWheel(uint64_t currentTick) {
+    m_currentTick = currentTick;
+}
+
+void TimingWheel::Clear(uint64_t currentTick) {
+
+    for (auto& level : m_slots) {
+        for (auto& slot : level) {
+            slot.clear();
+        }
+    }
+
+    m_currentTick = currentTick;
+    m_size = 0;
+}
+
+void TimingWheel::Schedule(uint32_t item, uint64_t tick) {
+
+    this->Place(Entry{
+        .tick = std::max(tick, m_currentTick + 1),
+        .item = item
+    });
+    m_size++;
+}
+
+uint64_t TimingWheel::GetCurrentTick() const {
+    return m_currentTick;
+}
+
+size_t TimingWheel::GetSize() const {
+    return m_size;
+}
+
+void TimingWheel::Place(const Entry& entry) {
+
+    // Items beyond the top level's range wrap around on it and get placed again when their slot comes up.
+    const uint64_t difference = entry.tick ^ m_currentTick;
+    const uint32_t level = std::min(difference == 0 ? 0 : static_cast<uint32_t>(std::bit_width(difference) - 1) / kSlotBits, kLevelCount - 1);
+
+    const uint32_t slot = static_cast<uint32_t>(entry.tick >> (level * kSlotBits)) & (kSlotCount - 1);
+    m_slots[level][slot].push_back(entry);
+}
+
+void TimingWheel::Cascade(uint32_t level) {
+
+    const uint32_t slot = static_cast<uint32_t>(m_currentTick >> (level * kSlotBits)) & (kSlotCount - 1);
+
+    std::swap(m_slots[level][slot], m_processing);
+    for (const Entry& entry : m_processing) {
+        this->Place(entry);
+    }
+
+    // Only wrapped around items on the top level can land in the same slot again.
+    m_processing.clear();
+    if (m_slots[level][slot].empty()) {
+        std::swap(m_slots[level][slot], m_processing);
+    }
+}
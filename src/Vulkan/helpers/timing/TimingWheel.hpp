@@ -0,0 +1,106 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+
+/**
+ * Hierarchical timing wheel over uint32_t items, e.g. dense indices.
+ *
+ * Level 0 has one slot per tick for the next kSlotCount ticks. Every level above covers kSlotCount times the range
+ * of the one below, one slot per range of the level below. Items far in the future wait on a higher level and are
+ * moved down when the wheel gets there, so scheduling and expiring cost O(1) however far ahead an item is.
+ */
+class TimingWheel
+{
+public:
+
+	static constexpr uint32_t kSlotBits = 8;
+	static constexpr uint32_t kSlotCount = 1 << kSlotBits;
+	static constexpr uint32_t kLevelCount = 4;
+
+	explicit TimingWheel(uint64_t currentTick = 0);
+
+	/**
+	 * Drops every item and restarts the wheel at the given tick.
+	 */
+	void Clear(uint64_t currentTick);
+
+	/**
+	 * Ticks at or before the current tick expire on the next tick.
+	 */
+	void Schedule(uint32_t item, uint64_t tick);
+
+	/**
+	 * Moves the wheel forward to the given tick and calls expired(item) for every item due up to it, in tick order.
+	 * Items may be scheduled again from inside the callback.
+	 */
+	template<typename Function>
+	void Advance(uint64_t tick, Function&& expired);
+
+	[[nodiscard]] uint64_t GetCurrentTick() const;
+	[[nodiscard]] size_t GetSize() const;
+
+private:
+
+	struct Entry
+	{
+		uint64_t tick;
+		uint32_t item;
+	};
+
+	/**
+	 * The level is the highest group of kSlotBits in which the tick differs from the current tick.
+	 */
+	void Place(const Entry& entry);
+
+	/**
+	 * Moves the current slot of a level into the levels below.
+	 */
+	void Cascade(uint32_t level);
+
+	std::array<std::array<std::vector<Entry>, kSlotCount>, kLevelCount> m_slots;
+
+	// Slot being processed. Swapped in and out, so slots keep their capacity.
+	std::vector<Entry> m_processing;
+
+	uint64_t m_currentTick;
+	size_t m_size = 0;
+};
+
+template<typename Function>
+void TimingWheel::Advance(uint64_t tick, Function&& expired) {
+
+	while (m_currentTick < tick) {
+
+		m_currentTick++;
+
+		// A level's current slot moves down whenever all the bits below it wrap around. Higher levels go first,
+		// so their items can still land in the lower slots that are cascaded next.
+		uint32_t cascadeLevel = 0;
+		while (cascadeLevel + 1 < kLevelCount && (m_currentTick & ((uint64_t{ 1 } << ((cascadeLevel + 1) * kSlotBits)) - 1)) == 0) {
+			cascadeLevel++;
+		}
+		for (uint32_t level = cascadeLevel; level > 0; level--) {
+			this->Cascade(level);
+		}
+
+		std::vector<Entry>& slot = m_slots[0][m_currentTick & (kSlotCount - 1)];
+		if (slot.empty()) {
+			continue;
+		}
+
+		// Rescheduled items are always for a later tick, so they never end up in this slot.
+		std::swap(slot, m_processing);
+		m_size -= m_processing.size();
+
+		for (const Entry& entry : m_processing) {
+			expired(entry.item);
+		}
+
+		m_processing.clear();
+		std::swap(slot, m_processing);
+	}
+}
\ No newline at end of file
@@ -1,28 +1,44 @@
 #include "DefaultRenderer.hpp"
 
+#include <glm/common.hpp>
+
 #include "MainComponentSystem.hpp"
 #include "../helpers/buffers/GenericBuffer.hpp"
+#include "../helpers/jobs/TaskGraph.hpp"
 
 DefaultRenderer::DefaultRenderer(const Context* context, MainComponentSystem* componentSystem)
 	: MainRenderer(context, componentSystem) {
 
-	componentSystem->SetEntityCount(100);
+	componentSystem->RequestEntityCount(100);
 	m_maxEntityCount = 20000;
 }
 
 
 void DefaultRenderer::Draw(VkCommandBuffer commandBuffer) {
 
+	// Push constants are recorded straight from the component arrays.
+	const auto tasks = m_componentSystem->GetScheduledTasks();
+	m_frameGraph->Wait(tasks.movement);
+	m_frameGraph->Wait(tasks.animation);
+
 	const VkBuffer vertexBuffers[] = { m_vertexBuffer->GetVkBuffer() };
 	constexpr VkDeviceSize offsets[] = { 0 };
 
 	vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
 	vkCmdBindIndexBuffer(commandBuffer, m_indexBuffer->GetVkBuffer(), 0, VK_INDEX_TYPE_UINT16);
 
+	// default.vert has no previous translation, so the interpolation is done here.
+	const float blendFactor = m_componentSystem->GetBlendFactor();
+
 	for (uint32_t ind = 0; ind < m_componentSystem->GetEntityCount(); ind++) {
 
+		glm::vec4 translate = m_componentSystem->GetTransforms()[ind].translate;
+		if (blendFactor < 1.0f) {
+			translate = glm::mix(m_componentSystem->GetPreviousTransforms()[ind].translate, translate, blendFactor);
+		}
+
 		PerObject perObject = {
-			.translate = m_componentSystem->GetTransforms()[ind].translate,
+			.translate = translate,
 			.uv = m_componentSystem->GetSprites()[ind]
 		};
 
@@ -2,6 +2,9 @@
 
 #include "../pch.hpp"
 #include "../helpers/buffers/GenericBuffer.hpp"
+#include "../helpers/Context.hpp"
+#include "../helpers/jobs/JobSystem.hpp"
+#include "../helpers/jobs/TaskGraph.hpp"
 
 #include <tracy/Tracy.hpp>
 
@@ -27,18 +30,15 @@ void InstancedRenderer::Destroy() {
 
 void InstancedRenderer::CreateInstanceBuffer() {
 
-    GenericBuffer::Desc desc = {
-        .bufferCreateInfo = VkBufferCreateInfo {
-            .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-            .size = MainComponentSystem::kMaxEntityCount * sizeof(InstanceData),
-            .usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-            .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
-        },
-        .memoryProperty = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
-    };
+    constexpr VkMemoryPropertyFlags memoryProperty = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    const uint32_t capacity = this->FitInstanceCapacity(memoryProperty, sizeof(InstanceData));
 
-    m_instancedBuffer = std::make_unique<GenericBuffer>(m_context, desc);
-    m_instancedBuffer->MapMemory(m_instancedBuffer->GetBufferSize());
+    m_instancedBuffer = std::make_unique<SegmentedInstanceBuffer>(m_context, SegmentedInstanceBuffer::Desc{
+        .stride = sizeof(InstanceData),
+        .firstSegmentCapacity = kFirstSegmentCapacity,
+        .maxCapacity = capacity,
+        .memoryProperty = memoryProperty
+    });
 }
 
 
@@ -47,42 +47,78 @@ void InstancedRenderer::UpdateInstanceBuffer() {
 
     ZoneScoped;
 
-    const uint32_t instanceCount = m_componentSystem->GetEntityCount();
-
-
     static bool writeData = true;
     ImGui::Checkbox("Write data", &writeData);
 
-
-	InstanceData data{};
-    for (size_t ind = 0; ind < instanceCount; ind++) {
-
-        data.translate = m_componentSystem->GetTransforms()[ind].translate;
-        //data.rotation = {};
-        data.sprite = m_componentSystem->GetSprites()[ind];
-
-        if (!writeData) {
-            continue;
-        }
-
-        const auto instances = static_cast<InstanceData*>(m_instancedBuffer->GetMappedMemory());
-        instances[ind] = data;
-    }
+    // The previous frame is done with the segments, and the count does not change until the next frame.
+    m_instancedBuffer->Resize(this->GetInstanceCount());
+
+    const auto tasks = m_componentSystem->GetScheduledTasks();
+    m_frameGraph->AddTask("Instance upload", [this, writeData = writeData]
+    {
+        const uint32_t instanceCount = std::min(this->GetInstanceCount(), m_instancedBuffer->GetCapacity());
+
+        const MainComponentSystem::Transform* transforms = m_componentSystem->GetTransforms().data();
+        const MainComponentSystem::Sprite* sprites = m_componentSystem->GetSprites().data();
+        const SegmentedInstanceBuffer* instancedBuffer = m_instancedBuffer.get();
+
+        const bool interpolate = m_componentSystem->GetBlendFactor() < 1.0f;
+        const MainComponentSystem::Transform* previousTransforms = interpolate ? m_componentSystem->GetPreviousTransforms().data() : transforms;
+
+        m_context->GetJobSystem()->ParallelFor("Instance upload batch", instanceCount, kMinUploadBatchSize, [=](uint32_t begin, uint32_t end)
+        {
+            instancedBuffer->ForEachRange<InstanceData>(begin, end, [=](InstanceData* instances, uint32_t rangeBegin, uint32_t rangeEnd)
+            {
+                InstanceData data{};
+                for (uint32_t ind = rangeBegin; ind < rangeEnd; ind++) {
+
+                    data.translate = transforms[ind].translate;
+                    //data.rotation = {};
+                    data.sprite = sprites[ind];
+                    data.previousTranslate = previousTransforms[ind].translate;
+
+                    if (!writeData) {
+                        continue;
+                    }
+
+                    instances[ind - rangeBegin] = data;
+                }
+            });
+        });
+    }, { tasks.movement, tasks.animation });
 }
 
 void InstancedRenderer::DestroyInstanceBuffer() {
 
     m_instancedBuffer->Destroy();
-    m_instancedBuffer = nullptr;
+    m_instancedBuffer.reset();
 }
 
 void InstancedRenderer::Draw(VkCommandBuffer commandBuffer) {
 
-    const VkBuffer vertexBuffers[] = { m_vertexBuffer->GetVkBuffer(), m_instancedBuffer->GetVkBuffer() };
-    constexpr VkDeviceSize offsets[] = { 0, 0 };
-    vkCmdBindVertexBuffers(commandBuffer, 0, 2, vertexBuffers, offsets);
+    const VkBuffer vertexBuffer = m_vertexBuffer->GetVkBuffer();
+    constexpr VkDeviceSize offset = 0;
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, &offset);
     vkCmdBindIndexBuffer(commandBuffer, m_indexBuffer->GetVkBuffer(), 0, VK_INDEX_TYPE_UINT16);
-    vkCmdDrawIndexed(commandBuffer, 6, m_componentSystem->GetEntityCount(), 0, 0, 0);
+
+    // One draw per segment. Instance attributes are fetched at firstInstance plus the instance number, so every
+    // segment is bound at offset 0 and drawn from firstInstance 0.
+    const uint32_t instanceCount = std::min(this->GetInstanceCount(), m_instancedBuffer->GetCapacity());
+    for (uint32_t segmentIndex = 0; segmentIndex < m_instancedBuffer->GetSegmentCount(); segmentIndex++) {
+
+        const SegmentedInstanceBuffer::Segment& segment = m_instancedBuffer->GetSegment(segmentIndex);
+        if (segment.firstInstance >= instanceCount) {
+            break;
+        }
+
+        const VkBuffer instanceBuffer = segment.buffer->GetVkBuffer();
+        vkCmdBindVertexBuffers(commandBuffer, 1, 1, &instanceBuffer, &offset);
+        vkCmdDrawIndexed(commandBuffer, 6, std::min(segment.capacity, instanceCount - segment.firstInstance), 0, 0, 0);
+    }
+}
+
+VkDeviceSize InstancedRenderer::GetResidentInstanceSize() const {
+    return m_instancedBuffer->GetResidentSize();
 }
 
 
@@ -141,6 +177,12 @@ MainRenderPipeline::VertexFormat InstancedRenderer::GetVertexFormat() const {
 	            .binding = 1,
 	            .format = VK_FORMAT_R32G32B32A32_SFLOAT,
 	            .offset = offsetof(InstanceData, sprite)
+	        },
+	        VkVertexInputAttributeDescription{
+	            .location = 5,
+	            .binding = 1,
+	            .format = VK_FORMAT_R32G32B32A32_SFLOAT,
+	            .offset = offsetof(InstanceData, previousTranslate)
 	        }
 	    }
     };
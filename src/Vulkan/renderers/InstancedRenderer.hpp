@@ -2,6 +2,7 @@
 
 #include "MainRenderer.hpp"
 #include "MainComponentSystem.hpp"
+#include "../helpers/buffers/SegmentedInstanceBuffer.hpp"
 
 class InstancedRenderer : public MainRenderer
 {
@@ -18,16 +19,22 @@ public:
 	void Draw(VkCommandBuffer commandBuffer) override;
 	void UpdateBuffers() override;
 
+	[[nodiscard]] VkDeviceSize GetResidentInstanceSize() const override;
+
 	MainRenderPipeline::VertexFormat GetVertexFormat() const override;
 
 private:
 
+	static constexpr uint32_t kMinUploadBatchSize = 8192;
+	static constexpr uint32_t kFirstSegmentCapacity = 64 * 1024;
+
 	struct InstanceData
 	{
 		glm::vec4 translate;
 		glm::vec4 rotation;
 		MainComponentSystem::Sprite sprite;
+		glm::vec4 previousTranslate;
 	};
 
-	std::unique_ptr<GenericBuffer> m_instancedBuffer;
+	std::unique_ptr<SegmentedInstanceBuffer> m_instancedBuffer;
 };
\ No newline at end of file
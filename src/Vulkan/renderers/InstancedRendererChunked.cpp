@@ -4,11 +4,21 @@
 
 #include "../pch.hpp"
 #include "../helpers/buffers/GenericBuffer.hpp"
+#include "../helpers/Context.hpp"
+#include "../helpers/jobs/JobSystem.hpp"
+#include "../helpers/jobs/TaskGraph.hpp"
 
+#include <bit>
 #include <tracy/Tracy.hpp>
 
 #include "MainComponentSystem.hpp"
 
+// The columns are bound as the translation stream when they can be imported.
+static_assert(sizeof(MainComponentSystem::Transform) == sizeof(glm::vec4));
+
+// With the same stride every stream is split into the same segments.
+static_assert(sizeof(MainComponentSystem::Sprite) == sizeof(glm::vec4));
+
 constexpr std::size_t constexpr_strlen(const char* str) {
     return *str ? 1 + constexpr_strlen(str + 1) : 0;
 }
@@ -29,39 +39,65 @@ void InstancedRendererChunked::Destroy() {
 
 void InstancedRendererChunked::CreateInstanceBuffers() {
 
+    constexpr VkMemoryPropertyFlags memoryProperty = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    const uint32_t capacity = this->FitInstanceCapacity(memoryProperty, 3 * sizeof(glm::vec4) + sizeof(MainComponentSystem::Sprite));
+
+    // The same first segment capacity and stride keep the segment boundaries of all streams in line.
+    const auto createStream = [&](uint32_t stride)
+    {
+        return std::make_unique<SegmentedInstanceBuffer>(m_context, SegmentedInstanceBuffer::Desc{
+            .stride = stride,
+            .firstSegmentCapacity = kFirstSegmentCapacity,
+            .maxCapacity = capacity,
+            .memoryProperty = memoryProperty
+        });
+    };
 
-    m_instancedTranslationBuffer = std::make_unique<GenericBuffer>(m_context, GenericBuffer::Desc{
-        .bufferCreateInfo = VkBufferCreateInfo {
-            .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-            .size = MainComponentSystem::kMaxEntityCount * sizeof(glm::vec4),
-            .usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-            .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
-        },
-        .memoryProperty = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
-    });
-    m_instancedTranslationBuffer->MapMemory(m_instancedTranslationBuffer->GetBufferSize());
-
-    m_instancedRotationBuffer = std::make_unique<GenericBuffer>(m_context, GenericBuffer::Desc{
-	    .bufferCreateInfo = VkBufferCreateInfo {
-	        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-	        .size = MainComponentSystem::kMaxEntityCount * sizeof(glm::vec4),
-	        .usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-	        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
-	    },
-	    .memoryProperty = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
-    });
-    m_instancedRotationBuffer->MapMemory(m_instancedRotationBuffer->GetBufferSize());
-
-    m_instancedSpriteBuffer = std::make_unique<GenericBuffer>(m_context, GenericBuffer::Desc{
-	    .bufferCreateInfo = VkBufferCreateInfo {
-	        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-	        .size = MainComponentSystem::kMaxEntityCount * sizeof(MainComponentSystem::Sprite),
-	        .usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-	        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
-	    },
-	    .memoryProperty = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+    m_instancedTranslationBuffer = createStream(sizeof(glm::vec4));
+    m_instancedRotationBuffer = createStream(sizeof(glm::vec4));
+    m_instancedSpriteBuffer = createStream(sizeof(MainComponentSystem::Sprite));
+    m_instancedPreviousTranslationBuffer = createStream(sizeof(glm::vec4));
+
+    m_translationSource = nullptr;
+    m_spriteSource = nullptr;
+    m_previousTranslationSource = nullptr;
+
+    m_zeroCopy = m_context->GetDevice()->GetDeviceMemory()->IsHostImportSupported();
+    if (m_zeroCopy) {
+
+        // There is no rotation component, so with nothing else to copy per frame it is written once.
+        this->ClearRotations();
+        spdlog::info("[InstancedRendererChunked] Binding the component columns directly");
+    }
+}
+
+bool InstancedRendererChunked::ReadsComponentMemory() const {
+    return m_translationSource != nullptr || m_spriteSource != nullptr || m_previousTranslationSource != nullptr;
+}
+
+void InstancedRendererChunked::ResizeStreams(uint32_t instanceCount) {
+
+    // Streams replaced by an imported column only keep their first segment.
+    m_instancedTranslationBuffer->Resize(m_translationSource == nullptr ? instanceCount : 0);
+    m_instancedPreviousTranslationBuffer->Resize(m_previousTranslationSource == nullptr ? instanceCount : 0);
+
+    if (m_instancedSpriteBuffer->Resize(m_spriteSource == nullptr ? instanceCount : 0)) {
+
+        // New segments do not hold the previous version.
+        m_uploadedSpriteVersion = std::nullopt;
+    }
+
+    if (m_instancedRotationBuffer->Resize(instanceCount) && m_zeroCopy) {
+        this->ClearRotations();
+    }
+}
+
+void InstancedRendererChunked::ClearRotations() const {
+
+    m_instancedRotationBuffer->ForEachRange<glm::vec4>(0, m_instancedRotationBuffer->GetCapacity(), [](glm::vec4* rotations, uint32_t begin, uint32_t end)
+    {
+        std::fill(rotations, rotations + (end - begin), glm::vec4{});
     });
-    m_instancedSpriteBuffer->MapMemory(m_instancedSpriteBuffer->GetBufferSize());
 }
 
 
@@ -70,8 +106,6 @@ void InstancedRendererChunked::UpdateInstanceBuffers() {
 
     ZoneScoped;
 
-    const uint32_t instanceCount = m_componentSystem->GetEntityCount();
-
     static bool writeData = true;
     ImGui::Checkbox("Write data", &writeData);
 
@@ -79,44 +113,247 @@ void InstancedRendererChunked::UpdateInstanceBuffers() {
         return;
     }
 
-    for (size_t ind = 0; ind < instanceCount; ind++) {
-        const auto translationBuffer = static_cast<glm::vec4*>(m_instancedTranslationBuffer->GetMappedMemory());
-        translationBuffer[ind] = m_componentSystem->GetTransforms()[ind].translate;
+    // The previous frame is done with the segments, and the count does not change until the next frame.
+    const uint32_t instanceCount = this->GetInstanceCount();
+
+    const auto tasks = m_componentSystem->GetScheduledTasks();
+
+    if (m_zeroCopy) {
+
+        // Fixed-rate steps swap the current and previous transform columns, so which one is bound is only known
+        // once movement is done.
+        m_frameGraph->Wait(tasks.movement);
+
+        const auto& transforms = m_componentSystem->GetTransforms();
+        const auto& sprites = m_componentSystem->GetSprites();
+        const auto& previousTransforms = m_componentSystem->GetPreviousTransforms();
+
+        m_translationSource = this->ImportColumn(transforms.data(), transforms.size() * sizeof(MainComponentSystem::Transform), transforms.capacity() * sizeof(MainComponentSystem::Transform));
+        m_spriteSource = this->ImportColumn(sprites.data(), sprites.size() * sizeof(MainComponentSystem::Sprite), sprites.capacity() * sizeof(MainComponentSystem::Sprite));
+
+        // The shader ignores the previous translation without a fixed rate, and the column may not exist yet.
+        bool imported = m_translationSource != nullptr && m_spriteSource != nullptr;
+        m_previousTranslationSource = nullptr;
+        if (m_componentSystem->GetBlendFactor() < 1.0f) {
+            m_previousTranslationSource = this->ImportColumn(previousTransforms.data(), previousTransforms.size() * sizeof(MainComponentSystem::Transform), previousTransforms.capacity() * sizeof(MainComponentSystem::Transform));
+            imported = imported && m_previousTranslationSource != nullptr;
+        }
+
+        if (imported) {
+            this->ResizeStreams(instanceCount);
+            ImGui::Text("Instance data: zero-copy");
+            return;
+        }
+
+        spdlog::warn("[InstancedRendererChunked] Could not import the component columns, copying the instance data instead");
+        m_zeroCopy = false;
+        m_uploadedSpriteVersion = std::nullopt;
     }
 
-    for (size_t ind = 0; ind < instanceCount; ind++) {
-        const auto rotationBuffer = static_cast<glm::vec4*>(m_instancedRotationBuffer->GetMappedMemory());
-        rotationBuffer[ind] = {};
+    m_translationSource = nullptr;
+    m_spriteSource = nullptr;
+    m_previousTranslationSource = nullptr;
+    this->ResizeStreams(instanceCount);
+    ImGui::Text("Instance data: copied");
+
+    // Every stream only waits for the system that produces it.
+    m_frameGraph->AddTask("Translation upload", [this]
+    {
+        const MainComponentSystem::Transform* transforms = m_componentSystem->GetTransforms().data();
+        const SegmentedInstanceBuffer* translationBuffer = m_instancedTranslationBuffer.get();
+
+        m_context->GetJobSystem()->ParallelFor("Translation upload batch", std::min(this->GetInstanceCount(), translationBuffer->GetCapacity()), kMinUploadBatchSize, [=](uint32_t begin, uint32_t end)
+        {
+            translationBuffer->ForEachRange<glm::vec4>(begin, end, [=](glm::vec4* translations, uint32_t rangeBegin, uint32_t rangeEnd)
+            {
+                for (uint32_t ind = rangeBegin; ind < rangeEnd; ind++) {
+                    translations[ind - rangeBegin] = transforms[ind].translate;
+                }
+            });
+        });
+    }, { tasks.movement });
+
+    if (m_componentSystem->GetBlendFactor() < 1.0f) {
+
+        m_frameGraph->AddTask("Previous translation upload", [this]
+        {
+            const MainComponentSystem::Transform* previousTransforms = m_componentSystem->GetPreviousTransforms().data();
+            const SegmentedInstanceBuffer* previousTranslationBuffer = m_instancedPreviousTranslationBuffer.get();
+
+            m_context->GetJobSystem()->ParallelFor("Previous translation upload batch", std::min(this->GetInstanceCount(), previousTranslationBuffer->GetCapacity()), kMinUploadBatchSize, [=](uint32_t begin, uint32_t end)
+            {
+                previousTranslationBuffer->ForEachRange<glm::vec4>(begin, end, [=](glm::vec4* previousTranslations, uint32_t rangeBegin, uint32_t rangeEnd)
+                {
+                    for (uint32_t ind = rangeBegin; ind < rangeEnd; ind++) {
+                        previousTranslations[ind - rangeBegin] = previousTransforms[ind].translate;
+                    }
+                });
+            });
+        }, { tasks.movement });
     }
 
-    for (size_t ind = 0; ind < instanceCount; ind++) {
-        const auto spriteBuffer = static_cast<MainComponentSystem::Sprite*>(m_instancedSpriteBuffer->GetMappedMemory());
-        spriteBuffer[ind] = m_componentSystem->GetSprites()[ind];
+    m_frameGraph->AddTask("Rotation upload", [this]
+    {
+        const SegmentedInstanceBuffer* rotationBuffer = m_instancedRotationBuffer.get();
+
+        m_context->GetJobSystem()->ParallelFor("Rotation upload batch", std::min(this->GetInstanceCount(), rotationBuffer->GetCapacity()), kMinUploadBatchSize, [=](uint32_t begin, uint32_t end)
+        {
+            rotationBuffer->ForEachRange<glm::vec4>(begin, end, [](glm::vec4* rotations, uint32_t rangeBegin, uint32_t rangeEnd)
+            {
+                for (uint32_t ind = rangeBegin; ind < rangeEnd; ind++) {
+                    rotations[ind - rangeBegin] = {};
+                }
+            });
+        });
+    });
+
+    m_frameGraph->AddTask("Sprite upload", [this]
+    {
+        const MainComponentSystem::Sprite* sprites = m_componentSystem->GetSprites().data();
+        const SegmentedInstanceBuffer* spriteBuffer = m_instancedSpriteBuffer.get();
+        const uint32_t instanceCount = std::min(this->GetInstanceCount(), spriteBuffer->GetCapacity());
+
+        // The buffer persists, so if it holds the previous version only the changed sprites need to be written.
+        const MainComponentSystem::SpriteChanges changes = m_componentSystem->GetSpriteChanges();
+        const bool uploadChanged = changes.changed != nullptr && m_uploadedSpriteVersion == changes.version - 1;
+        m_uploadedSpriteVersion = changes.version;
+
+        if (uploadChanged) {
+
+            const uint32_t* changed = changes.changed->data();
+            m_context->GetJobSystem()->ParallelFor("Changed sprite upload batch", static_cast<uint32_t>(changes.changed->size()), kMinUploadBatchSize, [=](uint32_t begin, uint32_t end)
+            {
+                for (uint32_t ind = begin; ind < end; ind++) {
+                    if (changed[ind] < instanceCount) {
+                        *spriteBuffer->GetInstance<MainComponentSystem::Sprite>(changed[ind]) = sprites[changed[ind]];
+                    }
+                }
+            });
+            return;
+        }
+
+        m_context->GetJobSystem()->ParallelFor("Sprite upload batch", instanceCount, kMinUploadBatchSize, [=](uint32_t begin, uint32_t end)
+        {
+            spriteBuffer->ForEachRange<MainComponentSystem::Sprite>(begin, end, [=](MainComponentSystem::Sprite* spriteData, uint32_t rangeBegin, uint32_t rangeEnd)
+            {
+                for (uint32_t ind = rangeBegin; ind < rangeEnd; ind++) {
+                    spriteData[ind - rangeBegin] = sprites[ind];
+                }
+            });
+        });
+    }, { tasks.animation });
+}
+
+const GenericBuffer* InstancedRendererChunked::ImportColumn(const void* data, size_t usedBytes, size_t capacityBytes) {
+
+    // Importing pins the pages, and the columns reserve far more than is usually used, so only a prefix is imported
+    // that doubles as the column fills up. The column owns whole pages, so the import may go up to the block end.
+    const VkDeviceSize size = std::min<VkDeviceSize>(std::bit_ceil(std::max(usedBytes, HugePages::kHugePageSize)), HugePages::GetBlockSize(capacityBytes));
+
+    const auto it = m_importedColumns.find(data);
+    if (it != m_importedColumns.end() && it->second->GetBufferSize() >= size) {
+        return it->second.get();
+    }
+
+    if (!HostImportedBuffer::CanImport(m_context, data, size)) {
+        return nullptr;
     }
+
+    // The import may reach past the elements in use, into pages that are only reserved.
+    HugePages::Commit(const_cast<void*>(data), size);
+
+    std::unique_ptr<HostImportedBuffer> buffer;
+    try {
+        buffer = std::make_unique<HostImportedBuffer>(m_context, HostImportedBuffer::Desc{
+            .usageFlags = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+            .hostPointer = const_cast<void*>(data),
+            .size = size,
+            .category = MemoryCategory::Instance
+        });
+    }
+    catch (const std::runtime_error& error) {
+        spdlog::warn("[InstancedRendererChunked] {}", error.what());
+        return nullptr;
+    }
+
+    spdlog::info("[InstancedRendererChunked] Imported {:.2f} MB of component storage", static_cast<double>(size) / 1024.0 / 1024.0);
+
+    // The smaller import is replaced only now, so it stays if the larger one fails. The previous frame is done with it.
+    if (it != m_importedColumns.end()) {
+        it->second->Destroy();
+    }
+
+    const GenericBuffer* result = buffer.get();
+    m_importedColumns.insert_or_assign(data, std::move(buffer));
+    return result;
 }
 
 void InstancedRendererChunked::DestroyInstanceBuffers() {
 
-    m_instancedRotationBuffer->Destroy();
-    m_instancedRotationBuffer = nullptr;
-    m_instancedSpriteBuffer->Destroy();
-    m_instancedSpriteBuffer = nullptr;
-    m_instancedTranslationBuffer->Destroy();
-    m_instancedTranslationBuffer = nullptr;
+    for (const auto& [data, buffer] : m_importedColumns) {
+        buffer->Destroy();
+    }
+    m_importedColumns.clear();
+
+    m_translationSource = nullptr;
+    m_spriteSource = nullptr;
+    m_previousTranslationSource = nullptr;
+
+    for (std::unique_ptr<SegmentedInstanceBuffer>* stream : { &m_instancedRotationBuffer, &m_instancedSpriteBuffer, &m_instancedTranslationBuffer, &m_instancedPreviousTranslationBuffer }) {
+        (*stream)->Destroy();
+        stream->reset();
+    }
+}
+
+InstancedRendererChunked::Binding InstancedRendererChunked::GetSegmentBinding(const SegmentedInstanceBuffer& stream, const GenericBuffer* importedColumn, uint32_t segmentIndex, uint32_t firstInstance, VkDeviceSize stride) {
+
+    // A stream that was replaced by the column only has its first segment left.
+    if (importedColumn != nullptr) {
+        return { importedColumn->GetVkBuffer(), firstInstance * stride };
+    }
+    return { stream.GetSegment(segmentIndex).buffer->GetVkBuffer(), 0 };
 }
 
 void InstancedRendererChunked::Draw(VkCommandBuffer commandBuffer) {
 
-    const VkBuffer vertexBuffers[] = {
-    	m_vertexBuffer->GetVkBuffer(),
-    	m_instancedTranslationBuffer->GetVkBuffer(),
-    	m_instancedRotationBuffer->GetVkBuffer(),
-    	m_instancedSpriteBuffer->GetVkBuffer(),
-    };
-    constexpr VkDeviceSize offsets[] = { 0, 0, 0, 0 };
-    vkCmdBindVertexBuffers(commandBuffer, 0, 4, vertexBuffers, offsets);
+    const VkBuffer vertexBuffer = m_vertexBuffer->GetVkBuffer();
+    constexpr VkDeviceSize vertexOffset = 0;
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, &vertexOffset);
     vkCmdBindIndexBuffer(commandBuffer, m_indexBuffer->GetVkBuffer(), 0, VK_INDEX_TYPE_UINT16);
-    vkCmdDrawIndexed(commandBuffer, 6, m_componentSystem->GetEntityCount(), 0, 0, 0);
+
+    // One draw per segment, see InstancedRenderer::Draw. The rotation stream is always bound, and every other stream
+    // that is bound has at least as many segments below the instance count.
+    const uint32_t instanceCount = std::min(this->GetInstanceCount(), m_instancedRotationBuffer->GetCapacity());
+    for (uint32_t segmentIndex = 0; segmentIndex < m_instancedRotationBuffer->GetSegmentCount(); segmentIndex++) {
+
+        const SegmentedInstanceBuffer::Segment& segment = m_instancedRotationBuffer->GetSegment(segmentIndex);
+        if (segment.firstInstance >= instanceCount) {
+            break;
+        }
+
+        const Binding bindings[] = {
+            GetSegmentBinding(*m_instancedTranslationBuffer, m_translationSource, segmentIndex, segment.firstInstance, sizeof(glm::vec4)),
+            GetSegmentBinding(*m_instancedRotationBuffer, nullptr, segmentIndex, segment.firstInstance, sizeof(glm::vec4)),
+            GetSegmentBinding(*m_instancedSpriteBuffer, m_spriteSource, segmentIndex, segment.firstInstance, sizeof(MainComponentSystem::Sprite)),
+            GetSegmentBinding(*m_instancedPreviousTranslationBuffer, m_previousTranslationSource, segmentIndex, segment.firstInstance, sizeof(glm::vec4))
+        };
+
+        VkBuffer instanceBuffers[std::size(bindings)];
+        VkDeviceSize offsets[std::size(bindings)];
+        for (size_t ind = 0; ind < std::size(bindings); ind++) {
+            instanceBuffers[ind] = bindings[ind].buffer;
+            offsets[ind] = bindings[ind].offset;
+        }
+
+        vkCmdBindVertexBuffers(commandBuffer, 1, static_cast<uint32_t>(std::size(bindings)), instanceBuffers, offsets);
+        vkCmdDrawIndexed(commandBuffer, 6, std::min(segment.capacity, instanceCount - segment.firstInstance), 0, 0, 0);
+    }
+}
+
+VkDeviceSize InstancedRendererChunked::GetResidentInstanceSize() const {
+
+    return m_instancedTranslationBuffer->GetResidentSize() + m_instancedRotationBuffer->GetResidentSize()
+        + m_instancedSpriteBuffer->GetResidentSize() + m_instancedPreviousTranslationBuffer->GetResidentSize();
 }
 
 
@@ -149,6 +386,11 @@ MainRenderPipeline::VertexFormat InstancedRendererChunked::GetVertexFormat() con
                 .binding = 3,
                 .stride = sizeof(MainComponentSystem::Sprite),
                 .inputRate = VK_VERTEX_INPUT_RATE_INSTANCE
+            },
+            VkVertexInputBindingDescription {
+                .binding = 4,
+                .stride = sizeof(glm::vec4),
+                .inputRate = VK_VERTEX_INPUT_RATE_INSTANCE
             }
         },
         .attributes = {
@@ -185,6 +427,12 @@ MainRenderPipeline::VertexFormat InstancedRendererChunked::GetVertexFormat() con
 	            .binding = 3,
 	            .format = VK_FORMAT_R32G32B32A32_SFLOAT,
 	            .offset = 0
+	        },
+	        VkVertexInputAttributeDescription{
+	            .location = 5,
+	            .binding = 4,
+	            .format = VK_FORMAT_R32G32B32A32_SFLOAT,
+	            .offset = 0
 	        }
 	    }
     };
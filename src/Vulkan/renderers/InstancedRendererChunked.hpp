@@ -1,5 +1,9 @@
 #pragma once
+#include <unordered_map>
+
 #include "MainRenderer.hpp"
+#include "../helpers/buffers/HostImportedBuffer.hpp"
+#include "../helpers/buffers/SegmentedInstanceBuffer.hpp"
 
 class InstancedRendererChunked : public MainRenderer
 {
@@ -17,11 +21,72 @@ public:
 	void Draw(VkCommandBuffer commandBuffer) override;
 	void UpdateBuffers() override;
 
+	[[nodiscard]] VkDeviceSize GetResidentInstanceSize() const override;
+
+	/**
+	 * True while the imported columns are bound.
+	 */
+	[[nodiscard]] bool ReadsComponentMemory() const override;
+
 	MainRenderPipeline::VertexFormat GetVertexFormat() const override;
 
 private:
 
-	std::unique_ptr<GenericBuffer> m_instancedTranslationBuffer;
-	std::unique_ptr<GenericBuffer> m_instancedRotationBuffer;
-	std::unique_ptr<GenericBuffer> m_instancedSpriteBuffer;
+	static constexpr uint32_t kMinUploadBatchSize = 8192;
+	static constexpr uint32_t kFirstSegmentCapacity = 64 * 1024;
+
+	struct Binding
+	{
+		VkBuffer buffer;
+		VkDeviceSize offset;
+	};
+
+	/**
+	 * Vertex buffer over the used part of a component column's storage, imported again whenever it outgrows the
+	 * last import. nullptr when the storage cannot be imported.
+	 */
+	const GenericBuffer* ImportColumn(const void* data, size_t usedBytes, size_t capacityBytes);
+
+	/**
+	 * Grows the streams that are bound by the next Draw to the count and shrinks the others to their first segment.
+	 */
+	void ResizeStreams(uint32_t instanceCount);
+	void ClearRotations() const;
+
+	/**
+	 * The imported column at the segment's first instance if there is one, the stream's own segment otherwise.
+	 */
+	static Binding GetSegmentBinding(const SegmentedInstanceBuffer& stream, const GenericBuffer* importedColumn, uint32_t segmentIndex, uint32_t firstInstance, VkDeviceSize stride);
+
+	std::unique_ptr<SegmentedInstanceBuffer> m_instancedTranslationBuffer;
+	std::unique_ptr<SegmentedInstanceBuffer> m_instancedRotationBuffer;
+	std::unique_ptr<SegmentedInstanceBuffer> m_instancedSpriteBuffer;
+
+	/**
+	 * Only written with a fixed simulation rate, the shader ignores it otherwise.
+	 */
+	std::unique_ptr<SegmentedInstanceBuffer> m_instancedPreviousTranslationBuffer;
+
+	/**
+	 * Sprite version the sprite buffer holds, see MainComponentSystem::GetSpriteChanges.
+	 */
+	std::optional<uint64_t> m_uploadedSpriteVersion;
+
+	/**
+	 * Set while the component columns are bound directly as vertex buffers (VK_EXT_external_memory_host).
+	 * Cleared for good as soon as a column cannot be imported, the copies above are used from then on.
+	 */
+	bool m_zeroCopy = false;
+
+	/**
+	 * Keyed by the column's data pointer. A column's storage never moves, but fixed-rate steps swap the current
+	 * and previous transform columns and pipelined snapshots rotate, so the data pointers are looked up again
+	 * every frame once movement is done.
+	 */
+	std::unordered_map<const void*, std::unique_ptr<HostImportedBuffer>> m_importedColumns;
+
+	// Imported columns bound by the next Draw instead of the streams above, nullptr where the stream is bound.
+	const GenericBuffer* m_translationSource{};
+	const GenericBuffer* m_spriteSource{};
+	const GenericBuffer* m_previousTranslationSource{};
 };
\ No newline at end of file
@@ -1,96 +1,1019 @@
 #include "MainComponentSystem.hpp"
 
+#include <cmath>
 #include <tracy/Tracy.hpp>
 
 #include "../pch.hpp"
 #include "MainRenderer.hpp"
+#include "../helpers/jobs/JobSystem.hpp"
+#include "../helpers/scene/SceneFile.hpp"
 
-#include <omp.h>
+namespace {
 
-MainComponentSystem::MainComponentSystem() : m_entityCount(kMaxEntityCount / 10) {
+    glm::vec4 ComputeTranslate(const MainComponentSystem::MoveComponent& moveComponent, double currentTime) {
 
-    std::random_device rndDevice;
-    std::mt19937 rndEngine(rndDevice());
+        auto translate = moveComponent.center;
+        translate.y += sin(moveComponent.phase + currentTime) * moveComponent.amplitude;
+        return translate;
+    }
+
+    constexpr float kPhaseScale = 1.0f / 256.0f;
+
+    /**
+     * \param definitionFrame Frame of the definition at the current time, see UpdateAnimationFrames.
+     */
+    uint32_t ComputeFrame(float definitionFrame, uint16_t phase) {
+        return static_cast<uint32_t>(definitionFrame + static_cast<float>(phase) * kPhaseScale);
+    }
+
+    MainComponentSystem::Sprite ComputeSprite(const MainComponentSystem::AnimationDefinition& definition, uint32_t frame) {
+
+        const float uOffset = static_cast<float>(frame) / static_cast<float>(definition.frameCount);
 
-    std::uniform_real_distribution<> offsetDist(-100, 100);
-    std::uniform_real_distribution<> zDist(-1, 1);
-    std::uniform_real_distribution<> amplitudeDist(0.7, 1.2);
+        return MainComponentSystem::Sprite{
+            .topLeftX     = definition.originalSprite.topLeftX + uOffset,
+            .bottomRightX = definition.originalSprite.bottomRightX + uOffset,
+            .topLeftY     = definition.originalSprite.topLeftY,
+            .bottomRightY = definition.originalSprite.bottomRightY
+        };
+    }
+
+    /**
+     * Tick at which to look at the entity again, a tick before it switches to the frame after the given one.
+     * The sprite is computed from the time as a float, which can round up past the flip, so coming up early is
+     * what keeps it from being missed. An entity that comes up early keeps its frame and is rescheduled.
+     */
+    uint64_t ComputeNextFrameTick(const MainComponentSystem::AnimationDefinition& definition, uint16_t phase, uint32_t frame, double tickRate) {
+
+        const double framesPerSecond = static_cast<double>(definition.frameCount) / definition.delay;
+        const double nextFrameTime = (static_cast<double>(frame) + 1.0 - static_cast<double>(phase) * kPhaseScale) / framesPerSecond;
+        const uint64_t tick = static_cast<uint64_t>(nextFrameTime * tickRate);
+        return tick > 0 ? tick - 1 : 0;
+    }
+}
 
-    m_transforms.resize(kMaxEntityCount);
-    m_sprites.resize(kMaxEntityCount);
+template<typename T>
+void MainComponentSystem::SwapRemove(Column<T>& column, const EntityRegistry::DespawnResult& result) {
+
+    column[result.denseIndex] = column[result.movedFromIndex];
+    column.pop_back();
+}
+
+template<typename T>
+void MainComponentSystem::CommitColumn(Column<T>& column, size_t count) {
+    HugePages::Commit(column.data(), count * sizeof(T));
+}
+
+MainComponentSystem::MainComponentSystem(JobSystem* jobSystem, uint32_t initialEntityCount, uint64_t seed)
+    : m_jobSystem(jobSystem), m_registry(std::min(initialEntityCount, kMaxEntityCount)), m_spatialGrid(jobSystem, SpatialHashGrid::Desc{ .cellSize = 2.0f, .bucketCount = 1 << 16 }), m_rng(seed) {
+
+    ZoneScoped;
+
+    // Address space only, pages are committed as the columns grow.
+    m_transforms.reserve(kMaxEntityCount);
+    m_previousTransforms.reserve(kMaxEntityCount);
+    m_sprites.reserve(kMaxEntityCount);
 
     m_moveComponents.reserve(kMaxEntityCount);
     m_animations.reserve(kMaxEntityCount);
 
-    for (uint32_t ind = 0; ind < kMaxEntityCount; ind++) {
+    this->RegisterAnimation(AnimationDefinition{
+        .originalSprite = Sprite{
+            .topLeftX = 0,
+            .bottomRightX = 1 / 8.0f,
+            .topLeftY = 0,
+            .bottomRightY = 1.0f
+        },
+        .frameCount = 8,
+        .delay = 0.6f
+    });
 
-        m_moveComponents.push_back(MoveComponent{
-            .center = { offsetDist(rndEngine), offsetDist(rndEngine), zDist(rndEngine), 0 },
-            .amplitude = static_cast<float>(amplitudeDist(rndEngine))
-        });
+    this->SetEntityCount(initialEntityCount);
+}
 
-        m_animations.push_back(Animation{
-            .originalSprite = Sprite{
-	            .topLeftX = 0,
-                .bottomRightX = 1 / 8.0f,
-                .topLeftY = 0,
-                .bottomRightY = 1.0f
-			},
-            .frameCount = 8,
-            .delay = 0.6f
-        });
-    }
+MainComponentSystem::~MainComponentSystem() {
+    this->StopSimulationThread();
 }
 
 void MainComponentSystem::Update() {
+    this->UpdateAt(glfwGetTime());
+}
+
+void MainComponentSystem::UpdateAt(double currentTime) {
+
+    ZoneScoped;
+
+    this->ApplyRequests();
+    this->BeginSpriteChanges();
+
+    if (m_simulationRate != 0) {
+        this->RunFixedSteps(this->AdvanceFixedTime(currentTime));
+    }
+    else if (m_updateTiers.enabled) {
+        this->UpdateTiered(currentTime);
+    }
+    else {
+        this->UpdateMovement(currentTime);
+        this->UpdateAnimation(currentTime);
+        m_updatedEntityCount.store(m_registry.Size(), std::memory_order_relaxed);
+    }
+
+    this->UpdateSpatialGrid();
+}
+
+void MainComponentSystem::Schedule(TaskGraph& graph) {
 
     ZoneScoped;
 
+    if (m_requestedPipelined != this->IsPipelined()) {
+        m_requestedPipelined ? this->StartSimulationThread() : this->StopSimulationThread();
+    }
+
+    if (this->IsPipelined()) {
+
+        // Frame N renders the latest finished step while the simulation thread works on N + 1.
+        // If the step is not finished yet, the previous snapshot is rendered again.
+        m_snapshots.Acquire();
+
+        m_simulationStepRequested.store(true, std::memory_order_release);
+        m_simulationStepRequested.notify_one();
+
+        m_scheduledTasks = ScheduledTasks{};
+        return;
+    }
+
+    // Nothing from the previous frame is running anymore, so the arrays can be resized here.
+    this->ApplyRequests();
+    this->BeginSpriteChanges();
+
     const double currentTime = glfwGetTime();
+    if (m_simulationRate != 0) {
+
+        // Steps have to run in order, so movement and animation share a single task.
+        const uint32_t stepCount = this->AdvanceFixedTime(currentTime);
+        const TaskGraph::TaskID steps = stepCount > 0
+            ? graph.AddTask("Fixed steps", [this, stepCount] { this->RunFixedSteps(stepCount); })
+            : TaskGraph::kInvalidTask;
+
+        // Rebuilt even without a step, the entity count may have changed.
+        m_scheduledTasks = ScheduledTasks{
+            .movement = steps,
+            .animation = steps,
+            .spatialGrid = graph.AddTask("Spatial grid", [this] { this->UpdateSpatialGrid(); }, { steps })
+        };
+        return;
+    }
+
+    if (m_updateTiers.enabled) {
+
+        const TaskGraph::TaskID tiered = graph.AddTask("Tiered update", [this, currentTime] { this->UpdateTiered(currentTime); });
+        m_scheduledTasks = ScheduledTasks{
+            .movement = tiered,
+            .animation = tiered,
+            .spatialGrid = graph.AddTask("Spatial grid", [this] { this->UpdateSpatialGrid(); }, { tiered })
+        };
+        return;
+    }
+
+    m_updatedEntityCount.store(m_registry.Size(), std::memory_order_relaxed);
+
+    const TaskGraph::TaskID movement = graph.AddTask("Movement", [this, currentTime] { this->UpdateMovement(currentTime); });
+    m_scheduledTasks = ScheduledTasks{
+        .movement = movement,
+        .animation = graph.AddTask("Animation", [this, currentTime] { this->UpdateAnimation(currentTime); }),
+        .spatialGrid = graph.AddTask("Spatial grid", [this] { this->UpdateSpatialGrid(); }, { movement })
+    };
+}
+
+MainComponentSystem::ScheduledTasks MainComponentSystem::GetScheduledTasks() const {
+    return m_scheduledTasks;
+}
+
+uint32_t MainComponentSystem::AdvanceFixedTime(double currentTime) {
+
+    const double stepTime = 1.0 / m_simulationRate;
+
+    m_accumulatedTime += currentTime - m_lastUpdateTime;
+    m_lastUpdateTime = currentTime;
+
+    uint32_t stepCount = static_cast<uint32_t>(m_accumulatedTime / stepTime);
+    if (stepCount > kMaxStepsPerUpdate) {
+        stepCount = kMaxStepsPerUpdate;
+        m_accumulatedTime = std::fmod(m_accumulatedTime, stepTime);
+    }
+    else {
+        m_accumulatedTime -= stepCount * stepTime;
+    }
+
+    m_blendFactor = static_cast<float>(m_accumulatedTime / stepTime);
+    m_updatedEntityCount.store(stepCount * m_registry.Size(), std::memory_order_relaxed);
+    return stepCount;
+}
+
+void MainComponentSystem::RunFixedSteps(uint32_t stepCount) {
+
+    ZoneScoped;
+
+    const double stepTime = 1.0 / m_simulationRate;
+
+    for (uint32_t step = 0; step < stepCount; step++) {
+
+        // Every transform is rewritten by the step, so the old values only need to change places.
+        std::swap(m_previousTransforms, m_transforms);
+
+        m_simulationTime += stepTime;
+        this->UpdateMovement(m_simulationTime);
+        this->UpdateAnimation(m_simulationTime);
+    }
+}
+
+void MainComponentSystem::RequestSimulationRate(uint32_t stepsPerSecond) {
+
+    std::lock_guard lock(m_requestMutex);
+    m_requestedSimulationRate = stepsPerSecond;
+}
+
+uint32_t MainComponentSystem::GetRequestedSimulationRate() const {
+
+    std::lock_guard lock(m_requestMutex);
+    return m_requestedSimulationRate.value_or(m_simulationRate);
+}
+
+void MainComponentSystem::RequestUpdateTiers(const UpdateTierDesc& desc) {
+
+    std::lock_guard lock(m_requestMutex);
+    m_requestedUpdateTiers = desc;
+}
+
+MainComponentSystem::UpdateTierDesc MainComponentSystem::GetRequestedUpdateTiers() const {
+
+    std::lock_guard lock(m_requestMutex);
+    return m_requestedUpdateTiers.value_or(m_updateTiers);
+}
+
+void MainComponentSystem::SetViewProjection(const glm::mat4& viewProjection) {
+
+    std::lock_guard lock(m_requestMutex);
+    m_requestedViewProjection = viewProjection;
+}
+
+void MainComponentSystem::RequestEventDrivenAnimation(bool eventDriven) {
+
+    std::lock_guard lock(m_requestMutex);
+    m_requestedEventDrivenAnimation = eventDriven;
+}
+
+bool MainComponentSystem::GetRequestedEventDrivenAnimation() const {
+
+    std::lock_guard lock(m_requestMutex);
+    return m_requestedEventDrivenAnimation;
+}
+
+MainComponentSystem::SpriteChanges MainComponentSystem::GetSpriteChanges() const {
+
+    // The simulation thread owns the changes in pipelined mode.
+    if (this->IsPipelined()) {
+        return SpriteChanges{ .version = 0, .changed = nullptr };
+    }
+
+    if (m_allSpritesChanged) {
+        return SpriteChanges{ .version = m_spriteVersion, .changed = nullptr };
+    }
+
+    return SpriteChanges{ .version = m_spriteVersion, .changed = &m_changedSprites };
+}
+
+uint32_t MainComponentSystem::GetChangedSpriteCount() const {
+    return m_changedSpriteCount.load(std::memory_order_relaxed);
+}
+
+uint32_t MainComponentSystem::GetUpdatedEntityCount() const {
+    return m_updatedEntityCount.load(std::memory_order_relaxed);
+}
+
+void MainComponentSystem::RequestPipelined(bool pipelined) {
+    m_requestedPipelined = pipelined;
+}
+
+bool MainComponentSystem::IsPipelined() const {
+    return m_simulationThread.joinable();
+}
+
+void MainComponentSystem::StartSimulationThread() {
+
+    ZoneScoped;
+
+    // Renderers read the snapshot from the first frame on, so the current state is published right away.
+    this->PublishSnapshot();
+    m_snapshots.Acquire();
+
+    m_simulationRunning.store(true, std::memory_order_release);
+    m_simulationThread = std::thread(&MainComponentSystem::SimulationLoop, this);
+
+    spdlog::info("[MainComponentSystem] Simulation thread started");
+}
+
+void MainComponentSystem::StopSimulationThread() {
+
+    if (!m_simulationThread.joinable()) {
+        return;
+    }
+
+    ZoneScoped;
+
+    m_simulationRunning.store(false, std::memory_order_release);
+    m_simulationStepRequested.store(true, std::memory_order_release);
+    m_simulationStepRequested.notify_one();
+
+    m_simulationThread.join();
+
+    spdlog::info("[MainComponentSystem] Simulation thread stopped");
+}
+
+void MainComponentSystem::SimulationLoop() {
+
+    tracy::SetThreadName("Simulation");
+
+    while (true) {
+
+        // One step per rendered frame. A request that arrives mid-step is picked up right after it.
+        while (!m_simulationStepRequested.exchange(false, std::memory_order_acq_rel)) {
+            m_simulationStepRequested.wait(false, std::memory_order_acquire);
+        }
+
+        if (!m_simulationRunning.load(std::memory_order_acquire)) {
+            return;
+        }
+
+        this->Update();
+        this->PublishSnapshot();
+    }
+}
+
+void MainComponentSystem::PublishSnapshot() {
+
+    ZoneScoped;
+
+    Snapshot& snapshot = m_snapshots.GetWriteBuffer();
+
+    // Same as the live columns, the storage never moves once allocated and only the live count is committed.
+    snapshot.transforms.reserve(kMaxEntityCount);
+    snapshot.sprites.reserve(kMaxEntityCount);
+    snapshot.previousTransforms.reserve(kMaxEntityCount);
+
+    MainComponentSystem::CommitColumn(snapshot.transforms, m_transforms.size());
+    MainComponentSystem::CommitColumn(snapshot.sprites, m_sprites.size());
+    if (m_simulationRate != 0) {
+        MainComponentSystem::CommitColumn(snapshot.previousTransforms, m_previousTransforms.size());
+    }
+
+    snapshot.entities.assign(m_registry.GetEntities().begin(), m_registry.GetEntities().end());
+    snapshot.transforms.assign(m_transforms.begin(), m_transforms.end());
+    snapshot.sprites.assign(m_sprites.begin(), m_sprites.end());
+
+    snapshot.blendFactor = m_blendFactor;
+    if (m_simulationRate != 0) {
+        snapshot.previousTransforms.assign(m_previousTransforms.begin(), m_previousTransforms.end());
+    }
+
+    m_snapshots.Publish();
+}
+
+void MainComponentSystem::UpdateMovement(double currentTime) {
+
+    ZoneScoped;
 
     const MoveComponent* __restrict moveComponentsPtr = m_moveComponents.data();
 	Transform* __restrict transformsPtr = m_transforms.data();
 
-	#pragma omp parallel for schedule(static)
-    for (int ind = 0; ind < m_entityCount; ind++) {
+    m_jobSystem->ParallelFor("Movement batch", m_registry.Size(), kMinBatchSize, [=](uint32_t begin, uint32_t end)
+    {
+        for (uint32_t ind = begin; ind < end; ind++) {
+            transformsPtr[ind].translate = ComputeTranslate(moveComponentsPtr[ind], currentTime);
+        }
+    });
+}
 
-        auto translate = moveComponentsPtr[ind].center;
-        translate.y += sin(ind + currentTime) * moveComponentsPtr[ind].amplitude;
+void MainComponentSystem::UpdateSpatialGrid() {
 
-        transformsPtr[ind].translate = translate;
+    static_assert(sizeof(Transform) == sizeof(glm::vec4), "The grid reads translations as a tightly packed vec4 array");
+    m_spatialGrid.Rebuild(&m_transforms.data()->translate, m_registry.Size());
+}
+
+void MainComponentSystem::UpdateAnimation(double currentTime) {
+
+    ZoneScoped;
+
+    if (m_eventDrivenAnimation) {
+        this->AdvanceAnimationWheel(currentTime);
+    }
+    else {
+        this->UpdateAllSprites(currentTime);
     }
+}
 
+void MainComponentSystem::UpdateAllSprites(double currentTime) {
+
+    this->UpdateAnimationFrames(currentTime);
+
+    // The table is a few cache lines at most and stays resident, the per-entity stream is 4 bytes.
+    const AnimationDefinition* __restrict definitionsPtr = m_animationDefinitions.data();
+    const float* __restrict framesPtr = m_animationFrames.data();
     const Animation* __restrict animationsPtr = m_animations.data();
     Sprite* __restrict spritesPtr = m_sprites.data();
 
-	#pragma omp parallel for schedule(static)
-    for (int ind = 0; ind < m_entityCount; ind++) {
+    m_jobSystem->ParallelFor("Animation batch", m_registry.Size(), kMinBatchSize, [=](uint32_t begin, uint32_t end)
+    {
+        for (uint32_t ind = begin; ind < end; ind++) {
 
-        uint32_t currentFrame = static_cast<float>(currentTime) / animationsPtr[ind].delay * static_cast<float>(animationsPtr[ind].frameCount);
-    	currentFrame += ind;  // For randomness
+            const Animation animation = animationsPtr[ind];
+            spritesPtr[ind] = ComputeSprite(definitionsPtr[animation.definition], ComputeFrame(framesPtr[animation.definition], animation.phase));
+        }
+    });
 
-        const float uOffset = static_cast<float>(currentFrame) / static_cast<float>(animationsPtr[ind].frameCount);
+    m_allSpritesChanged = true;
+    m_changedSpriteCount.store(m_registry.Size(), std::memory_order_relaxed);
+}
 
-        spritesPtr[ind].topLeftX     = animationsPtr[ind].originalSprite.topLeftX + uOffset;
-        spritesPtr[ind].bottomRightX = animationsPtr[ind].originalSprite.bottomRightX + uOffset;
-        spritesPtr[ind].topLeftY     = animationsPtr[ind].originalSprite.topLeftY;
-        spritesPtr[ind].bottomRightY = animationsPtr[ind].originalSprite.bottomRightY;
+void MainComponentSystem::AdvanceAnimationWheel(double currentTime) {
+
+    ZoneScoped;
+
+    if (m_animationWheelStale) {
+        this->RebuildAnimationWheel(currentTime);
+        return;
+    }
+
+    this->UpdateAnimationFrames(currentTime);
+
+    // The wheel itself is serial, the flipped entities are updated in parallel in between.
+    m_expiredSprites.clear();
+    m_animationWheel.Advance(static_cast<uint64_t>(currentTime * kAnimationTickRate), [this](uint32_t ind)
+    {
+        m_expiredSprites.push_back(ind);
+    });
+
+    const uint32_t expiredCount = static_cast<uint32_t>(m_expiredSprites.size());
+    m_nextFrameTicks.resize(expiredCount);
+
+    const uint32_t* __restrict expiredPtr = m_expiredSprites.data();
+    uint64_t* __restrict nextFrameTicksPtr = m_nextFrameTicks.data();
+    const AnimationDefinition* __restrict definitionsPtr = m_animationDefinitions.data();
+    const float* __restrict framesPtr = m_animationFrames.data();
+    const Animation* __restrict animationsPtr = m_animations.data();
+    Sprite* __restrict spritesPtr = m_sprites.data();
+
+    m_jobSystem->ParallelFor("Animation event batch", expiredCount, kMinBatchSize, [=](uint32_t begin, uint32_t end)
+    {
+        for (uint32_t expired = begin; expired < end; expired++) {
+
+            const uint32_t ind = expiredPtr[expired];
+            const Animation animation = animationsPtr[ind];
+            const AnimationDefinition& definition = definitionsPtr[animation.definition];
+
+            const uint32_t frame = ComputeFrame(framesPtr[animation.definition], animation.phase);
+            spritesPtr[ind] = ComputeSprite(definition, frame);
+            nextFrameTicksPtr[expired] = ComputeNextFrameTick(definition, animation.phase, frame, kAnimationTickRate);
+        }
+    });
+
+    for (uint32_t expired = 0; expired < expiredCount; expired++) {
+        m_animationWheel.Schedule(m_expiredSprites[expired], m_nextFrameTicks[expired]);
     }
 
+    // Entities that came up early did not actually change, uploading them again is cheaper than filtering.
+    m_changedSprites.insert(m_changedSprites.end(), m_expiredSprites.begin(), m_expiredSprites.end());
+
+    m_changedSpriteCount.store(static_cast<uint32_t>(m_changedSprites.size()), std::memory_order_relaxed);
+}
+
+void MainComponentSystem::RebuildAnimationWheel(double currentTime) {
+
+    ZoneScoped;
+
+    // Brings every sprite up to date, then schedules its next flip.
+    this->UpdateAllSprites(currentTime);
+
+    m_animationWheel.Clear(static_cast<uint64_t>(currentTime * kAnimationTickRate));
+    for (uint32_t ind = 0; ind < m_registry.Size(); ind++) {
+
+        const Animation animation = m_animations[ind];
+        const AnimationDefinition& definition = m_animationDefinitions[animation.definition];
+
+        const uint32_t frame = ComputeFrame(m_animationFrames[animation.definition], animation.phase);
+        m_animationWheel.Schedule(ind, ComputeNextFrameTick(definition, animation.phase, frame, kAnimationTickRate));
+    }
+
+    m_animationWheelStale = false;
+}
+
+void MainComponentSystem::BeginSpriteChanges() {
+
+    m_spriteVersion++;
+    m_allSpritesChanged = false;
+    m_changedSprites.clear();
+}
+
+void MainComponentSystem::UpdateAnimationFrames(double currentTime) {
+
+    // Only depends on the definition, so it is done once per definition instead of once per entity.
+    m_animationFrames.resize(m_animationDefinitions.size());
+    for (size_t ind = 0; ind < m_animationDefinitions.size(); ind++) {
+
+        const AnimationDefinition& definition = m_animationDefinitions[ind];
+        m_animationFrames[ind] = static_cast<float>(currentTime) / definition.delay * static_cast<float>(definition.frameCount);
+    }
+}
+
+void MainComponentSystem::UpdateTiered(double currentTime) {
+
+    ZoneScoped;
+
+    // Spawning and despawning change the dense order, so what the renderers uploaded before no longer lines up.
+    const bool denseOrderChanged = m_tiersStale;
+    if (m_tiersStale || m_tieredFrame % kUpdateTierRefreshPeriod == 0) {
+        this->ClassifyUpdateTiers();
+    }
+
+    this->UpdateAnimationFrames(currentTime);
+
+    const MoveComponent* __restrict moveComponentsPtr = m_moveComponents.data();
+    Transform* __restrict transformsPtr = m_transforms.data();
+    const AnimationDefinition* __restrict definitionsPtr = m_animationDefinitions.data();
+    const float* __restrict framesPtr = m_animationFrames.data();
+    const Animation* __restrict animationsPtr = m_animations.data();
+    Sprite* __restrict spritesPtr = m_sprites.data();
+
+    // Event-driven animation does not need the tiers, it already skips the entities that do not change.
+    const bool animate = !m_eventDrivenAnimation;
+
+    uint32_t updatedCount = 0;
+    for (uint32_t tier = 0; tier < UpdateTierCount; tier++) {
+
+        const uint32_t period = kUpdateTierPeriods[tier];
+        const uint32_t slice = static_cast<uint32_t>(m_tieredFrame % period);
+        const std::vector<uint32_t>& tierEntities = m_tierEntities[tier];
+
+        if (tierEntities.size() <= slice) {
+            continue;
+        }
+
+        // Every period-th entity of the tier, starting at this frame's slice.
+        const uint32_t dueCount = (static_cast<uint32_t>(tierEntities.size()) - slice + period - 1) / period;
+        const uint32_t* duePtr = tierEntities.data() + slice;
+        updatedCount += dueCount;
+
+        // Same as the timing wheel, only the due entities are reported, each batch writes its own part of the list.
+        uint32_t* changedPtr = nullptr;
+        if (animate) {
+            const size_t changedOffset = m_changedSprites.size();
+            m_changedSprites.resize(changedOffset + dueCount);
+            changedPtr = m_changedSprites.data() + changedOffset;
+        }
+
+        m_jobSystem->ParallelFor("Tier batch", dueCount, kMinBatchSize, [=](uint32_t begin, uint32_t end)
+        {
+            for (uint32_t due = begin; due < end; due++) {
+
+                const uint32_t ind = duePtr[static_cast<size_t>(due) * period];
+                transformsPtr[ind].translate = ComputeTranslate(moveComponentsPtr[ind], currentTime);
+
+                if (animate) {
+                    const Animation animation = animationsPtr[ind];
+                    spritesPtr[ind] = ComputeSprite(definitionsPtr[animation.definition], ComputeFrame(framesPtr[animation.definition], animation.phase));
+                    changedPtr[due] = ind;
+                }
+            }
+        });
+    }
+
+    if (!animate) {
+        this->AdvanceAnimationWheel(currentTime);
+    }
+    else if (denseOrderChanged) {
+        m_allSpritesChanged = true;
+        m_changedSpriteCount.store(m_registry.Size(), std::memory_order_relaxed);
+    }
+    else if (!m_allSpritesChanged) {
+        m_changedSpriteCount.store(static_cast<uint32_t>(m_changedSprites.size()), std::memory_order_relaxed);
+    }
+
+    m_tieredFrame++;
+    m_updatedEntityCount.store(updatedCount, std::memory_order_relaxed);
+}
+
+void MainComponentSystem::ClassifyUpdateTiers() {
+
+    ZoneScoped;
+
+    const uint32_t entityCount = m_registry.Size();
+    const uint32_t batchCount = std::max(1u, std::min(m_jobSystem->GetThreadCount(), (entityCount + kMinBatchSize - 1) / kMinBatchSize));
+    const uint32_t batchSize = (entityCount + batchCount - 1) / batchCount;
+    m_tierBatches.resize(batchCount);
+
+    const glm::mat4 viewProjection = m_viewProjection;
+    const float nearDistance = m_updateTiers.nearDistance;
+
+    m_jobSystem->ParallelFor("Classify tiers", batchCount, 1, [=, this](uint32_t beginBatch, uint32_t endBatch)
+    {
+        for (uint32_t batch = beginBatch; batch < endBatch; batch++) {
+
+            auto& tierLists = m_tierBatches[batch];
+            for (auto& tierList : tierLists) {
+                tierList.clear();
+            }
+
+            const uint32_t end = std::min(entityCount, (batch + 1) * batchSize);
+            for (uint32_t ind = batch * batchSize; ind < end; ind++) {
+
+                const glm::vec4& translate = m_transforms[ind].translate;
+                const glm::vec4 clip = viewProjection * glm::vec4(translate.x, translate.y, translate.z, 1.0f);
+
+                // w is the distance along the view direction.
+                const float extent = clip.w * kVisibilityMargin;
+                const bool visible = clip.w > 0.0f && std::abs(clip.x) <= extent && std::abs(clip.y) <= extent;
+
+                const UpdateTier tier = !visible ? OffScreenTier : clip.w > nearDistance ? FarTier : NearTier;
+                tierLists[tier].push_back(ind);
+            }
+        }
+    });
+
+    // Batches cover increasing index ranges, so the tier lists come out sorted.
+    for (uint32_t tier = 0; tier < UpdateTierCount; tier++) {
+
+        m_tierEntities[tier].clear();
+        for (const auto& tierLists : m_tierBatches) {
+            m_tierEntities[tier].insert(m_tierEntities[tier].end(), tierLists[tier].begin(), tierLists[tier].end());
+        }
+    }
+
+    m_tiersStale = false;
+}
+
+MainComponentSystem::AnimationID MainComponentSystem::RegisterAnimation(const AnimationDefinition& definition) {
+
+    if (m_animationDefinitions.size() >= kMaxAnimationDefinitionCount) {
+        throw std::runtime_error("[MainComponentSystem] Out of animation IDs");
+    }
+    if (definition.frameCount == 0 || definition.delay <= 0.0f) {
+        throw std::runtime_error("[MainComponentSystem] Animation needs at least one frame and a positive delay");
+    }
+
+    m_animationDefinitions.push_back(definition);
+    m_animationWheelStale = true;
+    return static_cast<AnimationID>(m_animationDefinitions.size() - 1);
+}
+
+const std::vector<MainComponentSystem::AnimationDefinition>& MainComponentSystem::GetAnimationDefinitions() const {
+    return m_animationDefinitions;
+}
+
+Entity MainComponentSystem::Spawn() {
+
+    if (m_registry.Size() >= kMaxEntityCount) {
+        throw std::runtime_error("[MainComponentSystem] Reached the entity limit");
+    }
+
+    const Entity entity = m_registry.Spawn();
+
+    this->ResizeColumns(m_registry.Size());
+    this->InitializeEntity(m_registry.Size() - 1);
+
+    return entity;
+}
+
+void MainComponentSystem::InitializeEntity(uint32_t denseIndex) {
+
+    const Entity entity = m_registry.GetEntity(denseIndex);
+
+    // The generation is part of the counter, so a reused index does not repeat the previous entity.
+    const uint64_t counter = ((static_cast<uint64_t>(entity.generation) << 32) | entity.index) * RandomStream::RandomStreamCount;
+
+    const glm::vec4 center = {
+        m_rng.Uniform(counter + RandomStream::CenterX, -100.0f, 100.0f),
+        m_rng.Uniform(counter + RandomStream::CenterY, -100.0f, 100.0f),
+        m_rng.Uniform(counter + RandomStream::CenterZ, -1.0f, 1.0f),
+        0
+    };
+
+    m_moveComponents[denseIndex] = MoveComponent{
+        .center = center,
+        .amplitude = m_rng.Uniform(counter + RandomStream::Amplitude, 0.7f, 1.2f),
+        .phase = static_cast<float>(entity.index)
+    };
+
+    // The sampler repeats, so only the phase modulo the frame count matters.
+    m_animations[denseIndex] = Animation{
+        .definition = kDefaultAnimation,
+        .phase = static_cast<uint16_t>(m_rng.Next32(counter + RandomStream::AnimationPhase))
+    };
+
+    // Written by the next Update. Starting at the center keeps interpolation from sliding in from the origin.
+    // The columns are not zeroed on resize, so every element is written here.
+    m_transforms[denseIndex] = Transform{ .translate = center };
+    m_previousTransforms[denseIndex] = Transform{ .translate = center };
+    m_sprites[denseIndex] = m_animationDefinitions[kDefaultAnimation].originalSprite;
+}
+
+void MainComponentSystem::ResizeColumns(uint32_t entityCount) {
+
+    MainComponentSystem::CommitColumn(m_transforms, entityCount);
+    MainComponentSystem::CommitColumn(m_previousTransforms, entityCount);
+    MainComponentSystem::CommitColumn(m_moveComponents, entityCount);
+    MainComponentSystem::CommitColumn(m_sprites, entityCount);
+    MainComponentSystem::CommitColumn(m_animations, entityCount);
+
+    m_transforms.resize(entityCount);
+    m_previousTransforms.resize(entityCount);
+    m_moveComponents.resize(entityCount);
+    m_sprites.resize(entityCount);
+    m_animations.resize(entityCount);
+
+    // The tier lists and the animation wheel hold dense indices.
+    m_tiersStale = true;
+    m_animationWheelStale = true;
+}
+
+void MainComponentSystem::Despawn(Entity entity) {
+
+    const EntityRegistry::DespawnResult result = m_registry.Despawn(entity);
+
+    MainComponentSystem::SwapRemove(m_transforms, result);
+    MainComponentSystem::SwapRemove(m_previousTransforms, result);
+    MainComponentSystem::SwapRemove(m_moveComponents, result);
+    MainComponentSystem::SwapRemove(m_sprites, result);
+    MainComponentSystem::SwapRemove(m_animations, result);
+
+    m_tiersStale = true;
+    m_animationWheelStale = true;
+}
+
+bool MainComponentSystem::IsAlive(Entity entity) const {
+    return m_registry.IsAlive(entity);
 }
 
 void MainComponentSystem::SetEntityCount(uint32_t newEntityCount) {
-    m_entityCount = newEntityCount;
+
+    ZoneScoped;
+
+    newEntityCount = std::min(newEntityCount, kMaxEntityCount);
+
+    while (m_registry.Size() > newEntityCount) {
+        // Despawning the last dense entity does not move anything.
+        this->Despawn(m_registry.GetEntity(m_registry.Size() - 1));
+    }
+
+    if (m_registry.Size() >= newEntityCount) {
+        return;
+    }
+
+    // Only the registry is serial. Every entity is initialized from its own counters, so the rest is a parallel fill.
+    const uint32_t firstDenseIndex = m_registry.Size();
+    {
+        ZoneScopedN("Spawn handles");
+        while (m_registry.Size() < newEntityCount) {
+            m_registry.Spawn();
+        }
+    }
+
+    this->ResizeColumns(newEntityCount);
+
+    m_jobSystem->ParallelFor("Initialize entities", newEntityCount - firstDenseIndex, kMinBatchSize, [=, this](uint32_t begin, uint32_t end)
+    {
+        for (uint32_t ind = firstDenseIndex + begin; ind < firstDenseIndex + end; ind++) {
+            this->InitializeEntity(ind);
+        }
+    });
 }
 
 uint32_t MainComponentSystem::GetEntityCount() const {
-    return m_entityCount;
+
+    if (this->IsPipelined()) {
+        return static_cast<uint32_t>(m_snapshots.GetReadBuffer().entities.size());
+    }
+
+    return m_registry.Size();
+}
+
+void MainComponentSystem::RequestEntityCount(uint32_t newEntityCount) {
+
+    std::lock_guard lock(m_requestMutex);
+    m_requestedEntityCount = newEntityCount;
+}
+
+uint32_t MainComponentSystem::GetRequestedEntityCount() const {
+
+    {
+        std::lock_guard lock(m_requestMutex);
+        if (m_requestedEntityCount.has_value()) {
+            return m_requestedEntityCount.value();
+        }
+    }
+
+    return this->GetEntityCount();
+}
+
+void MainComponentSystem::ApplyRequests() {
+
+    std::optional<uint32_t> requestedEntityCount;
+    std::optional<uint32_t> requestedSimulationRate;
+    std::optional<std::string> requestedSceneSave;
+    std::optional<std::string> requestedSceneLoad;
+    std::optional<UpdateTierDesc> requestedUpdateTiers;
+    bool requestedEventDrivenAnimation;
+    {
+        std::lock_guard lock(m_requestMutex);
+        requestedEventDrivenAnimation = m_requestedEventDrivenAnimation;
+        requestedUpdateTiers = m_requestedUpdateTiers;
+        m_viewProjection = m_requestedViewProjection;
+        m_requestedUpdateTiers = std::nullopt;
+        requestedEntityCount = m_requestedEntityCount;
+        requestedSimulationRate = m_requestedSimulationRate;
+        requestedSceneSave = std::move(m_requestedSceneSave);
+        requestedSceneLoad = std::move(m_requestedSceneLoad);
+        m_requestedEntityCount = std::nullopt;
+        m_requestedSimulationRate = std::nullopt;
+        m_requestedSceneSave = std::nullopt;
+        m_requestedSceneLoad = std::nullopt;
+    }
+
+    // Saving first, so save and load in the same frame round-trips.
+    if (requestedSceneSave.has_value()) {
+        try {
+            this->SaveScene(requestedSceneSave.value());
+        }
+        catch (const std::exception& e) {
+            spdlog::error("[MainComponentSystem] Could not save the scene: {}", e.what());
+        }
+    }
+
+    if (requestedSceneLoad.has_value()) {
+        try {
+            this->LoadScene(requestedSceneLoad.value());
+        }
+        catch (const std::exception& e) {
+            spdlog::error("[MainComponentSystem] Could not load the scene: {}", e.what());
+        }
+    }
+
+    if (requestedEntityCount.has_value()) {
+        this->SetEntityCount(requestedEntityCount.value());
+    }
+
+    if (requestedEventDrivenAnimation != m_eventDrivenAnimation) {
+
+        // The wheel is not maintained while it is off.
+        m_eventDrivenAnimation = requestedEventDrivenAnimation;
+        m_animationWheelStale = true;
+    }
+
+    if (requestedUpdateTiers.has_value()) {
+
+        // Off while disabled, so the tiers may be arbitrarily old.
+        m_tiersStale |= requestedUpdateTiers->enabled && !m_updateTiers.enabled;
+        m_updateTiers = requestedUpdateTiers.value();
+    }
+
+    if (requestedSimulationRate.has_value() && requestedSimulationRate.value() != m_simulationRate) {
+
+        m_simulationRate = requestedSimulationRate.value();
+        m_blendFactor = 1.0f;
+
+        if (m_simulationRate != 0) {
+            // Previous transforms are not maintained while simulating once per frame.
+            m_previousTransforms.assign(m_transforms.begin(), m_transforms.end());
+
+            m_lastUpdateTime = glfwGetTime();
+            m_simulationTime = m_lastUpdateTime;
+            m_accumulatedTime = 0.0;
+        }
+    }
+}
+
+void MainComponentSystem::SaveScene(const std::string& path) const {
+
+    ZoneScoped;
+
+    SceneWriter writer(m_registry.Size());
+    writer.AddColumn(SceneColumn::MoveComponents, m_moveComponents);
+    writer.AddColumn(SceneColumn::Animations, m_animations);
+    writer.AddColumn(SceneColumn::Transforms, m_transforms);
+    writer.AddColumn(SceneColumn::Sprites, m_sprites);
+    writer.AddTable(SceneColumn::AnimationDefinitions, m_animationDefinitions);
+    writer.Write(path);
 }
 
-const std::vector<MainComponentSystem::Transform>& MainComponentSystem::GetTransforms() const {
+void MainComponentSystem::LoadScene(const std::string& path) {
+
+    ZoneScoped;
+
+    const auto startTime = std::chrono::high_resolution_clock::now();
+
+    const SceneFile scene(path);
+    const uint32_t entityCount = scene.GetEntityCount();
+    if (entityCount > kMaxEntityCount) {
+        throw std::runtime_error(std::format("[MainComponentSystem] Scene {} has {} entities, the limit is {}", path, entityCount, kMaxEntityCount));
+    }
+
+    // Everything is validated before any state changes.
+    const MoveComponent* moveComponents = scene.GetColumn<MoveComponent>(SceneColumn::MoveComponents);
+    const Animation* animations = scene.GetColumn<Animation>(SceneColumn::Animations);
+    const Transform* transforms = scene.GetColumn<Transform>(SceneColumn::Transforms);
+    const Sprite* sprites = scene.GetColumn<Sprite>(SceneColumn::Sprites);
+    const std::span<const AnimationDefinition> animationDefinitions = scene.GetTable<AnimationDefinition>(SceneColumn::AnimationDefinitions);
+
+    if (animationDefinitions.empty() || animationDefinitions.size() > kMaxAnimationDefinitionCount) {
+        throw std::runtime_error(std::format("[MainComponentSystem] Scene {} has {} animation definitions", path, animationDefinitions.size()));
+    }
+    for (uint32_t ind = 0; ind < entityCount; ind++) {
+        if (animations[ind].definition >= animationDefinitions.size()) {
+            throw std::runtime_error(std::format("[MainComponentSystem] Entity {} in scene {} uses an unknown animation", ind, path));
+        }
+    }
+
+    m_registry.Clear();
+    for (uint32_t ind = 0; ind < entityCount; ind++) {
+        m_registry.Spawn();
+    }
+
+    MainComponentSystem::CommitColumn(m_moveComponents, entityCount);
+    MainComponentSystem::CommitColumn(m_animations, entityCount);
+    MainComponentSystem::CommitColumn(m_transforms, entityCount);
+    MainComponentSystem::CommitColumn(m_previousTransforms, entityCount);
+    MainComponentSystem::CommitColumn(m_sprites, entityCount);
+
+    m_moveComponents.assign(moveComponents, moveComponents + entityCount);
+    m_animations.assign(animations, animations + entityCount);
+    m_animationDefinitions.assign(animationDefinitions.begin(), animationDefinitions.end());
+    m_transforms.assign(transforms, transforms + entityCount);
+    m_previousTransforms.assign(transforms, transforms + entityCount);
+    m_sprites.assign(sprites, sprites + entityCount);
+    m_tiersStale = true;
+    m_animationWheelStale = true;
+
+    const auto endTime = std::chrono::high_resolution_clock::now();
+    spdlog::info("[MainComponentSystem] Loaded {} entities from {} in {:.2f} ms", entityCount, path,
+        std::chrono::duration<double, std::milli>(endTime - startTime).count());
+}
+
+void MainComponentSystem::RequestSceneSave(const std::string& path) {
+
+    std::lock_guard lock(m_requestMutex);
+    m_requestedSceneSave = path;
+}
+
+void MainComponentSystem::RequestSceneLoad(const std::string& path) {
+
+    std::lock_guard lock(m_requestMutex);
+    m_requestedSceneLoad = path;
+}
+
+const std::vector<Entity>& MainComponentSystem::GetEntities() const {
+
+    if (this->IsPipelined()) {
+        return m_snapshots.GetReadBuffer().entities;
+    }
+
+    return m_registry.GetEntities();
+}
+
+const MainComponentSystem::Column<MainComponentSystem::Transform>& MainComponentSystem::GetTransforms() const {
+
+    if (this->IsPipelined()) {
+        return m_snapshots.GetReadBuffer().transforms;
+    }
+
     return m_transforms;
 }
 
-const std::vector<MainComponentSystem::Sprite>& MainComponentSystem::GetSprites() const {
+const MainComponentSystem::Column<MainComponentSystem::Sprite>& MainComponentSystem::GetSprites() const {
+
+    if (this->IsPipelined()) {
+        return m_snapshots.GetReadBuffer().sprites;
+    }
+
     return m_sprites;
 }
+
+const MainComponentSystem::Column<MainComponentSystem::Transform>& MainComponentSystem::GetPreviousTransforms() const {
+
+    if (this->IsPipelined()) {
+        return m_snapshots.GetReadBuffer().previousTransforms;
+    }
+
+    return m_previousTransforms;
+}
+
+const SpatialHashGrid& MainComponentSystem::GetSpatialGrid() const {
+    return m_spatialGrid;
+}
+
+float MainComponentSystem::GetBlendFactor() const {
+
+    if (this->IsPipelined()) {
+        return m_snapshots.GetReadBuffer().blendFactor;
+    }
+
+    return m_blendFactor;
+}
@@ -1,18 +1,52 @@
 #pragma once
 
+#include <array>
 #include <vector>
+#include <string>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <optional>
 #include <glm/mat4x4.hpp>
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
 #include <glm/vec4.hpp>
 
 #include "../helpers/IComponentSystem.hpp"
+#include "../helpers/ecs/EntityRegistry.hpp"
+#include "../helpers/jobs/TaskGraph.hpp"
+#include "../helpers/jobs/TripleBuffer.hpp"
+#include "../helpers/spatial/SpatialHashGrid.hpp"
+#include "../helpers/random/CounterRng.hpp"
+#include "../helpers/memory/HugePageAllocator.hpp"
+#include "../helpers/timing/TimingWheel.hpp"
+
+class JobSystem;
 
 class MainComponentSystem : public IComponentSystem
 {
 public:
 
-	static constexpr uint32_t kMaxEntityCount = 1000000;
+	/**
+	 * Columns reserve address space up to it and commit pages as entities are added. The instanced renderers
+	 * may draw fewer, see MainRenderer::FitInstanceCapacity.
+	 */
+	static constexpr uint32_t kMaxEntityCount = 32 * 1024 * 1024;
+	static constexpr uint32_t kDefaultEntityCount = 100000;
+
+	/**
+	 * Relative to the working directory, which is the asset folder when started from the IDE.
+	 */
+	static constexpr const char* kDefaultScenePath = "scene.bin";
+
+	static constexpr uint64_t kDefaultSeed = 0x5EED;
+
+	/**
+	 * Component storage. Pages come from HugePages::Reserve and are first touched by the parallel initialization.
+	 * Reserve the full capacity before use and commit the elements before growing into them, see CommitColumn.
+	 */
+	template<typename T>
+	using Column = std::vector<T, ReservedPageAllocator<T>>;
 
 	struct Transform
 	{
@@ -31,9 +65,17 @@ public:
 	{
 		glm::vec4 center;
 		float amplitude;
+
+		/**
+		 * Used to be the entity's array index. Stored explicitly, because swap-remove moves entities around.
+		 */
+		float phase;
 	};
 
-	struct Animation
+	/**
+	 * Shared by every entity playing the animation, see RegisterAnimation.
+	 */
+	struct AnimationDefinition
 	{
 		Sprite originalSprite;
 
@@ -41,24 +83,421 @@ public:
 		float delay;
 	};
 
+	using AnimationID = uint16_t;
+	static constexpr AnimationID kDefaultAnimation = 0;
+	static constexpr uint32_t kMaxAnimationDefinitionCount = UINT16_MAX + 1;
 
+	/**
+	 * Per-entity part of the animation. Everything else is looked up in the definition table.
+	 */
+	struct Animation
+	{
+		AnimationID definition;
 
-	MainComponentSystem();
+		/**
+		 * Frames the entity is ahead of the others in 8.8 fixed point, so they neither show the same frame
+		 * nor flip frames at the same time.
+		 */
+		uint16_t phase;
+	};
+
+	/**
+	 * \param initialEntityCount Randomly generated entities. Pass 0 when a scene is loaded right after.
+	 * \param seed Entities are a pure function of the seed and their handle, independent of the thread count.
+	 */
+	explicit MainComponentSystem(JobSystem* jobSystem, uint32_t initialEntityCount = kDefaultEntityCount, uint64_t seed = kDefaultSeed);
+	~MainComponentSystem() override;
 
 	void Update() override;
 
+	/**
+	 * Update at the given time instead of the current one, so that two systems can be stepped in lockstep.
+	 */
+	void UpdateAt(double currentTime);
+
+	/**
+	 * Movement and animation do not depend on each other, so they are added as two independent tasks.
+	 *
+	 * In pipelined mode no tasks are added. The latest complete snapshot is picked up instead,
+	 * and the simulation thread is told to start on the next frame.
+	 */
+	void Schedule(TaskGraph& graph) override;
+
+	/**
+	 * Simulates at a fixed rate instead of once per frame. 0 goes back to once per frame.
+	 * Rendering interpolates between the last two steps, see GetPreviousTransforms and GetBlendFactor.
+	 * Applied by the next Update/Schedule.
+	 */
+	void RequestSimulationRate(uint32_t stepsPerSecond);
+	[[nodiscard]] uint32_t GetRequestedSimulationRate() const;
+
+	/**
+	 * Runs the simulation on its own thread, one frame ahead of rendering.
+	 * Applied by the next Schedule, like RequestEntityCount.
+	 */
+	void RequestPipelined(bool pipelined);
+	[[nodiscard]] bool IsPipelined() const;
+
+	/**
+	 * Entities are sorted into tiers by their distance to the camera, see SetViewProjection.
+	 * Visible entities closer than nearDistance are simulated every frame, visible entities further away
+	 * every 4th frame and off-screen entities every 16th. Slower tiers are time-sliced round-robin,
+	 * so every frame handles an equal share of them.
+	 *
+	 * Only applies while simulating once per frame. A fixed simulation rate already throttles everything.
+	 */
+	struct UpdateTierDesc
+	{
+		bool enabled = false;
+		float nearDistance = 60.0f;
+	};
+
+	/**
+	 * Applied by the next Update/Schedule.
+	 */
+	void RequestUpdateTiers(const UpdateTierDesc& desc);
+	[[nodiscard]] UpdateTierDesc GetRequestedUpdateTiers() const;
+
+	/**
+	 * Camera the update tiers are chosen from. Safe to call while the scheduled tasks are running.
+	 */
+	void SetViewProjection(const glm::mat4& viewProjection);
+
+	/**
+	 * Entities moved and animated by the last update, summed over all fixed steps.
+	 * Equal to the entity count without update tiers.
+	 */
+	[[nodiscard]] uint32_t GetUpdatedEntityCount() const;
+
+	/**
+	 * Instead of recomputing every sprite every update, a timing wheel schedules each entity's next frame change
+	 * and only the entities whose frame flips are touched. See GetSpriteChanges.
+	 * Applied by the next Update/Schedule.
+	 */
+	void RequestEventDrivenAnimation(bool eventDriven);
+	[[nodiscard]] bool GetRequestedEventDrivenAnimation() const;
+
+	struct SpriteChanges
+	{
+		/**
+		 * Incremented by every update.
+		 */
+		uint64_t version;
+
+		/**
+		 * Dense indices whose sprite changed from version - 1 to version, possibly more than once.
+		 * Null when any sprite may have changed.
+		 */
+		const std::vector<uint32_t>* changed;
+	};
+
+	/**
+	 * Lets renderers upload only the changed sprites, as long as they uploaded the previous version.
+	 * Ready after the animation task. Always reports everything as changed in pipelined mode.
+	 */
+	[[nodiscard]] SpriteChanges GetSpriteChanges() const;
+
+	/**
+	 * Sprites rewritten by the last update. Equal to the entity count unless the animation is event driven.
+	 */
+	[[nodiscard]] uint32_t GetChangedSpriteCount() const;
+
+	struct ScheduledTasks
+	{
+		TaskGraph::TaskID movement = TaskGraph::kInvalidTask;
+		TaskGraph::TaskID animation = TaskGraph::kInvalidTask;
+		TaskGraph::TaskID spatialGrid = TaskGraph::kInvalidTask;
+	};
+
+	/**
+	 * Tasks added by the last Schedule call. Transforms are ready after movement, sprites after animation,
+	 * the spatial grid after spatialGrid.
+	 */
+	[[nodiscard]] ScheduledTasks GetScheduledTasks() const;
+
+	/**
+	 * Adds a definition to the table. kDefaultAnimation is registered by the constructor.
+	 * Like Spawn, must not be called in pipelined mode or while the scheduled tasks are running.
+	 */
+	AnimationID RegisterAnimation(const AnimationDefinition& definition);
+	[[nodiscard]] const std::vector<AnimationDefinition>& GetAnimationDefinitions() const;
+
+	/**
+	 * Spawn, Despawn and SetEntityCount must not be called in pipelined mode, use RequestEntityCount.
+	 */
+	Entity Spawn();
+	void Despawn(Entity entity);
+	[[nodiscard]] bool IsAlive(Entity entity) const;
+
+	/**
+	 * Spawns or despawns entities from the back of the dense arrays until the count matches.
+	 */
 	void SetEntityCount(uint32_t newEntityCount);
 	[[nodiscard]] uint32_t GetEntityCount() const;
 
-	[[nodiscard]] const std::vector<Transform>& GetTransforms() const;
-	[[nodiscard]] const std::vector<Sprite>& GetSprites() const;
+	/**
+	 * Same as SetEntityCount, but deferred until the next Update/Schedule.
+	 * Safe to call while the scheduled tasks are running.
+	 */
+	void RequestEntityCount(uint32_t newEntityCount);
+
+	/**
+	 * The pending request if there is one, the current count otherwise.
+	 */
+	[[nodiscard]] uint32_t GetRequestedEntityCount() const;
+
+	/**
+	 * Writes all the entities to a scene file, see SceneFile. Entity handles are not stored.
+	 * Must not be called in pipelined mode or while the scheduled tasks are running, use the Request versions.
+	 */
+	void SaveScene(const std::string& path) const;
+
+	/**
+	 * Replaces all the entities with the ones from the scene file. Existing handles become invalid.
+	 * The columns are copied out of the mapping in bulk, nothing is generated.
+	 */
+	void LoadScene(const std::string& path);
+
+	/**
+	 * Deferred like RequestEntityCount. Errors are logged instead of thrown.
+	 */
+	void RequestSceneSave(const std::string& path);
+	void RequestSceneLoad(const std::string& path);
+
+	/**
+	 * Dense component arrays. Element i of every array belongs to GetEntities()[i].
+	 * In pipelined mode these, and GetEntityCount, come from the snapshot picked up by the last Schedule.
+	 * Every column reserves address space for kMaxEntityCount elements and never reallocates, so renderers may
+	 * import the storage as device memory. Only the pages in use are committed. Fixed-rate steps swap the current and previous transforms.
+	 */
+	[[nodiscard]] const std::vector<Entity>& GetEntities() const;
+	[[nodiscard]] const Column<Transform>& GetTransforms() const;
+	[[nodiscard]] const Column<Sprite>& GetSprites() const;
+
+	/**
+	 * Transforms of the step before the current one. Only kept up to date with a fixed simulation rate.
+	 */
+	[[nodiscard]] const Column<Transform>& GetPreviousTransforms() const;
+
+	/**
+	 * Index over the current transforms, rebuilt every update. Query results are dense indices.
+	 * In pipelined mode it belongs to the simulation thread and must not be queried from outside.
+	 */
+	[[nodiscard]] const SpatialHashGrid& GetSpatialGrid() const;
+
+	/**
+	 * How far rendering is between the previous and the current transforms.
+	 * Always 1 when simulating once per frame, so the previous transforms can be ignored.
+	 */
+	[[nodiscard]] float GetBlendFactor() const;
 private:
 
-	uint32_t m_entityCount;
+	/**
+	 * Smaller ranges are not worth a job.
+	 */
+	static constexpr uint32_t kMinBatchSize = 4096;
+
+	/**
+	 * Steps beyond this are dropped after a hitch, so a slow step can not snowball into slower frames.
+	 */
+	static constexpr uint32_t kMaxStepsPerUpdate = 4;
+
+	void UpdateMovement(double currentTime);
+	void UpdateAnimation(double currentTime);
+	void UpdateSpatialGrid();
+
+	/**
+	 * Movement and animation of the entities whose tier is due this frame, in a single pass.
+	 */
+	void UpdateTiered(double currentTime);
+	void ClassifyUpdateTiers();
+
+	/**
+	 * Fills m_animationFrames for the given time.
+	 */
+	void UpdateAnimationFrames(double currentTime);
+
+	/**
+	 * Event-driven animation, updates the entities whose frame flipped since the last call.
+	 */
+	void AdvanceAnimationWheel(double currentTime);
+	void UpdateAllSprites(double currentTime);
+	void RebuildAnimationWheel(double currentTime);
+
+	/**
+	 * Starts a new version of the sprite changes. Called before the animation of an update runs.
+	 */
+	void BeginSpriteChanges();
+	void ApplyRequests();
+
+	/**
+	 * Fills every column at the dense index with the initial state of its entity.
+	 * The columns must already be large enough.
+	 */
+	void InitializeEntity(uint32_t denseIndex);
+	void ResizeColumns(uint32_t entityCount);
+
+	/**
+	 * Adds the time since the last call to the accumulator and updates the blend factor.
+	 * \return Number of fixed steps to run.
+	 */
+	uint32_t AdvanceFixedTime(double currentTime);
+	void RunFixedSteps(uint32_t stepCount);
+
+	void StartSimulationThread();
+	void StopSimulationThread();
+	void SimulationLoop();
+	void PublishSnapshot();
+
+	/**
+	 * Every random value of an entity comes from its own counter, see InitializeEntity.
+	 */
+	enum RandomStream : uint64_t
+	{
+		CenterX,
+		CenterY,
+		CenterZ,
+		Amplitude,
+		AnimationPhase,
+		RandomStreamCount
+	};
+
+	/**
+	 * Classified by ClassifyUpdateTiers from the distance along the view direction and the frustum.
+	 */
+	enum UpdateTier : uint32_t
+	{
+		NearTier,
+		FarTier,
+		OffScreenTier,
+		UpdateTierCount
+	};
+
+	/**
+	 * An entity in tier t is updated every kUpdateTierPeriods[t] frames.
+	 */
+	static constexpr std::array<uint32_t, UpdateTierCount> kUpdateTierPeriods = { 1, 4, 16 };
+
+	/**
+	 * Entities are sorted into tiers again every this many frames, a full round of the slowest tier.
+	 */
+	static constexpr uint32_t kUpdateTierRefreshPeriod = 16;
+
+	/**
+	 * Entities slightly outside the frustum still count as visible, so they do not pop in after moving.
+	 */
+	static constexpr float kVisibilityMargin = 1.1f;
+
+	/**
+	 * Resolution of the animation timing wheel, in ticks per second.
+	 */
+	static constexpr double kAnimationTickRate = 1000.0;
+
+	/**
+	 * Column IDs in scene files. Never reuse a value.
+	 */
+	enum SceneColumn : uint32_t
+	{
+		MoveComponents = 1,
+		Animations = 2,
+		Transforms = 3,
+		Sprites = 4,
+		AnimationDefinitions = 5,
+	};
+
+	template<typename T>
+	static void SwapRemove(Column<T>& column, const EntityRegistry::DespawnResult& result);
+
+	/**
+	 * Commits the pages for the first count elements. Needed before resize or assign grows the column.
+	 */
+	template<typename T>
+	static void CommitColumn(Column<T>& column, size_t count);
+
+	struct Snapshot
+	{
+		std::vector<Entity> entities;
+		Column<Transform> transforms;
+		Column<Sprite> sprites;
+		Column<Transform> previousTransforms;
+		float blendFactor = 1.0f;
+	};
+
+	JobSystem* m_jobSystem;
+	ScheduledTasks m_scheduledTasks{};
+
+	// Written by the main thread, applied by whichever thread runs the simulation.
+	mutable std::mutex m_requestMutex;
+	std::optional<uint32_t> m_requestedEntityCount;
+	std::optional<uint32_t> m_requestedSimulationRate;
+	std::optional<std::string> m_requestedSceneSave;
+	std::optional<std::string> m_requestedSceneLoad;
+	std::optional<UpdateTierDesc> m_requestedUpdateTiers;
+	bool m_requestedEventDrivenAnimation = false;
+	glm::mat4 m_requestedViewProjection{ 1.0f };
+
+	uint32_t m_simulationRate = 0;
+	double m_simulationTime = 0.0;
+	double m_lastUpdateTime = 0.0;
+	double m_accumulatedTime = 0.0;
+	float m_blendFactor = 1.0f;
+
+	UpdateTierDesc m_updateTiers{};
+	glm::mat4 m_viewProjection{ 1.0f };
+	uint64_t m_tieredFrame = 0;
+
+	/**
+	 * Dense indices of the entities in every tier. Rebuilt whenever the dense order changes.
+	 */
+	std::array<std::vector<uint32_t>, UpdateTierCount> m_tierEntities;
+	bool m_tiersStale = true;
+
+	// Per batch tier lists of ClassifyUpdateTiers, merged in batch order afterwards.
+	std::vector<std::array<std::vector<uint32_t>, UpdateTierCount>> m_tierBatches;
+
+	// Read by the UI while the simulation thread writes it.
+	std::atomic<uint32_t> m_updatedEntityCount{ 0 };
+
+	bool m_requestedPipelined = false;
+	std::thread m_simulationThread;
+	std::atomic<bool> m_simulationRunning{ false };
+	std::atomic<bool> m_simulationStepRequested{ false };
+	TripleBuffer<Snapshot> m_snapshots;
+
+	EntityRegistry m_registry;
+
+	Column<Transform> m_transforms;
+	Column<Transform> m_previousTransforms;
+	Column<MoveComponent> m_moveComponents;
+
+	Column<Sprite> m_sprites;
+	Column<Animation> m_animations;
+
+	std::vector<AnimationDefinition> m_animationDefinitions;
+
+	/**
+	 * Frame every definition is on at the time of the current update, before the entity's phase is added.
+	 */
+	std::vector<float> m_animationFrames;
+
+	bool m_eventDrivenAnimation = false;
+	TimingWheel m_animationWheel;
+
+	/**
+	 * The wheel holds dense indices and next flip times, both change with the dense order and the definitions.
+	 */
+	bool m_animationWheelStale = true;
+
+	uint64_t m_spriteVersion = 0;
+	bool m_allSpritesChanged = true;
+	std::vector<uint32_t> m_changedSprites;
+
+	// AdvanceAnimationWheel scratch, kept around to avoid reallocating every frame.
+	std::vector<uint32_t> m_expiredSprites;
+	std::vector<uint64_t> m_nextFrameTicks;
+	std::atomic<uint32_t> m_changedSpriteCount{ 0 };
 
-	std::vector<Transform> m_transforms;
-	std::vector<MoveComponent> m_moveComponents;
+	SpatialHashGrid m_spatialGrid;
 
-	std::vector<Sprite> m_sprites;
-	std::vector<Animation> m_animations;
+	CounterRng m_rng;
 };
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include "MainRenderer.hpp"
 
 #include <imgui.h>
+#include <tracy/Tracy.hpp>
 
 #include "MainComponentSystem.hpp"
 #include "MainRenderPipeline.hpp"
@@ -9,6 +10,7 @@
 #include "../App.hpp"
 #include "../helpers/buffers/LocalBuffer.hpp"
 #include "../helpers/buffers/StagingBuffer.hpp"
+#include "../helpers/buffers/FrameArena.hpp"
 #include "../helpers/textures/Sampler.hpp"
 #include "../helpers/Shader.hpp"
 #include "../helpers/ShaderLayout.hpp"
@@ -24,31 +26,30 @@ void MainRenderer::Initialize(const std::string& vertexShader, const std::string
 
     this->CreateVertexBuffer();
     this->CreateIndexBuffer();
-    this->CreateUniformBuffers();
 
     m_vertexShader = std::make_unique<Shader>(m_context->GetDevice(), vertexShader, Shader::Type::Vertex);
     m_fragmentShader = std::make_unique<Shader>(m_context->GetDevice(), fragmentShader, Shader::Type::Fragment);
 
-    m_shaderLayout = std::make_unique<ShaderLayout>(m_context->GetDevice(), m_vertexShader.get(), m_fragmentShader.get());
+    m_shaderLayout = std::make_unique<ShaderLayout>(m_context->GetDevice(), m_vertexShader.get(), m_fragmentShader.get(), std::vector<std::string>{ "Matrices" });
 
     m_mainRenderPipeline = std::make_unique<MainRenderPipeline>(m_context, m_shaderLayout.get(), this->GetVertexFormat());
 
-    m_sampler = std::make_unique<Sampler>(m_context, "textures/Coin-sheet.png");
+    m_sampler = m_context->GetResourcePool()->AcquireSampler("textures/Coin-sheet.png");
 
-    m_shaderLayout->AttachBuffer("Matrices", m_uniformMatrixBuffer.get(), 0, m_uniformMatrixBuffer->GetBufferSize());
+    // Attached once at the start of the arena, every frame only moves the dynamic offset to its slice.
+    m_shaderLayout->AttachBuffer("Matrices", m_context->GetFrameArena()->GetBuffer(), 0, sizeof(UniformBufferObject));
     m_shaderLayout->AttackSampler("DiffuseSampler", m_sampler.get());
 }
 
 void MainRenderer::Destroy() {
 
-    m_sampler->Destroy();
+    m_context->GetResourcePool()->ReleaseSampler(std::move(m_sampler));
 
     m_mainRenderPipeline->Destroy();
 	m_vertexShader->Destroy();
     m_fragmentShader->Destroy();
     m_shaderLayout->Destroy();
 
-    this->DestroyUniformBuffers();
     this->DestroyIndexBuffer();
     this->DestroyVertexBuffer();
 }
@@ -56,16 +57,58 @@ void MainRenderer::Destroy() {
 void MainRenderer::Record(const MainRenderer::RecordDesc& desc) {
 
     const VkCommandBuffer commandBuffer = desc.commandBuffer;
+    m_frameGraph = desc.frameGraph;
 
     static bool updateBuffers = true;
-    static int entityCount = static_cast<int>(m_componentSystem->GetEntityCount());
+    static bool pipelinedSimulation = false;
+    static int simulationRate = static_cast<int>(m_componentSystem->GetRequestedSimulationRate());
+
+    ImGui::Checkbox("Pipelined simulation", &pipelinedSimulation);
+    m_componentSystem->RequestPipelined(pipelinedSimulation);
+
+    // 0 simulates once per frame.
+    ImGui::SliderInt("Simulation Rate (Hz)", &simulationRate, 0, 240);
+    m_componentSystem->RequestSimulationRate(simulationRate);
+
+    static MainComponentSystem::UpdateTierDesc updateTiers = m_componentSystem->GetRequestedUpdateTiers();
+    ImGui::Checkbox("Update tiers", &updateTiers.enabled);
+    ImGui::SliderFloat("Near tier distance", &updateTiers.nearDistance, 0, 200);
+    m_componentSystem->RequestUpdateTiers(updateTiers);
+
+    static bool eventDrivenAnimation = m_componentSystem->GetRequestedEventDrivenAnimation();
+    ImGui::Checkbox("Event-driven animation", &eventDrivenAnimation);
+    m_componentSystem->RequestEventDrivenAnimation(eventDrivenAnimation);
+
+    const uint32_t changedSpriteCount = m_componentSystem->GetChangedSpriteCount();
+    ImGui::Text("Sprites changed: %u", changedSpriteCount);
+    TracyPlot("Sprites changed", static_cast<int64_t>(changedSpriteCount));
+
+    const uint32_t updatedEntityCount = m_componentSystem->GetUpdatedEntityCount();
+    ImGui::Text("Entities updated: %u", updatedEntityCount);
+    TracyPlot("Entities updated", static_cast<int64_t>(updatedEntityCount));
 
     ImGui::Checkbox("Update buffers", &updateBuffers);
     if (updateBuffers) {
         this->UpdateBuffers();
     }
-    ImGui::SliderInt("Entity Count", &entityCount, 0, m_maxEntityCount);
-    m_componentSystem->SetEntityCount(entityCount);
+
+    // Only sent on change, so loading a scene is not overridden by the slider.
+    int entityCount = static_cast<int>(m_componentSystem->GetRequestedEntityCount());
+    if (ImGui::SliderInt("Entity Count", &entityCount, 0, m_maxEntityCount)) {
+        m_componentSystem->RequestEntityCount(entityCount);
+    }
+
+    if (m_componentSystem->GetEntityCount() > m_maxEntityCount) {
+        ImGui::Text("Drawing %u of the entities, the memory budget is exhausted", m_maxEntityCount);
+    }
+
+    if (ImGui::Button("Save scene")) {
+        m_componentSystem->RequestSceneSave(MainComponentSystem::kDefaultScenePath);
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Load scene")) {
+        m_componentSystem->RequestSceneLoad(MainComponentSystem::kDefaultScenePath);
+    }
 
     const VkViewport viewport = {
         .x = 0, .y = 0,
@@ -84,34 +127,98 @@ void MainRenderer::Record(const MainRenderer::RecordDesc& desc) {
 
     vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_mainRenderPipeline->GetVkPipeline());
 
+    this->PushUniforms();
     m_shaderLayout->BindDescriptors(commandBuffer);
 
+    this->ShowMemoryBudget();
+
     this->Draw(commandBuffer);
 }
 
-void MainRenderer::UpdateBuffers() {
+uint32_t MainRenderer::FitInstanceCapacity(VkMemoryPropertyFlags memoryProperty, VkDeviceSize bytesPerInstance) {
 
-    this->UpdateUniformBuffers();
+    // The pool frees what it retains when an allocation would not fit otherwise, and it may hold the very buffers
+    // this renderer had the last time.
+    const VkDeviceSize available = m_context->GetDevice()->GetDeviceMemory()->GetAvailableBudget(memoryProperty) + m_context->GetResourcePool()->GetRetainedSize();
+    const VkDeviceSize capacity = static_cast<VkDeviceSize>(static_cast<double>(available) * kInstanceBudgetShare) / bytesPerInstance;
+
+    if (capacity == 0) {
+        throw std::runtime_error(std::format("[MainRenderer] Not a single instance fits into the remaining budget of {} bytes", available));
+    }
+    if (capacity < m_maxEntityCount) {
+        spdlog::warn("[MainRenderer] Only {} of {} instances fit into the remaining budget of {:.2f} MB", capacity, m_maxEntityCount, static_cast<double>(available) / 1024.0 / 1024.0);
+        m_maxEntityCount = static_cast<uint32_t>(capacity);
+    }
+
+    return m_maxEntityCount;
+}
+
+uint32_t MainRenderer::GetInstanceCount() const {
+    return std::min(m_componentSystem->GetEntityCount(), m_maxEntityCount);
+}
+
+VkDeviceSize MainRenderer::GetResidentInstanceSize() const {
+    return 0;
 }
 
-void MainRenderer::CreateUniformBuffers() {
+void MainRenderer::ShowMemoryBudget() const {
 
-    GenericBuffer::Desc desc = {
-        .bufferCreateInfo = VkBufferCreateInfo {
-            .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-            .size = sizeof(UniformBufferObject),
-            .usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-            .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
-        },
-        .memoryProperty = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
-    };
+    if (!ImGui::CollapsingHeader("Memory budget")) {
+        return;
+    }
+
+    ImGui::Text("Resident instance memory: %.2f MB for %u instances", static_cast<double>(this->GetResidentInstanceSize()) / 1024.0 / 1024.0,
+        this->GetInstanceCount());
+
+    const std::vector<DeviceMemory::HeapBudget>& heapBudgets = m_context->GetDevice()->GetDeviceMemory()->GetHeapBudgets();
+    for (uint32_t heapIndex = 0; heapIndex < heapBudgets.size(); heapIndex++) {
 
-    m_uniformMatrixBuffer = std::make_unique<GenericBuffer>(m_context, desc);
-    m_uniformMatrixBuffer->MapMemory(m_uniformMatrixBuffer->GetBufferSize());
+        const DeviceMemory::HeapBudget& heap = heapBudgets[heapIndex];
+        const bool deviceLocal = (heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
 
+        ImGui::Text("Heap %u (%s): %.1f / %.1f MB", heapIndex, deviceLocal ? "device" : "host",
+            static_cast<double>(heap.usage) / 1024.0 / 1024.0, static_cast<double>(heap.budget) / 1024.0 / 1024.0);
+
+        for (uint32_t category = 0; category < DeviceMemory::kCategoryCount; category++) {
+
+            if (heap.categoryUsage[category] == 0) {
+                continue;
+            }
+            ImGui::Text("    %s: %.2f MB", DeviceMemory::GetCategoryName(static_cast<MemoryCategory>(category)),
+                static_cast<double>(heap.categoryUsage[category]) / 1024.0 / 1024.0);
+        }
+    }
+
+    const DeviceMemory::Snapshot snapshot = m_context->GetDevice()->GetDeviceMemory()->GetSnapshot();
+    ImGui::Text("Resources: %u, %.2f MB live, %.2f MB peak", snapshot.resources.liveCount,
+        static_cast<double>(snapshot.resources.liveSize) / 1024.0 / 1024.0, static_cast<double>(snapshot.resources.highWaterMark) / 1024.0 / 1024.0);
+    ImGui::Text("Last frame: %llu allocations, %llu frees", static_cast<unsigned long long>(snapshot.frame.allocationCount),
+        static_cast<unsigned long long>(snapshot.frame.freeCount));
+
+    const ResourcePool* resourcePool = m_context->GetResourcePool();
+    ImGui::Text("Resource pool: %u retained, %.1f MB, %u hits, %u misses", resourcePool->GetRetainedCount(),
+        static_cast<double>(resourcePool->GetRetainedSize()) / 1024.0 / 1024.0, resourcePool->GetHitCount(), resourcePool->GetMissCount());
+
+    Defragmenter* defragmenter = m_context->GetDefragmenter();
+    const Defragmenter::Stats defragmentation = defragmenter->GetStats();
+
+    ImGui::Text("Blocks: %u, %.1f / %.1f MB used", defragmentation.blockCount,
+        static_cast<double>(defragmentation.blockUsedSize) / 1024.0 / 1024.0, static_cast<double>(defragmentation.blockSize) / 1024.0 / 1024.0);
+    ImGui::Text("Defragmentation: %u buffers, %u moves, %.1f MB moved, %u blocks freed", defragmentation.registeredCount,
+        defragmentation.moveCount, static_cast<double>(defragmentation.movedSize) / 1024.0 / 1024.0, defragmentation.freedBlockCount);
+
+    bool defragment = defragmenter->IsEnabled();
+    if (ImGui::Checkbox("Defragment", &defragment)) {
+        defragmenter->SetEnabled(defragment);
+    }
+}
+
+void MainRenderer::UpdateBuffers() {
+
+    this->UpdateUniformBuffers();
 }
 
-void MainRenderer::UpdateUniformBuffers() const {
+void MainRenderer::UpdateUniformBuffers() {
 
     int width, height;
     m_context->GetScreenSize(width, height);
@@ -119,22 +226,46 @@ void MainRenderer::UpdateUniformBuffers() const {
     static float camZOffset = -20;
     ImGui::SliderFloat("Camera Z Offset", &camZOffset, -200, 0);
 
-    const MainRenderer::UniformBufferObject ubo = {
+    m_uniforms = {
         .view = glm::translate(glm::identity<glm::mat4>(), glm::vec3(0, 0, camZOffset)),
-        .proj = glm::perspective(glm::radians(45.0f), static_cast<float>(width) / static_cast<float>(height), 0.1f, 1000.0f)
+        .proj = glm::perspective(glm::radians(45.0f), static_cast<float>(width) / static_cast<float>(height), 0.1f, 1000.0f),
+        .blendFactor = m_componentSystem->GetBlendFactor()
     };
 
-    void* mappedUboPtr = m_uniformMatrixBuffer->GetMappedMemory();
-    std::memcpy(mappedUboPtr, &ubo, sizeof(ubo));
+    m_componentSystem->SetViewProjection(m_uniforms.proj * m_uniforms.view);
 }
 
-void MainRenderer::DestroyUniformBuffers() {
+void MainRenderer::PushUniforms() const {
 
-    m_uniformMatrixBuffer->Destroy();
-    m_uniformMatrixBuffer = nullptr;
+    const FrameArena::Slice slice = m_context->GetFrameArena()->Push(m_uniforms);
+    m_shaderLayout->SetDynamicOffset("Matrices", static_cast<uint32_t>(slice.offset));
+}
+
+ResourcePool::BufferKey MainRenderer::GetVertexBufferKey() {
+    return {
+        .size = sizeof(MainRenderer::Vertex) * 4,
+        .usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+        .memoryProperty = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        .content = "MainRenderer quad vertices"
+    };
+}
+
+ResourcePool::BufferKey MainRenderer::GetIndexBufferKey() {
+    return {
+        .size = sizeof(uint16_t) * 6,
+        .usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+        .memoryProperty = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        .content = "MainRenderer quad indices"
+    };
 }
 
 void MainRenderer::CreateVertexBuffer() {
+
+    m_vertexBuffer = m_context->GetResourcePool()->AcquireBuffer(MainRenderer::GetVertexBufferKey());
+    if (m_vertexBuffer != nullptr) {
+        return;
+    }
+
     const std::vector<MainRenderer::Vertex> vertices = {
         {{-0.5f, -0.5f, 0.0f}, -1},
         {{-0.5f,  0.5f, 0.0f}, 0xFF03102},
@@ -145,7 +276,8 @@ void MainRenderer::CreateVertexBuffer() {
     LocalBuffer::Desc vertexDesc = {
         .usageFlags = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
         .buffer = vertices.data(),
-        .bufferSize = sizeof(MainRenderer::Vertex) * vertices.size()
+        .bufferSize = sizeof(MainRenderer::Vertex) * vertices.size(),
+        .category = MemoryCategory::Vertex
     };
 
     m_vertexBuffer = std::make_unique<LocalBuffer>(m_context, vertexDesc);
@@ -153,23 +285,29 @@ void MainRenderer::CreateVertexBuffer() {
 
 void MainRenderer::DestroyVertexBuffer() {
 
-    m_vertexBuffer->Destroy();
-    m_vertexBuffer = nullptr;
+    m_context->GetResourcePool()->ReleaseBuffer(MainRenderer::GetVertexBufferKey(), std::move(m_vertexBuffer));
 }
 
 void MainRenderer::CreateIndexBuffer() {
+
+    m_indexBuffer = m_context->GetResourcePool()->AcquireBuffer(MainRenderer::GetIndexBufferKey());
+    if (m_indexBuffer != nullptr) {
+        return;
+    }
+
     const std::vector<uint16_t> indices = { 0, 1, 2, 2, 3, 0 };
 
     LocalBuffer::Desc desc = {
         .usageFlags = VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
         .buffer = indices.data(),
-        .bufferSize = static_cast <uint32_t>(sizeof(uint16_t) * indices.size())
+        .bufferSize = static_cast <uint32_t>(sizeof(uint16_t) * indices.size()),
+        .category = MemoryCategory::Index
     };
 
     m_indexBuffer = std::make_unique<LocalBuffer>(m_context, desc);
 }
 
 void MainRenderer::DestroyIndexBuffer() {
-    m_indexBuffer->Destroy();
-    m_indexBuffer = nullptr;
+
+    m_context->GetResourcePool()->ReleaseBuffer(MainRenderer::GetIndexBufferKey(), std::move(m_indexBuffer));
 }
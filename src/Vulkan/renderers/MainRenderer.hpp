@@ -12,6 +12,7 @@
 #include "../helpers/textures/Sampler.hpp"
 #include "../helpers/ShaderLayout.hpp"
 #include "../helpers/Shader.hpp"
+#include "../helpers/ResourcePool.hpp"
 
 class Context;
 class DeviceQueue;
@@ -19,11 +20,17 @@ class GenericBuffer;
 class StagingBuffer;
 class IRenderPipeline;
 class MainComponentSystem;
+class TaskGraph;
 
 class MainRenderer : public IRenderer
 {
 public:
 
+	/**
+	 * Share of the remaining budget that the instance buffers may take up.
+	 */
+	static constexpr double kInstanceBudgetShare = 0.75;
+
 	explicit MainRenderer(const Context* context, MainComponentSystem* componentSystem);
 
 	void Initialize(const std::string& vertexShader, const std::string& fragmentShader) override;
@@ -37,6 +44,11 @@ protected:
 	{
 		glm::mat4 view;
 		glm::mat4 proj;
+
+		/**
+		 * Interpolation between the previous and the current simulation step. 1 means current only.
+		 */
+		float blendFactor;
 	};
 
 	struct Vertex
@@ -48,9 +60,19 @@ protected:
 	virtual void Draw(VkCommandBuffer commandBuffer) = 0;
 	virtual void UpdateBuffers();
 
-	void CreateUniformBuffers();
-	void UpdateUniformBuffers() const;
-	void DestroyUniformBuffers();
+	void UpdateUniformBuffers();
+
+	/**
+	 * Copies m_uniforms into the frame arena and points the "Matrices" binding at it. Done every frame, even when
+	 * the uniforms were not updated, since the previous slice is gone once the arena is reset.
+	 */
+	void PushUniforms() const;
+
+	/**
+	 * The quad is the same for every renderer, so it is kept in the resource pool under these keys.
+	 */
+	static ResourcePool::BufferKey GetVertexBufferKey();
+	static ResourcePool::BufferKey GetIndexBufferKey();
 
 	void CreateVertexBuffer();
 	void DestroyVertexBuffer();
@@ -60,16 +82,44 @@ protected:
 
 	virtual MainRenderPipeline::VertexFormat GetVertexFormat() const = 0;
 
+	/**
+	 * Lowers m_maxEntityCount so the instance buffers fit into the budget of the heap they are allocated from.
+	 * Called before the instance buffers are created, which may then grow up to the returned capacity.
+	 */
+	uint32_t FitInstanceCapacity(VkMemoryPropertyFlags memoryProperty, VkDeviceSize bytesPerInstance);
+
+	/**
+	 * Entities beyond the instance capacity are still simulated, just not drawn.
+	 */
+	[[nodiscard]] uint32_t GetInstanceCount() const;
+
+	/**
+	 * Bytes of instance storage currently allocated, shown in the debug window.
+	 */
+	[[nodiscard]] virtual VkDeviceSize GetResidentInstanceSize() const;
+
+	void ShowMemoryBudget() const;
+
 	const Context* m_context;
 	MainComponentSystem* m_componentSystem;
 
+	/**
+	 * Graph of the frame that is currently being recorded. Uploads that depend on the simulation are added as tasks.
+	 */
+	TaskGraph* m_frameGraph{};
+
 	std::unique_ptr<Shader> m_fragmentShader;
 	std::unique_ptr<Shader> m_vertexShader;
 	std::unique_ptr<ShaderLayout> m_shaderLayout;
 
 	std::unique_ptr<GenericBuffer> m_vertexBuffer;
 	std::unique_ptr<GenericBuffer> m_indexBuffer;
-	std::unique_ptr<GenericBuffer> m_uniformMatrixBuffer;
+
+	UniformBufferObject m_uniforms = {
+		.view = glm::mat4(1.0f),
+		.proj = glm::mat4(1.0f),
+		.blendFactor = 1.0f
+	};
 
 	std::unique_ptr<Sampler> m_sampler;
 	std::unique_ptr<IRenderPipeline> m_mainRenderPipeline;